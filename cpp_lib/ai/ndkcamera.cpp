@@ -22,6 +22,13 @@
 
 #include "ncnn/mat.h"
 
+#include "ndk_utils/cpu_topology.h"
+#include "ndk_utils/worker_pool.h"
+
+// below this many pixels a band the frame is copied on the camera thread alone
+static const int WINDOW_COPY_MIN_BAND_PIXELS = 128 * 1024;
+static const int WINDOW_COPY_MAX_THREADS = 4;
+
 static void onDisconnected(void* context, ACameraDevice* device)
 {
     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onDisconnected %p", device);
@@ -434,6 +441,10 @@ NdkCameraWindow::NdkCameraWindow() : NdkCamera()
     sensor_manager = ASensorManager_getInstance();
 
     accelerometer_sensor = ASensorManager_getDefaultSensor(sensor_manager, ASENSOR_TYPE_ACCELEROMETER);
+
+    // persistent threads pinned to the inference cores, which are idle while a frame is shown
+    const std::vector<int>& cpus = cpu_topology::getPlacement().inference;
+    worker_pool = std::make_unique<WorkerPool>(std::min(WINDOW_COPY_MAX_THREADS, (int)cpus.size()), cpus);
 }
 
 NdkCameraWindow::~NdkCameraWindow()
@@ -749,38 +760,45 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
     // scale to target size
     if (buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM || buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM)
     {
-        for (int y = 0; y < render_h; y++)
+        // one band of rows per thread, or all of them here for small frames
+        const int band_count = worker_pool->getTaskCount((int64_t)render_w * render_h, WINDOW_COPY_MIN_BAND_PIXELS);
+        worker_pool->run(band_count, [&](int band)
         {
-            const unsigned char* ptr = rgb_render.ptr<const unsigned char>(y);
-            unsigned char* outptr = (unsigned char*)buf.bits + buf.stride * 4 * y;
-
-            int x = 0;
-#if __ARM_NEON
-            for (; x + 7 < render_w; x += 8)
+            const int y0 = (int)((int64_t)render_h * band / band_count);
+            const int y1 = (int)((int64_t)render_h * (band + 1) / band_count);
+            for (int y = y0; y < y1; y++)
             {
-                uint8x8x3_t _rgb = vld3_u8(ptr);
-                uint8x8x4_t _rgba;
-                _rgba.val[0] = _rgb.val[0];
-                _rgba.val[1] = _rgb.val[1];
-                _rgba.val[2] = _rgb.val[2];
-                _rgba.val[3] = vdup_n_u8(255);
-                vst4_u8(outptr, _rgba);
+                const unsigned char* ptr = rgb_render.ptr<const unsigned char>(y);
+                unsigned char* outptr = (unsigned char*)buf.bits + buf.stride * 4 * y;
 
-                ptr += 24;
-                outptr += 32;
-            }
+                int x = 0;
+#if __ARM_NEON
+                for (; x + 7 < render_w; x += 8)
+                {
+                    uint8x8x3_t _rgb = vld3_u8(ptr);
+                    uint8x8x4_t _rgba;
+                    _rgba.val[0] = _rgb.val[0];
+                    _rgba.val[1] = _rgb.val[1];
+                    _rgba.val[2] = _rgb.val[2];
+                    _rgba.val[3] = vdup_n_u8(255);
+                    vst4_u8(outptr, _rgba);
+
+                    ptr += 24;
+                    outptr += 32;
+                }
 #endif // __ARM_NEON
-            for (; x < render_w; x++)
-            {
-                outptr[0] = ptr[0];
-                outptr[1] = ptr[1];
-                outptr[2] = ptr[2];
-                outptr[3] = 255;
+                for (; x < render_w; x++)
+                {
+                    outptr[0] = ptr[0];
+                    outptr[1] = ptr[1];
+                    outptr[2] = ptr[2];
+                    outptr[3] = 255;
 
-                ptr += 3;
-                outptr += 4;
+                    ptr += 3;
+                    outptr += 4;
+                }
             }
-        }
+        });
     }
 
     ANativeWindow_unlockAndPost(win);
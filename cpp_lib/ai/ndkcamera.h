@@ -23,8 +23,12 @@
 #include <camera/NdkCameraMetadata.h>
 #include <media/NdkImageReader.h>
 
+#include <memory>
+
 #include <opencv2/core/core.hpp>
 
+class WorkerPool;
+
 class NdkCamera
 {
 public:
@@ -75,6 +79,9 @@ private:
     mutable ASensorEventQueue* sensor_event_queue;
     const ASensor* accelerometer_sensor;
     ANativeWindow* win;
+
+    // copies the frames to the window in row bands, see ndk_utils/worker_pool.h
+    std::unique_ptr<WorkerPool> worker_pool;
 };
 
 #endif // NDKCAMERA_H
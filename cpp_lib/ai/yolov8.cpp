@@ -55,3 +55,7 @@ int YOLOv8::load(AAssetManager* mgr, const char* parampath, const char* modelpat
 void YOLOv8::set_det_target_size(int target_size) {
     det_target_size = target_size;
 }
+
+void YOLOv8::set_num_threads(int num_threads) {
+    yolov8.opt.num_threads = num_threads;
+}
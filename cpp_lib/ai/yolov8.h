@@ -50,6 +50,7 @@ public:
     int load(AAssetManager* mgr, const char* parampath, const char* modelpath, bool use_gpu = false);
 
     void set_det_target_size(int target_size);
+    void set_num_threads(int num_threads);
 
     virtual int detect(const cv::Mat& rgb, std::vector<Object>& objects) = 0;
     virtual int draw(cv::Mat& rgb, const std::vector<Object>& objects) = 0;
@@ -1,5 +1,7 @@
 #include <unordered_map>
+#define DR_FLAC_IMPLEMENTATION 1
 #define DR_MP3_IMPLEMENTATION 1
+#define DR_WAV_IMPLEMENTATION 1
 #include <android/asset_manager.h>
 #include <android/input.h>
 #include <android_native_app_glue.h>
@@ -29,11 +31,15 @@
 #include "renderer/gl.h"
 #include "renderer/texture_renderer.hpp"
 
+#include "ndk_utils/cpu_topology.h"
 #include "ndk_utils/log.h"
 #include "ndk_utils/util.h"
 #include "ndk_utils/data_types.h"
 
 #include "audio/OboeEngine.h"
+#include "audio/PcmPack.h"
+#include "audio/dr_flac.h"
+#include "audio/dr_wav.h"
 #include "camera/CameraController.hpp"
 #include "camera/camera_engine.h"
 
@@ -42,12 +48,29 @@ PRINT_MACRO(NCNN_VULKAN);
 #include "ai/yolov8.h"
 PRINT_MACRO(NCNN_VULKAN);
 
+#include "ncnn/cpu.h"
 #include "ncnn/gpu.h"
 
 #include "input_handler.h"
 
 
-using Mp3Data = std::tuple<std::shared_ptr<std::vector<uint8_t>>, size_t>;
+/**
+ * An audio asset opened in buffer mode. The decoders read its bytes in place: for an asset stored
+ * uncompressed in the APK that is a view of the mapped file, nothing is copied.
+ */
+struct AudioAsset {
+    AAsset*        asset = nullptr;
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+    // Seek points of an MP3, from the "<name>.idx" asset the APK build writes next to it.
+    std::shared_ptr<const Mp3FrameIndex> mp3Index;
+
+    ~AudioAsset() {
+        if (asset != nullptr) {
+            AAsset_close(asset);
+        }
+    }
+};
 
 bool pointInRect(float x, float y, float x1, float y1, float w, float h) {
     return x > x1 && x < x1 + w && y > y1 && y < y1+h;
@@ -81,8 +104,6 @@ struct AppEngine {
                     appEngine->initDisplay();
 #endif  // RENDER_CAM_TO_WINDOW
 
-                    appEngine->playMp3();
-
                     //                    appEngine->m_yoloInit = std::async(std::launch::async, [appEngine]() {
                     appEngine->initYolo();
                     //                    });
@@ -90,7 +111,11 @@ struct AppEngine {
                     AConfiguration_fromAssetManager(config, app->activity->assetManager);
                     appEngine->m_screenWidth = AConfiguration_getScreenWidthDp(config);
                     appEngine->m_screenHeight = AConfiguration_getScreenHeightDp(config);
+                    appEngine->m_oboeEngine.setSpectrumEnabled(true);
                     appEngine->m_oboeEngine.start();
+                    appEngine->openPcmPack();
+                    // Started first so the boot sound is decoded for the stream's format.
+                    appEngine->playSound();
                     // if (!appEngine->m_camCtrl.openAndCapture("0")) {
                     //     LOGE("Failed to open camera");
                     // }
@@ -180,10 +205,13 @@ struct AppEngine {
         float x_norm = (float)x / m_screenWidth;
         float y_norm = (float)y / m_screenHeight;
         LOGV("Button(x:%f, y:%f, button:%d, bDown:%d)\n", x_norm, y_norm, button, bDown);
-        if (pointInRect(x_norm, y_norm, -1, -1, 1,1)) { playMp3("robot_boot.mp3"); }
-        if (pointInRect(x_norm, y_norm, 0, -1, 1,1)) { playMp3("robot_random_code.mp3"); }
-        if (pointInRect(x_norm, y_norm, -1, 0, 1,1)) { playMp3("robot_thankyou.mp3"); }
-        if (pointInRect(x_norm, y_norm, 0, 0, 1,1)) { playMp3("test.mp3"); }
+        // The robot's lines queue up on a press and play back to back instead of over each other.
+        if (bDown) {
+            if (pointInRect(x_norm, y_norm, -1, -1, 1,1)) { queueSound("robot_boot.mp3"); }
+            if (pointInRect(x_norm, y_norm, 0, -1, 1,1)) { queueSound("robot_random_code.mp3"); }
+            if (pointInRect(x_norm, y_norm, -1, 0, 1,1)) { queueSound("robot_thankyou.mp3"); }
+        }
+        if (pointInRect(x_norm, y_norm, 0, 0, 1,1)) { playSound("test.mp3"); }
         for (auto handler : m_inputHandlers) {
             handler->handleButton(x_norm, y_norm, button, bDown);
         }
@@ -268,6 +296,8 @@ struct AppEngine {
             m_2dScene->addRectangle(std::make_shared<renderer_2d::Rectangle>(0.5, 0.5, 0.2, 0.2));
             m_2dScene->addRectangle(std::make_shared<renderer_2d::Rectangle>(0.8, 0.8, 0.2, 0.2));
             m_eyeRenderer = new EyeRenderer();
+            m_eyeRenderer->setAudioEnvelope(&m_oboeEngine.getEnvelope());
+            m_eyeRenderer->setAudioSpectrum(&m_oboeEngine.getSpectrumAnalyzer());
             m_inputHandlers.push_back(m_eyeRenderer);
             //eye_renderer->resize(800, 600);
             m_textureRenderer = new TextureRenderer();
@@ -297,6 +327,18 @@ struct AppEngine {
             // }
             // m_eyeRenderer->playMouth();
         }
+        if (now - m_lastAudioStatsTime > kAudioStatsIntervalSeconds) {
+            m_lastAudioStatsTime = now;
+            m_oboeEngine.getCallbackStats().log("audio callback");
+        }
+        if (now - m_lastLatencyTime > kLatencyIntervalSeconds) {
+            // The mouth follows the audio envelope once it is heard.
+            m_lastLatencyTime = now;
+            const double latencyMillis = m_oboeEngine.getCurrentOutputLatencyMillis();
+            if (latencyMillis >= 0.0) {
+                m_eyeRenderer->setOutputLatency((float)(latencyMillis / 1000.0));
+            }
+        }
         m_eyeRenderer->update((float)delta_time_second);
         //m_2dScene->update();
     }
@@ -343,21 +385,100 @@ struct AppEngine {
 #endif
     }
 
-    void playMp3(std::string name = "test.mp3") {
-        Mp3Data mp3Data = {nullptr, 0};
-        if (!m_audioData.contains(name)) {
-            if (!m_audioNames.contains(name)) {
-                LOGE("unknown audio name");
-                return;
-            }
-            mp3Data = readAsset(name);
-            if (std::get<0>(mp3Data) == nullptr) {
-                LOGE("Failed to read asset: %s", name.c_str());
-                return;
-            }
-            m_audioData[name] = mp3Data;
+    void playSound(std::string name = "test.mp3") {
+        if (const PcmClip* clip = findPackedClip(name)) {
+            playClipInSync(clip);
+            return;
+        }
+        ClipCache& cache = m_oboeEngine.getClipCache();
+        if (const PcmClip* clip = cache.find(name)) {
+            playClipInSync(clip);
+            return;
+        }
+
+        std::shared_ptr<AudioAsset> audio = findAudio(name);
+        if (audio == nullptr) {
+            return;
+        }
+
+        // Decode once, later triggers are served from the cache. Clips over the budget are streamed.
+        if (const PcmClip* clip = cache.insert(name, audio->data, audio->size)) {
+            playClipInSync(clip);
+        } else {
+            m_oboeEngine.playStream(audio->data, audio->size, audio->mp3Index);
+        }
+    }
+
+    /**
+     * Play a clip right after the ones queued before it, with no gap between them.
+     */
+    void queueSound(const std::string& name) {
+        if (std::shared_ptr<AudioAsset> audio = findAudio(name)) {
+            m_oboeEngine.queueClip(audio->data, audio->size);
+        }
+    }
+
+    /**
+     * The mapped asset of a sound, opened on first use.
+     */
+    std::shared_ptr<AudioAsset> findAudio(const std::string& name) {
+        if (auto it = m_audioData.find(name); it != m_audioData.end()) {
+            return it->second;
+        }
+        if (!m_audioNames.contains(name)) {
+            LOGE("unknown audio name");
+            return nullptr;
+        }
+        std::shared_ptr<AudioAsset> audio = openAudioAsset(name);
+        if (audio != nullptr) {
+            m_audioData[name] = audio;
+        }
+        return audio;
+    }
+
+    /**
+     * The clips scripts/build_pack.sh transcoded ahead of time. They play straight from the mapped
+     * asset; without the pack each clip is decoded on its first trigger.
+     */
+    void openPcmPack() {
+        m_pcmPackAsset = openAudioAsset(kPcmPackName);
+        if (m_pcmPackAsset == nullptr) {
+            return;
+        }
+        m_pcmPack = PcmPack::open(m_pcmPackAsset->data, m_pcmPackAsset->size);
+        if (m_pcmPack == nullptr) {
+            LOGW("%s is unreadable, clips are decoded instead", kPcmPackName);
+            m_pcmPackAsset.reset();
+            return;
+        }
+        // Read it in now rather than fault its pages in on the audio thread at the first trigger.
+        m_pcmPack->prefetch();
+        LOGI("PCM pack: %zu clips, %d Hz, %d ch", m_pcmPack->getClipCount(), m_pcmPack->getSampleRate(),
+             m_pcmPack->getChannelCount());
+    }
+
+    /**
+     * A clip of the pack, if the pack was built for the stream's format.
+     */
+    const PcmClip* findPackedClip(const std::string& name) {
+        const ClipCache& cache = m_oboeEngine.getClipCache();
+        if (m_pcmPack == nullptr || m_pcmPack->getSampleRate() != cache.getSampleRate()
+            || m_pcmPack->getChannelCount() != cache.getChannelCount()) {
+            return nullptr;
+        }
+        return m_pcmPack->find(name);
+    }
+
+    /**
+     * Play a clip a fixed lead after the trigger instead of at whichever callback comes next, so the
+     * trigger latency does not jitter, and open the mouth when it is heard.
+     */
+    void playClipInSync(const PcmClip* clip) {
+        const int64_t lead = m_oboeEngine.getTriggerLeadNanos();
+        m_oboeEngine.playClipAt(clip, get_time_nanos() + lead);
+        if (m_eyeRenderer != nullptr) {
+            m_eyeRenderer->playMouth((float)lead / 1e9f);
         }
-        m_oboeEngine.playMp3((uint8_t*)std::get<0>(mp3Data)->data(), std::get<1>(mp3Data));
     }
 
 
@@ -388,6 +509,48 @@ struct AppEngine {
         return {buf, size};
     }
 
+    std::shared_ptr<AudioAsset> openAudioAsset(const std::string& name) {
+        auto audio = std::make_shared<AudioAsset>();
+        audio->asset = AAssetManager_open(m_app->activity->assetManager, name.c_str(), AASSET_MODE_BUFFER);
+        if (audio->asset == nullptr) {
+            LOGE("Failed to open asset: %s", name.c_str());
+            return nullptr;
+        }
+        audio->data = static_cast<const uint8_t*>(AAsset_getBuffer(audio->asset));
+        audio->size = AAsset_getLength(audio->asset);
+        if (audio->data == nullptr) {
+            LOGE("Failed to map asset: %s", name.c_str());
+            return nullptr;
+        }
+        if (name.ends_with(".mp3")) {
+            audio->mp3Index = openMp3Index(name, audio->data, audio->size);
+        }
+        return audio;
+    }
+
+    /**
+     * The index scripts/build_pack.sh serializes next to an MP3 asset. Without one the clip still
+     * plays, its length comes from the Xing header and a seek decodes from the start.
+     */
+    std::shared_ptr<const Mp3FrameIndex> openMp3Index(const std::string& name, const uint8_t* data, size_t size) {
+        const std::string indexName = name + ".idx";
+        AAsset* asset = AAssetManager_open(m_app->activity->assetManager, indexName.c_str(), AASSET_MODE_BUFFER);
+        if (asset == nullptr) {
+            LOGI("No seek index for %s", name.c_str());
+            return nullptr;
+        }
+        std::shared_ptr<const Mp3FrameIndex> index;
+        if (const void* bytes = AAsset_getBuffer(asset)) {
+            index = Mp3FrameIndex::deserialize(bytes, AAsset_getLength(asset));
+        }
+        AAsset_close(asset);
+        if (index == nullptr || !index->matches(data, size)) {
+            LOGW("Seek index %s is stale or unreadable, ignored", indexName.c_str());
+            return nullptr;
+        }
+        return index;
+    }
+
     void initYolo() {
         if (m_yolov8 == nullptr) {
             LOGI("YoloProcesser m_yolov8 == nullptr, create m_yolov8");
@@ -419,6 +582,15 @@ struct AppEngine {
                 return;
             }
             yolo->set_det_target_size(320);
+
+            // Keep the CPU layers on the inference cores, clear of the audio and decoder threads.
+            const std::vector<int>& inferenceCpus = cpu_topology::getPlacement().inference;
+            ncnn::CpuSet            cpuSet;
+            for (int cpu : inferenceCpus) {
+                cpuSet.enable(cpu);
+            }
+            ncnn::set_cpu_thread_affinity(cpuSet);
+            yolo->set_num_threads(static_cast<int>(inferenceCpus.size()));
             LOGI("load yolo ok");
             m_yolov8 = yolo;
         }
@@ -484,7 +656,9 @@ struct AppEngine {
         "robot_thankyou.mp3",
         "robot_random_code.mp3"
     };
-    std::unordered_map<std::string, Mp3Data> m_audioData;
+    std::unordered_map<std::string, std::shared_ptr<AudioAsset>> m_audioData;
+    std::shared_ptr<AudioAsset> m_pcmPackAsset;
+    std::unique_ptr<PcmPack>    m_pcmPack;  // destroyed after m_oboeEngine, which plays its clips
     OboeEngine       m_oboeEngine;
     CameraController m_camCtrl;
     CameraEngine*    m_camEngine = nullptr;
@@ -495,6 +669,12 @@ struct AppEngine {
 
     double m_lastUpdateTime = 0.0f;
     double m_lastAnimationTime = 0.0f;
+    double m_lastAudioStatsTime = 0.0f;
+    double m_lastLatencyTime = 0.0f;
+
+    static constexpr const char* kPcmPackName = "clips.pcmpack";
+    static constexpr double      kAudioStatsIntervalSeconds = 30.0;
+    static constexpr double      kLatencyIntervalSeconds = 1.0;
 
 
     YOLOv8*           m_yolov8 = nullptr;
@@ -0,0 +1,160 @@
+#include "AudioGraph.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Simd.h"
+#include "ndk_utils/log.h"
+
+AudioGraph::NodeId AudioGraph::addSource(IRenderableAudio* source) {
+    if (source == nullptr) {
+        return kInvalidNode;
+    }
+    mNodes.push_back({NodeType::Source, source, nullptr, {}});
+    return static_cast<NodeId>(mNodes.size()) - 1;
+}
+
+AudioGraph::NodeId AudioGraph::addNode(std::shared_ptr<AudioNode> effect, NodeId input) {
+    if (effect == nullptr || input < 0 || input >= static_cast<NodeId>(mNodes.size())) {
+        return kInvalidNode;
+    }
+    mNodes.push_back({NodeType::Effect, nullptr, std::move(effect), {input}});
+    return static_cast<NodeId>(mNodes.size()) - 1;
+}
+
+AudioGraph::NodeId AudioGraph::addMix(const std::vector<NodeId>& inputs) {
+    const bool valid = std::all_of(inputs.begin(), inputs.end(), [this](NodeId input) {
+        return input >= 0 && input < static_cast<NodeId>(mNodes.size());
+    });
+    if (inputs.empty() || !valid) {
+        return kInvalidNode;
+    }
+    mNodes.push_back({NodeType::Mix, nullptr, nullptr, inputs});
+    return static_cast<NodeId>(mNodes.size()) - 1;
+}
+
+bool AudioGraph::setOutput(NodeId output) {
+    if (output < 0 || output >= static_cast<NodeId>(mNodes.size())) {
+        return false;
+    }
+    mOutput = output;
+    return true;
+}
+
+bool AudioGraph::compile(int32_t sampleRate, int32_t channelCount) {
+    mSteps.clear();
+    mBufferCount = 0;
+    mOutputBuffer = -1;
+    mChannelCount = channelCount;
+    if (mOutput == kInvalidNode) {
+        return false;
+    }
+
+    // Inputs always come before the nodes reading them, so ids are already a topological order. Only
+    // the nodes the output depends on are compiled, each with the number of reads of its output.
+    const size_t         nodeCount = static_cast<size_t>(mOutput) + 1;
+    std::vector<bool>    needed(nodeCount, false);
+    std::vector<int32_t> readsLeft(nodeCount, 0);
+    needed[mOutput] = true;
+    for (NodeId id = mOutput; id >= 0; --id) {
+        if (needed[id]) {
+            for (NodeId input : mNodes[id].inputs) {
+                needed[input] = true;
+                ++readsLeft[input];
+            }
+        }
+    }
+
+    std::vector<int32_t> bufferOf(nodeCount, -1);
+    std::vector<int32_t> freeBuffers;
+    auto allocate = [&]() {
+        if (freeBuffers.empty()) {
+            return mBufferCount++;
+        }
+        const int32_t buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        return buffer;
+    };
+    // Take the input's buffer for writing if this is its last read, otherwise copy it to a new one.
+    auto take = [&](NodeId input) {
+        if (--readsLeft[input] == 0) {
+            return bufferOf[input];
+        }
+        const int32_t buffer = allocate();
+        mSteps.push_back({StepType::Copy, buffer, bufferOf[input], nullptr, nullptr});
+        return buffer;
+    };
+    auto read = [&](NodeId input) {
+        if (--readsLeft[input] == 0) {
+            freeBuffers.push_back(bufferOf[input]);
+        }
+    };
+
+    for (NodeId id = 0; id <= mOutput; ++id) {
+        if (!needed[id]) {
+            continue;
+        }
+        Node& node = mNodes[id];
+        switch (node.type) {
+            case NodeType::Source:
+                bufferOf[id] = allocate();
+                mSteps.push_back({StepType::Render, bufferOf[id], -1, node.source, nullptr});
+                break;
+            case NodeType::Effect:
+                node.effect->prepare(sampleRate, channelCount, kBlockFrames);
+                bufferOf[id] = take(node.inputs[0]);
+                mSteps.push_back({StepType::Process, bufferOf[id], -1, nullptr, node.effect.get()});
+                break;
+            case NodeType::Mix:
+                bufferOf[id] = take(node.inputs[0]);
+                for (size_t i = 1; i < node.inputs.size(); ++i) {
+                    mSteps.push_back({StepType::Mix, bufferOf[id], bufferOf[node.inputs[i]], nullptr, nullptr});
+                    read(node.inputs[i]);
+                }
+                break;
+        }
+    }
+
+    // The buffer left holding the output is the stream's own. Whatever it held before is overwritten
+    // before the output is written to it.
+    mOutputBuffer = bufferOf[mOutput];
+    const size_t blockSamples = static_cast<size_t>(kBlockFrames) * channelCount;
+    mBufferData.assign(blockSamples * mBufferCount, 0.0f);
+    mBuffers.resize(mBufferCount);
+    for (int32_t i = 0; i < mBufferCount; ++i) {
+        mBuffers[i] = mBufferData.data() + blockSamples * i;
+    }
+    LOGI("Audio graph: %zu steps, %d block buffers", mSteps.size(), mBufferCount);
+    return true;
+}
+
+void AudioGraph::renderAudio(float* audioData, int32_t numFrames) {
+    if (mOutputBuffer < 0) {
+        memset(audioData, 0, static_cast<size_t>(numFrames) * std::max(mChannelCount, 1) * sizeof(float));
+        return;
+    }
+    for (int32_t done = 0; done < numFrames; done += kBlockFrames) {
+        const int32_t frames = std::min(kBlockFrames, numFrames - done);
+        const size_t  samples = static_cast<size_t>(frames) * mChannelCount;
+        mBuffers[mOutputBuffer] = audioData + static_cast<size_t>(done) * mChannelCount;
+        for (const Step& step : mSteps) {
+            float* buffer = mBuffers[step.buffer];
+            switch (step.type) {
+                case StepType::Render:
+                    step.source->renderAudio(buffer, frames);
+                    break;
+                case StepType::Process:
+                    step.effect->process(buffer, frames);
+                    break;
+                case StepType::Copy:
+                    memcpy(buffer, mBuffers[step.input], samples * sizeof(float));
+                    break;
+                case StepType::Mix: {
+                    constexpr float kUnity[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+                    simd::accumulate(buffer, mBuffers[step.input], samples, kUnity);
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "IRenderableAudio.h"
+
+/**
+ * A processing stage of an AudioGraph, e.g. a filter or a limiter.
+ *
+ * prepare() runs on the control thread when the graph is compiled and is where a node allocates
+ * whatever it needs for blocks of up to maxFrames. process() then runs on the audio thread and must
+ * not allocate, lock or block.
+ */
+class AudioNode {
+  public:
+    virtual ~AudioNode() = default;
+
+    /**
+     * Set the format and reset the node's state. Only called while no stream renders the graph.
+     */
+    virtual void prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) = 0;
+
+    /**
+     * Process a block of interleaved samples in place.
+     * @param numFrames - at most the maxFrames given to prepare()
+     */
+    virtual void process(float* audioData, int32_t numFrames) = 0;
+};
+
+/**
+ * Sources and effects chained into one IRenderableAudio, so gain, filtering and limiting are written
+ * once instead of into every source.
+ *
+ * The graph is built on the control thread, each node taking earlier ones as its inputs, so it is
+ * acyclic by construction. compile() then flattens the part the output depends on into a list of
+ * steps, prepares the nodes and allocates every buffer the steps use. An effect whose input feeds
+ * nothing else processes that input's buffer in place, and a buffer is reused once the node it held
+ * has been consumed, so a chain needs a single buffer whatever its length. The output node writes
+ * straight into the stream's buffer.
+ *
+ * renderAudio() runs the steps over blocks of kBlockFrames, never more, whatever the burst size. It
+ * does not allocate, lock or block, provided the sources and nodes do not.
+ */
+class AudioGraph : public IRenderableAudio {
+  public:
+    using NodeId = int32_t;
+
+    static constexpr int32_t kBlockFrames = 64;
+    static constexpr NodeId  kInvalidNode = -1;
+
+    /**
+     * Add a source rendered into the graph. The source must outlive its use by the graph.
+     */
+    NodeId addSource(IRenderableAudio* source);
+
+    /**
+     * Add a node which processes the output of another.
+     * @return the new node, or kInvalidNode if the input does not exist
+     */
+    NodeId addNode(std::shared_ptr<AudioNode> node, NodeId input);
+
+    /**
+     * Add a node which sums the outputs of others.
+     * @return the new node, or kInvalidNode if an input does not exist
+     */
+    NodeId addMix(const std::vector<NodeId>& inputs);
+
+    /**
+     * Choose the node rendered to the stream. Takes effect at the next compile().
+     */
+    bool setOutput(NodeId output);
+
+    /**
+     * Flatten the graph and prepare it for a stream of this format. Only call this while no stream is
+     * rendering the graph.
+     * @return false if there is no output, the graph then renders silence
+     */
+    bool compile(int32_t sampleRate, int32_t channelCount);
+
+    void renderAudio(float* audioData, int32_t numFrames) override;
+
+    /**
+     * Steps and block buffers of the compiled graph. One of the buffers is the stream's.
+     */
+    size_t getStepCount() const { return mSteps.size(); }
+
+    int32_t getBufferCount() const { return mBufferCount; }
+
+  private:
+    enum class NodeType { Source, Effect, Mix };
+
+    struct Node {
+        NodeType                   type;
+        IRenderableAudio*          source = nullptr;
+        std::shared_ptr<AudioNode> effect;
+        std::vector<NodeId>        inputs;
+    };
+
+    enum class StepType { Render, Process, Copy, Mix };
+
+    struct Step {
+        StepType          type;
+        int32_t           buffer;         // buffer written
+        int32_t           input = -1;     // buffer read by Copy and Mix
+        IRenderableAudio* source = nullptr;
+        AudioNode*        effect = nullptr;
+    };
+
+    std::vector<Node>   mNodes;
+    NodeId              mOutput = kInvalidNode;
+    int32_t             mChannelCount = 0;
+    std::vector<Step>   mSteps;
+    int32_t             mBufferCount = 0;
+    int32_t             mOutputBuffer = -1;
+    std::vector<float>  mBufferData;
+    std::vector<float*> mBuffers;  // per buffer, the output's points into the stream's buffer
+};
@@ -0,0 +1,299 @@
+#include "AudioNodes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+
+namespace {
+    inline simd::float4 abs4(simd::float4 x) { return simd::max(x, simd::sub(simd::set1(0.0f), x)); }
+}  // namespace
+
+BiquadNode::BiquadNode(Type type, float frequency, float q, float gainDb)
+    : mType(type), mFrequency(frequency), mQ(q), mGainDb(gainDb) {}
+
+BiquadNode::Coefficients BiquadNode::design(Type type, float frequency, float q, float gainDb, int32_t sampleRate) {
+    const double w0 = 2.0 * M_PI * std::min<double>(frequency, 0.49 * sampleRate) / sampleRate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double a = std::pow(10.0, gainDb / 40.0);
+    const double shelf = 2.0 * std::sqrt(a) * alpha;
+    double       b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+    switch (type) {
+        case Type::LowPass:
+            b0 = b2 = (1.0 - cosW0) / 2.0;
+            b1 = 1.0 - cosW0;
+            a0 = 1.0 + alpha, a1 = -2.0 * cosW0, a2 = 1.0 - alpha;
+            break;
+        case Type::HighPass:
+            b0 = b2 = (1.0 + cosW0) / 2.0;
+            b1 = -(1.0 + cosW0);
+            a0 = 1.0 + alpha, a1 = -2.0 * cosW0, a2 = 1.0 - alpha;
+            break;
+        case Type::Peaking:
+            b0 = 1.0 + alpha * a, b1 = -2.0 * cosW0, b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a, a1 = -2.0 * cosW0, a2 = 1.0 - alpha / a;
+            break;
+        case Type::LowShelf:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cosW0 + shelf);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW0);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cosW0 - shelf);
+            a0 = (a + 1.0) + (a - 1.0) * cosW0 + shelf;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW0);
+            a2 = (a + 1.0) + (a - 1.0) * cosW0 - shelf;
+            break;
+        case Type::HighShelf:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cosW0 + shelf);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW0);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cosW0 - shelf);
+            a0 = (a + 1.0) - (a - 1.0) * cosW0 + shelf;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW0);
+            a2 = (a + 1.0) - (a - 1.0) * cosW0 - shelf;
+            break;
+    }
+    return {static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+            static_cast<float>(a1 / a0), static_cast<float>(a2 / a0)};
+}
+
+void BiquadNode::prepare(int32_t sampleRate, int32_t channelCount, int32_t /* maxFrames */) {
+    mChannelCount = channelCount;
+    mCoefficients = design(mType, mFrequency, mQ, mGainDb, sampleRate);
+    mStates.assign(channelCount, State());
+
+    // Run the recurrence over four frames from each state and input alone set to one.
+    const Coefficients& c = mCoefficients;
+    for (int k = 0; k < 8; ++k) {
+        double x[6] = {};  // x[n-2] .. x[n+3]
+        double y[6] = {};  // y[n-2] .. y[n+3]
+        if (k < 6) {
+            x[k] = 1.0;
+        } else {
+            y[k - 6] = 1.0;
+        }
+        for (int j = 2; j < 6; ++j) {
+            y[j] = c.b0 * x[j] + c.b1 * x[j - 1] + c.b2 * x[j - 2] - c.a1 * y[j - 1] - c.a2 * y[j - 2];
+            mColumns[k][j - 2] = static_cast<float>(y[j]);
+        }
+    }
+}
+
+void BiquadNode::process(float* audioData, int32_t numFrames) {
+    if (mChannelCount > kMaxBlockChannels) {
+        processFrames(audioData, 0, numFrames);
+        return;
+    }
+    simd::float4 columns[8];
+    for (int k = 0; k < 8; ++k) {
+        columns[k] = simd::load(mColumns[k]);
+    }
+    const int32_t channels = mChannelCount;
+    const int32_t blockFrames = numFrames & ~3;
+    simd::float4  y[kMaxBlockChannels];
+    for (int32_t i = 0; i < blockFrames; i += 4) {
+        float* frames = audioData + i * channels;
+        for (int32_t ch = 0; ch < channels; ++ch) {
+            State&       s = mStates[ch];
+            const float* x = frames + ch;
+            // The inputs first, the outputs they depend on last, to keep the recursion short.
+            simd::float4 acc = simd::mul(columns[0], simd::set1(s.x2));
+            acc = simd::madd(acc, columns[1], simd::set1(s.x1));
+            acc = simd::madd(acc, columns[2], simd::set1(x[0]));
+            acc = simd::madd(acc, columns[3], simd::set1(x[channels]));
+            acc = simd::madd(acc, columns[4], simd::set1(x[2 * channels]));
+            acc = simd::madd(acc, columns[5], simd::set1(x[3 * channels]));
+            acc = simd::madd(acc, columns[6], simd::set1(s.y2));
+            y[ch] = simd::madd(acc, columns[7], simd::set1(s.y1));
+            s.x2 = x[2 * channels];
+            s.x1 = x[3 * channels];
+        }
+        if (channels == 2) {
+            simd::storeInterleaved(frames, y[0], y[1]);
+        } else {
+            simd::store(frames, y[0]);
+        }
+        for (int32_t ch = 0; ch < channels; ++ch) {
+            mStates[ch].y2 = frames[2 * channels + ch];
+            mStates[ch].y1 = frames[3 * channels + ch];
+        }
+    }
+    processFrames(audioData, blockFrames, numFrames);
+}
+
+// The direct form, for the frames left over and for more than two channels.
+void BiquadNode::processFrames(float* audioData, int32_t begin, int32_t end) {
+    const Coefficients& c = mCoefficients;
+    for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+        State& s = mStates[ch];
+        for (int32_t i = begin; i < end; ++i) {
+            float&      sample = audioData[i * mChannelCount + ch];
+            const float x = sample;
+            const float y = c.b0 * x + c.b1 * s.x1 + c.b2 * s.x2 - c.a1 * s.y1 - c.a2 * s.y2;
+            s.x2 = s.x1;
+            s.x1 = x;
+            s.y2 = s.y1;
+            s.y1 = y;
+            sample = y;
+        }
+    }
+}
+
+void GainRampNode::prepare(int32_t sampleRate, int32_t channelCount, int32_t /* maxFrames */) {
+    mChannelCount = channelCount;
+    mRampFrames = std::max(1, sampleRate * kRampMillis / 1000);
+    mGain = mRampTarget = mTarget.load(std::memory_order_relaxed);
+    mRampFramesLeft = 0;
+}
+
+void GainRampNode::process(float* audioData, int32_t numFrames) {
+    const float target = mTarget.load(std::memory_order_relaxed);
+    if (target != mRampTarget) {
+        mRampTarget = target;
+        mRampStep = (target - mGain) / mRampFrames;
+        mRampFramesLeft = mRampFrames;
+    }
+
+    int32_t frame = 0;
+    if (mRampFramesLeft > 0) {
+        // Each frame gets the target less a step per frame left in the ramp, so the last is on it.
+        const int32_t frames = std::min(numFrames, mRampFramesLeft);
+        const size_t  count = static_cast<size_t>(frames) * mChannelCount;
+        const float   last = static_cast<float>(mRampFramesLeft - 1);
+        size_t        i = 0;
+        if (mChannelCount <= 2) {
+            const int32_t      framesPerVector = 4 / mChannelCount;
+            const simd::float4 offsets = mChannelCount == 1 ? simd::set4(0.0f, 1.0f, 2.0f, 3.0f)
+                                                            : simd::set4(0.0f, 0.0f, 1.0f, 1.0f);
+            const simd::float4 target = simd::set1(mRampTarget);
+            const simd::float4 step = simd::set1(-mRampStep);
+            for (int32_t k = 0; i + 4 <= count; i += 4, k += framesPerVector) {
+                const simd::float4 left = simd::sub(simd::set1(last - static_cast<float>(k)), offsets);
+                simd::store(audioData + i, simd::mul(simd::load(audioData + i), simd::madd(target, left, step)));
+            }
+        }
+        for (; i < count; ++i) {
+            audioData[i] *= mRampTarget - (last - static_cast<float>(i / mChannelCount)) * mRampStep;
+        }
+        mRampFramesLeft -= frames;
+        mGain = mRampTarget - static_cast<float>(mRampFramesLeft) * mRampStep;
+        frame = frames;
+    }
+
+    if (frame < numFrames && mGain != 1.0f) {
+        float*             data = audioData + static_cast<size_t>(frame) * mChannelCount;
+        const size_t       count = static_cast<size_t>(numFrames - frame) * mChannelCount;
+        const simd::float4 gain = simd::set1(mGain);
+        size_t             i = 0;
+        for (; i + 4 <= count; i += 4) {
+            simd::store(data + i, simd::mul(simd::load(data + i), gain));
+        }
+        for (; i < count; ++i) {
+            data[i] *= mGain;
+        }
+    }
+}
+
+void LimiterNode::prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) {
+    mChannelCount = channelCount;
+    mLookAhead = std::max(1, static_cast<int32_t>(sampleRate * kLookAheadMillis / 1000.0f));
+    mReleaseCoefficient = static_cast<float>(1.0 - std::exp(-1000.0 / (kReleaseMillis * sampleRate)));
+    mFrame = 0;
+
+    // A frame is pushed before the oldest is dropped, so the ring holds up to mLookAhead + 1.
+    size_t capacity = 1;
+    while (capacity < static_cast<size_t>(mLookAhead) + 1) {
+        capacity *= 2;
+    }
+    mMinimum.assign(capacity, Entry {0, 1.0f});
+    mMinimumHead = 0;
+    mMinimumSize = 0;
+    mReleased = 1.0f;
+    mWindow.assign(mLookAhead, 1.0f);
+    mWindowPosition = 0;
+    mWindowSum = mLookAhead;
+    mGains.assign(maxFrames, 1.0f);
+    mDelay.assign(static_cast<size_t>(mLookAhead - 1 + maxFrames) * channelCount, 0.0f);
+}
+
+void LimiterNode::process(float* audioData, int32_t numFrames) {
+    const size_t delayed = static_cast<size_t>(mLookAhead - 1) * mChannelCount;
+    const size_t count = static_cast<size_t>(numFrames) * mChannelCount;
+    measurePeaks(audioData, numFrames);
+    memcpy(mDelay.data() + delayed, audioData, count * sizeof(float));
+
+    const size_t mask = mMinimum.size() - 1;
+    for (int32_t i = 0; i < numFrames; ++i, ++mFrame) {
+        const float peak = mGains[i];
+        const float needed = peak > mThreshold ? mThreshold / peak : 1.0f;
+
+        // The smallest gain needed by this frame and the mLookAhead - 1 before it.
+        while (mMinimumSize > 0 && mMinimum[(mMinimumHead + mMinimumSize - 1) & mask].gain >= needed) {
+            --mMinimumSize;
+        }
+        mMinimum[(mMinimumHead + mMinimumSize++) & mask] = {mFrame, needed};
+        if (mMinimum[mMinimumHead].frame <= mFrame - mLookAhead) {
+            mMinimumHead = (mMinimumHead + 1) & mask;
+            --mMinimumSize;
+        }
+        const float minimum = mMinimum[mMinimumHead].gain;
+        mReleased = minimum < mReleased ? minimum : mReleased + (minimum - mReleased) * mReleaseCoefficient;
+
+        // Every gain averaged is at most the one the frame leaving the delay needs. The running sum
+        // drifts, the released gain bounds it.
+        mWindowSum += mReleased - mWindow[mWindowPosition];
+        mWindow[mWindowPosition] = mReleased;
+        mWindowPosition = mWindowPosition + 1 == mLookAhead ? 0 : mWindowPosition + 1;
+        mGains[i] = std::min(static_cast<float>(mWindowSum / mLookAhead), mReleased);
+    }
+
+    applyGains(audioData, numFrames);
+    memmove(mDelay.data(), mDelay.data() + count, delayed * sizeof(float));
+}
+
+// The largest magnitude of each frame into mGains.
+void LimiterNode::measurePeaks(const float* audioData, int32_t numFrames) {
+    int32_t i = 0;
+    if (mChannelCount == 1) {
+        for (; i + 4 <= numFrames; i += 4) {
+            simd::store(mGains.data() + i, abs4(simd::load(audioData + i)));
+        }
+    } else if (mChannelCount == 2) {
+        for (; i + 4 <= numFrames; i += 4) {
+            simd::float4 left;
+            simd::float4 right;
+            simd::loadDeinterleaved(audioData + i * 2, left, right);
+            simd::store(mGains.data() + i, simd::max(abs4(left), abs4(right)));
+        }
+    }
+    for (; i < numFrames; ++i) {
+        float peak = 0.0f;
+        for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+            peak = std::max(peak, std::fabs(audioData[i * mChannelCount + ch]));
+        }
+        mGains[i] = peak;
+    }
+}
+
+// The delayed frames times their gains into the block.
+void LimiterNode::applyGains(float* audioData, int32_t numFrames) {
+    const float* delayed = mDelay.data();
+    int32_t      i = 0;
+    if (mChannelCount == 1) {
+        for (; i + 4 <= numFrames; i += 4) {
+            simd::store(audioData + i, simd::mul(simd::load(delayed + i), simd::load(mGains.data() + i)));
+        }
+    } else if (mChannelCount == 2) {
+        for (; i + 4 <= numFrames; i += 4) {
+            const simd::float4 gain = simd::load(mGains.data() + i);
+            simd::float4       left;
+            simd::float4       right;
+            simd::loadDeinterleaved(delayed + i * 2, left, right);
+            simd::storeInterleaved(audioData + i * 2, simd::mul(left, gain), simd::mul(right, gain));
+        }
+    }
+    for (; i < numFrames; ++i) {
+        for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+            audioData[i * mChannelCount + ch] = delayed[i * mChannelCount + ch] * mGains[i];
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "AudioGraph.h"
+
+/**
+ * Second order IIR filter with the RBJ cookbook responses, one per channel.
+ *
+ * Mono and stereo are filtered four frames at a time: the next four outputs of a channel are a linear
+ * function of the two inputs and outputs before them and the four new inputs, with columns computed
+ * once from the coefficients. That takes eight multiply-adds where the direct form needs sixteen
+ * dependent operations. More channels are filtered one frame at a time.
+ */
+class BiquadNode : public AudioNode {
+  public:
+    enum class Type { LowPass, HighPass, Peaking, LowShelf, HighShelf };
+
+    struct Coefficients {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;  // a0 normalized to 1
+    };
+
+    /**
+     * @param frequency - corner or center frequency in Hz
+     * @param q - 0.7071 for a Butterworth low or high pass
+     * @param gainDb - gain of the peak or shelf, ignored by the passes
+     */
+    BiquadNode(Type type, float frequency, float q = 0.7071f, float gainDb = 0.0f);
+
+    static Coefficients design(Type type, float frequency, float q, float gainDb, int32_t sampleRate);
+
+    const Coefficients& getCoefficients() const { return mCoefficients; }
+
+    void prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) override;
+
+    void process(float* audioData, int32_t numFrames) override;
+
+  private:
+    static constexpr int32_t kMaxBlockChannels = 2;
+
+    struct State {
+        float x1 = 0.0f, x2 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+    };
+
+    void processFrames(float* audioData, int32_t begin, int32_t end);
+
+    Type               mType;
+    float              mFrequency;
+    float              mQ;
+    float              mGainDb;
+    int32_t            mChannelCount = 0;
+    Coefficients       mCoefficients;
+    // Contribution of x[n-2], x[n-1], x[n..n+3], y[n-2] and y[n-1] to y[n..n+3].
+    float              mColumns[8][4] = {};
+    std::vector<State> mStates;
+};
+
+/**
+ * Gain which can be changed from any thread while the graph plays. A change ramps linearly over
+ * kRampMillis, so it never clicks. A gain of one costs nothing and any other one multiply per sample.
+ */
+class GainRampNode : public AudioNode {
+  public:
+    static constexpr int32_t kRampMillis = 20;
+
+    explicit GainRampNode(float gain = 1.0f) : mTarget(gain), mGain(gain) {}
+
+    /**
+     * Ramp to a linear gain, starting in the next block.
+     */
+    void setGain(float gain) { mTarget.store(gain, std::memory_order_relaxed); }
+
+    float getGain() const { return mTarget.load(std::memory_order_relaxed); }
+
+    void prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) override;
+
+    void process(float* audioData, int32_t numFrames) override;
+
+  private:
+    std::atomic<float> mTarget;
+    int32_t            mChannelCount = 0;
+    int32_t            mRampFrames = 1;
+    float              mGain;  // audio thread only, like the rest below
+    float              mRampTarget = 0.0f;
+    float              mRampStep = 0.0f;
+    int32_t            mRampFramesLeft = 0;
+};
+
+/**
+ * Look-ahead peak limiter: no sample leaves it louder than the threshold, and the gain never jumps.
+ *
+ * Each frame's gain is the smallest one any frame in the next kLookAheadMillis needs, released
+ * slowly, then averaged over the look-ahead. The average reaches a frame's gain by the time the
+ * frame, delayed by the look-ahead, is output. The latency is getLatencyFrames().
+ *
+ * The peak of each frame and the gains are applied four samples at a time, the gain computer is a
+ * sliding minimum and a running sum.
+ */
+class LimiterNode : public AudioNode {
+  public:
+    static constexpr float kDefaultThreshold = 0.944f;  // -0.5 dBFS
+    static constexpr float kLookAheadMillis = 1.5f;
+    static constexpr float kReleaseMillis = 60.0f;
+
+    explicit LimiterNode(float threshold = kDefaultThreshold) : mThreshold(threshold) {}
+
+    void prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) override;
+
+    void process(float* audioData, int32_t numFrames) override;
+
+    int32_t getLatencyFrames() const { return mLookAhead - 1; }
+
+    float getThreshold() const { return mThreshold; }
+
+  private:
+    struct Entry {
+        int64_t frame;
+        float   gain;
+    };
+
+    void measurePeaks(const float* audioData, int32_t numFrames);
+    void applyGains(float* audioData, int32_t numFrames);
+
+    const float        mThreshold;
+    int32_t            mChannelCount = 0;
+    int32_t            mLookAhead = 1;
+    float              mReleaseCoefficient = 0.0f;
+    int64_t            mFrame = 0;
+    // Sliding minimum over the look-ahead, a ring of increasing gains.
+    std::vector<Entry> mMinimum;
+    size_t             mMinimumHead = 0;
+    size_t             mMinimumSize = 0;
+    float              mReleased = 1.0f;
+    // The last mLookAhead released gains and their sum.
+    std::vector<float> mWindow;
+    int32_t            mWindowPosition = 0;
+    double             mWindowSum = 0.0;
+    // Peaks, then gains, of the block.
+    std::vector<float> mGains;
+    // mLookAhead - 1 delayed frames, then the block.
+    std::vector<float> mDelay;
+};
@@ -0,0 +1,91 @@
+#include "CallbackStats.h"
+
+#include <cmath>
+
+#include "ndk_utils/log.h"
+
+namespace {
+    template <size_t N>
+    int32_t percentileBucket(const std::array<uint32_t, N>& histogram, uint64_t total, double fraction) {
+        const uint64_t target = static_cast<uint64_t>(std::ceil(fraction * total));
+        uint64_t       seen = 0;
+        for (size_t i = 0; i < N; ++i) {
+            seen += histogram[i];
+            if (seen >= target && seen > 0) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        return static_cast<int32_t>(N) - 1;
+    }
+}  // namespace
+
+double CallbackStats::Snapshot::durationBucketMicros(int32_t bucket) {
+    return std::ldexp(1.0 + (bucket % 4) / 4.0, bucket / 4);
+}
+
+double CallbackStats::Snapshot::durationPercentileMicros(double fraction) const {
+    if (callbacks == 0) {
+        return 0.0;
+    }
+    return durationBucketMicros(percentileBucket(durationHistogram, callbacks, fraction) + 1);
+}
+
+double CallbackStats::Snapshot::dutyCyclePercentile(double fraction) const {
+    if (callbacks == 0) {
+        return 0.0;
+    }
+    return (percentileBucket(dutyCycleHistogram, callbacks, fraction) + 1) * kDutyCyclePercentPerBucket / 100.0;
+}
+
+void CallbackStats::Snapshot::log(const char* name) const {
+    LOGI("%s: %llu callbacks, mean %.1fus, p99 < %.0fus, max %.0fus, p99 duty cycle < %.0f%%, %llu overruns", name,
+         (unsigned long long)callbacks, meanMicros, durationPercentileMicros(0.99), maxMicros,
+         dutyCyclePercentile(0.99) * 100.0, (unsigned long long)overruns);
+    LOGI("%s: %llu xruns in %llu callbacks, buffer %d frames (was %d, %llu changes), latency %.1fms", name,
+         (unsigned long long)xRuns, (unsigned long long)xRunCallbacks, bufferSizeFrames, previousBufferSizeFrames,
+         (unsigned long long)bufferSizeChanges, outputLatencyMillis);
+    if (restarts > 0) {
+        LOGI("%s: %u restarts, disconnect to first callback last %.1fms, max %.1fms", name, restarts,
+             lastRestartMillis, maxRestartMillis);
+    }
+}
+
+CallbackStats::Snapshot CallbackStats::snapshot() const {
+    Snapshot result;
+    result.callbacks = mCallbacks.load(std::memory_order_relaxed);
+    result.frames = mFrames.load(std::memory_order_relaxed);
+    result.overruns = mOverruns.load(std::memory_order_relaxed);
+    const int64_t totalNanos = mTotalNanos.load(std::memory_order_relaxed);
+    result.meanMicros = result.callbacks > 0 ? totalNanos / 1e3 / result.callbacks : 0.0;
+    result.maxMicros = mMaxNanos.load(std::memory_order_relaxed) / 1e3;
+    result.xRuns = mXRuns.load(std::memory_order_relaxed);
+    result.xRunCallbacks = mXRunCallbacks.load(std::memory_order_relaxed);
+    result.bufferSizeFrames = mBufferSizeFrames.load(std::memory_order_relaxed);
+    result.previousBufferSizeFrames = mPreviousBufferSizeFrames.load(std::memory_order_relaxed);
+    result.bufferSizeChanges = mBufferSizeChanges.load(std::memory_order_relaxed);
+    for (int32_t i = 0; i < kDurationBuckets; ++i) {
+        result.durationHistogram[i] = mDurationHistogram[i].load(std::memory_order_relaxed);
+    }
+    for (int32_t i = 0; i < kDutyCycleBuckets; ++i) {
+        result.dutyCycleHistogram[i] = mDutyCycleHistogram[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void CallbackStats::clear() {
+    mCallbacks.store(0, std::memory_order_relaxed);
+    mFrames.store(0, std::memory_order_relaxed);
+    mOverruns.store(0, std::memory_order_relaxed);
+    mTotalNanos.store(0, std::memory_order_relaxed);
+    mMaxNanos.store(0, std::memory_order_relaxed);
+    mXRuns.store(0, std::memory_order_relaxed);
+    mXRunCallbacks.store(0, std::memory_order_relaxed);
+    mBufferSizeChanges.store(0, std::memory_order_relaxed);
+    for (auto& bucket : mDurationHistogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    for (auto& bucket : mDutyCycleHistogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    // The buffer size is a state rather than a count, it is kept.
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Per-callback statistics of an output stream, written by the audio thread without locks and read
+ * by any other thread through snapshot().
+ *
+ * Every counter is a relaxed atomic with a single writer, so recording costs a few plain stores and
+ * a reader never makes the callback wait. A snapshot is not taken atomically as a whole: counters
+ * updated by a callback which runs during the copy may be one callback apart.
+ */
+class CallbackStats {
+  public:
+    // Callback durations in log buckets, four per octave starting at 1us. The last one is open.
+    static constexpr int32_t kDurationBuckets = 80;
+    // Duty cycle (callback duration / duration of the frames it rendered) in 5% buckets up to 200%.
+    static constexpr int32_t kDutyCyclePercentPerBucket = 5;
+    static constexpr int32_t kDutyCycleBuckets = 41;
+
+    struct Snapshot {
+        uint64_t callbacks = 0;
+        uint64_t frames = 0;
+        // Callbacks which took longer than the duration of the frames they rendered.
+        uint64_t overruns = 0;
+        double   meanMicros = 0.0;
+        double   maxMicros = 0.0;
+        // Xruns reported by the stream, summed over restarts, and the number of callbacks which saw any.
+        uint64_t xRuns = 0;
+        uint64_t xRunCallbacks = 0;
+        // Buffer size as of the last callback and how often it changed, e.g. by the LatencyTuner.
+        int32_t  bufferSizeFrames = 0;
+        int32_t  previousBufferSizeFrames = 0;
+        uint64_t bufferSizeChanges = 0;
+        // Filled by whoever owns the stream, @see OboeEngine::getCallbackStats. Negative if unknown.
+        double   outputLatencyMillis = -1.0;
+        // Stream restarts after a disconnect and the time from the disconnect to the first callback
+        // of the new stream, also filled by the owner.
+        uint32_t restarts = 0;
+        double   lastRestartMillis = -1.0;
+        double   maxRestartMillis = -1.0;
+
+        std::array<uint32_t, kDurationBuckets>  durationHistogram {};
+        std::array<uint32_t, kDutyCycleBuckets> dutyCycleHistogram {};
+
+        // Lower edge of a duration bucket in microseconds.
+        static double durationBucketMicros(int32_t bucket);
+
+        /**
+         * Callback duration below which the given fraction of callbacks finished, to the resolution
+         * of the histogram (the upper edge of the bucket).
+         */
+        double durationPercentileMicros(double fraction) const;
+
+        double dutyCyclePercentile(double fraction) const;
+
+        void log(const char* name) const;
+    };
+
+    /**
+     * Record one callback. Audio thread only.
+     * @param durationNanos time spent in the callback
+     * @param periodNanos duration of the frames it rendered
+     * @param xRuns xrun count of the stream since it was opened, negative if unavailable
+     */
+    void record(int64_t durationNanos, int64_t periodNanos, int32_t frames, int32_t xRuns, int32_t bufferSizeFrames) {
+        if (mResetRequested.load(std::memory_order_acquire)) {
+            clear();
+            mResetRequested.store(false, std::memory_order_release);
+        }
+        const uint32_t streams = mStreams.load(std::memory_order_acquire);
+        if (streams != mStreamsSeen) {
+            mStreamXRuns = 0;
+            mStreamsSeen = streams;
+        }
+        add(mCallbacks, 1);
+        add(mFrames, frames);
+        add(mTotalNanos, durationNanos);
+        if (durationNanos > mMaxNanos.load(std::memory_order_relaxed)) {
+            mMaxNanos.store(durationNanos, std::memory_order_relaxed);
+        }
+        if (durationNanos > periodNanos) {
+            add(mOverruns, 1);
+        }
+        add(mDurationHistogram[durationBucket(durationNanos)], 1);
+        const int64_t dutyPercent = periodNanos > 0 ? durationNanos * 100 / periodNanos : 0;
+        add(mDutyCycleHistogram[std::min<int64_t>(dutyPercent / kDutyCyclePercentPerBucket, kDutyCycleBuckets - 1)], 1);
+
+        if (xRuns > mStreamXRuns) {
+            add(mXRuns, xRuns - mStreamXRuns);
+            add(mXRunCallbacks, 1);
+            mStreamXRuns = xRuns;
+        }
+        const int32_t lastBufferSize = mBufferSizeFrames.load(std::memory_order_relaxed);
+        if (bufferSizeFrames != lastBufferSize) {
+            if (lastBufferSize != 0) {
+                add(mBufferSizeChanges, 1);
+                mPreviousBufferSizeFrames.store(lastBufferSize, std::memory_order_relaxed);
+            }
+            mBufferSizeFrames.store(bufferSizeFrames, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Copy the statistics. Never blocks the audio thread, call it from any other thread.
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * Start counting from zero. The audio thread clears the counters at its next callback.
+     */
+    void reset() { mResetRequested.store(true, std::memory_order_release); }
+
+    /**
+     * The next callbacks come from a new stream, whose xrun count starts from zero again. Call before
+     * its first callback, from any thread.
+     */
+    void beginStream() { mStreams.fetch_add(1, std::memory_order_release); }
+
+  private:
+    template <typename T>
+    static void add(std::atomic<T>& counter, int64_t value) {
+        // Only the audio thread writes, so a load and a store are enough and cheaper than an RMW.
+        counter.store(counter.load(std::memory_order_relaxed) + static_cast<T>(value), std::memory_order_relaxed);
+    }
+
+    static int32_t durationBucket(int64_t nanos) {
+        const uint64_t micros = nanos > 1000 ? static_cast<uint64_t>(nanos) / 1000 : 1;
+        const int32_t  octave = 63 - __builtin_clzll(micros);
+        // The two bits below the leading one pick the quarter of the octave.
+        const int32_t quarter = octave >= 2 ? static_cast<int32_t>((micros >> (octave - 2)) & 3)
+                                            : static_cast<int32_t>((micros << (2 - octave)) & 3);
+        return std::min(octave * 4 + quarter, kDurationBuckets - 1);
+    }
+
+    void clear();
+
+    std::atomic<uint64_t> mCallbacks { 0 };
+    std::atomic<uint64_t> mFrames { 0 };
+    std::atomic<uint64_t> mOverruns { 0 };
+    std::atomic<int64_t>  mTotalNanos { 0 };
+    std::atomic<int64_t>  mMaxNanos { 0 };
+    std::atomic<uint64_t> mXRuns { 0 };
+    std::atomic<uint64_t> mXRunCallbacks { 0 };
+    std::atomic<int32_t>  mBufferSizeFrames { 0 };
+    std::atomic<int32_t>  mPreviousBufferSizeFrames { 0 };
+    std::atomic<uint64_t> mBufferSizeChanges { 0 };
+    std::atomic<bool>     mResetRequested { false };
+    std::atomic<uint32_t> mStreams { 0 };  // bumped by beginStream()
+
+    // Audio thread only
+    int32_t               mStreamXRuns = 0;  // of the current stream, already added to mXRuns
+    uint32_t              mStreamsSeen = 0;
+
+    std::array<std::atomic<uint32_t>, kDurationBuckets>  mDurationHistogram {};
+    std::array<std::atomic<uint32_t>, kDutyCycleBuckets> mDutyCycleHistogram {};
+};
@@ -0,0 +1,94 @@
+#include "CaptureCallback.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "ndk_utils/log.h"
+#include "ndk_utils/rt_check.h"
+
+oboe::DataCallbackResult CaptureCallback::onAudioReady(oboe::AudioStream* oboeStream, void* audioData,
+                                                       int32_t numFrames) {
+    (void)oboeStream;
+    rt_check::ScopedRealtime realtime;
+    mCallbacks.fetch_add(1, std::memory_order_relaxed);
+    if (mMaxFrames == 0) {
+        return oboe::DataCallbackResult::Continue;
+    }
+
+    for (int32_t done = 0; done < numFrames;) {
+        const int32_t frames = std::min(mMaxFrames, numFrames - done);
+        const size_t  offset = static_cast<size_t>(done) * mChannelCount;
+        const size_t  count = static_cast<size_t>(frames) * mChannelCount;
+        const float*  input = static_cast<const float*>(audioData) + offset;
+        if (mFormat == oboe::AudioFormat::I16) {
+            const int16_t*     samples = static_cast<const int16_t*>(audioData) + offset;
+            const simd::float4 scale = simd::set1(1.0f / 32768.0f);
+            size_t             i = 0;
+            for (; i + 4 <= count; i += 4) {
+                simd::store(mFloat.data() + i, simd::mul(simd::set4(samples[i], samples[i + 1], samples[i + 2],
+                                                                    samples[i + 3]), scale));
+            }
+            for (; i < count; ++i) {
+                mFloat[i] = samples[i] / 32768.0f;
+            }
+            input = mFloat.data();
+        }
+        if (mChannelCount == 1) {
+            capture(input, frames);
+        } else {
+            mDownmix(input, mMono.data(), frames);
+            capture(mMono.data(), frames);
+        }
+        done += frames;
+    }
+    return oboe::DataCallbackResult::Continue;
+}
+
+void CaptureCallback::capture(const float* mono, int32_t numFrames) {
+    mVoiceActivity.process(mono, numFrames);
+    const size_t written = mRing.write(mono, numFrames);
+    if (written < static_cast<size_t>(numFrames)) {
+        mDroppedFrames.fetch_add(numFrames - written, std::memory_order_relaxed);
+    }
+}
+
+void CaptureCallback::useStream(std::shared_ptr<oboe::AudioStream> stream) {
+    if (stream) {
+        setFormat(stream->getSampleRate(), stream->getChannelCount(), stream->getFormat(),
+                  std::max(stream->getBufferCapacityInFrames(), stream->getFramesPerBurst()));
+    }
+}
+
+void CaptureCallback::setFormat(int32_t sampleRate, int32_t channelCount, oboe::AudioFormat format,
+                                int32_t maxFrames) {
+    mChannelCount = std::max(channelCount, 1);
+    mFormat = format;
+    mMaxFrames = std::max(maxFrames, 1);
+    mDownmix.setLayout(mChannelCount, 1);
+    mFloat.assign(format == oboe::AudioFormat::I16 ? static_cast<size_t>(mMaxFrames) * mChannelCount : 0, 0.0f);
+    mMono.assign(mChannelCount > 1 ? mMaxFrames : 0, 0.0f);
+    // The ring and its positions carry on, only the producer's side is touched.
+    const uint64_t start = mRing.writePosition();
+    mVoiceActivity.prepare(sampleRate, static_cast<int64_t>(start));
+    mDroppedFrames.store(0, std::memory_order_relaxed);
+    mCallbacks.store(0, std::memory_order_relaxed);
+    mSampleRate.store(sampleRate, std::memory_order_release);
+    mStreamStartPosition.store(start, std::memory_order_release);
+    mStreamGeneration.fetch_add(1, std::memory_order_acq_rel);
+    LOGI("Capture: %d Hz, %d ch, %s, %zu frame ring, stream %u from frame %llu", sampleRate, mChannelCount,
+         format == oboe::AudioFormat::I16 ? "I16" : "float", mRing.capacity(), getStreamGeneration(),
+         static_cast<unsigned long long>(start));
+}
+
+bool CaptureCallback::waitForSpeech(int32_t timeoutMillis) const {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (!mVoiceActivity.isSpeech()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        usleep(kConsumerIdleMicros);
+    }
+    return true;
+}
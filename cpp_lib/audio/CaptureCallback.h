@@ -0,0 +1,122 @@
+#pragma once
+#include <oboe/Oboe.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ChannelConvert.h"
+#include "SpscRingBuffer.h"
+#include "VoiceActivityDetector.h"
+
+/**
+ * Data callback of the capture stream: it moves the captured frames, mixed down to mono, into a
+ * lock-free ring for one consumer thread and runs a VoiceActivityDetector over them.
+ *
+ * The callback never allocates, locks or blocks. If the consumer falls behind by more than the ring
+ * holds, the frames which do not fit are dropped and counted. Positions count the frames written to
+ * the ring since the callback was created, the detector's speech frames are in the same count as long
+ * as nothing was dropped.
+ *
+ * The ring is allocated once, for kMaxSampleRate, and lives as long as the callback: a consumer keeps
+ * reading it while the engine closes and reopens the capture stream. A new stream only bumps the
+ * stream generation and carries on from the write position of the last one.
+ *
+ * The consumer can sleep in waitForSpeech(), dropping what it does not need with keepLatest(), and
+ * read from getVoiceActivity().getSpeechStartFrame(), so it only runs while someone speaks and still
+ * hears the start of it.
+ */
+class CaptureCallback : public oboe::AudioStreamDataCallback {
+  public:
+    static constexpr int32_t kDefaultCapacityMillis = 2000;
+    static constexpr int     kConsumerIdleMicros = 2000;
+    static constexpr int32_t kMaxSampleRate = 96000;  // the ring holds capacityMillis up to this rate
+
+    explicit CaptureCallback(int32_t capacityMillis = kDefaultCapacityMillis)
+        : mRing(static_cast<size_t>(kMaxSampleRate) * capacityMillis / 1000) { }
+
+    oboe::DataCallbackResult onAudioReady(oboe::AudioStream* oboeStream, void* audioData, int32_t numFrames) override;
+
+    /**
+     * Prepare for the stream which is about to start: size the conversion buffers, reset the detector
+     * and start a new stream generation. Only call this while no capture stream is running; the consumer
+     * may go on reading.
+     */
+    void useStream(std::shared_ptr<oboe::AudioStream> stream);
+
+    void setFormat(int32_t sampleRate, int32_t channelCount, oboe::AudioFormat format, int32_t maxFrames);
+
+    int32_t getSampleRate() const { return mSampleRate.load(std::memory_order_acquire); }
+
+    /**
+     * Counts the streams prepared with useStream() or setFormat(), 0 before the first.
+     */
+    uint32_t getStreamGeneration() const { return mStreamGeneration.load(std::memory_order_acquire); }
+
+    /**
+     * Position of the first frame of the latest stream. What is before it may be at another sample
+     * rate; a consumer which must not mix the two drops it with skipTo().
+     */
+    uint64_t getStreamStartPosition() const { return mStreamStartPosition.load(std::memory_order_acquire); }
+
+    const VoiceActivityDetector& getVoiceActivity() const { return mVoiceActivity; }
+
+    // Consumer side, one thread
+
+    /**
+     * Move up to numFrames mono frames out of the ring.
+     * @return the number of frames read
+     */
+    size_t read(float* audioData, size_t numFrames) { return mRing.read(audioData, numFrames); }
+
+    size_t availableToRead() const { return mRing.availableToRead(); }
+
+    uint64_t getReadPosition() const { return mRing.readPosition(); }
+
+    /**
+     * Drop the frames before a position, e.g. the start of speech. Positions already read or not yet
+     * captured are clamped.
+     */
+    void skipTo(uint64_t position) { mRing.skipTo(position); }
+
+    /**
+     * Drop all but the latest frames. A consumer which waits for speech does this while there is none,
+     * so the ring never overflows and still holds the start of the next speech.
+     */
+    void keepLatest(size_t numFrames) {
+        const size_t available = availableToRead();
+        if (available > numFrames) {
+            skipTo(getReadPosition() + available - numFrames);
+        }
+    }
+
+    /**
+     * Sleep until speech is detected, polling every kConsumerIdleMicros.
+     * @return false if there was none within the timeout
+     */
+    bool waitForSpeech(int32_t timeoutMillis) const;
+
+    uint64_t getDroppedFrames() const { return mDroppedFrames.load(std::memory_order_relaxed); }
+
+    uint64_t getCallbackCount() const { return mCallbacks.load(std::memory_order_relaxed); }
+
+  private:
+    void capture(const float* mono, int32_t numFrames);
+
+    // Capture thread, set while no stream runs.
+    int32_t             mChannelCount = 0;
+    oboe::AudioFormat   mFormat = oboe::AudioFormat::Float;
+    int32_t             mMaxFrames = 0;
+    channels::Converter mDownmix;
+    std::vector<float>  mFloat;  // an I16 burst as float
+    std::vector<float>  mMono;
+
+    SpscRingBuffer<float>  mRing;
+    VoiceActivityDetector  mVoiceActivity;
+    std::atomic<int32_t>   mSampleRate {0};
+    std::atomic<uint32_t>  mStreamGeneration {0};
+    std::atomic<uint64_t>  mStreamStartPosition {0};
+    std::atomic<uint64_t>  mDroppedFrames {0};
+    std::atomic<uint64_t>  mCallbacks {0};
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "Simd.h"
+
+/**
+ * Channel layout kernels for interleaved float frames, specialized at compile time on the channel
+ * counts so the per-frame loops have constant strides and no branches. Mono to stereo, stereo to
+ * mono and interleaving stereo have SIMD bodies.
+ *
+ * Pick a kernel once per stream configuration with Converter, getInterleaver or getDeinterleaver
+ * and call it per block.
+ *
+ * Every conversion in the library follows the same layout rule: output channel i takes input
+ * channel min(i, inputs - 1), so mono goes to every channel and extra channels are dropped, except
+ * that stereo to mono is the average of the two.
+ */
+namespace channels {
+
+    // Counts up to this get a specialized kernel, larger ones a generic loop.
+    constexpr int32_t kMaxChannels = 8;
+
+    template <int32_t In, int32_t Out>
+    inline void convert(const float* in, float* out, size_t frames) {
+        static_assert(In > 0 && Out > 0);
+        size_t j = 0;
+        if constexpr (In == Out) {
+            std::memcpy(out, in, frames * In * sizeof(float));
+            return;
+        } else if constexpr (In == 1 && Out == 2) {
+            for (; j + 4 <= frames; j += 4) {
+                const simd::float4 mono = simd::load(in + j);
+                simd::storeInterleaved(out + j * 2, mono, mono);
+            }
+        } else if constexpr (In == 2 && Out == 1) {
+            const simd::float4 half = simd::set1(0.5f);
+            for (; j + 4 <= frames; j += 4) {
+                simd::float4 left;
+                simd::float4 right;
+                simd::loadDeinterleaved(in + j * 2, left, right);
+                simd::store(out + j, simd::mul(simd::add(left, right), half));
+            }
+        }
+        for (; j < frames; ++j) {
+            const float* frame = in + j * In;
+            if constexpr (In == 2 && Out == 1) {
+                out[j] = 0.5f * (frame[0] + frame[1]);
+            } else {
+                for (int32_t i = 0; i < Out; ++i) {
+                    out[j * Out + i] = frame[i < In ? i : In - 1];
+                }
+            }
+        }
+    }
+
+    /**
+     * The same conversion for any channel counts, with the counts read at run time.
+     */
+    inline void convert(const float* in, int32_t inChannels, float* out, int32_t outChannels, size_t frames) {
+        for (size_t j = 0; j < frames; ++j) {
+            const float* frame = in + j * inChannels;
+            if (inChannels == 2 && outChannels == 1) {
+                out[j] = 0.5f * (frame[0] + frame[1]);
+                continue;
+            }
+            for (int32_t i = 0; i < outChannels; ++i) {
+                out[j * outChannels + i] = frame[i < inChannels ? i : inChannels - 1];
+            }
+        }
+    }
+
+    /**
+     * Interleave one buffer per channel into frames.
+     */
+    template <int32_t Channels>
+    inline void interleave(const float* const* planes, float* out, size_t frames) {
+        size_t j = 0;
+        if constexpr (Channels == 1) {
+            std::memcpy(out, planes[0], frames * sizeof(float));
+            return;
+        } else if constexpr (Channels == 2) {
+            for (; j + 4 <= frames; j += 4) {
+                simd::storeInterleaved(out + j * 2, simd::load(planes[0] + j), simd::load(planes[1] + j));
+            }
+        }
+        for (; j < frames; ++j) {
+            for (int32_t i = 0; i < Channels; ++i) {
+                out[j * Channels + i] = planes[i][j];
+            }
+        }
+    }
+
+    /**
+     * Split frames into one buffer per channel.
+     */
+    template <int32_t Channels>
+    inline void deinterleave(const float* in, float* const* planes, size_t frames) {
+        size_t j = 0;
+        if constexpr (Channels == 1) {
+            std::memcpy(planes[0], in, frames * sizeof(float));
+            return;
+        } else if constexpr (Channels == 2) {
+            for (; j + 4 <= frames; j += 4) {
+                simd::float4 left;
+                simd::float4 right;
+                simd::loadDeinterleaved(in + j * 2, left, right);
+                simd::store(planes[0] + j, left);
+                simd::store(planes[1] + j, right);
+            }
+        }
+        for (; j < frames; ++j) {
+            for (int32_t i = 0; i < Channels; ++i) {
+                planes[i][j] = in[j * Channels + i];
+            }
+        }
+    }
+
+    using ConvertFunction = void (*)(const float* in, float* out, size_t frames);
+    using InterleaveFunction = void (*)(const float* const* planes, float* out, size_t frames);
+    using DeinterleaveFunction = void (*)(const float* in, float* const* planes, size_t frames);
+
+    namespace detail {
+        template <int32_t In, size_t... Out>
+        constexpr std::array<ConvertFunction, kMaxChannels> convertRow(std::index_sequence<Out...>) {
+            return {&convert<In, static_cast<int32_t>(Out) + 1>...};
+        }
+
+        template <size_t... In>
+        constexpr std::array<std::array<ConvertFunction, kMaxChannels>, kMaxChannels> convertTable(
+                std::index_sequence<In...>) {
+            return {convertRow<static_cast<int32_t>(In) + 1>(std::make_index_sequence<kMaxChannels>())...};
+        }
+
+        template <size_t... C>
+        constexpr std::array<InterleaveFunction, kMaxChannels> interleaveTable(std::index_sequence<C...>) {
+            return {&interleave<static_cast<int32_t>(C) + 1>...};
+        }
+
+        template <size_t... C>
+        constexpr std::array<DeinterleaveFunction, kMaxChannels> deinterleaveTable(std::index_sequence<C...>) {
+            return {&deinterleave<static_cast<int32_t>(C) + 1>...};
+        }
+
+        constexpr bool isSpecialized(int32_t channels) { return channels >= 1 && channels <= kMaxChannels; }
+    }  // namespace detail
+
+    /**
+     * The kernel for a pair of channel counts, nullptr if either is outside 1..kMaxChannels.
+     */
+    inline ConvertFunction getConverter(int32_t inChannels, int32_t outChannels) {
+        static constexpr auto kTable = detail::convertTable(std::make_index_sequence<kMaxChannels>());
+        if (!detail::isSpecialized(inChannels) || !detail::isSpecialized(outChannels)) {
+            return nullptr;
+        }
+        return kTable[inChannels - 1][outChannels - 1];
+    }
+
+    inline InterleaveFunction getInterleaver(int32_t channelCount) {
+        static constexpr auto kTable = detail::interleaveTable(std::make_index_sequence<kMaxChannels>());
+        return detail::isSpecialized(channelCount) ? kTable[channelCount - 1] : nullptr;
+    }
+
+    inline DeinterleaveFunction getDeinterleaver(int32_t channelCount) {
+        static constexpr auto kTable = detail::deinterleaveTable(std::make_index_sequence<kMaxChannels>());
+        return detail::isSpecialized(channelCount) ? kTable[channelCount - 1] : nullptr;
+    }
+
+    /**
+     * A conversion between two layouts, dispatched when the layout is set rather than per sample.
+     * Counts above kMaxChannels fall back to the run time loop.
+     */
+    class Converter {
+      public:
+        Converter() = default;
+
+        Converter(int32_t inChannels, int32_t outChannels) { setLayout(inChannels, outChannels); }
+
+        void setLayout(int32_t inChannels, int32_t outChannels) {
+            mInChannels = inChannels;
+            mOutChannels = outChannels;
+            mFunction = getConverter(inChannels, outChannels);
+        }
+
+        int32_t getInChannels() const { return mInChannels; }
+
+        int32_t getOutChannels() const { return mOutChannels; }
+
+        void operator()(const float* in, float* out, size_t frames) const {
+            if (mFunction != nullptr) {
+                mFunction(in, out, frames);
+            } else {
+                convert(in, mInChannels, out, mOutChannels, frames);
+            }
+        }
+
+      private:
+        int32_t         mInChannels = 1;
+        int32_t         mOutChannels = 1;
+        ConvertFunction mFunction = &convert<1, 1>;
+    };
+
+}  // namespace channels
@@ -0,0 +1,190 @@
+#include "ClipCache.h"
+
+#include <algorithm>
+
+#include "ndk_utils/log.h"
+#include "ChannelConvert.h"
+#include "ImaAdpcm.h"
+#include "PcmDecoder.h"
+#include "Resampler.h"
+
+namespace {
+    constexpr uint64_t kDecodeChunkFrames = 4096;
+}
+
+ClipCache::ClipCache(size_t budgetBytes) : mBudgetBytes(budgetBytes) { }
+
+void ClipCache::setFormat(int32_t sampleRate, int32_t channelCount) {
+    if (sampleRate == mSampleRate && channelCount == mChannelCount) {
+        return;
+    }
+    LOGI("Clip cache format %d Hz, %d ch, dropping %zu clips", sampleRate, channelCount, mEntries.size());
+    mSampleRate = sampleRate;
+    mChannelCount = channelCount;
+    for (auto& [name, entry] : mEntries) {
+        retire(std::move(entry.clip));
+    }
+    mEntries.clear();
+    mLru.clear();
+    mBytesUsed = 0;
+    mBytesSaved = 0;
+}
+
+void ClipCache::setBudget(size_t budgetBytes) {
+    mBudgetBytes = budgetBytes;
+    makeRoom(0);
+}
+
+const PcmClip* ClipCache::find(const std::string& name) {
+    auto it = mEntries.find(name);
+    if (it == mEntries.end()) {
+        ++mMisses;
+        return nullptr;
+    }
+    ++mHits;
+    mLru.splice(mLru.begin(), mLru, it->second.lruPosition);
+    return it->second.clip.get();
+}
+
+const PcmClip* ClipCache::insert(const std::string& name, const uint8_t* data, size_t size) {
+    purgeRetired();
+    if (auto it = mEntries.find(name); it != mEntries.end()) {
+        return it->second.clip.get();
+    }
+
+    auto clip = decode(name, data, size, mSampleRate, mChannelCount);
+    if (!clip) {
+        return nullptr;
+    }
+    const size_t bytesSaved = mStorage == ClipStorage::Adpcm ? compress(*clip) : 0;
+    const size_t bytes = clip->sizeInBytes();
+    if (!makeRoom(bytes)) {
+        LOGW("Clip %s (%zu bytes) does not fit in the cache budget of %zu bytes", name.c_str(), bytes, mBudgetBytes);
+        return nullptr;
+    }
+
+    const PcmClip* result = clip.get();
+    mLru.push_front(result);
+    mEntries.emplace(name, Entry { std::move(clip), mLru.begin(), bytesSaved });
+    mBytesUsed += bytes;
+    mBytesSaved += bytesSaved;
+    LOGI("Cached clip %s: %d frames, %zu bytes%s, %zu/%zu bytes used", name.c_str(), result->frames, bytes,
+         result->isCompressed() ? " as IMA-ADPCM" : "", mBytesUsed, mBudgetBytes);
+    return result;
+}
+
+bool ClipCache::makeRoom(size_t bytes) {
+    if (bytes > mBudgetBytes) {
+        return false;
+    }
+    auto it = mLru.end();
+    while (mBytesUsed + bytes > mBudgetBytes && it != mLru.begin()) {
+        --it;
+        const PcmClip* victim = *it;
+        if (victim->isPlaying()) {
+            continue;
+        }
+        auto entry = mEntries.find(victim->name);
+        mBytesUsed -= victim->sizeInBytes();
+        mBytesSaved -= entry->second.bytesSaved;
+        it = mLru.erase(it);
+        mEntries.erase(entry);
+        ++mEvictions;
+    }
+    return mBytesUsed + bytes <= mBudgetBytes;
+}
+
+void ClipCache::retire(std::unique_ptr<PcmClip> clip) {
+    if (clip && clip->isPlaying()) {
+        mRetired.push_back(std::move(clip));
+    }
+}
+
+void ClipCache::purgeRetired() {
+    std::erase_if(mRetired, [](const std::unique_ptr<PcmClip>& clip) { return !clip->isPlaying(); });
+}
+
+std::unique_ptr<PcmClip> ClipCache::decode(const std::string& name,
+                                           const uint8_t*     data,
+                                           size_t             size,
+                                           int32_t            sampleRate,
+                                           int32_t            channelCount) {
+    auto decoder = PcmDecoder::open(data, size);
+    if (!decoder) {
+        LOGE("Failed to open clip %s", name.c_str());
+        return nullptr;
+    }
+
+    // Decode in chunks rather than asking for the frame count, which for MP3 would scan the whole file first.
+    const int32_t      sourceRate = decoder->getSampleRate();
+    const int32_t      sourceChannels = decoder->getChannelCount();
+    std::vector<float> decoded;
+    uint64_t           frames = 0;
+    while (true) {
+        decoded.resize((frames + kDecodeChunkFrames) * sourceChannels);
+        uint64_t read = decoder->read(&decoded[frames * sourceChannels], kDecodeChunkFrames);
+        frames += read;
+        if (read < kDecodeChunkFrames) {
+            break;
+        }
+    }
+    decoded.resize(frames * sourceChannels);
+
+    if (frames == 0) {
+        LOGE("Clip %s has no audio", name.c_str());
+        return nullptr;
+    }
+
+    auto clip = std::make_unique<PcmClip>();
+    clip->name = name;
+    clip->samples = convert(decoded, sourceRate, sourceChannels, sampleRate, channelCount);
+    clip->samples.shrink_to_fit();
+    clip->frames = static_cast<int32_t>(clip->samples.size() / channelCount);
+    clip->sampleRate = sampleRate;
+    clip->channelCount = channelCount;
+    return clip;
+}
+
+size_t ClipCache::compress(PcmClip& clip) {
+    if (!ima_adpcm::isSupported(clip.channelCount) || clip.samples.empty()) {
+        return 0;
+    }
+    const size_t floatBytes = clip.samples.capacity() * sizeof(float);
+    clip.adpcm = ima_adpcm::encode(clip.samples.data(), clip.frames, clip.channelCount);
+    clip.samples.clear();
+    clip.samples.shrink_to_fit();
+    return floatBytes - clip.adpcm.capacity();
+}
+
+std::vector<float> ClipCache::convert(const std::vector<float>& input,
+                                      int32_t                   inputRate,
+                                      int32_t                   inputChannels,
+                                      int32_t                   outputRate,
+                                      int32_t                   outputChannels) {
+    const std::vector<float>* source = &input;
+    std::vector<float>        resampled;
+    if (inputRate != outputRate) {
+        const int32_t inputFrames = static_cast<int32_t>(input.size() / inputChannels);
+        const int32_t outputFrames = static_cast<int32_t>(static_cast<int64_t>(inputFrames) * outputRate / inputRate);
+        Resampler     resampler(inputRate, outputRate, inputChannels);
+        resampled.resize(static_cast<size_t>(outputFrames) * inputChannels);
+        int32_t produced = resampler.process(input.data(), inputFrames, resampled.data(), outputFrames);
+        // Drain the filter lookahead with silence to get the last frames out.
+        std::vector<float> silence(static_cast<size_t>(Resampler::kBlockFrames) * inputChannels, 0.0f);
+        while (produced < outputFrames) {
+            int32_t more = resampler.process(silence.data(), Resampler::kBlockFrames,
+                                             &resampled[static_cast<size_t>(produced) * inputChannels],
+                                             outputFrames - produced);
+            if (more == 0) {
+                break;
+            }
+            produced += more;
+        }
+        source = &resampled;
+    }
+
+    const size_t       frames = source->size() / inputChannels;
+    std::vector<float> output(frames * outputChannels);
+    channels::Converter(inputChannels, outputChannels)(source->data(), output.data(), frames);
+    return output;
+}
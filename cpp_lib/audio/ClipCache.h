@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PcmClip.h"
+
+/**
+ * How ClipCache keeps decoded clips. Adpcm takes about an eighth of the memory of Float, at 4 bits a
+ * sample, and the mixer decodes it as it plays, @see ima_adpcm.
+ */
+enum class ClipStorage { Float, Adpcm };
+
+/**
+ * Decodes named MP3, WAV or FLAC assets once, converted to the stream's sample rate and channel layout, and keeps
+ * them under a memory budget with least-recently-used eviction.
+ *
+ * A hit costs a hash lookup and a list splice: no decoding and no allocation. Clips that are still
+ * playing (@see PcmClip::isPlaying) are never freed; if they have to leave the cache they are parked
+ * until their voices finish.
+ *
+ * The cache is not thread-safe, use it from the thread which triggers clips.
+ */
+class ClipCache {
+  public:
+    static constexpr size_t kDefaultBudgetBytes = 16 * 1024 * 1024;
+
+    explicit ClipCache(size_t budgetBytes = kDefaultBudgetBytes);
+
+    /**
+     * Set the format clips are decoded to. Clips decoded for a different format are dropped.
+     */
+    void setFormat(int32_t sampleRate, int32_t channelCount);
+
+    void setBudget(size_t budgetBytes);
+
+    /**
+     * Set how clips inserted from now on are kept. IMA-ADPCM needs a format of 1, 2 or 4 channels,
+     * clips of other formats are kept as float.
+     */
+    void setStorage(ClipStorage storage) { mStorage = storage; }
+
+    ClipStorage getStorage() const { return mStorage; }
+
+    /**
+     * Look up a clip and mark it as most recently used. Counts as a hit or a miss.
+     * @return the clip, or nullptr if it has to be inserted first
+     */
+    const PcmClip* find(const std::string& name);
+
+    /**
+     * Decode a clip held in memory and add it to the cache, evicting older clips to make room.
+     * @return the clip, or nullptr if it cannot be decoded or does not fit in the budget
+     */
+    const PcmClip* insert(const std::string& name, const uint8_t* data, size_t size);
+
+    /**
+     * Decode an MP3, WAV or FLAC clip held in memory into a clip of the given format.
+     */
+    static std::unique_ptr<PcmClip> decode(const std::string& name,
+                                           const uint8_t*     data,
+                                           size_t             size,
+                                           int32_t            sampleRate,
+                                           int32_t            channelCount);
+
+    /**
+     * Replace a clip's float samples with IMA-ADPCM.
+     * @return the number of bytes saved
+     */
+    static size_t compress(PcmClip& clip);
+
+    /**
+     * Convert interleaved PCM to the given sample rate and channel count.
+     */
+    static std::vector<float> convert(const std::vector<float>& input,
+                                      int32_t                   inputRate,
+                                      int32_t                   inputChannels,
+                                      int32_t                   outputRate,
+                                      int32_t                   outputChannels);
+
+    uint64_t getHitCount() const { return mHits; }
+
+    uint64_t getMissCount() const { return mMisses; }
+
+    uint64_t getEvictionCount() const { return mEvictions; }
+
+    size_t getBytesUsed() const { return mBytesUsed; }
+
+    size_t getBudget() const { return mBudgetBytes; }
+
+    /**
+     * How many more bytes the cached clips would take as float.
+     */
+    size_t getBytesSaved() const { return mBytesSaved; }
+
+    int32_t getSampleRate() const { return mSampleRate; }
+
+    int32_t getChannelCount() const { return mChannelCount; }
+
+  private:
+    struct Entry {
+        std::unique_ptr<PcmClip>            clip;
+        std::list<const PcmClip*>::iterator lruPosition;
+        size_t                              bytesSaved = 0;
+    };
+
+    // Evict least recently used clips which are not playing until bytes more fit in the budget.
+    bool makeRoom(size_t bytes);
+    void retire(std::unique_ptr<PcmClip> clip);
+    void purgeRetired();
+
+    size_t      mBudgetBytes;
+    size_t      mBytesUsed = 0;
+    size_t      mBytesSaved = 0;
+    int32_t     mSampleRate = 48000;
+    int32_t     mChannelCount = 2;
+    ClipStorage mStorage = ClipStorage::Float;
+
+    std::unordered_map<std::string, Entry> mEntries;
+    std::list<const PcmClip*>              mLru;  // most recently used first
+    std::vector<std::unique_ptr<PcmClip>>  mRetired;
+
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mEvictions = 0;
+};
@@ -0,0 +1,203 @@
+#include "ClipSequencer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ndk_utils/log.h"
+
+namespace {
+    // Clip starts and ends the callback has not reached yet. The decoder thread waits while it is full.
+    constexpr size_t kMaxBoundaries = 64;
+
+    // Ids wrap from UINT32_MAX to 1, so compare them by their distance. The few clips alive at a
+    // time are never 2^31 ids apart.
+    bool isClearedBy(uint32_t id, uint32_t clearThrough) { return static_cast<int32_t>(id - clearThrough) <= 0; }
+}  // namespace
+
+ClipSequencer::ClipSequencer(int32_t deviceSampleRate, int32_t deviceChannelCount)
+    : DecodeAheadSource(deviceSampleRate, deviceChannelCount, "Clip sequencer")
+    , mRequests(std::make_unique<SpscRingBuffer<Request>>(kMaxQueuedClips))
+    , mBoundaries(std::make_unique<SpscRingBuffer<Boundary>>(kMaxBoundaries)) { }
+
+ClipSequencer::~ClipSequencer() { stop(); }
+
+uint32_t ClipSequencer::enqueue(const void* data, size_t size) {
+    if (mRequests->availableToWrite() == 0) {
+        LOGW("Clip queue full, %zu clips waiting", kMaxQueuedClips);
+        return 0;
+    }
+    mLastId = mLastId == UINT32_MAX ? 1 : mLastId + 1;
+    const Request request {data, size, mLastId};
+    mRequests->write(&request, 1);
+    return request.id;
+}
+
+void ClipSequencer::renderAudio(float* audioData, int32_t numFrames) {
+    const uint64_t before = mRing->readPosition();
+    const size_t   got = readRing(audioData, numFrames);
+    const uint64_t position = mRing->readPosition();
+    // What a clear() skipped, the clips which start or end in it are never heard.
+    const uint64_t skippedTo = position - got * mDeviceChannelCount;
+
+    // A clip has started once its first frame is read, the queue has run dry once its end is reached.
+    Boundary boundary;
+    while (mBoundaries->peek(&boundary, 1) == 1
+           && (boundary.id == 0 ? boundary.position <= position : boundary.position < position)) {
+        mBoundaries->read(&boundary, 1);
+        if (boundary.position >= before && boundary.position < skippedTo) {
+            continue;
+        }
+        mPlayingClip.store(boundary.id, std::memory_order_relaxed);
+        if (boundary.id != 0) {
+            mClipsStarted.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (got < static_cast<size_t>(numFrames) && mPlayingClip.load(std::memory_order_relaxed) != 0) {
+        countUnderrun(numFrames - got);
+    }
+}
+
+void ClipSequencer::pollRequests() {
+    const uint32_t clearThrough = mClearThrough.load(std::memory_order_acquire);
+    if (clearThrough != mClearedThrough && mBoundaries->availableToWrite() > 0) {
+        dropCleared(clearThrough);
+    }
+
+    // Open the next clip and decode its pre-roll while the current one still plays.
+    openNext();
+    if (mDecoder == nullptr && mNext.decoder != nullptr) {
+        advance();
+    }
+}
+
+// Leave room for a clip start and end marker as well.
+bool ClipSequencer::readyToDecode() const { return mDecoder != nullptr && mBoundaries->availableToWrite() >= 2; }
+
+void ClipSequencer::onDecoderEnd() {
+    // The next clip goes on at the very next ring position, the callback never sees the join.
+    LOGI("Clip %u finished", mClipId);
+    // The resampler carries on into a next clip of the same format, otherwise its tail goes now.
+    if (mNext.decoder == nullptr || mNext.decoder->getSampleRate() != mSampleRate
+        || mNext.decoder->getChannelCount() != mChannelCount) {
+        drainResampler();
+    }
+    mDecoder.reset();
+    if (mNext.decoder != nullptr) {
+        advance();
+    } else {
+        const Boundary end {mRing->writePosition(), 0};
+        mBoundaries->write(&end, 1);
+    }
+}
+
+/**
+ * Open the first queued clip, if there is no next clip yet, and decode its first kPreRollMillis.
+ */
+void ClipSequencer::openNext() {
+    Request request;
+    if (mNext.decoder != nullptr || mRequests->read(&request, 1) == 0) {
+        return;
+    }
+    auto decoder = PcmDecoder::open(request.data, request.size);
+    if (!decoder) {
+        LOGE("Clip %u: unknown format or bad header, skipped", request.id);
+        return;
+    }
+    LOGI("Clip %u: %s, %d ch, %d Hz, %u frames of encoder delay and %u of padding trimmed", request.id,
+         PcmDecoder::formatToText(decoder->getFormat()), decoder->getChannelCount(), decoder->getSampleRate(),
+         decoder->getEncoderDelayFrames(), decoder->getEncoderPaddingFrames());
+
+    const uint64_t preRollFrames = static_cast<uint64_t>(decoder->getSampleRate()) * kPreRollMillis / 1000;
+    mNext.preRoll.resize(preRollFrames * decoder->getChannelCount());
+    mNext.preRollFrames = decoder->read(mNext.preRoll.data(), preRollFrames);
+    mNext.decoder = std::move(decoder);
+    mNext.id = request.id;
+}
+
+/**
+ * Make the next clip the current one. Its first frame goes at the current ring write position.
+ */
+void ClipSequencer::advance() {
+    setDecoder(std::move(mNext.decoder));
+    mClipId = mNext.id;
+    mPreRoll.swap(mNext.preRoll);
+    mPreRollFrames = mNext.preRollFrames;
+    mPreRollRead = 0;
+    mClipStart = mRing->writePosition();
+    mBoundaryPending = true;
+}
+
+/**
+ * Drop every clip up to the id clear() was called after, and what the ring holds of them.
+ */
+void ClipSequencer::dropCleared(uint32_t clearThrough) {
+    mClearedThrough = clearThrough;
+    if (mDecoder != nullptr && isClearedBy(mClipId, clearThrough)) {
+        mDecoder.reset();
+    }
+    if (mNext.decoder != nullptr && isClearedBy(mNext.id, clearThrough)) {
+        mNext.decoder.reset();
+    }
+    Request request;
+    while (mRequests->peek(&request, 1) == 1 && isClearedBy(request.id, clearThrough)) {
+        mRequests->read(&request, 1);
+    }
+
+    if (mDecoder == nullptr) {
+        resetResampler();
+        mBoundaryPending = false;
+        const Boundary end {mRing->writePosition(), 0};
+        skipTo(end.position);
+        mBoundaries->write(&end, 1);
+    } else {
+        // A clip queued after the clear() already plays, only what came before it goes.
+        skipTo(mClipStart);
+    }
+    LOGI("Clip queue cleared up to clip %u", clearThrough);
+}
+
+/**
+ * Read the current clip, its pre-roll first.
+ * @return the number of frames read, 0 at the end of the clip
+ */
+uint64_t ClipSequencer::readDecoder(float* output, uint64_t frames) {
+    if (mPreRollRead < mPreRollFrames) {
+        frames = std::min(frames, mPreRollFrames - mPreRollRead);
+        std::memcpy(output, mPreRoll.data() + mPreRollRead * mChannelCount, frames * mChannelCount * sizeof(float));
+        mPreRollRead += frames;
+        return frames;
+    }
+    return mDecoder->read(output, frames);
+}
+
+bool ClipSequencer::decodeChunk() {
+    if (!DecodeAheadSource::decodeChunk()) {
+        return false;
+    }
+    // The start is only published once frames follow it, so the callback does not count the wait
+    // for them as an underrun.
+    if (mBoundaryPending) {
+        const Boundary start {mClipStart, mClipId};
+        mBoundaries->write(&start, 1);
+        mBoundaryPending = false;
+    }
+    return true;
+}
+
+/**
+ * The boundaries point into the dropped ring. The clip being decoded starts again at position 0, it
+ * is only reported as started if the callback had not reached it yet.
+ */
+void ClipSequencer::onRingReset() {
+    Boundary boundary;
+    while (mBoundaries->read(&boundary, 1) == 1) {
+    }
+    if (mDecoder != nullptr) {
+        mClipStart = 0;
+        mBoundaryPending = mPlayingClip.load(std::memory_order_relaxed) != mClipId;
+    } else {
+        const Boundary end {0, 0};
+        mBoundaries->write(&end, 1);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "DecodeAheadSource.h"
+#include "PcmDecoder.h"
+#include "SpscRingBuffer.h"
+
+/**
+ * Plays a queue of MP3, WAV or FLAC clips held in memory back to back, without a gap between them.
+ *
+ * Like StreamingSoundGenerator, the clips are decoded ahead into the ring of a DecodeAheadSource.
+ * As soon as a clip starts, the thread opens the next queued one and decodes its first
+ * kPreRollMillis, so when the current clip runs out its last frame is followed in the ring by the
+ * next clip's first: the hand-off is sample accurate, and the audio callback never opens a decoder
+ * or takes a lock. MP3 encoder delay and padding are left out by the decoder, @see
+ * PcmDecoder::getEncoderDelayFrames, so no encoder silence is heard at the joins.
+ *
+ * Clips with the same format share the resampler, which carries its history across the join.
+ */
+class ClipSequencer : public DecodeAheadSource {
+  public:
+    static constexpr int32_t kPreRollMillis = 50;
+    static constexpr size_t  kMaxQueuedClips = 16;
+
+    ClipSequencer(int32_t deviceSampleRate, int32_t deviceChannelCount);
+
+    ~ClipSequencer() override;
+
+    /**
+     * Queue a clip to play after the ones already queued, or at once if nothing plays. The data is
+     * not copied and has to outlive the sequencer. Call from one thread at a time.
+     * @return an id for getPlayingClip(), or 0 if kMaxQueuedClips are already waiting
+     */
+    uint32_t enqueue(const void* data, size_t size);
+
+    /**
+     * Drop the clips queued so far and cut the one playing. The decoder thread does it, so a callback
+     * or two may still render it. Clips queued after this play as usual. Call from the thread which
+     * enqueues.
+     */
+    void clear() { mClearThrough.store(mLastId, std::memory_order_release); }
+
+    /**
+     * Id of the clip the last callback rendered, 0 if the queue had run dry. It changes in the
+     * callback which renders the first frame of a clip.
+     */
+    uint32_t getPlayingClip() const { return mPlayingClip.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of clips which have started to play.
+     */
+    uint64_t getClipsStarted() const { return mClipsStarted.load(std::memory_order_relaxed); }
+
+    /**
+     * Counts the callbacks short of frames while a clip played, @see getUnderrunCount. The silence
+     * after the last queued clip is not counted.
+     */
+    void renderAudio(float* audioData, int32_t numFrames) override;
+
+  protected:
+    void     pollRequests() override;
+    bool     readyToDecode() const override;
+    void     onDecoderEnd() override;
+    uint64_t readDecoder(float* output, uint64_t frames) override;
+    bool     decodeChunk() override;
+    void     onRingReset() override;
+
+  private:
+    struct Request {
+        const void* data;
+        size_t      size;
+        uint32_t    id;
+    };
+
+    // The ring position of a clip's first frame, or with id 0 of the end of the last queued clip.
+    struct Boundary {
+        uint64_t position;
+        uint32_t id;
+    };
+
+    // The next clip, opened with its first frames decoded ahead of the hand-off.
+    struct Next {
+        std::unique_ptr<PcmDecoder> decoder;
+        std::vector<float>          preRoll;
+        uint64_t                    preRollFrames = 0;
+        uint32_t                    id = 0;
+    };
+
+    void openNext();
+    void advance();
+    void dropCleared(uint32_t clearThrough);
+
+    std::unique_ptr<SpscRingBuffer<Request>>  mRequests;    // enqueue() to the decoder thread
+    std::unique_ptr<SpscRingBuffer<Boundary>> mBoundaries;  // decoder thread to the callback
+    std::atomic<uint32_t>                     mClearThrough { 0 };  // clips up to this id are dropped
+    uint32_t                                  mLastId = 0;  // enqueue() only
+    std::atomic<uint32_t>                     mPlayingClip { 0 };
+    std::atomic<uint64_t>                     mClipsStarted { 0 };
+
+    // Decoder thread only
+    uint32_t                    mClipId = 0;
+    uint64_t                    mClipStart = 0;  // ring position of the clip's first frame
+    bool                        mBoundaryPending = false;  // the clip's start is not in mBoundaries yet
+    uint32_t                    mClearedThrough = 0;
+    Next                        mNext;
+    std::vector<float>          mPreRoll;  // the current clip's pre-roll
+    uint64_t                    mPreRollFrames = 0;
+    uint64_t                    mPreRollRead = 0;
+};
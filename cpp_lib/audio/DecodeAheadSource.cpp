@@ -0,0 +1,175 @@
+#include "DecodeAheadSource.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+#include "ndk_utils/cpu_topology.h"
+#include "ndk_utils/log.h"
+
+DecodeAheadSource::DecodeAheadSource(int32_t deviceSampleRate, int32_t deviceChannelCount, const char* name)
+    : TappableAudioSource(deviceSampleRate, deviceChannelCount)
+    , mDeviceSampleRate(deviceSampleRate)
+    , mDeviceChannelCount(deviceChannelCount)
+    , mRing(std::make_unique<SpscRingBuffer<float>>(kRingFrames * deviceChannelCount))
+    , mName(name)
+    , mConverter(deviceChannelCount, deviceChannelCount) { }
+
+DecodeAheadSource::~DecodeAheadSource() { stop(); }
+
+void DecodeAheadSource::start() {
+    if (mDecodeThread.joinable()) {
+        return;
+    }
+    prime();
+    startThread();
+}
+
+void DecodeAheadSource::stop() {
+    mDecoderRunning = false;
+    if (mDecodeThread.joinable()) {
+        mDecodeThread.join();
+    }
+}
+
+void DecodeAheadSource::setChannelCount(int32_t count) {
+    if (count == mDeviceChannelCount) {
+        return;
+    }
+    const bool wasRunning = mDecodeThread.joinable();
+    stop();
+    mDeviceChannelCount = count;
+    mRing = std::make_unique<SpscRingBuffer<float>>(kRingFrames * count);
+    mConverter.setLayout(mChannelCount, count);
+    mSkipTo.store(0, std::memory_order_relaxed);
+    // A clip which had ended keeps no frames to play.
+    if (isClipEnded()) {
+        mEndPosition.store(0, std::memory_order_relaxed);
+    }
+    onRingReset();
+    if (!wasRunning) {
+        return;
+    }
+    // Refill the ring before the next stream's first callback, like start().
+    for (int i = 0; i < 2 && readyToDecode(); ++i) {
+        if (!decodeChunk()) {
+            onDecoderEnd();
+        }
+    }
+    startThread();
+}
+
+void DecodeAheadSource::renderAudio(float* audioData, int32_t numFrames) {
+    const size_t got = readRing(audioData, numFrames);
+    if (got < static_cast<size_t>(numFrames) && mRing->readPosition() < mEndPosition.load(std::memory_order_acquire)) {
+        countUnderrun(numFrames - got);
+    }
+}
+
+size_t DecodeAheadSource::readRing(float* audioData, int32_t numFrames) {
+    // Drop whatever was decoded before the clip which plays now.
+    mRing->skipTo(mSkipTo.load(std::memory_order_acquire));
+
+    const size_t wanted = static_cast<size_t>(numFrames) * mDeviceChannelCount;
+    const size_t got = mRing->read(audioData, wanted);
+    std::fill(audioData + got, audioData + wanted, 0.0f);
+    return got / mDeviceChannelCount;
+}
+
+void DecodeAheadSource::startThread() {
+    mDecoderRunning = true;
+    mDecodeThread = std::thread(&DecodeAheadSource::decodeLoop, this);
+}
+
+void DecodeAheadSource::decodeLoop() {
+    cpu_topology::placeCurrentThread(cpu_topology::ThreadRole::Decoder);
+    uint64_t reportedUnderruns = 0;
+    while (mDecoderRunning) {
+        pollRequests();
+
+        const uint64_t underruns = mUnderrunCount.load(std::memory_order_relaxed);
+        if (underruns != reportedUnderruns) {
+            LOGW("%s underruns: %llu callbacks, %llu frames", mName, (unsigned long long)underruns,
+                 (unsigned long long)mUnderrunFrames.load(std::memory_order_relaxed));
+            reportedUnderruns = underruns;
+        }
+
+        // Leave room for what a resampled chunk can grow to.
+        const size_t chunkSamples =
+                (kDecodeChunkFrames * mDeviceSampleRate / std::max(mSampleRate, 1) + 4) * mDeviceChannelCount;
+        if (!readyToDecode() || mRing->availableToWrite() < chunkSamples) {
+            usleep(kDecoderIdleMicros);
+            continue;
+        }
+
+        if (!decodeChunk()) {
+            onDecoderEnd();
+        }
+    }
+}
+
+bool DecodeAheadSource::decodeChunk() {
+    mDecodeBuffer.resize(kDecodeChunkFrames * mChannelCount);
+    const uint64_t readFrames = readDecoder(mDecodeBuffer.data(), kDecodeChunkFrames);
+    if (readFrames == 0) {
+        return false;
+    }
+
+    const float*  source = mDecodeBuffer.data();
+    size_t        frames = readFrames;
+    const int32_t deviceSampleRate = mDeviceSampleRate;
+    if (deviceSampleRate != mSampleRate) {
+        if (!isResamplerCurrent(deviceSampleRate)) {
+            mResampler = std::make_unique<Resampler>(mSampleRate, deviceSampleRate, mChannelCount);
+        }
+        const size_t capacity = readFrames * deviceSampleRate / mSampleRate + 4;
+        mResampled.resize(capacity * mChannelCount);
+        frames = mResampler->process(mDecodeBuffer.data(), static_cast<int32_t>(readFrames), mResampled.data(),
+                                     static_cast<int32_t>(capacity));
+        source = mResampled.data();
+    }
+    writeToRing(source, frames);
+    return true;
+}
+
+void DecodeAheadSource::setDecoder(std::unique_ptr<PcmDecoder> decoder) {
+    mDecoder = std::move(decoder);
+    mSampleRate = mDecoder->getSampleRate();
+    mChannelCount = mDecoder->getChannelCount();
+    mConverter.setLayout(mChannelCount, mDeviceChannelCount);
+}
+
+void DecodeAheadSource::drainResampler() {
+    const int32_t deviceSampleRate = mDeviceSampleRate;
+    if (deviceSampleRate == mSampleRate || !isResamplerCurrent(deviceSampleRate)) {
+        return;
+    }
+    const int32_t tail = mResampler->getTailFrames();
+    mResampled.resize(static_cast<size_t>(tail) * mChannelCount);
+    writeToRing(mResampled.data(), mResampler->drain(mResampled.data(), tail));
+    mResampler->reset();
+}
+
+void DecodeAheadSource::resetResampler() {
+    if (mResampler) {
+        mResampler->reset();
+    }
+}
+
+void DecodeAheadSource::beginClip() {
+    mEndPosition.store(kNoEnd, std::memory_order_release);
+    skipTo(mRing->writePosition());
+}
+
+bool DecodeAheadSource::isResamplerCurrent(int32_t deviceSampleRate) const {
+    return mResampler && mResampler->getInputRate() == mSampleRate && mResampler->getOutputRate() == deviceSampleRate
+           && mResampler->getChannelCount() == mChannelCount;
+}
+
+/**
+ * Convert frames of the clip's channel count to the device's and push them into the ring.
+ */
+void DecodeAheadSource::writeToRing(const float* source, size_t frames) {
+    mConvertBuffer.resize(frames * mDeviceChannelCount);
+    mConverter(source, mConvertBuffer.data(), frames);
+    mRing->write(mConvertBuffer.data(), mConvertBuffer.size());
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ChannelConvert.h"
+#include "PcmDecoder.h"
+#include "Resampler.h"
+#include "SpscRingBuffer.h"
+#include "TappableAudioSource.h"
+
+/**
+ * Base of the sources which decode ahead of the audio callback, @see StreamingSoundGenerator and
+ * ClipSequencer.
+ *
+ * A background thread reads a PcmDecoder in chunks of kDecodeChunkFrames, converts them to the device
+ * rate and channel count and pushes them into a lock-free ring, so renderAudio only copies frames out
+ * of it. Which decoder plays, and when it changes, is up to the subclass through the hooks the thread
+ * calls. A clip is published with beginClip() and ends at the ring position endClip() marks; the
+ * callback counts the frames it misses before that end as underruns.
+ *
+ * The thread calls the subclass, so a subclass has to stop() it in its own destructor.
+ */
+class DecodeAheadSource : public TappableAudioSource {
+  public:
+    // Decode-ahead depth, about 170ms at 48kHz.
+    static constexpr size_t   kRingFrames = 8192;
+    static constexpr uint64_t kDecodeChunkFrames = 1024;
+    static constexpr int      kDecoderIdleMicros = 2000;
+
+    /**
+     * @param name - what the source is called in the underrun log
+     */
+    DecodeAheadSource(int32_t deviceSampleRate, int32_t deviceChannelCount, const char* name);
+
+    ~DecodeAheadSource() override;
+
+    void tap(bool isOn) override { (void)isOn; }
+
+    /**
+     * Start the decoder thread. Call this before the source is handed to a stream.
+     */
+    void start();
+
+    void stop();
+
+    /**
+     * Device sample rate to convert to. Frames already in the ring keep the old rate.
+     */
+    void setSampleRate(int32_t rate) { mDeviceSampleRate.store(rate); }
+
+    /**
+     * Device channel count to convert to. The ring is sized for it, so the frames it holds are dropped
+     * and the clip plays on from what the decoder reads next. Call only while no stream renders the
+     * source, the decoder thread is stopped and restarted around the change.
+     */
+    void setChannelCount(int32_t count);
+
+    int32_t getChannelCount() const { return mDeviceChannelCount; }
+
+    /**
+     * Number of callbacks in which the decoder had not produced enough frames. Frames missing after
+     * the end of a clip are not counted.
+     */
+    uint64_t getUnderrunCount() const { return mUnderrunCount.load(std::memory_order_relaxed); }
+
+    uint64_t getUnderrunFrames() const { return mUnderrunFrames.load(std::memory_order_relaxed); }
+
+    /**
+     * True once every frame of the clip has been rendered.
+     */
+    bool isFinished() const { return mRing->readPosition() >= mEndPosition.load(std::memory_order_acquire); }
+
+    void renderAudio(float* audioData, int32_t numFrames) override;
+
+  protected:
+    // Decoder thread hooks.
+
+    /**
+     * Decode the first chunks before the thread starts, called by start().
+     */
+    virtual void prime() { }
+
+    /**
+     * Pick up what the other threads asked for, called before each chunk.
+     */
+    virtual void pollRequests() { }
+
+    /**
+     * Whether there is a chunk to decode, given room for it in the ring.
+     */
+    virtual bool readyToDecode() const { return mDecoder != nullptr && !isClipEnded(); }
+
+    /**
+     * The decoder has no more frames. By default the resampler's tail goes into the ring and the clip
+     * ends after it.
+     */
+    virtual void onDecoderEnd() {
+        drainResampler();
+        endClip();
+    }
+
+    virtual uint64_t readDecoder(float* output, uint64_t frames) { return mDecoder->read(output, frames); }
+
+    /**
+     * Decode one chunk, convert it to the device rate and channel count and push it into the ring.
+     * @return false once the decoder has no more frames
+     */
+    virtual bool decodeChunk();
+
+    /**
+     * The ring was replaced by an empty one whose positions start at 0, called by setChannelCount()
+     * with the decoder thread stopped.
+     */
+    virtual void onRingReset() { }
+
+    // Decoder thread only, or before start().
+
+    /**
+     * Read from another decoder. The resampler is kept, @see resetResampler.
+     */
+    void setDecoder(std::unique_ptr<PcmDecoder> decoder);
+
+    /**
+     * Push the output the resampler still holds into the ring, as if silence followed the clip, and
+     * start it afresh for whatever comes next.
+     */
+    void drainResampler();
+
+    void resetResampler();
+
+    /**
+     * Drop what the ring holds before the current write position, the next frames written start a
+     * clip whose end is not known yet.
+     */
+    void beginClip();
+
+    /**
+     * The clip ends at the current write position.
+     */
+    void endClip() { mEndPosition.store(mRing->writePosition(), std::memory_order_release); }
+
+    bool isClipEnded() const { return mEndPosition.load(std::memory_order_relaxed) != kNoEnd; }
+
+    /**
+     * Have the callback drop what the ring holds before a position.
+     */
+    void skipTo(uint64_t position) { mSkipTo.store(position, std::memory_order_release); }
+
+    // Audio callback only.
+
+    /**
+     * Copy frames out of the ring and fill what it does not hold with silence.
+     * @return the number of frames copied
+     */
+    size_t readRing(float* audioData, int32_t numFrames);
+
+    void countUnderrun(size_t frames) {
+        mUnderrunCount.fetch_add(1, std::memory_order_relaxed);
+        mUnderrunFrames.fetch_add(frames, std::memory_order_relaxed);
+    }
+
+    std::atomic<int32_t>                   mDeviceSampleRate;
+    int32_t                                mDeviceChannelCount;  // only changes while both threads are stopped
+    std::unique_ptr<SpscRingBuffer<float>> mRing;
+    std::unique_ptr<PcmDecoder>            mDecoder;  // decoder thread only once started
+
+  private:
+    static constexpr uint64_t kNoEnd = UINT64_MAX;
+
+    void startThread();
+    void decodeLoop();
+    bool isResamplerCurrent(int32_t deviceSampleRate) const;
+    void writeToRing(const float* source, size_t frames);
+
+    const char*           mName;
+    std::atomic<bool>     mDecoderRunning { false };
+    std::thread           mDecodeThread;
+    std::atomic<uint64_t> mSkipTo { 0 };       // ring position where the current clip starts
+    std::atomic<uint64_t> mEndPosition { 0 };  // ring position where the current clip ends
+    std::atomic<uint64_t> mUnderrunCount { 0 };
+    std::atomic<uint64_t> mUnderrunFrames { 0 };
+
+    // Decoder thread only
+    std::vector<float>         mDecodeBuffer;
+    std::vector<float>         mResampled;
+    std::vector<float>         mConvertBuffer;
+    std::unique_ptr<Resampler> mResampler;
+    channels::Converter        mConverter;  // from the clip's channels to the device's
+};
@@ -1,11 +1,17 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <unistd.h>
 #include <oboe/AudioStreamCallback.h>
+#include "ndk_utils/cpu_topology.h"
 #include "ndk_utils/log.h"
+#include "ndk_utils/rt_check.h"
 
 #include "IRenderableAudio.h"
 #include "IRestartable.h"
+#include "TpdfDither.h"
 
 /**
  * This is a callback object which will render data from an `IRenderableAudio` source.
@@ -18,23 +24,43 @@ public:
     virtual oboe::DataCallbackResult
     onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) override {
         (void)oboeStream;
+        rt_check::ScopedRealtime realtime;
 
         if (mIsThreadAffinityEnabled && !mIsThreadAffinitySet) {
             setThreadAffinity();
             mIsThreadAffinitySet = true;
         }
 
-        float *outputBuffer = static_cast<float *>(audioData);
-
         std::shared_ptr<IRenderableAudio> localRenderable = mRenderable;
         if (!localRenderable) {
             LOGE("Renderable source not set!");
             return oboe::DataCallbackResult::Stop;
         }
-        localRenderable->renderAudio(outputBuffer, numFrames);
+        if (mOutputFormat == oboe::AudioFormat::I16) {
+            renderI16(*localRenderable, static_cast<int16_t *>(audioData), numFrames);
+        } else {
+            localRenderable->renderAudio(static_cast<float *>(audioData), numFrames);
+        }
         return oboe::DataCallbackResult::Continue;
     }
 
+    /**
+     * Set the sample format of the stream. Sources always render float; for I16 the callback renders
+     * into its own buffer and converts with TPDF dither, @see TpdfDither. Call it before the stream
+     * starts, the buffer is allocated here so the callback never does.
+     *
+     * @param maxFrames - frames rendered at a time, a larger callback is rendered in several passes
+     */
+    void setOutputFormat(oboe::AudioFormat format, int32_t channelCount, int32_t maxFrames) {
+        mOutputFormat = format;
+        mChannelCount = channelCount;
+        if (format == oboe::AudioFormat::I16) {
+            mFloatBuffer.resize(static_cast<size_t>(std::max(maxFrames, 1)) * channelCount);
+        }
+    }
+
+    oboe::AudioFormat getOutputFormat() const { return mOutputFormat; }
+
     void setSource(std::shared_ptr<IRenderableAudio> renderable) {
         mRenderable = renderable;
     }
@@ -61,18 +87,43 @@ public:
 
     /**
      * Enable or disable binding the audio callback thread to specific CPU cores. The CPU core IDs
-     * can be specified using @see setCpuIds. If no CPU IDs are specified the initial core which the
-     * audio thread is called on will be used.
+     * can be specified using @see setCpuIds. If no CPU IDs are specified the audio core of the
+     * device's thread placement is used (@see cpu_topology::Placement), or the initial core which
+     * the audio thread is called on if the topology is unknown.
+     *
+     * Call it before the stream starts: the topology is probed here rather than on the audio thread.
      *
      * @param isEnabled - whether the audio callback thread should be bound to specific CPU core(s)
      */
     void setThreadAffinityEnabled(bool isEnabled){
+        if (isEnabled && mCpuIds.empty()) {
+            mCpuIds = cpu_topology::getPlacement().audio;
+        }
         mIsThreadAffinityEnabled = isEnabled;
         LOGD("Thread affinity enabled: %s", (isEnabled) ? "true" : "false");
     }
 
 private:
     std::shared_ptr<IRenderableAudio> mRenderable;
+    oboe::AudioFormat mOutputFormat = oboe::AudioFormat::Float;
+    int32_t mChannelCount = 0;
+    std::vector<float> mFloatBuffer; // float render target of an I16 stream
+    TpdfDither mDither;
+
+    void renderI16(IRenderableAudio &renderable, int16_t *outputBuffer, int32_t numFrames) {
+        const int32_t maxFrames = mChannelCount > 0 ? static_cast<int32_t>(mFloatBuffer.size()) / mChannelCount : 0;
+        if (maxFrames == 0) {
+            std::fill_n(outputBuffer, static_cast<size_t>(numFrames) * mChannelCount, 0);
+            return;
+        }
+        for (int32_t done = 0; done < numFrames;) {
+            const int32_t frames = std::min(maxFrames, numFrames - done);
+            renderable.renderAudio(mFloatBuffer.data(), frames);
+            mDither.process(mFloatBuffer.data(), outputBuffer + static_cast<size_t>(done) * mChannelCount,
+                            static_cast<size_t>(frames) * mChannelCount);
+            done += frames;
+        }
+    }
     std::vector<int> mCpuIds; // IDs of CPU cores which the audio callback should be bound to
     std::atomic<bool> mIsThreadAffinityEnabled { false };
     std::atomic<bool> mIsThreadAffinitySet { false };
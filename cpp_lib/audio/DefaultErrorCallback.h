@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <oboe/AudioStreamCallback.h>
 #include "ndk_utils/log.h"
@@ -18,6 +20,15 @@ public:
     DefaultErrorCallback(IRestartable &parent): mParent(parent) {}
     virtual ~DefaultErrorCallback() = default;
 
+    virtual void onErrorBeforeClose(oboe::AudioStream *oboeStream, oboe::Result error) override {
+        (void)oboeStream;
+        // Closing the dead stream is part of the gap, so the restart is timed from here.
+        if (error == oboe::Result::ErrorDisconnected) {
+            mLastDisconnectNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
     virtual void onErrorAfterClose(oboe::AudioStream *oboeStream, oboe::Result error) override {
         (void)oboeStream;
         // Restart the stream if the error is a disconnect, otherwise do nothing and log the error
@@ -29,8 +40,14 @@ public:
 //        LOGE("Error was %s", oboe::convertToText(error));
     }
 
+    /**
+     * steady_clock time of the last disconnect in nanoseconds, 0 if there was none.
+     */
+    int64_t getLastDisconnectNanos() const { return mLastDisconnectNanos; }
+
 private:
     IRestartable &mParent;
+    std::atomic<int64_t> mLastDisconnectNanos { 0 };
 
 };
 
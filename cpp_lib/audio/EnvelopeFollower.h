@@ -0,0 +1,103 @@
+#pragma once
+#include <time.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#include "Simd.h"
+
+/**
+ * Level of the rendered output, for visuals that follow the audio such as the mouth.
+ *
+ * process() runs on the audio thread after each burst: one SIMD pass for the RMS and peak, then a
+ * smoother with a fast attack and a slower release. The result is published through a sequence lock
+ * with a single writer, so publishing is wait-free and read() never holds up the audio thread: it
+ * retries if it raced with a write, and gives up after a few attempts.
+ *
+ * Each envelope carries the CLOCK_MONOTONIC time its burst was rendered. It is heard the output
+ * latency later, @see OboeEngine::getCurrentOutputLatencyMillis.
+ */
+class EnvelopeFollower {
+  public:
+    static constexpr float   kAttackSeconds = 0.01f;
+    static constexpr float   kReleaseSeconds = 0.08f;
+    static constexpr int32_t kReadAttempts = 4;
+
+    struct Envelope {
+        float    rms = 0.0f;
+        float    peak = 0.0f;
+        float    level = 0.0f;       // smoothed RMS
+        int64_t  framePosition = 0;  // first frame of the burst, @see VoiceMixer::getFramePosition
+        int64_t  renderNanos = 0;
+        uint64_t sequence = 0;  // counts the bursts published, tells a new envelope from the last one
+    };
+
+    /**
+     * Measure a burst of interleaved samples and publish the envelope. Audio thread only.
+     */
+    void process(const float* audioData, int32_t numFrames, int32_t channelCount, int32_t sampleRate,
+                 int64_t framePosition) {
+        const size_t count = static_cast<size_t>(numFrames) * channelCount;
+        if (count == 0 || sampleRate <= 0) {
+            return;
+        }
+        float sumSquares = 0.0f;
+        float peak = 0.0f;
+        simd::sumSquaresAndPeak(audioData, count, sumSquares, peak);
+        const float rms = std::sqrt(sumSquares / static_cast<float>(count));
+        const float seconds = static_cast<float>(numFrames) / static_cast<float>(sampleRate);
+        mLevel = rms + (mLevel - rms) * std::exp(-seconds / (rms > mLevel ? kAttackSeconds : kReleaseSeconds));
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        const uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mRms.store(rms, std::memory_order_relaxed);
+        mPeak.store(peak, std::memory_order_relaxed);
+        mSmoothed.store(mLevel, std::memory_order_relaxed);
+        mFramePosition.store(framePosition, std::memory_order_relaxed);
+        mRenderNanos.store(now.tv_sec * 1000000000LL + now.tv_nsec, std::memory_order_relaxed);
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * Copy the latest envelope. Any thread, never blocks the audio thread.
+     * @return false if nothing was published yet, or every attempt raced with a write
+     */
+    bool read(Envelope& envelope) const {
+        for (int32_t attempt = 0; attempt < kReadAttempts; ++attempt) {
+            const uint64_t before = mSequence.load(std::memory_order_acquire);
+            if (before == 0) {
+                return false;
+            }
+            if ((before & 1) != 0) {
+                continue;
+            }
+            envelope.rms = mRms.load(std::memory_order_relaxed);
+            envelope.peak = mPeak.load(std::memory_order_relaxed);
+            envelope.level = mSmoothed.load(std::memory_order_relaxed);
+            envelope.framePosition = mFramePosition.load(std::memory_order_relaxed);
+            envelope.renderNanos = mRenderNanos.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == before) {
+                envelope.sequence = before / 2;
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    float mLevel = 0.0f;  // audio thread only
+
+    // Odd while a write is in progress.
+    std::atomic<uint64_t> mSequence { 0 };
+    std::atomic<float>    mRms { 0.0f };
+    std::atomic<float>    mPeak { 0.0f };
+    std::atomic<float>    mSmoothed { 0.0f };
+    std::atomic<int64_t>  mFramePosition { 0 };
+    std::atomic<int64_t>  mRenderNanos { 0 };
+};
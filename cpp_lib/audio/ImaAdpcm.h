@@ -0,0 +1,237 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Simd.h"
+
+/**
+ * IMA-ADPCM for clips kept in memory: 4 bits a sample, a quarter of int16 and an eighth of float.
+ *
+ * Each channel is coded in blocks of kBlockFrames samples, and every block starts from a header with
+ * the decoder state, so blocks decode independently. Four blocks, one per SIMD lane, make a group:
+ * the channels of 4 / channelCount consecutive blocks of frames, which is why only 1, 2 and 4 channels
+ * are supported. The codes of a group are stored lane-interleaved, a 32 bit word of eight codes per
+ * lane at a time, so the decoder loads eight samples of all four lanes with one load and runs the
+ * IMA state update on the four lanes at once. Only the step size table lookup stays scalar.
+ *
+ * A group is 16 bytes of header and kBlockFrames * 2 bytes of codes, it decodes to kGroupSamples
+ * interleaved float samples. The data is an in-memory format: it is not a WAV IMA-ADPCM stream.
+ */
+namespace ima_adpcm {
+
+    constexpr int32_t kLanes = 4;
+    constexpr int32_t kBlockFrames = 128;  // a multiple of 8
+    constexpr int32_t kGroupSamples = kBlockFrames * kLanes;
+    constexpr size_t  kGroupHeaderBytes = 16;  // int16 predictors[4], uint8 step indices[4], padding
+    constexpr size_t  kGroupBytes = kGroupHeaderBytes + kGroupSamples / 2;
+
+    inline bool isSupported(int32_t channelCount) { return channelCount > 0 && kLanes % channelCount == 0; }
+
+    // Frames in a group.
+    inline int32_t groupFrames(int32_t channelCount) { return kGroupSamples / channelCount; }
+
+    inline size_t groupCount(int32_t frames, int32_t channelCount) {
+        return static_cast<size_t>((frames + groupFrames(channelCount) - 1) / groupFrames(channelCount));
+    }
+
+    namespace detail {
+        constexpr int32_t kMaxStepIndex = 88;
+
+        constexpr int16_t kSteps[kMaxStepIndex + 1] = {
+                7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+                25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+                88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+                307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+                1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+                3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+                12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+        constexpr int32_t kIndexAdjust[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+        // The standard IMA state update for one code.
+        inline void decodeSample(int32_t code, int32_t& predictor, int32_t& stepIndex) {
+            const int32_t step = kSteps[stepIndex];
+            int32_t       diff = step >> 3;
+            if (code & 4) diff += step;
+            if (code & 2) diff += step >> 1;
+            if (code & 1) diff += step >> 2;
+            predictor = std::clamp(code & 8 ? predictor - diff : predictor + diff, -32768, 32767);
+            stepIndex = std::clamp(stepIndex + kIndexAdjust[code & 7], 0, kMaxStepIndex);
+        }
+
+        inline int32_t encodeSample(int32_t sample, int32_t& predictor, int32_t& stepIndex) {
+            int32_t diff = sample - predictor;
+            int32_t code = 0;
+            if (diff < 0) {
+                code = 8;
+                diff = -diff;
+            }
+            int32_t step = kSteps[stepIndex];
+            if (diff >= step) {
+                code |= 4;
+                diff -= step;
+            }
+            step >>= 1;
+            if (diff >= step) {
+                code |= 2;
+                diff -= step;
+            }
+            step >>= 1;
+            if (diff >= step) {
+                code |= 1;
+            }
+            decodeSample(code, predictor, stepIndex);
+            return code;
+        }
+
+        struct Header {
+            int16_t predictors[kLanes];
+            uint8_t stepIndices[kLanes];
+            uint8_t padding[kLanes];
+        };
+        static_assert(sizeof(Header) == kGroupHeaderBytes);
+
+        // The block and the channel a lane codes, as the frame and sample offset of its first sample.
+        inline size_t laneOffset(int32_t lane, int32_t channelCount) {
+            return static_cast<size_t>(lane / channelCount) * kBlockFrames * channelCount + lane % channelCount;
+        }
+    }  // namespace detail
+
+    /**
+     * Encode interleaved float samples. The last group is padded with silence.
+     */
+    inline std::vector<uint8_t> encode(const float* samples, int32_t frames, int32_t channelCount) {
+        const size_t         groups = groupCount(frames, channelCount);
+        const size_t         total = static_cast<size_t>(frames) * channelCount;
+        std::vector<uint8_t> data(groups * kGroupBytes);
+        // Each channel is coded as one run, every block header takes the state the run is in.
+        int32_t predictors[kLanes] = {};
+        int32_t stepIndices[kLanes] = {};
+        for (size_t group = 0; group < groups; ++group) {
+            uint8_t*       out = data.data() + group * kGroupBytes;
+            detail::Header header = {};
+            uint32_t       words[kBlockFrames / 8][kLanes] = {};
+            for (int32_t lane = 0; lane < kLanes; ++lane) {
+                const int32_t channel = lane % channelCount;
+                const size_t  first = group * kGroupSamples + detail::laneOffset(lane, channelCount);
+                header.predictors[lane] = static_cast<int16_t>(predictors[channel]);
+                header.stepIndices[lane] = static_cast<uint8_t>(stepIndices[channel]);
+                for (int32_t i = 0; i < kBlockFrames; ++i) {
+                    const size_t  index = first + static_cast<size_t>(i) * channelCount;
+                    const float   value = index < total ? samples[index] : 0.0f;
+                    const int32_t sample = static_cast<int32_t>(std::clamp(std::lrint(value * 32768.0f), -32768L,
+                                                                           32767L));
+                    const auto    code = static_cast<uint32_t>(
+                            detail::encodeSample(sample, predictors[channel], stepIndices[channel]));
+                    words[i / 8][lane] |= code << (4 * (i % 8));
+                }
+            }
+            std::memcpy(out, &header, sizeof(header));
+            std::memcpy(out + kGroupHeaderBytes, words, sizeof(words));
+        }
+        return data;
+    }
+
+    /**
+     * Decode a group into kGroupSamples interleaved samples, four lanes at a time.
+     */
+    inline void decodeGroup(const uint8_t* group, int32_t channelCount, float* out) {
+        detail::Header header;
+        std::memcpy(&header, group, sizeof(header));
+        const simd::int4   zero = simd::set1i(0);
+        const simd::int4   one = simd::set1i(1);
+        const simd::int4   five = simd::set1i(5);
+        const simd::int4   seven = simd::set1i(7);
+        const simd::int4   fifteen = simd::set1i(15);
+        const simd::int4   minSample = simd::set1i(-32768);
+        const simd::int4   maxSample = simd::set1i(32767);
+        const simd::int4   maxIndex = simd::set1i(detail::kMaxStepIndex);
+        const simd::float4 scale = simd::set1(1.0f / 32768.0f);
+        simd::int4         predictor = simd::set4i(header.predictors[0], header.predictors[1], header.predictors[2],
+                                                   header.predictors[3]);
+        simd::int4         stepIndex = simd::set4i(header.stepIndices[0], header.stepIndices[1],
+                                                   header.stepIndices[2], header.stepIndices[3]);
+        int32_t            indices[kLanes];
+        const uint8_t*     codes = group + kGroupHeaderBytes;
+
+        for (int32_t frame = 0; frame < kBlockFrames; frame += 8, codes += sizeof(int32_t) * kLanes) {
+            int32_t words[kLanes];
+            std::memcpy(words, codes, sizeof(words));
+            simd::int4   word = simd::load(words);
+            simd::float4 rows[8];  // a sample of each lane
+            for (simd::float4& row : rows) {
+                const simd::int4 code = simd::bitAnd(word, fifteen);
+                word = simd::shiftRight<4>(word);
+                simd::store(indices, stepIndex);
+                const simd::int4 step = simd::set4i(detail::kSteps[indices[0]], detail::kSteps[indices[1]],
+                                                    detail::kSteps[indices[2]], detail::kSteps[indices[3]]);
+                // Add step, step / 2 and step / 4 where code bits 2, 1 and 0 are set, masking each term
+                // with 0 - bit, a lane of all ones where the bit is set.
+                const simd::int4 bit2 = simd::sub(zero, simd::bitAnd(simd::shiftRight<2>(code), one));
+                const simd::int4 bit1 = simd::sub(zero, simd::bitAnd(simd::shiftRight<1>(code), one));
+                const simd::int4 bit0 = simd::sub(zero, simd::bitAnd(code, one));
+                simd::int4       diff = simd::shiftRight<3>(step);
+                diff = simd::add(diff, simd::bitAnd(step, bit2));
+                diff = simd::add(diff, simd::bitAnd(simd::shiftRight<1>(step), bit1));
+                diff = simd::add(diff, simd::bitAnd(simd::shiftRight<2>(step), bit0));
+                // Negate where bit 3 is set: (diff ^ -1) - -1.
+                const simd::int4 sign = simd::sub(zero, simd::shiftRight<3>(code));
+                predictor = simd::add(predictor, simd::sub(simd::bitXor(diff, sign), sign));
+                predictor = simd::min(simd::max(predictor, minSample), maxSample);
+                // The index moves by -1 for magnitudes 0 to 3 and by 2 * magnitude - 6 above.
+                const simd::int4 magnitude = simd::bitAnd(code, seven);
+                const simd::int4 large = simd::sub(zero, simd::shiftRight<2>(magnitude));
+                const simd::int4 adjust = simd::sub(simd::bitAnd(simd::sub(simd::add(magnitude, magnitude), five),
+                                                                 large), one);
+                stepIndex = simd::min(simd::max(simd::add(stepIndex, adjust), zero), maxIndex);
+                row = simd::mul(simd::toFloat(predictor), scale);
+            }
+
+            if (channelCount == kLanes) {
+                // The rows are frames already.
+                for (int32_t i = 0; i < 8; ++i) {
+                    simd::store(out + static_cast<size_t>(frame + i) * kLanes, rows[i]);
+                }
+                continue;
+            }
+            // Turn the rows into eight samples of each lane.
+            simd::transpose(rows[0], rows[1], rows[2], rows[3]);
+            simd::transpose(rows[4], rows[5], rows[6], rows[7]);
+            for (int32_t lane = 0; lane < kLanes; lane += channelCount) {
+                float* const first = out + detail::laneOffset(lane, channelCount) + static_cast<size_t>(frame)
+                                                                                           * channelCount;
+                if (channelCount == 1) {
+                    simd::store(first, rows[lane]);
+                    simd::store(first + 4, rows[lane + 4]);
+                } else {
+                    simd::storeInterleaved(first, rows[lane], rows[lane + 1]);
+                    simd::storeInterleaved(first + 8, rows[lane + 4], rows[lane + 5]);
+                }
+            }
+        }
+    }
+
+    /**
+     * The same as decodeGroup, one sample at a time, as a reference.
+     */
+    inline void decodeGroupScalar(const uint8_t* group, int32_t channelCount, float* out) {
+        detail::Header header;
+        std::memcpy(&header, group, sizeof(header));
+        const uint8_t* codes = group + kGroupHeaderBytes;
+        for (int32_t lane = 0; lane < kLanes; ++lane) {
+            int32_t predictor = header.predictors[lane];
+            int32_t stepIndex = header.stepIndices[lane];
+            float*  first = out + detail::laneOffset(lane, channelCount);
+            for (int32_t i = 0; i < kBlockFrames; ++i) {
+                uint32_t word;
+                std::memcpy(&word, codes + ((i / 8) * kLanes + lane) * sizeof(uint32_t), sizeof(word));
+                detail::decodeSample(static_cast<int32_t>(word >> (4 * (i % 8))) & 15, predictor, stepIndex);
+                first[static_cast<size_t>(i) * channelCount] = predictor / 32768.0f;
+            }
+        }
+    }
+
+}  // namespace ima_adpcm
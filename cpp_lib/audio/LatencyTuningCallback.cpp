@@ -1,9 +1,21 @@
 #include "LatencyTuningCallback.h"
 
+#include <algorithm>
+#include <chrono>
+
 oboe::DataCallbackResult LatencyTuningCallback::onAudioReady(
      oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) {
+    rt_check::ScopedRealtime realtime;
+    const auto start = std::chrono::steady_clock::now();
+    if (mFirstCallbackNanos.load(std::memory_order_relaxed) == 0) {
+        mFirstCallbackNanos.store(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(),
+                std::memory_order_release);
+    }
+    // Normally set up by useStream(), creating the tuner here allocates on the audio thread.
     if (oboeStream != mStream) {
         mStream = oboeStream;
+        mStats.beginStream();
         mLatencyTuner = std::make_unique<oboe::LatencyTuner>(*oboeStream);
     }
     if (mBufferTuneEnabled
@@ -11,17 +23,24 @@ oboe::DataCallbackResult LatencyTuningCallback::onAudioReady(
             && oboeStream->getAudioApi() == oboe::AudioApi::AAudio) {
         mLatencyTuner->tune();
     }
-    auto underrunCountResult = oboeStream->getXRunCount();
-    int bufferSize = oboeStream->getBufferSizeInFrames();
-    /**
-     * The following output can be seen by running a systrace. Tracing is preferable to logging
-    * inside the callback since tracing does not block.
-    *
-    * See https://developer.android.com/studio/profile/systrace-commandline.html
-    */
-    if (Trace::isEnabled()) Trace::beginSection("numFrames %d, Underruns %d, buffer size %d",
-        numFrames, underrunCountResult.value(), bufferSize);
     auto result = DefaultDataCallback::onAudioReady(oboeStream, audioData, numFrames);
-    if (Trace::isEnabled()) Trace::endSection();
+    const auto end = std::chrono::steady_clock::now();
+
+    // With AAudio these read shared memory, nothing here formats strings or blocks.
+    auto xRunCount = oboeStream->getXRunCount();
+    const int64_t periodNanos = static_cast<int64_t>(numFrames) * 1000000000LL / oboeStream->getSampleRate();
+    mStats.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), periodNanos, numFrames,
+                  xRunCount ? xRunCount.value() : -1, oboeStream->getBufferSizeInFrames());
     return result;
 }
+
+void LatencyTuningCallback::useStream(std::shared_ptr<oboe::AudioStream> stream) {
+    mStream = stream.get();
+    mFirstCallbackNanos.store(0, std::memory_order_release);
+    mStats.beginStream();
+    if (mStream) {
+        setOutputFormat(mStream->getFormat(), mStream->getChannelCount(),
+                        std::max(mStream->getBufferCapacityInFrames(), mStream->getFramesPerBurst()));
+    }
+    mLatencyTuner = mStream ? std::make_unique<oboe::LatencyTuner>(*mStream) : nullptr;
+}
@@ -2,25 +2,22 @@
 #include <oboe/Oboe.h>
 #include <oboe/LatencyTuner.h>
 
+#include <atomic>
+
+#include "CallbackStats.h"
 #include "TappableAudioSource.h"
 #include "DefaultDataCallback.h"
-#include "ndk_utils/trace.h"
 
 /**
  * This callback object extends the functionality of `DefaultDataCallback` by automatically
  * tuning the latency of the audio stream. @see onAudioReady for more details on this.
  *
- * It also demonstrates how to use tracing functions for logging inside the audio callback without
- * blocking.
+ * It also times every callback and tracks the stream's xruns and buffer size in a CallbackStats,
+ * which other threads can read without blocking the audio thread.
  */
 class LatencyTuningCallback: public DefaultDataCallback {
 public:
-    LatencyTuningCallback() : DefaultDataCallback() {
-
-        // Initialize the trace functions, this enables you to output trace statements without
-        // blocking. See https://developer.android.com/studio/profile/systrace-commandline.html
-        Trace::initialize();
-    }
+    LatencyTuningCallback() : DefaultDataCallback() { }
 
     /**
      * Every time the playback stream requires data this method will be called.
@@ -35,13 +32,28 @@ public:
 
     void setBufferTuneEnabled(bool enabled) {mBufferTuneEnabled = enabled;}
 
+    /**
+     * Prepare for the stream which is about to start, so the first callback does not allocate.
+     */
     void useStream(std::shared_ptr<oboe::AudioStream>  stream);
 
+    /**
+     * steady_clock time in nanoseconds at which the first callback of the stream passed to useStream
+     * started, 0 until it has.
+     */
+    int64_t getFirstCallbackNanos() const { return mFirstCallbackNanos.load(std::memory_order_acquire); }
+
+    const CallbackStats& getStats() const { return mStats; }
+
+    CallbackStats& getStats() { return mStats; }
+
 private:
     bool mBufferTuneEnabled = true;
 
     // This will be used to automatically tune the buffer size of the stream, obtaining optimal latency
     std::unique_ptr<oboe::LatencyTuner> mLatencyTuner;
     oboe::AudioStream  *mStream = nullptr;
+    CallbackStats mStats;
+    std::atomic<int64_t> mFirstCallbackNanos { 0 };
 };
 
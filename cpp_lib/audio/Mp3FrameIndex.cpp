@@ -0,0 +1,220 @@
+#include "Mp3FrameIndex.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "dr_mp3.h"
+#include "ndk_utils/log.h"
+
+namespace {
+    constexpr uint8_t  kMagic[4] = {'M', 'P', '3', 'X'};
+    constexpr uint32_t kVersion = 1;
+    constexpr size_t   kHeaderBytes = 4 + 4 + 8 + 8 + 8 + 4;
+    constexpr size_t   kPointBytes = 8 + 8 + 2 + 2;
+    // Bytes fingerprinted at each end of the asset.
+    constexpr size_t   kFingerprintBytes = 4096;
+    // Frames compared to find where a seek to a point lands, and how late it may land.
+    constexpr uint64_t kVerifyFrames = 1152;
+    constexpr uint64_t kMaxLandingError = 6 * 1152;
+    // The first two granules after a jump miss the MDCT overlap and synthesis filter history before it.
+    constexpr uint64_t kSettleFrames = 2 * 576;
+
+    void put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    uint64_t get(const uint8_t*& in, int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        in += bytes;
+        return value;
+    }
+
+    uint64_t fnv1a(uint64_t hash, const uint8_t* bytes, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Seek to a frame with only the point to go by, dr_mp3 searches a bound seek table linearly.
+    bool seekWith(drmp3& mp3, const Mp3FrameIndex::Point& point, uint64_t pcmFrame) {
+        drmp3_seek_point seekPoint {point.byteOffset, point.pcmFrame, point.mp3FramesToDiscard,
+                                    point.pcmFramesToDiscard};
+        drmp3_bind_seek_table(&mp3, 1, &seekPoint);
+        const bool ok = drmp3_seek_to_pcm_frame(&mp3, pcmFrame);
+        drmp3_bind_seek_table(&mp3, 0, nullptr);
+        return ok;
+    }
+
+    /**
+     * After jumping to a point dr_mp3 decodes mp3FramesToDiscard frames, only the last of them to PCM,
+     * and takes it to start pcmFramesToDiscard frames before the point. Its first kSettleFrames are
+     * only an approximation, so a seek has to land past them. But a frame whose main data begins in
+     * the bit reservoir of frames before the jump decodes to nothing, dr_mp3 then decodes one more and
+     * the seek lands a frame or two late, in the approximation.
+     *
+     * Seek probe to the point, find how late it lands in what sequential reads there decoding from
+     * the start, move the point past the approximation and check a seek to it is exact.
+     * @return false if the point cannot be made exact, it is then left out
+     */
+    bool verify(drmp3& sequential, drmp3& probe, Mp3FrameIndex::Point& point) {
+        const uint32_t       channels = probe.channels;
+        std::vector<int16_t> expected((kVerifyFrames + kMaxLandingError) * channels);
+        std::vector<int16_t> landed(kVerifyFrames * channels);
+
+        // Points come in order and far apart, sequential only ever reads forward.
+        const uint64_t delay = sequential.delayInPCMFrames;
+        const uint64_t target = point.pcmFrame - delay;
+        const uint64_t position = sequential.currentPCMFrame - std::min<uint64_t>(sequential.currentPCMFrame, delay);
+        if (target < position
+            || drmp3_read_pcm_frames_s16(&sequential, target - position, nullptr) != target - position) {
+            return false;
+        }
+        const uint64_t expectedFrames =
+                drmp3_read_pcm_frames_s16(&sequential, kVerifyFrames + kMaxLandingError, expected.data());
+        if (!seekWith(probe, point, point.pcmFrame)
+            || drmp3_read_pcm_frames_s16(&probe, kVerifyFrames, landed.data()) != kVerifyFrames) {
+            return false;
+        }
+
+        // Late by whole MPEG frames, where the landing is closest to the decode from the start.
+        const uint64_t frameSize = probe.pcmFramesConsumedInMP3Frame + probe.pcmFramesRemainingInMP3Frame;
+        uint64_t       late = 0;
+        int64_t        leastError = INT64_MAX;
+        for (uint64_t offset = 0; offset + kVerifyFrames <= expectedFrames; offset += frameSize) {
+            int64_t error = 0;
+            for (size_t i = 0; i < landed.size(); ++i) {
+                error += std::abs(landed[i] - expected[offset * channels + i]);
+            }
+            if (error < leastError) {
+                leastError = error;
+                late = offset;
+            }
+        }
+
+        const uint64_t decoded = point.pcmFrame - point.pcmFramesToDiscard + late;
+        point.pcmFrame = std::max(point.pcmFrame + late, decoded + kSettleFrames);
+        point.pcmFramesToDiscard = static_cast<uint16_t>(point.pcmFrame - decoded);
+        if (point.pcmFrame - delay + kVerifyFrames > expectedFrames + target
+            || !seekWith(probe, point, point.pcmFrame)
+            || drmp3_read_pcm_frames_s16(&probe, kVerifyFrames, landed.data()) != kVerifyFrames) {
+            return false;
+        }
+        const size_t start = (point.pcmFrame - delay - target) * channels;
+        return std::equal(landed.begin(), landed.end(), expected.begin() + start);
+    }
+}  // namespace
+
+std::shared_ptr<const Mp3FrameIndex> Mp3FrameIndex::build(const void* data, size_t size, uint32_t framesPerPoint) {
+    drmp3 mp3;
+    if (!drmp3_init_memory(&mp3, data, size, nullptr)) {
+        LOGE("Failed to open MP3 for indexing");
+        return nullptr;
+    }
+
+    const uint64_t               mp3Frames = drmp3_get_mp3_frame_count(&mp3);
+    drmp3_uint32                 count = static_cast<drmp3_uint32>(std::max<uint64_t>(1, mp3Frames / framesPerPoint));
+    std::vector<drmp3_seek_point> seekPoints(count);
+    if (!drmp3_calculate_seek_points(&mp3, &count, seekPoints.data())) {
+        LOGE("Failed to index MP3");
+        drmp3_uninit(&mp3);
+        return nullptr;
+    }
+
+    auto index = std::make_shared<Mp3FrameIndex>();
+    index->mAssetSize = size;
+    index->mFingerprint = fingerprint(data, size);
+    index->mTotalFrames = drmp3_get_pcm_frame_count(&mp3);
+
+    // Every point is checked against a decode from the start and left out if a seek to it goes astray.
+    drmp3 probe;
+    drmp3_init_memory(&probe, data, size, nullptr);
+    drmp3_seek_to_pcm_frame(&mp3, 0);
+    size_t dropped = 0;
+    for (drmp3_uint32 i = 0; i < count; ++i) {
+        Point point {seekPoints[i].seekPosInBytes, seekPoints[i].pcmFrameIndex, seekPoints[i].mp3FramesToDiscard,
+                     seekPoints[i].pcmFramesToDiscard};
+        // A seek lands by reading on from the point, which has to be past the encoder delay for the
+        // frames read to be counted the same way as when the clip plays from the start.
+        if (point.pcmFrame - point.pcmFramesToDiscard < mp3.delayInPCMFrames) {
+            continue;
+        }
+        if (verify(mp3, probe, point)) {
+            index->mPoints.push_back(point);
+        } else {
+            ++dropped;
+        }
+    }
+    drmp3_uninit(&probe);
+    drmp3_uninit(&mp3);
+    LOGI("MP3 index: %zu points for %llu MPEG frames, %llu PCM frames, %zu points dropped", index->mPoints.size(),
+         (unsigned long long)mp3Frames, (unsigned long long)index->mTotalFrames, dropped);
+    return index;
+}
+
+std::shared_ptr<const Mp3FrameIndex> Mp3FrameIndex::deserialize(const void* bytes, size_t size) {
+    const auto* in = static_cast<const uint8_t*>(bytes);
+    if (size < kHeaderBytes || !std::equal(kMagic, kMagic + 4, in)) {
+        return nullptr;
+    }
+    in += 4;
+    if (get(in, 4) != kVersion) {
+        return nullptr;
+    }
+    auto index = std::make_shared<Mp3FrameIndex>();
+    index->mAssetSize = get(in, 8);
+    index->mFingerprint = get(in, 8);
+    index->mTotalFrames = get(in, 8);
+    const uint64_t count = get(in, 4);
+    if (size != kHeaderBytes + count * kPointBytes) {
+        return nullptr;
+    }
+    index->mPoints.resize(count);
+    for (Point& point : index->mPoints) {
+        point.byteOffset = get(in, 8);
+        point.pcmFrame = get(in, 8);
+        point.mp3FramesToDiscard = static_cast<uint16_t>(get(in, 2));
+        point.pcmFramesToDiscard = static_cast<uint16_t>(get(in, 2));
+    }
+    return index;
+}
+
+std::vector<uint8_t> Mp3FrameIndex::serialize() const {
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    out.reserve(kHeaderBytes + mPoints.size() * kPointBytes);
+    put(out, kVersion, 4);
+    put(out, mAssetSize, 8);
+    put(out, mFingerprint, 8);
+    put(out, mTotalFrames, 8);
+    put(out, mPoints.size(), 4);
+    for (const Point& point : mPoints) {
+        put(out, point.byteOffset, 8);
+        put(out, point.pcmFrame, 8);
+        put(out, point.mp3FramesToDiscard, 2);
+        put(out, point.pcmFramesToDiscard, 2);
+    }
+    return out;
+}
+
+bool Mp3FrameIndex::matches(const void* data, size_t size) const {
+    return size == mAssetSize && fingerprint(data, size) == mFingerprint;
+}
+
+const Mp3FrameIndex::Point* Mp3FrameIndex::findPoint(uint64_t pcmFrame) const {
+    auto after = std::upper_bound(mPoints.begin(), mPoints.end(), pcmFrame,
+                                  [](uint64_t frame, const Point& point) { return frame < point.pcmFrame; });
+    return after == mPoints.begin() ? nullptr : &*(after - 1);
+}
+
+uint64_t Mp3FrameIndex::fingerprint(const void* data, size_t size) {
+    const auto*  bytes = static_cast<const uint8_t*>(data);
+    const size_t head = std::min(size, kFingerprintBytes);
+    const size_t tail = std::min(size - head, kFingerprintBytes);
+    const uint64_t hash = fnv1a(0xcbf29ce484222325ull, bytes, head);
+    return fnv1a(hash, bytes + size - tail, tail);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Seek points into an MP3 held in memory: the byte offset and PCM frame of every kFramesPerPoint-th
+ * MPEG frame, with the frames to decode and drop before it so the bit reservoir is filled.
+ *
+ * Building one walks the whole bitstream and decodes it to check every point, so it is done once per
+ * asset, at APK build time with host/mp3_index.cpp. With an index, opening the clip needs no walk
+ * to learn its length and a seek is a binary search plus about kFramesPerPoint frames of decoding,
+ * @see PcmDecoder::seek.
+ *
+ * The serialized form is little endian and carries the asset's size and a fingerprint of its first
+ * and last bytes, so an index is never used with an asset it was not built from.
+ */
+class Mp3FrameIndex {
+  public:
+    static constexpr uint32_t kFramesPerPoint = 16;  // about 0.4s of audio between points
+
+    struct Point {
+        uint64_t byteOffset;  // first byte of the MPEG frame decoding starts at
+        uint64_t pcmFrame;    // frame the point lands on, counting the encoder delay
+        uint16_t mp3FramesToDiscard;
+        uint16_t pcmFramesToDiscard;
+    };
+
+    /**
+     * Walk the MP3 and collect its seek points.
+     * @return the index, or nullptr if the data is not an MP3 dr_mp3 can open
+     */
+    static std::shared_ptr<const Mp3FrameIndex> build(const void* data, size_t size,
+                                                      uint32_t framesPerPoint = kFramesPerPoint);
+
+    /**
+     * @return the index, or nullptr if the bytes are not a serialized index of this version
+     */
+    static std::shared_ptr<const Mp3FrameIndex> deserialize(const void* bytes, size_t size);
+
+    std::vector<uint8_t> serialize() const;
+
+    /**
+     * True if the index was built from this data.
+     */
+    bool matches(const void* data, size_t size) const;
+
+    /**
+     * Frames the clip decodes to, without the encoder delay and padding.
+     */
+    uint64_t getTotalFrames() const { return mTotalFrames; }
+
+    size_t getPointCount() const { return mPoints.size(); }
+
+    /**
+     * The last point at or before a PCM frame counted with the encoder delay, nullptr if there is
+     * none and decoding has to start from the beginning. O(log n).
+     */
+    const Point* findPoint(uint64_t pcmFrame) const;
+
+  private:
+    static uint64_t fingerprint(const void* data, size_t size);
+
+    uint64_t           mAssetSize = 0;
+    uint64_t           mFingerprint = 0;
+    uint64_t           mTotalFrames = 0;
+    std::vector<Point> mPoints;
+};
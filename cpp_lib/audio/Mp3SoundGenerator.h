@@ -1,163 +1,178 @@
+#pragma once
 #include <memory>
 
 #include "ndk_utils/log.h"
 #include "dr_mp3.h"
+#include "ChannelConvert.h"
+#include "Mp3FrameIndex.h"
+#include "Resampler.h"
+#include "StreamingSoundGenerator.h"
 #include "TappableAudioSource.h"
 #include "oboe/Definitions.h"
 #include "oboe/Oboe.h"
 
-#include <vector>
-#include <cmath>
-#include <stdexcept>
-
-/**
- * Upsample PCM audio data using linear interpolation
- * 
- * @param input Input PCM samples (interleaved if multi-channel)
- * @param input_sample_rate Original sample rate (Hz)
- * @param output_sample_rate Target sample rate (Hz)
- * @param channels Number of audio channels (1 = mono, 2 = stereo, etc.)
- * @return Upsampled PCM data
- */
-inline std::vector<float> upsample_pcm(const std::vector<float>& input, 
-                                int input_sample_rate, 
-                                int output_sample_rate, 
-                                int channels = 1) {
-    if (input_sample_rate <= 0 || output_sample_rate <= 0) {
-        throw std::invalid_argument("Sample rates must be positive");
-    }
-    if (channels <= 0) {
-        throw std::invalid_argument("Channels must be positive");
-    }
-    if (input.size() % channels != 0) {
-        throw std::invalid_argument("Input size must be divisible by number of channels");
-    }
-    if (output_sample_rate <= input_sample_rate) {
-        throw std::invalid_argument("Output sample rate must be higher than input for upsampling");
-    }
-
-    // Calculate upsampling ratio
-    double ratio = static_cast<double>(output_sample_rate) / input_sample_rate;
-    size_t input_frames = input.size() / channels;
-    size_t output_frames = static_cast<size_t>(std::ceil(input_frames * ratio));
-    
-    std::vector<float> output(output_frames * channels);
-    
-    // Process each channel separately
-    for (int ch = 0; ch < channels; ++ch) {
-        for (size_t out_frame = 0; out_frame < output_frames; ++out_frame) {
-            // Calculate corresponding position in input
-            double input_pos = out_frame / ratio;
-            
-            // Get the two nearest input samples
-            size_t input_frame_low = static_cast<size_t>(std::floor(input_pos));
-            size_t input_frame_high = input_frame_low + 1;
-            
-            // Handle boundary conditions
-            if (input_frame_low >= input_frames) {
-                // Beyond end - use last sample
-                output[out_frame * channels + ch] = input[(input_frames - 1) * channels + ch];
-            } else if (input_frame_high >= input_frames) {
-                // At the last sample - no interpolation needed
-                output[out_frame * channels + ch] = input[input_frame_low * channels + ch];
-            } else {
-                // Linear interpolation
-                float sample_low = input[input_frame_low * channels + ch];
-                float sample_high = input[input_frame_high * channels + ch];
-                float fraction = static_cast<float>(input_pos - input_frame_low);
-                output[out_frame * channels + ch] = sample_low + fraction * (sample_high - sample_low);
-            }
-        }
-    }
-    
-    return output;
-}
-
-// Helper function for integer PCM data (16-bit)
-inline std::vector<int16_t> upsample_pcm_int16(const std::vector<int16_t>& input,
-                                        int input_sample_rate,
-                                        int output_sample_rate,
-                                        int channels = 1) {
-    // Convert to float
-    std::vector<float> input_float(input.size());
-    for (size_t i = 0; i < input.size(); ++i) {
-        input_float[i] = static_cast<float>(input[i]) / 32768.0f;
-    }
-    
-    // Upsample
-    std::vector<float> output_float = upsample_pcm(input_float, input_sample_rate, 
-                                                   output_sample_rate, channels);
-    
-    // Convert back to int16_t
-    std::vector<int16_t> output(output_float.size());
-    for (size_t i = 0; i < output_float.size(); ++i) {
-        float clamped = std::max(-1.0f, std::min(1.0f, output_float[i]));
-        output[i] = static_cast<int16_t>(clamped * 32767.0f);
-    }
-    
-    return output;
-}
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 
 class Mp3SoundGenerator : public TappableAudioSource {
     static constexpr size_t kSharedBufferSize = 1024*1024;
+    static constexpr int32_t kResampleBufferFrames = 4096;
 
   public:
-    static oboe::ResultWithValue<std::shared_ptr<Mp3SoundGenerator>> createFromFile(std::string filepath) {
+    static constexpr uint64_t kUnknownLength = UINT64_MAX;
+
+    /**
+     * @param deviceChannelCount - channel count of the stream the clip plays on, @see setChannelCount
+     */
+    static oboe::ResultWithValue<std::shared_ptr<Mp3SoundGenerator>> createFromFile(std::string filepath,
+                                                                                    int32_t deviceChannelCount) {
         drmp3 mp3;
         if (!drmp3_init_file(&mp3, filepath.c_str(), NULL)) {
             LOGE("Failed to open MP3");
             return oboe::ResultWithValue<std::shared_ptr<Mp3SoundGenerator>>(oboe::Result::ErrorNull);
         }
 
-        auto pcm_frame_count = drmp3_get_pcm_frame_count(&mp3);
+        auto pcm_frame_count = readFrameCount(mp3, nullptr);
         auto channels = mp3.channels;
         auto sample_rate = mp3.sampleRate;
 
-        LOGI("MP3 file has %llu frames, %d ch, %d Hz", pcm_frame_count, channels, sample_rate);
-        auto ret = oboe::ResultWithValue(std::make_shared<Mp3SoundGenerator>(sample_rate, channels));
+        logFormat(pcm_frame_count, channels, sample_rate);
+        auto ret = oboe::ResultWithValue(
+                std::make_shared<Mp3SoundGenerator>(sample_rate, channels, deviceChannelCount));
         ret.value()->mMp3 = mp3;
+        ret.value()->mTotalFrames = pcm_frame_count;
+        ret.value()->mConverter.setLayout(channels, ret.value()->mDeviceChannelCount);
+        ret.value()->prepareResampler();
         return ret;
     }
 
-    static oboe::ResultWithValue<std::shared_ptr<Mp3SoundGenerator>> createFromBuf(char* buf, int size) {
-        drmp3 mp3;
+    /**
+     * @param deviceChannelCount - channel count of the stream the clip plays on, @see setChannelCount
+     * @param index - seek points of the clip, which give its length and make seekTo() O(log n).
+     * Without one the length comes from the Xing header; the bitstream is never walked to count frames.
+     */
+    static oboe::ResultWithValue<std::shared_ptr<Mp3SoundGenerator>> createFromBuf(
+            char* buf, int size, int32_t deviceChannelCount,
+            const std::shared_ptr<const Mp3FrameIndex>& index = nullptr) {
+        // A memory decoder keeps a pointer to itself, so it has to be initialized in place rather than
+        // copied into the generator.
+        auto generator = std::make_shared<Mp3SoundGenerator>(0, 0, deviceChannelCount);
+        drmp3& mp3 = generator->mMp3;
         if (!drmp3_init_memory(&mp3, buf, size, nullptr)) {
             LOGE("Failed to open MP3");
             return oboe::ResultWithValue<std::shared_ptr<Mp3SoundGenerator>>(oboe::Result::ErrorNull);
         }
 
-        auto pcm_frame_count = drmp3_get_pcm_frame_count(&mp3);
+        auto pcm_frame_count = readFrameCount(mp3, index.get());
         auto channels = mp3.channels;
         auto sample_rate = mp3.sampleRate;
 
-        LOGI("MP3 file has %llu frames, %d ch, %d Hz", pcm_frame_count, channels, sample_rate);
-        auto ret = oboe::ResultWithValue(std::make_shared<Mp3SoundGenerator>(sample_rate, channels));
-        ret.value()->mMp3 = mp3;
-        return ret;
+        logFormat(pcm_frame_count, channels, sample_rate);
+        generator->mSampleRate = sample_rate;
+        generator->mChannelCount = channels;
+        generator->mTotalFrames = pcm_frame_count;
+        generator->mIndex = index;
+        generator->mConverter.setLayout(channels, generator->mDeviceChannelCount);
+        generator->prepareResampler();
+        return oboe::ResultWithValue(generator);
     }
 
-    int resetData(char* buf, int size) {
+    /**
+     * Switch to another clip, @see createFromBuf for the index.
+     */
+    int resetData(char* buf, int size, const std::shared_ptr<const Mp3FrameIndex>& index = nullptr) {
         LOGI("Reset MP3 data");
         std::lock_guard<std::mutex> lock(mMutex);
+        // Only the first frame is parsed, for the format and the length.
         if (!drmp3_init_memory(&mMp3, buf, size, nullptr)) {
             LOGE("Failed to open MP3");
             return -1;
         }
-        auto pcm_frame_count = drmp3_get_pcm_frame_count(&mMp3);
+        auto pcm_frame_count = readFrameCount(mMp3, index.get());
         auto channels = mMp3.channels;
         auto sample_rate = mMp3.sampleRate;
 
-        LOGI("MP3 file has %llu frames, %d ch, %d Hz", pcm_frame_count, channels, sample_rate);
+        logFormat(pcm_frame_count, channels, sample_rate);
+        mTotalFrames = pcm_frame_count;
+        mIndex = index;
+        if (mStream) {
+            // The decoder thread opens the clip itself, the audio callback never waits for it.
+            mStream->resetData(buf, size, index);
+            return 0;
+        }
         mSampleRate = sample_rate;
         mChannelCount = channels;
-        mTotalFrames = pcm_frame_count;
+        mConverter.setLayout(mChannelCount, mDeviceChannelCount);
+        updateResampler();
         return 0;
     }
 
+    /**
+     * Frames the clip decodes to, kUnknownLength if it has neither an index nor a Xing header.
+     */
+    uint64_t getFrameCount() const { return mTotalFrames.load(std::memory_order_relaxed); }
+
+    /**
+     * Play on from a frame of the clip. Only the streaming mode seeks, from the nearest point of the
+     * clip's index, @see PcmDecoder::seek.
+     * @return false if the generator is not streaming
+     */
+    bool seekTo(uint64_t frame) {
+        if (!mStream) {
+            LOGW("MP3 seek needs streaming mode");
+            return false;
+        }
+        mStream->seekTo(frame);
+        return true;
+    }
+
     // Switch the tones on
     void tap(bool isOn) override { (void)isOn; }
 
+    /**
+     * Switch to streaming mode: the clip plays through a StreamingSoundGenerator, whose thread decodes
+     * ahead into a lock-free ring already in the device format, so renderAudio only copies frames out
+     * of it. Only a clip held in memory can be streamed.
+     *
+     * Call this before the generator is handed to a stream.
+     */
+    void startStreaming() {
+        if (mStream) {
+            return;
+        }
+        std::unique_ptr<PcmDecoder> decoder;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            decoder = PcmDecoder::open(mMp3.memory.pData, mMp3.memory.dataSize, mIndex);
+        }
+        if (!decoder) {
+            LOGE("MP3 not held in memory, it cannot be streamed");
+            return;
+        }
+        mStream = std::make_unique<StreamingSoundGenerator>(std::move(decoder), mDeviceSampleRate, mDeviceChannelCount);
+        mStream->start();
+    }
+
+    void stopStreaming() {
+        if (mStream) {
+            mStream->stop();
+        }
+    }
+
+    /**
+     * Number of callbacks in which the streaming decoder had not produced enough frames. Frames
+     * missing at the end of a clip are not counted.
+     */
+    uint64_t getUnderrunCount() const { return mStream ? mStream->getUnderrunCount() : 0; }
+
+    uint64_t getUnderrunFrames() const { return mStream ? mStream->getUnderrunFrames() : 0; }
+
     void renderAudio(float* audioData, int32_t numFrames) override {
+        if (mStream) {
+            mStream->renderAudio(audioData, numFrames);
+            return;
+        }
         LOGV("renderAudio numFrames %d", numFrames);
         std::lock_guard<std::mutex> lock(mMutex);
         if (mDeviceSampleRate == mSampleRate) {
@@ -168,59 +183,124 @@ class Mp3SoundGenerator : public TappableAudioSource {
                 std::fill_n(mBuffer.get(), kSharedBufferSize, 0);
             }
             // No need to resample
-            for (int j = 0; j < (int)numFrames; ++j) {
-                for (int i = 0; i < mDeviceChannelCount; ++i) {
-                    if (mChannelCount == 2) {
-                        audioData[(j * mDeviceChannelCount) + i] = mBuffer[j*2 + i];
-                    } else if (mChannelCount ==1 ) {
-                        audioData[(j * mDeviceChannelCount) + i] = mBuffer[j];
-                    }
-                }
-            }
-        } else {
-            int input_frames = numFrames * mDeviceSampleRate / mSampleRate;
-            std::vector<float> input;
-            input.resize(input_frames * mChannelCount);
-            auto read_frames = drmp3_read_pcm_frames_f32(&mMp3, input_frames, input.data());
-            if (read_frames <= 0) {
-                LOGV("Decode failed");
-                return;
-            }
+            mConverter(mBuffer.get(), audioData, numFrames);
+        } else if (mResampler) {
+            // The resampler carries its phase and history across callbacks, so pull exactly as many
+            // input frames as this burst needs.
+            for (int32_t done = 0; done < numFrames;) {
+                const int32_t frames = std::min(numFrames - done, kResampleBufferFrames);
+                const int32_t inputFrames = mResampler->getInputFramesRequired(frames);
+                auto readFrames = drmp3_read_pcm_frames_f32(&mMp3, inputFrames, mBuffer.get());
+                // Past the end of the clip keep feeding silence so the filter tail drains.
+                std::fill(mBuffer.get() + readFrames * mChannelCount, mBuffer.get() + inputFrames * mChannelCount, 0.0f);
+                mResampler->process(mBuffer.get(), inputFrames, mResampleBuffer.get(), frames);
 
-            auto output = upsample_pcm(input, mSampleRate, mDeviceSampleRate);
-            LOGD("MP3 input_frames %d output_frames %zu", input_frames, output.size());
-            if ((int)output.size() < (int)numFrames * mChannelCount) {
-                output.resize(numFrames * mChannelCount);
-            }
-            // Resample
-            for (int j = 0; j < (int)numFrames; ++j) {
-                for (int i = 0; i < mDeviceChannelCount; ++i) {
-                    if (mChannelCount == 2) {
-                        audioData[(j * mDeviceChannelCount) + i] = output[j*2 + i];
-                    } else if (mChannelCount ==1 ) {
-                        audioData[(j * mDeviceChannelCount) + i] = output[j];
-                    }
-                }
+                mConverter(mResampleBuffer.get(), audioData + static_cast<size_t>(done) * mDeviceChannelCount, frames);
+                done += frames;
             }
+        } else {
+            // No clip, the buffer is not ours to leave as it was.
+            std::fill_n(audioData, static_cast<size_t>(numFrames) * mDeviceChannelCount, 0.0f);
         }
     }
 
-    Mp3SoundGenerator(int32_t sampleRate, int32_t channelCount)
-        : TappableAudioSource(sampleRate, channelCount) { }
+    Mp3SoundGenerator(int32_t sampleRate, int32_t channelCount, int32_t deviceChannelCount)
+        : TappableAudioSource(sampleRate, channelCount)
+        , mDeviceChannelCount(deviceChannelCount) { }
 
-    ~Mp3SoundGenerator() { }
+    ~Mp3SoundGenerator() { stopStreaming(); }
 
     void setSampleRate(int32_t rate) {
         LOGD("MP3 setSampleRate %d", rate);
+        if (mStream) {
+            mStream->setSampleRate(rate);
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (rate == mDeviceSampleRate && isResamplerCurrent()) {
+            return;  // a reopen at the same rate keeps the resampler's history
+        }
         mDeviceSampleRate = rate;
+        updateResampler();
+    }
+
+    /**
+     * Device channel count, @see DecodeAheadSource::setChannelCount. Call only while no stream renders
+     * the generator.
+     */
+    void setChannelCount(int32_t count) {
+        if (mStream) {
+            mStream->setChannelCount(count);
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDeviceChannelCount = count;
+        mConverter.setLayout(mChannelCount, mDeviceChannelCount);
     }
 
   private:
-    drmp3                    mMp3;
-    uint64_t                 mTotalFrames;
+    /**
+     * Length of the clip in O(1): from the index if it was built from this clip, else from the Xing
+     * header, else kUnknownLength.
+     */
+    static uint64_t readFrameCount(drmp3& mp3, const Mp3FrameIndex* index) {
+        if (index != nullptr && index->matches(mp3.memory.pData, mp3.memory.dataSize)) {
+            return index->getTotalFrames();
+        }
+        if (mp3.totalPCMFrameCount == DRMP3_UINT64_MAX) {
+            return kUnknownLength;
+        }
+        return drmp3_get_pcm_frame_count(&mp3);
+    }
+
+    static void logFormat(uint64_t frames, uint32_t channels, uint32_t sampleRate) {
+        if (frames == kUnknownLength) {
+            LOGI("MP3 file of unknown length, %d ch, %d Hz", channels, sampleRate);
+        } else {
+            LOGI("MP3 file has %llu frames, %d ch, %d Hz", (unsigned long long)frames, channels, sampleRate);
+        }
+    }
+
+    // For the factories, which play at the default device rate until setSampleRate().
+    void prepareResampler() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        updateResampler();
+    }
+
+    // Whether mResampler is the one the non-streaming path needs now. Must be called with mMutex held.
+    bool isResamplerCurrent() const {
+        if (mStream || mSampleRate <= 0 || mDeviceSampleRate == mSampleRate) {
+            return mResampler == nullptr;
+        }
+        return mResampler && mResampler->getInputRate() == mSampleRate
+               && mResampler->getOutputRate() == mDeviceSampleRate && mResampler->getChannelCount() == mChannelCount;
+    }
+
+    // Must be called with mMutex held, it is only used by the non-streaming path.
+    void updateResampler() {
+        if (mStream || mSampleRate <= 0 || mDeviceSampleRate == mSampleRate) {
+            mResampler.reset();
+            return;
+        }
+        if (!mResampler || mResampler->getInputRate() != mSampleRate
+            || mResampler->getOutputRate() != mDeviceSampleRate || mResampler->getChannelCount() != mChannelCount) {
+            mResampler = std::make_unique<Resampler>(mSampleRate, mDeviceSampleRate, mChannelCount);
+        } else {
+            mResampler->reset();
+        }
+    }
+
+    drmp3                    mMp3 {};
+    std::atomic<uint64_t>    mTotalFrames { kUnknownLength };
+    std::shared_ptr<const Mp3FrameIndex> mIndex;  // of the clip in mMp3, guarded by mMutex
     std::unique_ptr<float[]> mBuffer = std::make_unique<float[]>(kSharedBufferSize);
+    std::unique_ptr<float[]> mResampleBuffer = std::make_unique<float[]>(kResampleBufferFrames * 2);
+    std::unique_ptr<Resampler> mResampler;  // guarded by mMutex
     std::mutex               mMutex;
 
-    int32_t mDeviceSampleRate = 48000;
-    int32_t mDeviceChannelCount = 2;
+    std::atomic<int32_t> mDeviceSampleRate { 48000 };
+    int32_t              mDeviceChannelCount;  // guarded by mMutex
+    // From mChannelCount to mDeviceChannelCount, set whenever the clip changes.
+    channels::Converter  mConverter;
+
+    // Streaming mode, set before the generator is handed to a stream.
+    std::unique_ptr<StreamingSoundGenerator> mStream;
 };
@@ -1,4 +1,8 @@
 #include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <memory>
 
 #include "Oscillator.h"
@@ -6,6 +10,23 @@
 #include "OboeEngine.h"
 #include "SoundGenerator.h"
 
+namespace {
+    constexpr int64_t kNanosPerSecond = 1000000000;
+    // From Android 12 (S) the AAudio MMAP path takes float as well as 16 bit PCM.
+    constexpr int kFloatMMapSdkVersion = 31;
+
+    int64_t nowNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * kNanosPerSecond + ts.tv_nsec;
+    }
+
+    int64_t steadyNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}  // namespace
+
 /**
  * Main audio engine for the Oboe sample. It is responsible for:
  *
@@ -18,7 +39,31 @@
  */
 OboeEngine::OboeEngine()
     : mLatencyCallback(std::make_shared<LatencyTuningCallback>())
-    , mErrorCallback(std::make_shared<DefaultErrorCallback>(*this)) { }
+    , mErrorCallback(std::make_shared<DefaultErrorCallback>(*this))
+    , mVoiceMixer(std::make_shared<VoiceMixer>(mClipCache.getSampleRate(), mClipCache.getChannelCount()))
+    , mMasterGain(std::make_shared<GainRampNode>())
+    , mSpectrumAnalyzer(std::make_shared<SpectrumAnalyzer>())
+    , mMasterGraph(std::make_shared<AudioGraph>())
+    , mCaptureCallback(std::make_shared<CaptureCallback>())
+    , mDeviceFormat(DeviceFormat {mClipCache.getSampleRate(), mClipCache.getChannelCount()}) {
+    AudioGraph::NodeId node = mMasterGraph->addSource(mVoiceMixer.get());
+    node = mMasterGraph->addNode(mMasterGain, node);
+    node = mMasterGraph->addNode(std::make_shared<LimiterNode>(), node);
+    mMasterGraph->setOutput(mMasterGraph->addNode(mSpectrumAnalyzer, node));
+    // Keep the callback off the little cores and away from the decoder and inference threads.
+    mLatencyCallback->setThreadAffinityEnabled(true);
+    mControlThread = std::thread(&OboeEngine::controlLoop, this);
+}
+
+OboeEngine::~OboeEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mControlLock);
+        mControlThreadExit = true;
+    }
+    mControlCondition.notify_all();
+    mControlThread.join();
+    stop();
+}
 
 double OboeEngine::getCurrentOutputLatencyMillis() {
     if (!mIsLatencyDetectionSupported)
@@ -60,16 +105,89 @@ bool OboeEngine::isAAudioRecommended() {
 }
 
 void OboeEngine::tap(bool isDown) {
-    if (mAudioSource) {
-        mAudioSource->tap(isDown);
+    // A reopen may replace the synth, under mLock, and drops the taps queued before it.
+    std::lock_guard<std::mutex> lock(mLock);
+    mVoiceMixer->tap(mAudioSource.get(), isDown);
+}
+
+void OboeEngine::tapAt(bool isDown, int64_t presentationNanos) {
+    const int64_t               frame = getFramePositionAt(presentationNanos);
+    std::lock_guard<std::mutex> lock(mLock);
+    mVoiceMixer->tap(mAudioSource.get(), isDown, frame);
+}
+
+/**
+ * A frame of the stream and the CLOCK_MONOTONIC time it is heard. Call with mLock held.
+ * @return false if there is no stream
+ */
+bool OboeEngine::getPresentationAnchor(int64_t& frame, int64_t& nanos) {
+    if (!mStream) {
+        return false;
+    }
+    if (mIsLatencyDetectionSupported) {
+        auto timestamp = mStream->getTimestamp(CLOCK_MONOTONIC);
+        if (timestamp) {
+            frame = timestamp.value().position;
+            nanos = timestamp.value().timestamp;
+            return true;
+        }
+    }
+    // No timestamp yet: the next frame rendered is heard once the buffer ahead of it has played.
+    frame = mVoiceMixer->getFramePosition();
+    nanos = nowNanos() + mStream->getBufferSizeInFrames() * kNanosPerSecond / mStream->getSampleRate();
+    return true;
+}
+
+int64_t OboeEngine::getFramePositionAt(int64_t presentationNanos) {
+    std::lock_guard<std::mutex> lock(mLock);
+    int64_t                     frame = 0;
+    int64_t                     nanos = 0;
+    if (!getPresentationAnchor(frame, nanos)) {
+        return 0;  // as soon as a stream plays
+    }
+    return frame + (presentationNanos - nanos) * mStream->getSampleRate() / kNanosPerSecond;
+}
+
+int64_t OboeEngine::getTriggerLeadNanos() {
+    std::lock_guard<std::mutex> lock(mLock);
+    int64_t                     frame = 0;
+    int64_t                     nanos = 0;
+    if (!getPresentationAnchor(frame, nanos)) {
+        return 0;
     }
+    // A command queued now is taken by the callback after the one which may be running.
+    const int64_t firstFrame = mVoiceMixer->getFramePosition() + mStream->getFramesPerBurst();
+    const int64_t lead = nanos + (firstFrame - frame) * kNanosPerSecond / mStream->getSampleRate() - nowNanos();
+    mTriggerLeadNanos = std::max(mTriggerLeadNanos, lead);
+    return mTriggerLeadNanos;
+}
+
+oboe::AudioFormat OboeEngine::getOutputFormat() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStream ? mStream->getFormat() : oboe::AudioFormat::Unspecified;
+}
+
+/**
+ * I16 where the low latency path is 16 bit only: AAudio before Android 12, whose MMAP streams take
+ * no float, so a float stream would be converted without dither before it reaches the device.
+ */
+oboe::AudioFormat OboeEngine::chooseOutputFormat() {
+    switch (mOutputMode.load()) {
+        case OutputMode::Float: return oboe::AudioFormat::Float;
+        case OutputMode::I16: return oboe::AudioFormat::I16;
+        case OutputMode::Auto: break;
+    }
+    const bool isAAudio = mAudioApi == oboe::AudioApi::AAudio
+                          || (mAudioApi == oboe::AudioApi::Unspecified && isAAudioRecommended());
+    return isAAudio && oboe::getSdkVersion() < kFloatMMapSdkVersion ? oboe::AudioFormat::I16
+                                                                    : oboe::AudioFormat::Float;
 }
 
 oboe::Result OboeEngine::openPlaybackStream() {
     oboe::AudioStreamBuilder builder;
     oboe::Result             result = builder.setSharingMode(oboe::SharingMode::Exclusive)
                                   ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
-                                  ->setFormat(oboe::AudioFormat::Float)
+                                  ->setFormat(chooseOutputFormat())
                                   ->setFormatConversionAllowed(true)
                                   ->setDataCallback(mLatencyCallback)
                                   ->setErrorCallback(mErrorCallback)
@@ -79,14 +197,149 @@ oboe::Result OboeEngine::openPlaybackStream() {
                                   ->openStream(mStream);
     if (result == oboe::Result::OK) {
         mChannelCount = mStream->getChannelCount();
+        mLatencyCallback->useStream(mStream);
     }
     return result;
 }
 
+/**
+ * The input side of a full-duplex pair: same low-latency mode as the playback stream and its sample
+ * rate, so captured and played frames line up. Call with mLock held and the playback stream open.
+ */
+oboe::Result OboeEngine::openCaptureStream() {
+    oboe::AudioStreamBuilder builder;
+    oboe::Result             result = builder.setDirection(oboe::Direction::Input)
+                                  ->setSharingMode(oboe::SharingMode::Exclusive)
+                                  ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
+                                  ->setInputPreset(oboe::InputPreset::VoiceRecognition)
+                                  ->setFormat(oboe::AudioFormat::Float)
+                                  ->setFormatConversionAllowed(true)
+                                  ->setChannelCount(oboe::ChannelCount::Mono)
+                                  ->setChannelConversionAllowed(true)
+                                  ->setSampleRate(mStream->getSampleRate())
+                                  ->setSampleRateConversionQuality(oboe::SampleRateConversionQuality::Medium)
+                                  ->setDataCallback(mCaptureCallback)
+                                  ->setErrorCallback(mErrorCallback)
+                                  ->setAudioApi(mAudioApi)
+                                  ->openStream(mCaptureStream);
+    if (result != oboe::Result::OK) {
+        LOGE("Error creating capture stream. Error: %s", oboe::convertToText(result));
+        return result;
+    }
+    mCaptureCallback->useStream(mCaptureStream);
+    result = mCaptureStream->requestStart();
+    if (result != oboe::Result::OK) {
+        LOGE("Error starting capture stream. Error: %s", oboe::convertToText(result));
+        closeCaptureStream();
+    }
+    return result;
+}
+
+void OboeEngine::closeCaptureStream() {
+    if (mCaptureStream) {
+        mCaptureStream->stop();
+        mCaptureStream->close();
+        mCaptureStream.reset();
+    }
+}
+
+void OboeEngine::setSpectrumEnabled(bool enabled) {
+    // Under the lock, so the worker is not started while a restart prepares the analyzer.
+    std::lock_guard<std::mutex> lock(mLock);
+    if (enabled) {
+        mSpectrumAnalyzer->start();
+    } else {
+        mSpectrumAnalyzer->stop();
+    }
+}
+
+oboe::Result OboeEngine::startCapture() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mIsCapturing = true;
+    if (!mStream || mCaptureStream) {
+        return oboe::Result::OK;  // opened with the next playback stream
+    }
+    return openCaptureStream();
+}
+
+void OboeEngine::stopCapture() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mIsCapturing = false;
+    closeCaptureStream();
+}
+
 void OboeEngine::restart() {
     // The stream will have already been closed by the error callback.
-    mLatencyCallback->reset();
-    start();
+    {
+        std::lock_guard<std::mutex> lock(mControlLock);
+        mRestartRequested = true;
+    }
+    mControlCondition.notify_all();
+}
+
+void OboeEngine::controlLoop() {
+    std::unique_lock<std::mutex> lock(mControlLock);
+    while (true) {
+        mControlCondition.wait(lock, [this] { return mRestartRequested || mControlThreadExit; });
+        if (mControlThreadExit) {
+            return;
+        }
+        mRestartRequested = false;
+        lock.unlock();
+        restartAfterDisconnect();
+        lock.lock();
+    }
+}
+
+/**
+ * Reopen the stream on the control thread and time the gap from the disconnect to the first callback
+ * of the new stream.
+ */
+void OboeEngine::restartAfterDisconnect() {
+    const int64_t disconnectNanos = mErrorCallback->getLastDisconnectNanos();
+    const int64_t openNanos = steadyNanos();
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mIsRunning) {
+            return;  // stopped while the old stream was closing
+        }
+        mLatencyCallback->reset();
+        if (openAndStartStream() != oboe::Result::OK) {
+            return;
+        }
+    }
+    const int64_t startedNanos = steadyNanos();
+
+    // Wait for the first callback without holding mLock, giving up if the new stream is already gone.
+    int64_t firstCallbackNanos = 0;
+    {
+        std::unique_lock<std::mutex> lock(mControlLock);
+        for (int32_t waited = 0; waited < kFirstCallbackTimeoutMillis; waited += kFirstCallbackPollMillis) {
+            if (mControlCondition.wait_for(lock, std::chrono::milliseconds(kFirstCallbackPollMillis),
+                                           [this] { return mRestartRequested || mControlThreadExit; })) {
+                break;
+            }
+            if ((firstCallbackNanos = mLatencyCallback->getFirstCallbackNanos()) != 0) {
+                break;
+            }
+        }
+    }
+    if (firstCallbackNanos == 0) {
+        LOGW("Restarted stream has not called back after %d ms", kFirstCallbackTimeoutMillis);
+        return;
+    }
+
+    const int64_t fromNanos = disconnectNanos != 0 && disconnectNanos <= openNanos ? disconnectNanos : openNanos;
+    const double  gapMillis = (firstCallbackNanos - fromNanos) / 1e6;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        ++mRestarts;
+        mLastRestartMillis = gapMillis;
+        mMaxRestartMillis = std::max(mMaxRestartMillis, gapMillis);
+    }
+    LOGI("Restart: %.1fms from disconnect to first callback (close %.1fms, open and start %.1fms, first callback "
+         "%.1fms)", gapMillis, (openNanos - fromNanos) / 1e6, (startedNanos - openNanos) / 1e6,
+         (firstCallbackNanos - startedNanos) / 1e6);
 }
 
 oboe::Result OboeEngine::start(oboe::AudioApi audioApi, int deviceId, int channelCount) {
@@ -98,30 +351,89 @@ oboe::Result OboeEngine::start(oboe::AudioApi audioApi, int deviceId, int channe
 
 oboe::Result OboeEngine::start() {
     std::lock_guard<std::mutex> lock(mLock);
-    oboe::Result                result = oboe::Result::OK;
+    mIsRunning = true;
+    return openAndStartStream();
+}
+
+/**
+ * Open and start a stream with the current settings. Call with mLock held.
+ *
+ * Everything which outlives a stream is kept: the sources with their decoded data and resampler
+ * state, the clip cache and the mixer's voices. Only the format-dependent state changes, and only if
+ * the new stream's format differs. A new channel count drops what the streamed sources had decoded
+ * ahead, @see DecodeAheadSource::setChannelCount.
+ */
+oboe::Result OboeEngine::openAndStartStream() {
+    oboe::Result result = oboe::Result::OK;
     // It is possible for a stream's device to become disconnected during the open or between
     // the Open and the Start.
     // So if it fails to start, close the old stream and try again.
     int tryCount = 0;
+    // Either stream's disconnect reopens both, the one which is still open is closed first.
+    closeCaptureStream();
+    if (mStream) {
+        mStream->close();
+        mStream.reset();
+    }
     do {
-        if (tryCount > 0) {
-            usleep(20 * 1000);  // Sleep between tries to give the system time to settle.
+        // The first retry goes at once, a device switch is usually over by then. Later ones give the
+        // system time to settle.
+        if (tryCount > 1) {
+            usleep(kReopenRetryMillis * 1000);
         }
         mIsLatencyDetectionSupported = false;
+        mTriggerLeadNanos = 0;
         result = openPlaybackStream();
         if (result == oboe::Result::OK) {
-            if (mMp3AudioSource == nullptr) {
-                mAudioSource = std::make_shared<SoundGenerator>(mStream->getSampleRate(), mStream->getChannelCount());
-                mLatencyCallback->setSource(std::dynamic_pointer_cast<IRenderableAudio>(mAudioSource));
+            // Clips are mixed over whichever source streams, so the mixer is always the root.
+            mDeviceFormat.store({mStream->getSampleRate(), mStream->getChannelCount()});
+            // Every source follows the new format, whichever is playing, and the one which was playing
+            // stays selected. The synth only stands in when nothing has been played yet. No callback
+            // runs until the stream starts, so the sources can resize what they render into.
+            const int32_t sampleRate = mStream->getSampleRate();
+            const int32_t channelCount = mStream->getChannelCount();
+            if (mClipSequencer != nullptr) {
+                mClipSequencer->setSampleRate(sampleRate);
+                mClipSequencer->setChannelCount(channelCount);
+            }
+            if (mStreamAudioSource != nullptr) {
+                mStreamAudioSource->setSampleRate(sampleRate);
+                mStreamAudioSource->setChannelCount(channelCount);
+            }
+            if (mMp3AudioSource != nullptr) {
+                mMp3AudioSource->setSampleRate(sampleRate);
+                mMp3AudioSource->setChannelCount(channelCount);
+            }
+            IRenderableAudio* source = mVoiceMixer->getStreamSource();
+            const bool        usesSynth = source == nullptr || source == mAudioSource.get();
+            if (usesSynth && (mAudioSource == nullptr || mAudioSource->mChannelCount != mStream->getChannelCount())) {
+                mAudioSource = std::make_shared<SoundGenerator>(sampleRate, mStream->getChannelCount());
+            } else if (mAudioSource != nullptr) {
+                mAudioSource->setSampleRate(sampleRate);
+            }
+            if (usesSynth) {
+                source = mAudioSource.get();
+                mVoiceMixer->setStreamSource(source);
+            }
+            // Only now, so the taps queued for a synth which was just replaced are dropped with the rest.
+            mVoiceMixer->setFormat(mStream->getSampleRate(), mStream->getChannelCount());
+            if (source == mAudioSource.get()) {
                 LOGI("using synthetic source");
+            } else if (source == mClipSequencer.get()) {
+                LOGI("using clip sequencer source");
+            } else if (source == mStreamAudioSource.get()) {
+                LOGI("using %s stream source", PcmDecoder::formatToText(mStreamAudioSource->getFormat()));
             } else {
-                mMp3AudioSource->setSampleRate(mStream->getSampleRate());
-                mLatencyCallback->setSource(std::dynamic_pointer_cast<IRenderableAudio>(mMp3AudioSource));
                 LOGI("using mp3 source");
             }
+            mMasterGraph->compile(mStream->getSampleRate(), mStream->getChannelCount());
+            mLatencyCallback->setSource(mMasterGraph);
 
             LOGD("Stream opened: AudioAPI = %d, channelCount = %d, deviceID = %d", mStream->getAudioApi(),
                  mStream->getChannelCount(), mStream->getDeviceId());
+            LOGI("Output path: %s", mStream->getFormat() == oboe::AudioFormat::I16
+                                            ? "I16, rendered as float and dithered in the callback"
+                                            : "float");
 
             result = mStream->requestStart();
             if (result != oboe::Result::OK) {
@@ -131,6 +443,9 @@ oboe::Result OboeEngine::start() {
             } else {
                 mIsLatencyDetectionSupported =
                         (mStream->getTimestamp((CLOCK_MONOTONIC)) != oboe::Result::ErrorUnimplemented);
+                if (mIsCapturing) {
+                    openCaptureStream();  // playback goes on without it
+                }
             }
         } else {
             LOGE("Error creating playback stream. Error: %s", oboe::convertToText(result));
@@ -143,6 +458,8 @@ oboe::Result OboeEngine::stop() {
     oboe::Result result = oboe::Result::OK;
     // Stop, close and delete in case not already closed.
     std::lock_guard<std::mutex> lock(mLock);
+    mIsRunning = false;
+    closeCaptureStream();
     if (mStream) {
         result = mStream->stop();
         mStream->close();
@@ -1,36 +1,168 @@
 #pragma once
 #include <oboe/Oboe.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "AudioGraph.h"
+#include "AudioNodes.h"
+#include "CaptureCallback.h"
+#include "ClipCache.h"
+#include "ClipSequencer.h"
 #include "SoundGenerator.h"
+#include "SpectrumAnalyzer.h"
+#include "VoiceMixer.h"
 #include "Mp3SoundGenerator.h"
+#include "StreamingSoundGenerator.h"
 #include "LatencyTuningCallback.h"
 #include "IRestartable.h"
 #include "DefaultErrorCallback.h"
 
 constexpr int32_t kBufferSizeAutomatic = 0;
 
+/**
+ * Sample format asked of the device. The sources always render float; for I16 the data callback
+ * converts with TPDF dither itself, @see DefaultDataCallback::setOutputFormat, instead of leaving
+ * an undithered conversion stage to Oboe or the framework.
+ */
+enum class OutputMode { Float, I16, Auto };
+
 class OboeEngine : public IRestartable {
   public:
     OboeEngine();
 
-    virtual ~OboeEngine() = default;
+    virtual ~OboeEngine();
 
+    /**
+     * Switch the synthetic tone on or off at the start of the next callback.
+     */
     void tap(bool isDown);
-    void playMp3(uint8_t* data, int size) {
+
+    /**
+     * Switch the synthetic tone on or off at the frame heard at a CLOCK_MONOTONIC time.
+     */
+    void tapAt(bool isDown, int64_t presentationNanos);
+
+    /**
+     * Stream an MP3 held in memory, decoding it while it plays. Clips keep playing over it. Like
+     * playStream and queueClip it waits for a stream reopen in progress, which reads the sources.
+     * @param index - the clip's Mp3FrameIndex if there is one. It gives the clip's length without walking
+     * it and makes seeks O(log n), @see Mp3SoundGenerator::seekTo
+     */
+    void playMp3(uint8_t* data, int size, const std::shared_ptr<const Mp3FrameIndex>& index = nullptr) {
+        // The control thread reads the sources when it reopens the stream.
+        std::lock_guard<std::mutex> lock(mLock);
          mMp3Data = data;
          mMp3Size = size;
 
         if (mMp3AudioSource == nullptr) {
-            auto result = Mp3SoundGenerator::createFromBuf((char*)mMp3Data, mMp3Size);
+            const DeviceFormat format = mDeviceFormat.load();
+            auto result = Mp3SoundGenerator::createFromBuf((char*)mMp3Data, mMp3Size, format.channelCount, index);
             if (result.error() == oboe::Result::OK) {
                mMp3AudioSource = result.value();
+               mMp3AudioSource->setSampleRate(format.sampleRate);
+               mMp3AudioSource->startStreaming();
+               mVoiceMixer->setStreamSource(mMp3AudioSource.get());
             } else {
                 LOGE("Failed to create Mp3SoundGenerator: %s", oboe::convertToText(result.error()));
             }
         } else {
-           mMp3AudioSource->resetData((char*)mMp3Data, mMp3Size);
+           mMp3AudioSource->resetData((char*)mMp3Data, mMp3Size, index);
+           mVoiceMixer->setStreamSource(mMp3AudioSource.get());
+        }
+
+    }
+
+    /**
+     * Stream an MP3, WAV or FLAC clip held in memory, decoding it while it plays. Clips keep playing
+     * over it. The data is not copied and has to stay valid while the engine lives.
+     * @param mp3Index - seek points of an MP3 clip, @see StreamingSoundGenerator::seekTo
+     */
+    void playStream(const void* data, size_t size, const std::shared_ptr<const Mp3FrameIndex>& mp3Index = nullptr) {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mStreamAudioSource == nullptr) {
+            const DeviceFormat format = mDeviceFormat.load();
+            auto result = StreamingSoundGenerator::createFromBuf(data, size, format.sampleRate, format.channelCount,
+                                                                 mp3Index);
+            if (result.error() == oboe::Result::OK) {
+                mStreamAudioSource = result.value();
+                mStreamAudioSource->start();
+                mVoiceMixer->setStreamSource(mStreamAudioSource.get());
+            } else {
+                LOGE("Failed to create StreamingSoundGenerator: %s", oboe::convertToText(result.error()));
+            }
+        } else {
+            mStreamAudioSource->resetData(data, size, mp3Index);
+            mVoiceMixer->setStreamSource(mStreamAudioSource.get());
         }
+    }
+
+    /**
+     * Queue an MP3, WAV or FLAC clip held in memory to play right after the ones queued before it,
+     * without a gap. The queue replaces the streamed source until playStream or playMp3 is called.
+     * Clips keep playing over it. The data is not copied and has to stay valid while the engine lives.
+     * @return an id for ClipSequencer::getPlayingClip, or 0 if the queue is full
+     */
+    uint32_t queueClip(const void* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mClipSequencer == nullptr) {
+            const DeviceFormat format = mDeviceFormat.load();
+            mClipSequencer = std::make_shared<ClipSequencer>(format.sampleRate, format.channelCount);
+            mClipSequencer->start();
+        }
+        mVoiceMixer->setStreamSource(mClipSequencer.get());
+        return mClipSequencer->enqueue(data, size);
+    }
+
+    /**
+     * Play a clip from the cache on a new voice, it starts in the next audio callback.
+     * @return the voice id, @see VoiceMixer::play
+     */
+    uint32_t playClip(const PcmClip* clip, float gain = 1.0f, float pan = 0.0f, int32_t priority = 0) {
+        return mVoiceMixer->play(clip, gain, pan, priority);
+    }
+
+    /**
+     * Play a clip from the cache so that its first frame is heard at a CLOCK_MONOTONIC time, to the
+     * frame, wherever the callbacks fall. A time too close to be met plays in the next callback.
+     * @param presentationNanos - e.g. now plus getTriggerLeadNanos()
+     */
+    uint32_t playClipAt(const PcmClip* clip, int64_t presentationNanos, float gain = 1.0f, float pan = 0.0f,
+                        int32_t priority = 0) {
+        return mVoiceMixer->play(clip, gain, pan, priority, getFramePositionAt(presentationNanos));
+    }
+
+    void stopClip(uint32_t voiceId) { mVoiceMixer->stop(voiceId); }
+
+    /**
+     * Linear gain of everything played, ramped so it never clicks. The output is limited after it.
+     */
+    void setMasterGain(float gain) { mMasterGain->setGain(gain); }
+
+    /**
+     * How far ahead a sound has to be scheduled to be heard on time. Scheduling every trigger this far
+     * ahead gives it a fixed latency, instead of one which jitters by up to a burst with the phase of
+     * the callback. It only grows while a stream runs, e.g. when the LatencyTuner grows the buffer.
+     */
+    int64_t getTriggerLeadNanos();
 
+    /**
+     * The frame of the mixer's timeline (@see VoiceMixer::getFramePosition) heard at a CLOCK_MONOTONIC
+     * time. Extrapolated from the latest stream timestamp, or from the buffer size without timestamps.
+     */
+    int64_t getFramePositionAt(int64_t presentationNanos);
+
+    /**
+     * Clips are decoded to the format of the current stream. Only for the thread which triggers clips,
+     * as the cache is not thread-safe: a reopen on the control thread just publishes the new format,
+     * which is applied to the cache here, on that thread.
+     */
+    ClipCache& getClipCache() {
+        const DeviceFormat format = mDeviceFormat.load();
+        mClipCache.setFormat(format.sampleRate, format.channelCount);
+        return mClipCache;
     }
 
     /**
@@ -49,7 +181,11 @@ class OboeEngine : public IRestartable {
     oboe::Result stop();
 
 
-    // From IRestartable
+    /**
+     * From IRestartable. Hands the reopen to the control thread and returns at once, so the error
+     * callback thread is not held up. The sources, the clip cache and the mixer survive the reopen,
+     * only what depends on the sample rate is updated.
+     */
     void restart() override;
 
     void setBufferSizeInBursts(int32_t numBursts);
@@ -73,24 +209,127 @@ class OboeEngine : public IRestartable {
 
     bool isLatencyDetectionSupported();
 
+    /**
+     * Callback timing, xrun and buffer size statistics plus the current output latency. Safe to call
+     * from any thread, it never blocks the audio callback.
+     */
+    CallbackStats::Snapshot getCallbackStats() {
+        CallbackStats::Snapshot stats = mLatencyCallback->getStats().snapshot();
+        stats.outputLatencyMillis = getCurrentOutputLatencyMillis();
+        std::lock_guard<std::mutex> lock(mLock);
+        stats.restarts = mRestarts;
+        stats.lastRestartMillis = mLastRestartMillis;
+        stats.maxRestartMillis = mMaxRestartMillis;
+        return stats;
+    }
+
+    void resetCallbackStats() { mLatencyCallback->getStats().reset(); }
+
+    /**
+     * Level of the output, updated every callback. It outlives every stream the engine opens.
+     */
+    const EnvelopeFollower& getEnvelope() const { return mVoiceMixer->getEnvelope(); }
+
+    /**
+     * Run the analyzer at the end of the master graph, or stop its worker thread. It is off by default.
+     */
+    void setSpectrumEnabled(bool enabled);
+
+    /**
+     * Band energies of the output, published while the analyzer runs. It outlives every stream the
+     * engine opens.
+     */
+    const SpectrumAnalyzer& getSpectrumAnalyzer() const { return *mSpectrumAnalyzer; }
+
     bool isAAudioRecommended();
 
+    /**
+     * Sample format of the streams opened from now on. Auto, the default, opens I16 where that is the
+     * device's fast path.
+     */
+    void setOutputMode(OutputMode mode) { mOutputMode.store(mode); }
+
+    /**
+     * Sample format of the running stream, AudioFormat::Unspecified if there is none.
+     */
+    oboe::AudioFormat getOutputFormat();
+
+    /**
+     * Open a low-latency mono input stream next to the playback stream, at its sample rate, and keep
+     * it open across restarts until stopCapture(). Read the captured audio from getCapture().
+     */
+    oboe::Result startCapture();
+
+    void stopCapture();
+
+    /**
+     * The captured audio and its voice activity. It outlives every capture stream, so a consumer
+     * thread can hold on to it.
+     */
+    const std::shared_ptr<CaptureCallback>& getCapture() const { return mCaptureCallback; }
+
   private:
+    // How long the control thread waits for the first callback of a reopened stream.
+    static constexpr int32_t kFirstCallbackPollMillis = 1;
+    static constexpr int32_t kFirstCallbackTimeoutMillis = 1000;
+    // Between the tries to reopen a stream which failed to open or start, from the second retry on.
+    static constexpr int32_t kReopenRetryMillis = 10;
+
     oboe::Result reopenStream();
     oboe::Result openPlaybackStream();
+    oboe::Result openCaptureStream();
+    void         closeCaptureStream();
+    oboe::Result openAndStartStream();
+    oboe::AudioFormat chooseOutputFormat();
+    void         controlLoop();
+    void         restartAfterDisconnect();
+    bool         getPresentationAnchor(int64_t& frame, int64_t& nanos);
+
+    std::shared_ptr<oboe::AudioStream>       mStream = nullptr;
+    std::shared_ptr<LatencyTuningCallback>   mLatencyCallback = nullptr;
+    std::shared_ptr<DefaultErrorCallback>    mErrorCallback = nullptr;
+    std::shared_ptr<SoundGenerator>          mAudioSource = nullptr;
+    std::shared_ptr<Mp3SoundGenerator>       mMp3AudioSource = nullptr;
+    std::shared_ptr<StreamingSoundGenerator> mStreamAudioSource = nullptr;
+    std::shared_ptr<ClipSequencer>           mClipSequencer = nullptr;
+    ClipCache                                mClipCache;  // app thread only, @see getClipCache
+    std::shared_ptr<VoiceMixer>              mVoiceMixer = nullptr;
+    std::shared_ptr<GainRampNode>            mMasterGain = nullptr;
+    std::shared_ptr<SpectrumAnalyzer>        mSpectrumAnalyzer = nullptr;
+    std::shared_ptr<AudioGraph>              mMasterGraph = nullptr;  // mixer, gain, limiter, analyzer
+    std::shared_ptr<oboe::AudioStream>       mCaptureStream = nullptr;
+    std::shared_ptr<CaptureCallback>         mCaptureCallback = nullptr;
+    bool                                     mIsLatencyDetectionSupported = false;
+    int64_t                                  mTriggerLeadNanos = 0;
 
-    std::shared_ptr<oboe::AudioStream>     mStream = nullptr;
-    std::shared_ptr<LatencyTuningCallback> mLatencyCallback = nullptr;
-    std::shared_ptr<DefaultErrorCallback>  mErrorCallback = nullptr;
-    std::shared_ptr<SoundGenerator>        mAudioSource = nullptr;
-    std::shared_ptr<Mp3SoundGenerator>     mMp3AudioSource = nullptr;
-    bool                                   mIsLatencyDetectionSupported = false;
+    // Format of the current stream, written on the control thread and read by the app thread.
+    struct DeviceFormat {
+        int32_t sampleRate;
+        int32_t channelCount;
+    };
+    std::atomic<DeviceFormat> mDeviceFormat;
 
     uint8_t* mMp3Data = nullptr;
     int      mMp3Size = 0;
 
+    // Set on the app thread, read by the control thread when it reopens the stream.
+    std::atomic<OutputMode> mOutputMode { OutputMode::Auto };
+
     int32_t        mDeviceId = oboe::Unspecified;
     int32_t        mChannelCount = oboe::Unspecified;
     oboe::AudioApi mAudioApi = oboe::AudioApi::Unspecified;
     std::mutex     mLock;
+    bool           mIsRunning = false;  // between start() and stop(), guarded by mLock
+    bool           mIsCapturing = false;  // between startCapture() and stopCapture(), guarded by mLock
+
+    // Disconnect to first callback of the new stream, guarded by mLock.
+    uint32_t mRestarts = 0;
+    double   mLastRestartMillis = -1.0;
+    double   mMaxRestartMillis = -1.0;
+
+    std::thread             mControlThread;
+    std::mutex              mControlLock;
+    std::condition_variable mControlCondition;
+    bool                    mRestartRequested = false;  // guarded by mControlLock
+    bool                    mControlThreadExit = false;  // guarded by mControlLock
 };
@@ -2,9 +2,12 @@
 
 #include <cstdint>
 #include <atomic>
+#include <cstring>
 #include <math.h>
 #include <memory>
+#include <algorithm>
 #include "IRenderableAudio.h"
+#include "Simd.h"
 
 constexpr double kDefaultFrequency = 440.0;
 constexpr int32_t kDefaultSampleRate = 48000;
@@ -37,26 +40,58 @@ public:
 
     // From IRenderableAudio
     void renderAudio(float *audioData, int32_t numFrames) override {
+        renderAudio(audioData, numFrames, 1);
+    };
 
-        if (mIsWaveOn){
+    /**
+     * Render into every stride-th sample, e.g. one channel of an interleaved buffer.
+     *
+     * The parameters are read once per call and four frames are computed at a time.
+     */
+    void renderAudio(float *audioData, int32_t numFrames, int32_t stride) {
+        if (!mIsWaveOn.load(std::memory_order_relaxed)) {
             for (int i = 0; i < numFrames; ++i) {
+                audioData[i * stride] = 0.0f;
+            }
+            return;
+        }
 
-                // Sine wave (sinf)
-                //audioData[i] = sinf(mPhase) * mAmplitude;
-
-                // Square wave
-                if (mPhase <= kPi){
-                    audioData[i] = -mAmplitude;
-                } else {
-                    audioData[i] = mAmplitude;
+        const float amplitude = mAmplitude.load(std::memory_order_relaxed);
+        const float increment = static_cast<float>(mPhaseIncrement.load(std::memory_order_relaxed));
+        const simd::float4 high = simd::set1(amplitude);
+        const simd::float4 low = simd::set1(-amplitude);
+        const simd::float4 pi = simd::set1(static_cast<float>(kPi));
+        const simd::float4 twoPi = simd::set1(static_cast<float>(kTwoPi));
+        const simd::float4 step = simd::set1(4.0f * increment);
+
+        // Lane i holds the phase of frame i of the group of four.
+        simd::float4 phase = simd::set4(mPhase, mPhase + increment, mPhase + 2.0f * increment,
+                                        mPhase + 3.0f * increment);
+        phase = wrap(phase, twoPi);
+        for (int i = 0; i < numFrames; i += 4) {
+            // Square wave
+            const simd::float4 out = simd::select(simd::greater(phase, pi), high, low);
+            const int count = std::min(4, numFrames - i);
+            if (stride == 1 && count == 4) {
+                simd::store(audioData + i, out);
+            } else {
+                float values[4];
+                simd::store(values, out);
+                for (int j = 0; j < count; ++j) {
+                    audioData[(i + j) * stride] = values[j];
                 }
-
-                mPhase += mPhaseIncrement;
-                if (mPhase > kTwoPi) mPhase -= kTwoPi;
             }
-        } else {
-            memset(audioData, 0, sizeof(float) * numFrames);
+            if (count < 4) {
+                float phases[4];
+                simd::store(phases, phase);
+                mPhase = phases[count];
+                return;
+            }
+            phase = wrap(simd::add(phase, step), twoPi);
         }
+        float phases[4];
+        simd::store(phases, phase);
+        mPhase = phases[0];
     };
 
 private:
@@ -67,6 +102,12 @@ private:
     double mFrequency = kDefaultFrequency;
     int32_t mSampleRate = kDefaultSampleRate;
 
+    // Bring phases back into [0, 2pi), a step is at most four increments of up to pi each.
+    static simd::float4 wrap(simd::float4 phase, simd::float4 twoPi) {
+        phase = simd::select(simd::greaterEqual(phase, twoPi), simd::sub(phase, twoPi), phase);
+        return simd::select(simd::greaterEqual(phase, twoPi), simd::sub(phase, twoPi), phase);
+    }
+
     void updatePhaseIncrement(){
         mPhaseIncrement.store((kTwoPi * mFrequency) / static_cast<double>(mSampleRate));
     };
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A fully decoded clip, already in the stream's sample rate and channel layout, so playing it is a
+ * plain copy. A clip cached as IMA-ADPCM (@see ClipCache::setStorage) holds its samples in adpcm
+ * instead, in groups which the player decodes as it goes, @see ima_adpcm. A clip of a PcmPack owns no
+ * samples: they are read in place from the mapped pack, as float or int16.
+ *
+ * The audio thread only reads the samples through a raw pointer. While a player holds the clip it
+ * keeps activeVoices above zero, which stops ClipCache from freeing it.
+ */
+struct PcmClip {
+    std::string          name;
+    std::vector<float>   samples;  // interleaved, empty if compressed or mapped
+    std::vector<uint8_t> adpcm;    // ima_adpcm groups
+    const float*         mappedFloat = nullptr;  // interleaved samples in a mapped pack, not owned
+    const int16_t*       mappedI16 = nullptr;
+    int32_t              frames = 0;
+    int32_t              sampleRate = 0;
+    int32_t              channelCount = 0;
+
+    mutable std::atomic<int32_t> activeVoices { 0 };
+
+    size_t sizeInBytes() const {
+        return sizeof(PcmClip) + name.capacity() + samples.capacity() * sizeof(float) + adpcm.capacity();
+    }
+
+    bool isCompressed() const { return !adpcm.empty(); }
+
+    // The interleaved float samples, owned or mapped. Not for compressed or int16 clips.
+    const float* floatSamples() const { return mappedFloat != nullptr ? mappedFloat : samples.data(); }
+
+    // Called by whoever hands the clip to the audio thread, before it is handed over.
+    void retain() const { activeVoices.fetch_add(1, std::memory_order_relaxed); }
+
+    // Called by the audio thread once it no longer reads the samples.
+    void release() const { activeVoices.fetch_sub(1, std::memory_order_release); }
+
+    bool isPlaying() const { return activeVoices.load(std::memory_order_acquire) > 0; }
+};
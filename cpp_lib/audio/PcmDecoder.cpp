@@ -0,0 +1,189 @@
+#include "PcmDecoder.h"
+
+#include <cstring>
+
+#include "dr_flac.h"
+#include "dr_mp3.h"
+#include "dr_wav.h"
+#include "ndk_utils/log.h"
+
+namespace {
+    class Mp3Decoder : public PcmDecoder {
+      public:
+        ~Mp3Decoder() override {
+            if (mOpen) {
+                drmp3_uninit(&mMp3);
+            }
+        }
+
+        // A memory decoder keeps a pointer to itself, so it is initialized in place.
+        bool open(const void* data, size_t size) {
+            mOpen = drmp3_init_memory(&mMp3, data, size, nullptr);
+            mData = data;
+            mSize = size;
+            mSampleRate = static_cast<int32_t>(mMp3.sampleRate);
+            mChannelCount = static_cast<int32_t>(mMp3.channels);
+            return mOpen;
+        }
+
+        Format getFormat() const override { return Format::Mp3; }
+
+        uint64_t read(float* output, uint64_t frames) override {
+            return drmp3_read_pcm_frames_f32(&mMp3, frames, output);
+        }
+
+        bool rewind() override { return drmp3_seek_to_pcm_frame(&mMp3, 0); }
+
+        bool seek(uint64_t frame) override {
+            // dr_mp3 counts its frames from before the encoder delay, read() from after it.
+            const uint64_t               pcmFrame = frame + mMp3.delayInPCMFrames;
+            const Mp3FrameIndex::Point* point = mIndex ? mIndex->findPoint(pcmFrame) : nullptr;
+            if (point == nullptr) {
+                // Reading in the decoder's native format is the one which takes no output buffer.
+                return drmp3_seek_to_pcm_frame(&mMp3, 0) && drmp3_read_pcm_frames_s16(&mMp3, frame, nullptr) == frame;
+            }
+            // dr_mp3 searches its seek table linearly, so it is only handed the point already found.
+            drmp3_seek_point seekPoint {point->byteOffset, point->pcmFrame, point->mp3FramesToDiscard,
+                                        point->pcmFramesToDiscard};
+            drmp3_bind_seek_table(&mMp3, 1, &seekPoint);
+            const bool ok = drmp3_seek_to_pcm_frame(&mMp3, pcmFrame);
+            drmp3_bind_seek_table(&mMp3, 0, nullptr);
+            return ok;
+        }
+
+        void setIndex(std::shared_ptr<const Mp3FrameIndex> index) {
+            if (index && !index->matches(mData, mSize)) {
+                LOGW("MP3 index does not match the clip, ignored");
+                index.reset();
+            }
+            mIndex = std::move(index);
+        }
+
+        // dr_mp3 parses the LAME tag in the Xing/Info frame and skips both when reading.
+        uint32_t getEncoderDelayFrames() const override { return mMp3.delayInPCMFrames; }
+
+        uint32_t getEncoderPaddingFrames() const override { return mMp3.paddingInPCMFrames; }
+
+      private:
+        drmp3                                mMp3 {};
+        bool                                 mOpen = false;
+        const void*                          mData = nullptr;
+        size_t                               mSize = 0;
+        std::shared_ptr<const Mp3FrameIndex> mIndex;
+    };
+
+    class WavDecoder : public PcmDecoder {
+      public:
+        ~WavDecoder() override {
+            if (mOpen) {
+                drwav_uninit(&mWav);
+            }
+        }
+
+        bool open(const void* data, size_t size) {
+            mOpen = drwav_init_memory(&mWav, data, size, nullptr);
+            mSampleRate = static_cast<int32_t>(mWav.sampleRate);
+            mChannelCount = static_cast<int32_t>(mWav.channels);
+            return mOpen;
+        }
+
+        Format getFormat() const override { return Format::Wav; }
+
+        uint64_t read(float* output, uint64_t frames) override {
+            return drwav_read_pcm_frames_f32(&mWav, frames, output);
+        }
+
+        bool rewind() override { return drwav_seek_to_pcm_frame(&mWav, 0); }
+
+        bool seek(uint64_t frame) override { return drwav_seek_to_pcm_frame(&mWav, frame); }
+
+      private:
+        drwav mWav {};
+        bool  mOpen = false;
+    };
+
+    class FlacDecoder : public PcmDecoder {
+      public:
+        ~FlacDecoder() override { drflac_close(mFlac); }
+
+        bool open(const void* data, size_t size) {
+            mFlac = drflac_open_memory(data, size, nullptr);
+            if (mFlac == nullptr) {
+                return false;
+            }
+            mSampleRate = static_cast<int32_t>(mFlac->sampleRate);
+            mChannelCount = static_cast<int32_t>(mFlac->channels);
+            return true;
+        }
+
+        Format getFormat() const override { return Format::Flac; }
+
+        uint64_t read(float* output, uint64_t frames) override {
+            return drflac_read_pcm_frames_f32(mFlac, frames, output);
+        }
+
+        bool rewind() override { return drflac_seek_to_pcm_frame(mFlac, 0); }
+
+        bool seek(uint64_t frame) override { return drflac_seek_to_pcm_frame(mFlac, frame); }
+
+      private:
+        drflac* mFlac = nullptr;
+    };
+
+    template <typename Decoder>
+    std::unique_ptr<PcmDecoder> openDecoder(const void* data, size_t size) {
+        auto decoder = std::make_unique<Decoder>();
+        if (!decoder->open(data, size) || decoder->getChannelCount() <= 0 || decoder->getSampleRate() <= 0) {
+            return nullptr;
+        }
+        return decoder;
+    }
+}  // namespace
+
+PcmDecoder::Format PcmDecoder::detectFormat(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    if (size >= 12 && (memcmp(bytes, "RIFF", 4) == 0 || memcmp(bytes, "RF64", 4) == 0)
+        && memcmp(bytes + 8, "WAVE", 4) == 0) {
+        return Format::Wav;
+    }
+    if (size >= 4 && memcmp(bytes, "fLaC", 4) == 0) {
+        return Format::Flac;
+    }
+    if (size >= 3 && memcmp(bytes, "ID3", 3) == 0) {
+        return Format::Mp3;
+    }
+    if (size >= 2 && bytes[0] == 0xff && (bytes[1] & 0xe0) == 0xe0) {
+        return Format::Mp3;
+    }
+    return Format::Unknown;
+}
+
+const char* PcmDecoder::formatToText(Format format) {
+    switch (format) {
+        case Format::Mp3: return "MP3";
+        case Format::Wav: return "WAV";
+        case Format::Flac: return "FLAC";
+        default: return "unknown";
+    }
+}
+
+std::unique_ptr<PcmDecoder> PcmDecoder::open(const void* data, size_t size,
+                                             std::shared_ptr<const Mp3FrameIndex> mp3Index) {
+    const Format format = detectFormat(data, size);
+    std::unique_ptr<PcmDecoder> decoder;
+    switch (format) {
+        case Format::Mp3:
+            decoder = openDecoder<Mp3Decoder>(data, size);
+            if (decoder && mp3Index) {
+                static_cast<Mp3Decoder*>(decoder.get())->setIndex(std::move(mp3Index));
+            }
+            break;
+        case Format::Wav: decoder = openDecoder<WavDecoder>(data, size); break;
+        case Format::Flac: decoder = openDecoder<FlacDecoder>(data, size); break;
+        default: LOGE("Unknown audio format"); return nullptr;
+    }
+    if (!decoder) {
+        LOGE("Failed to open %s", formatToText(format));
+    }
+    return decoder;
+}
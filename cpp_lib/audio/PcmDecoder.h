@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Mp3FrameIndex.h"
+
+/**
+ * Decodes an MP3, WAV or FLAC clip to interleaved float frames, reading the encoded bytes in place.
+ *
+ * The data is typically an AAsset_getBuffer or mmap view. It is never copied, so it has to stay
+ * mapped for as long as the decoder lives. Opening a decoder may allocate, reading from one does
+ * not.
+ */
+class PcmDecoder {
+  public:
+    enum class Format { Unknown, Mp3, Wav, Flac };
+
+    /**
+     * Guess the format from the first bytes: "RIFF"/"RF64" is WAV, "fLaC" is FLAC, an ID3 tag or an
+     * MPEG frame sync is MP3.
+     */
+    static Format detectFormat(const void* data, size_t size);
+
+    static const char* formatToText(Format format);
+
+    /**
+     * Open a decoder for whichever format the data is in.
+     * @param mp3Index - seek points of an MP3, @see seek. Ignored unless it was built from this data.
+     * @return the decoder, or nullptr if the format is unknown or the header cannot be parsed
+     */
+    static std::unique_ptr<PcmDecoder> open(const void* data, size_t size,
+                                            std::shared_ptr<const Mp3FrameIndex> mp3Index = nullptr);
+
+    virtual ~PcmDecoder() = default;
+
+    virtual Format getFormat() const = 0;
+
+    /**
+     * Decode up to frames frames into output, which has room for frames * getChannelCount() samples.
+     * @return the number of frames decoded, 0 at the end of the clip
+     */
+    virtual uint64_t read(float* output, uint64_t frames) = 0;
+
+    /**
+     * Go back to the first frame.
+     */
+    virtual bool rewind() = 0;
+
+    /**
+     * Go to a frame, counted as read() returns them. WAV seeks directly and FLAC with its seek table
+     * or a bisection of the stream. An MP3 is decoded from the nearest point of its Mp3FrameIndex, or
+     * from the start without one.
+     */
+    virtual bool seek(uint64_t frame) = 0;
+
+    /**
+     * Frames of encoder delay at the start and padding at the end which read() leaves out. Only MP3
+     * has them, from the LAME/Xing header; without one they are 0 and nothing is trimmed.
+     */
+    virtual uint32_t getEncoderDelayFrames() const { return 0; }
+
+    virtual uint32_t getEncoderPaddingFrames() const { return 0; }
+
+    int32_t getSampleRate() const { return mSampleRate; }
+
+    int32_t getChannelCount() const { return mChannelCount; }
+
+  protected:
+    int32_t mSampleRate = 0;
+    int32_t mChannelCount = 0;
+};
@@ -0,0 +1,211 @@
+#include "PcmPack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "ndk_utils/log.h"
+#include "TpdfDither.h"
+
+// Samples are written and mapped as they are in memory.
+static_assert(std::endian::native == std::endian::little);
+
+namespace {
+    constexpr uint8_t  kMagic[4] = {'P', 'C', 'M', 'P'};
+    constexpr uint32_t kVersion = 1;
+    constexpr size_t   kHeaderBytes = 4 + 4 + 4 + 4 + 4 + 4;
+    constexpr size_t   kEntryBytes = 2 + 8 + 4;  // and the name
+
+    void put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    uint64_t get(const uint8_t*& in, int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        in += bytes;
+        return value;
+    }
+
+    size_t sampleBytes(PcmPack::SampleFormat format) {
+        return format == PcmPack::SampleFormat::I16 ? sizeof(int16_t) : sizeof(float);
+    }
+
+    size_t pageAlign(size_t offset) {
+        return (offset + PcmPack::kPageSize - 1) / PcmPack::kPageSize * PcmPack::kPageSize;
+    }
+}  // namespace
+
+std::vector<uint8_t> PcmPack::build(const std::vector<const PcmClip*>& clips, SampleFormat format) {
+    if (clips.empty()) {
+        return {};
+    }
+    const int32_t sampleRate = clips.front()->sampleRate;
+    const int32_t channelCount = clips.front()->channelCount;
+    for (const PcmClip* clip : clips) {
+        if (clip->sampleRate != sampleRate || clip->channelCount != channelCount || clip->isCompressed()
+            || clip->mappedI16 != nullptr) {
+            LOGE("Clip %s cannot go in the pack", clip->name.c_str());
+            return {};
+        }
+    }
+
+    // The index, with the offsets the samples will have.
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    put(out, kVersion, 4);
+    put(out, static_cast<uint32_t>(sampleRate), 4);
+    put(out, static_cast<uint32_t>(channelCount), 4);
+    put(out, static_cast<uint32_t>(format), 4);
+    put(out, clips.size(), 4);
+    size_t indexBytes = kHeaderBytes;
+    for (const PcmClip* clip : clips) {
+        indexBytes += kEntryBytes + clip->name.size();
+    }
+    size_t offset = pageAlign(indexBytes);
+    for (const PcmClip* clip : clips) {
+        put(out, clip->name.size(), 2);
+        out.insert(out.end(), clip->name.begin(), clip->name.end());
+        put(out, offset, 8);
+        put(out, static_cast<uint32_t>(clip->frames), 4);
+        offset = pageAlign(offset + static_cast<size_t>(clip->frames) * channelCount * sampleBytes(format));
+    }
+
+    TpdfDither dither;
+    for (const PcmClip* clip : clips) {
+        const size_t count = static_cast<size_t>(clip->frames) * channelCount;
+        const size_t start = pageAlign(out.size());
+        out.resize(start + count * sampleBytes(format));
+        uint8_t* const samples = out.data() + start;
+        if (format == SampleFormat::I16) {
+            dither.process(clip->floatSamples(), reinterpret_cast<int16_t*>(samples), count);
+        } else {
+            std::memcpy(samples, clip->floatSamples(), count * sizeof(float));
+        }
+    }
+    return out;
+}
+
+std::unique_ptr<PcmPack> PcmPack::open(const void* data, size_t size) {
+    const auto* in = static_cast<const uint8_t*>(data);
+    if (size < kHeaderBytes || !std::equal(kMagic, kMagic + 4, in)) {
+        return nullptr;
+    }
+    if (reinterpret_cast<uintptr_t>(data) % alignof(float) != 0) {
+        LOGE("PCM pack mapped at a misaligned address");
+        return nullptr;
+    }
+    in += 4;
+    if (get(in, 4) != kVersion) {
+        return nullptr;
+    }
+    std::unique_ptr<PcmPack> pack(new PcmPack());
+    pack->mData = static_cast<const uint8_t*>(data);
+    pack->mSize = size;
+    pack->mSampleRate = static_cast<int32_t>(get(in, 4));
+    pack->mChannelCount = static_cast<int32_t>(get(in, 4));
+    const uint64_t format = get(in, 4);
+    const uint64_t count = get(in, 4);
+    if (format != static_cast<uint32_t>(SampleFormat::I16) && format != static_cast<uint32_t>(SampleFormat::Float)) {
+        return nullptr;
+    }
+    // A clip's size is only bounds checked as frames * channels, which no channels would make 0.
+    if (pack->mSampleRate <= 0 || pack->mChannelCount <= 0) {
+        return nullptr;
+    }
+    pack->mFormat = static_cast<SampleFormat>(format);
+
+    const uint8_t* const end = pack->mData + size;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (end - in < static_cast<ptrdiff_t>(kEntryBytes)) {
+            return nullptr;
+        }
+        const uint64_t nameLength = get(in, 2);
+        if (end - in < static_cast<ptrdiff_t>(nameLength + kEntryBytes - 2)) {
+            return nullptr;
+        }
+        auto clip = std::make_unique<PcmClip>();
+        clip->name.assign(reinterpret_cast<const char*>(in), nameLength);
+        in += nameLength;
+        const uint64_t offset = get(in, 8);
+        clip->frames = static_cast<int32_t>(get(in, 4));
+        if (clip->frames < 0) {
+            return nullptr;
+        }
+        clip->sampleRate = pack->mSampleRate;
+        clip->channelCount = pack->mChannelCount;
+        const uint64_t bytes = static_cast<uint64_t>(clip->frames) * clip->channelCount
+                               * sampleBytes(pack->mFormat);
+        if (offset % kPageSize != 0 || offset > size || bytes > size - offset) {
+            return nullptr;
+        }
+        if (pack->mFormat == SampleFormat::I16) {
+            clip->mappedI16 = reinterpret_cast<const int16_t*>(pack->mData + offset);
+        } else {
+            clip->mappedFloat = reinterpret_cast<const float*>(pack->mData + offset);
+        }
+        pack->mClips[clip->name] = std::move(clip);
+    }
+    return pack;
+}
+
+std::unique_ptr<PcmPack> PcmPack::openFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Failed to open PCM pack %s", path.c_str());
+        return nullptr;
+    }
+    struct stat status {};
+    void*       mapping = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOGE("Failed to map PCM pack %s", path.c_str());
+        return nullptr;
+    }
+    std::unique_ptr<PcmPack> pack = open(mapping, static_cast<size_t>(status.st_size));
+    if (pack == nullptr) {
+        LOGE("%s is not a PCM pack", path.c_str());
+        munmap(mapping, static_cast<size_t>(status.st_size));
+        return nullptr;
+    }
+    pack->mMapping = mapping;
+    return pack;
+}
+
+PcmPack::~PcmPack() {
+    for (const auto& [name, clip] : mClips) {
+        if (clip->isPlaying()) {
+            LOGE("PCM pack closed while %s is playing", name.c_str());
+        }
+    }
+    if (mMapping != nullptr) {
+        munmap(mMapping, mSize);
+    }
+}
+
+const PcmClip* PcmPack::find(const std::string& name) const {
+    auto it = mClips.find(name);
+    return it == mClips.end() ? nullptr : it->second.get();
+}
+
+void PcmPack::prefetch() const {
+    // madvise takes a start aligned to the system's page, which may be larger than kPageSize, and the
+    // pack may be mapped inside a bigger file.
+    const auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const auto first = reinterpret_cast<uintptr_t>(mData) / pageSize * pageSize;
+    const auto last = reinterpret_cast<uintptr_t>(mData) + mSize;
+    if (madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED) != 0) {
+        LOGW("Cannot prefetch the PCM pack");
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PcmClip.h"
+
+/**
+ * Clips transcoded to raw PCM at APK build time, by host/pcm_pack.cpp, and played straight from the
+ * mapped file: opening a pack only reads its index, and a clip of it starts with no decoding and no
+ * copy, @see PcmClip::mappedFloat.
+ *
+ * The file is little endian: a header with the sample rate, channel count and sample format shared
+ * by all clips, then the name, offset and frame count of each clip. The interleaved int16 or float
+ * samples of every clip start on a kPageSize boundary of the file. scripts/build_pack.sh page-aligns
+ * the pack in the APK too, so once mapped a clip touches only its own pages.
+ *
+ * The format is fixed when the pack is built. A stream of another rate or channel count cannot play
+ * its clips, the player then decodes the source assets instead.
+ */
+class PcmPack {
+  public:
+    static constexpr size_t kPageSize = 4096;
+
+    enum class SampleFormat : uint32_t { I16 = 1, Float = 2 };
+
+    /**
+     * Lay clips of one format out as a pack. Float samples are converted to int16 with TPDF dither.
+     * @return the pack, or nothing if the clips differ in format or are compressed
+     */
+    static std::vector<uint8_t> build(const std::vector<const PcmClip*>& clips, SampleFormat format);
+
+    /**
+     * Read the index of a pack held in memory, which has to stay mapped while the pack is used.
+     * @return the pack, or nullptr if the bytes are not a pack of this version or are cut short
+     */
+    static std::unique_ptr<PcmPack> open(const void* data, size_t size);
+
+    /**
+     * Map a pack file read-only. The pack unmaps it when it is destroyed.
+     */
+    static std::unique_ptr<PcmPack> openFile(const std::string& path);
+
+    ~PcmPack();
+
+    /**
+     * A hash lookup, the samples are not touched. Keep the pack while the clip may be playing.
+     * @return the clip, or nullptr if the pack has none of that name
+     */
+    const PcmClip* find(const std::string& name) const;
+
+    /**
+     * Ask the kernel to read the samples in ahead of time, so the first trigger of a clip does not
+     * take page faults on the audio thread.
+     */
+    void prefetch() const;
+
+    int32_t getSampleRate() const { return mSampleRate; }
+
+    int32_t getChannelCount() const { return mChannelCount; }
+
+    SampleFormat getFormat() const { return mFormat; }
+
+    size_t getClipCount() const { return mClips.size(); }
+
+    size_t getSize() const { return mSize; }
+
+  private:
+    PcmPack() = default;
+
+    const uint8_t* mData = nullptr;
+    size_t         mSize = 0;
+    void*          mMapping = nullptr;  // set if the pack mapped the file itself
+    int32_t        mSampleRate = 0;
+    int32_t        mChannelCount = 0;
+    SampleFormat   mFormat = SampleFormat::I16;
+
+    std::unordered_map<std::string, std::unique_ptr<PcmClip>> mClips;
+};
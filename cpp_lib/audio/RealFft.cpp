@@ -0,0 +1,239 @@
+#include "RealFft.h"
+
+#include <cmath>
+#include <utility>
+
+#include "Simd.h"
+
+namespace {
+    // (ar + i ai)(br + i bi)
+    inline void complexMul(simd::float4 ar, simd::float4 ai, simd::float4 br, simd::float4 bi, simd::float4& outR,
+                           simd::float4& outI) {
+        outR = simd::sub(simd::mul(ar, br), simd::mul(ai, bi));
+        outI = simd::madd(simd::mul(ar, bi), ai, br);
+    }
+
+    /**
+     * A radix-4 butterfly of a forward transform: out0 = a + b + c + d, out1 = (a - c) - i (b - d),
+     * out2 = a - b + c - d and out3 = (a - c) + i (b - d), before the twiddles.
+     */
+    struct Butterfly4 {
+        simd::float4 r[4];
+        simd::float4 i[4];
+
+        Butterfly4(const simd::float4 (&ar)[4], const simd::float4 (&ai)[4]) {
+            const simd::float4 sumACr = simd::add(ar[0], ar[2]);
+            const simd::float4 sumACi = simd::add(ai[0], ai[2]);
+            const simd::float4 diffACr = simd::sub(ar[0], ar[2]);
+            const simd::float4 diffACi = simd::sub(ai[0], ai[2]);
+            const simd::float4 sumBDr = simd::add(ar[1], ar[3]);
+            const simd::float4 sumBDi = simd::add(ai[1], ai[3]);
+            // i (b - d)
+            const simd::float4 rotBDr = simd::sub(ai[3], ai[1]);
+            const simd::float4 rotBDi = simd::sub(ar[1], ar[3]);
+            r[0] = simd::add(sumACr, sumBDr);
+            i[0] = simd::add(sumACi, sumBDi);
+            r[1] = simd::sub(diffACr, rotBDr);
+            i[1] = simd::sub(diffACi, rotBDi);
+            r[2] = simd::sub(sumACr, sumBDr);
+            i[2] = simd::sub(sumACi, sumBDi);
+            r[3] = simd::add(diffACr, rotBDr);
+            i[3] = simd::add(diffACi, rotBDi);
+        }
+    };
+}  // namespace
+
+RealFft::RealFft(int32_t size) : mSize(size) {
+    const int32_t half = size / 2;
+    // Radix-4 stages while a transform can be split in four, the last split in two if one is left.
+    int32_t length = half;
+    int32_t stride = 1;
+    for (; length >= 4; length /= 4, stride *= 4) {
+        const int32_t quarter = length / 4;
+        mStages.push_back({length, stride, mTwiddles.size()});
+        mTwiddles.resize(mTwiddles.size() + 6 * quarter);
+        float* w = mTwiddles.data() + mStages.back().twiddles;
+        for (int32_t p = 0; p < quarter; ++p) {
+            for (int32_t k = 1; k <= 3; ++k) {
+                const double angle = -2.0 * M_PI * k * p / length;
+                w[(2 * k - 2) * quarter + p] = static_cast<float>(std::cos(angle));
+                w[(2 * k - 1) * quarter + p] = static_cast<float>(std::sin(angle));
+            }
+        }
+    }
+    mRadix2Last = length == 2;
+
+    mSplitTwiddles.resize(2 * (half + 1));
+    for (int32_t k = 0; k <= half; ++k) {
+        const double angle = -2.0 * M_PI * k / size;
+        mSplitTwiddles[k] = static_cast<float>(std::cos(angle));
+        mSplitTwiddles[half + 1 + k] = static_cast<float>(std::sin(angle));
+    }
+    mWork.resize(4 * static_cast<size_t>(half));
+    mRe.resize(half + 1);
+    mIm.resize(half + 1);
+}
+
+/**
+ * The first stage, stride 1: four butterflies side by side, each reading its inputs a quarter of the
+ * transform apart and writing its four outputs next to each other.
+ */
+void RealFft::radix4First(const Stage& stage, const float* xr, const float* xi, float* yr, float* yi) const {
+    const int32_t quarter = stage.length / 4;
+    const float*  w = mTwiddles.data() + stage.twiddles;
+    for (int32_t p = 0; p < quarter; p += 4) {
+        simd::float4 ar[4];
+        simd::float4 ai[4];
+        for (int32_t k = 0; k < 4; ++k) {
+            ar[k] = simd::load(xr + p + k * quarter);
+            ai[k] = simd::load(xi + p + k * quarter);
+        }
+        Butterfly4 out(ar, ai);
+        for (int32_t k = 1; k < 4; ++k) {
+            complexMul(out.r[k], out.i[k], simd::load(w + (2 * k - 2) * quarter + p),
+                       simd::load(w + (2 * k - 1) * quarter + p), out.r[k], out.i[k]);
+        }
+        // Rows of outputs to the outputs of each butterfly.
+        simd::transpose(out.r[0], out.r[1], out.r[2], out.r[3]);
+        simd::transpose(out.i[0], out.i[1], out.i[2], out.i[3]);
+        for (int32_t k = 0; k < 4; ++k) {
+            simd::store(yr + 4 * (p + k), out.r[k]);
+            simd::store(yi + 4 * (p + k), out.i[k]);
+        }
+    }
+}
+
+/**
+ * A later stage: the stride is a multiple of 4, so the lanes hold neighbouring transforms and share
+ * the twiddle factors.
+ */
+void RealFft::radix4(const Stage& stage, const float* xr, const float* xi, float* yr, float* yi) const {
+    const int32_t quarter = stage.length / 4;
+    const int32_t stride = stage.stride;
+    const float*  w = mTwiddles.data() + stage.twiddles;
+    for (int32_t p = 0; p < quarter; ++p) {
+        simd::float4 wr[4];
+        simd::float4 wi[4];
+        for (int32_t k = 1; k < 4; ++k) {
+            wr[k] = simd::set1(w[(2 * k - 2) * quarter + p]);
+            wi[k] = simd::set1(w[(2 * k - 1) * quarter + p]);
+        }
+        const size_t in = static_cast<size_t>(stride) * p;
+        const size_t out = static_cast<size_t>(stride) * 4 * p;
+        for (int32_t q = 0; q < stride; q += 4) {
+            simd::float4 ar[4];
+            simd::float4 ai[4];
+            for (int32_t k = 0; k < 4; ++k) {
+                ar[k] = simd::load(xr + in + static_cast<size_t>(stride) * k * quarter + q);
+                ai[k] = simd::load(xi + in + static_cast<size_t>(stride) * k * quarter + q);
+            }
+            Butterfly4 butterfly(ar, ai);
+            simd::store(yr + out + q, butterfly.r[0]);
+            simd::store(yi + out + q, butterfly.i[0]);
+            for (int32_t k = 1; k < 4; ++k) {
+                simd::float4 r;
+                simd::float4 i;
+                complexMul(butterfly.r[k], butterfly.i[k], wr[k], wi[k], r, i);
+                simd::store(yr + out + static_cast<size_t>(stride) * k + q, r);
+                simd::store(yi + out + static_cast<size_t>(stride) * k + q, i);
+            }
+        }
+    }
+}
+
+// Transforms of length 2, their only twiddle factor is 1.
+void RealFft::radix2Last(int32_t stride, const float* xr, const float* xi, float* yr, float* yi) const {
+    for (int32_t q = 0; q < stride; q += 4) {
+        const simd::float4 ar = simd::load(xr + q);
+        const simd::float4 ai = simd::load(xi + q);
+        const simd::float4 br = simd::load(xr + stride + q);
+        const simd::float4 bi = simd::load(xi + stride + q);
+        simd::store(yr + q, simd::add(ar, br));
+        simd::store(yi + q, simd::add(ai, bi));
+        simd::store(yr + stride + q, simd::sub(ar, br));
+        simd::store(yi + stride + q, simd::sub(ai, bi));
+    }
+}
+
+float* RealFft::transform() {
+    const size_t half = static_cast<size_t>(mSize) / 2;
+    float*       x = mWork.data();
+    float*       y = mWork.data() + 2 * half;
+    for (const Stage& stage : mStages) {
+        if (stage.stride == 1) {
+            radix4First(stage, x, x + half, y, y + half);
+        } else {
+            radix4(stage, x, x + half, y, y + half);
+        }
+        std::swap(x, y);
+    }
+    if (mRadix2Last) {
+        radix2Last(static_cast<int32_t>(half / 2), x, x + half, y, y + half);
+        std::swap(x, y);
+    }
+    return x;
+}
+
+void RealFft::forward(const float* input, float* re, float* im) {
+    const int32_t half = mSize / 2;
+    // Even samples as the real parts and odd ones as the imaginary parts.
+    for (int32_t n = 0; n < half; n += 4) {
+        simd::float4 even;
+        simd::float4 odd;
+        simd::loadDeinterleaved(input + 2 * n, even, odd);
+        simd::store(mWork.data() + n, even);
+        simd::store(mWork.data() + half + n, odd);
+    }
+    const float* zr = transform();
+    const float* zi = zr + half;
+
+    // X[k] = E[k] + e^(-2 pi i k / N) O[k], with the spectra of the even and odd samples
+    // E[k] = (Z[k] + conj Z[N/2 - k]) / 2 and O[k] = -i (Z[k] - conj Z[N/2 - k]) / 2.
+    const float*       wr = mSplitTwiddles.data();
+    const float*       wi = mSplitTwiddles.data() + half + 1;
+    const simd::float4 halfScale = simd::set1(0.5f);
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[half] = zr[0] - zi[0];
+    im[half] = 0.0f;
+    int32_t k = 1;
+    for (; k + 4 <= half; k += 4) {
+        const int32_t      m = half - k;
+        const simd::float4 ar = simd::load(zr + k);
+        const simd::float4 ai = simd::load(zi + k);
+        const simd::float4 br = simd::set4(zr[m], zr[m - 1], zr[m - 2], zr[m - 3]);
+        const simd::float4 bi = simd::set4(zi[m], zi[m - 1], zi[m - 2], zi[m - 3]);
+        const simd::float4 er = simd::mul(simd::add(ar, br), halfScale);
+        const simd::float4 ei = simd::mul(simd::sub(ai, bi), halfScale);
+        const simd::float4 orr = simd::mul(simd::add(ai, bi), halfScale);
+        const simd::float4 oi = simd::mul(simd::sub(br, ar), halfScale);
+        simd::float4       tr;
+        simd::float4       ti;
+        complexMul(simd::load(wr + k), simd::load(wi + k), orr, oi, tr, ti);
+        simd::store(re + k, simd::add(er, tr));
+        simd::store(im + k, simd::add(ei, ti));
+    }
+    for (; k < half; ++k) {
+        const int32_t m = half - k;
+        const float   er = 0.5f * (zr[k] + zr[m]);
+        const float   ei = 0.5f * (zi[k] - zi[m]);
+        const float   orr = 0.5f * (zi[k] + zi[m]);
+        const float   oi = 0.5f * (zr[m] - zr[k]);
+        re[k] = er + wr[k] * orr - wi[k] * oi;
+        im[k] = ei + wr[k] * oi + wi[k] * orr;
+    }
+}
+
+void RealFft::power(const float* input, float* power) {
+    forward(input, mRe.data(), mIm.data());
+    const int32_t bins = getBinCount();
+    int32_t       k = 0;
+    for (; k + 4 <= bins; k += 4) {
+        const simd::float4 r = simd::load(mRe.data() + k);
+        const simd::float4 i = simd::load(mIm.data() + k);
+        simd::store(power + k, simd::madd(simd::mul(r, r), i, i));
+    }
+    for (; k < bins; ++k) {
+        power[k] = mRe[k] * mRe[k] + mIm[k] * mIm[k];
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Forward FFT of real samples, for power-of-two sizes from kMinSize to kMaxSize.
+ *
+ * The size N real samples are taken as N / 2 complex ones, even samples real and odd imaginary, and
+ * transformed by a Stockham FFT: radix-4 stages, then one radix-2 stage if the log2 of N / 2 is odd.
+ * Stockham reorders as it goes, so there is no bit reversal pass, and it reads and writes whole
+ * vectors of the split real and imaginary arrays. The first stage runs four butterflies side by side
+ * and transposes their outputs, every later one runs four neighbouring transforms in the lanes with
+ * the twiddle factors broadcast. A last pass splits the half size transform into the N / 2 + 1 bins
+ * of the real input.
+ *
+ * The twiddle factors of every stage are computed once, in double precision, by the constructor.
+ * forward() and power() then do not allocate; an instance is for one thread at a time.
+ */
+class RealFft {
+  public:
+    static constexpr int32_t kMinSize = 64;
+    static constexpr int32_t kMaxSize = 16384;
+
+    static bool isSupported(int32_t size) { return size >= kMinSize && size <= kMaxSize && (size & (size - 1)) == 0; }
+
+    /**
+     * @param size - @see isSupported
+     */
+    explicit RealFft(int32_t size);
+
+    int32_t getSize() const { return mSize; }
+
+    int32_t getBinCount() const { return mSize / 2 + 1; }
+
+    /**
+     * Transform getSize() samples. Bin k, from 0 to getSize() / 2, is re[k] + i im[k], unscaled.
+     */
+    void forward(const float* input, float* re, float* im);
+
+    /**
+     * The squared magnitude of each of the getBinCount() bins.
+     */
+    void power(const float* input, float* power);
+
+  private:
+    struct Stage {
+        int32_t length;    // of the transforms the stage splits
+        int32_t stride;    // number of transforms run side by side
+        size_t  twiddles;  // offset in mTwiddles of the w1, w2 and w3 arrays, real then imaginary
+    };
+
+    // Run the stages over the complex samples in mWork, return the buffer holding the result.
+    float* transform();
+    void   radix4First(const Stage& stage, const float* xr, const float* xi, float* yr, float* yi) const;
+    void   radix4(const Stage& stage, const float* xr, const float* xi, float* yr, float* yi) const;
+    void   radix2Last(int32_t stride, const float* xr, const float* xi, float* yr, float* yi) const;
+
+    int32_t            mSize;
+    std::vector<Stage> mStages;
+    bool               mRadix2Last = false;
+    std::vector<float> mTwiddles;
+    std::vector<float> mSplitTwiddles;  // e^(-2 pi i k / N) for k from 0 to N / 2, real then imaginary
+    std::vector<float> mWork;           // two complex buffers of N / 2, real then imaginary
+    std::vector<float> mRe;
+    std::vector<float> mIm;
+};
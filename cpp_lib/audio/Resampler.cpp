@@ -0,0 +1,239 @@
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "Simd.h"
+
+namespace {
+    // Scale the cutoff below Nyquist to leave room for the transition band.
+    constexpr double kCutoffScale = 0.9;
+    constexpr double kKaiserBeta = 8.0;
+
+    // Zeroth order modified Bessel function of the first kind, used by the Kaiser window.
+    double besselI0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        const double halfX = x / 2.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (halfX / k) * (halfX / k);
+            sum += term;
+            if (term < sum * 1e-12) {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    double sinc(double x) {
+        if (std::fabs(x) < 1e-9) {
+            return 1.0;
+        }
+        return std::sin(M_PI * x) / (M_PI * x);
+    }
+}  // namespace
+
+Resampler::Resampler(int32_t inputRate, int32_t outputRate, int32_t channelCount, int32_t taps)
+    : mInputRate(inputRate), mOutputRate(outputRate), mChannelCount(channelCount) {
+    const double ratio = static_cast<double>(outputRate) / inputRate;
+
+    // When downsampling the kernel widens with the lower cutoff to keep the same stopband.
+    if (ratio < 1.0) {
+        taps = static_cast<int32_t>(std::ceil(taps / ratio));
+    }
+    mTaps = (taps + 3) & ~3;
+
+    const int32_t divisor = std::gcd(inputRate, outputRate);
+    const int32_t interpolation = outputRate / divisor;
+    const int32_t decimation = inputRate / divisor;
+    if (interpolation <= kMaxExactPhases) {
+        mExact = true;
+        mNumPhases = interpolation;
+        mStepWhole = decimation / interpolation;
+        mStepPhase = decimation % interpolation;
+    } else {
+        mExact = false;
+        mNumPhases = kInterpolatedPhases;
+        mStepFixed = static_cast<uint64_t>(std::llround(static_cast<double>(inputRate) / outputRate * 4294967296.0));
+    }
+
+    buildTable(std::min(1.0, ratio) * kCutoffScale);
+
+    mHistoryCapacity = mTaps + kBlockFrames;
+    mHistory.resize(static_cast<size_t>(mHistoryCapacity) * mChannelCount);
+    reset();
+}
+
+void Resampler::buildTable(double cutoff) {
+    const int32_t half = mTaps / 2;
+    const double  betaNorm = besselI0(kKaiserBeta);
+    mCoefficients.assign(static_cast<size_t>(mNumPhases + 1) * mTaps, 0.0f);
+
+    std::vector<double> row(mTaps);
+    for (int32_t phase = 0; phase <= mNumPhases; ++phase) {
+        const double fraction = static_cast<double>(phase) / mNumPhases;
+        double       sum = 0.0;
+        for (int32_t k = 0; k < mTaps; ++k) {
+            // Distance between input frame (base - half + 1 + k) and the output instant base + fraction.
+            const double x = k - (half - 1) - fraction;
+            const double w = x / half;
+            const double window = std::fabs(w) < 1.0 ? besselI0(kKaiserBeta * std::sqrt(1.0 - w * w)) / betaNorm : 0.0;
+            row[k] = cutoff * sinc(cutoff * x) * window;
+            sum += row[k];
+        }
+        // Normalise every phase to unity DC gain so there is no phase dependent ripple.
+        for (int32_t k = 0; k < mTaps; ++k) {
+            mCoefficients[static_cast<size_t>(phase) * mTaps + k] = static_cast<float>(row[k] / sum);
+        }
+    }
+}
+
+void Resampler::reset() {
+    std::fill(mHistory.begin(), mHistory.end(), 0.0f);
+    // Pretend silence preceded the signal so the first output frame lines up with input frame 0.
+    mBase = mTaps / 2 - 1;
+    mHistoryFrames = mBase;
+    mPhase = 0;
+    mFraction = 0;
+}
+
+int32_t Resampler::getInputFramesRequired(int32_t outputFrames) const {
+    if (outputFrames <= 0) {
+        return 0;
+    }
+    const int64_t steps = outputFrames - 1;
+    int64_t       lastBase;
+    if (mExact) {
+        const int64_t phase = mPhase + mStepPhase * steps;
+        lastBase = mBase + mStepWhole * steps + phase / mNumPhases;
+    } else {
+        lastBase = mBase + static_cast<int64_t>((mFraction + mStepFixed * static_cast<uint64_t>(steps)) >> 32);
+    }
+    const int64_t needed = lastBase + mTaps / 2 + 1 - mHistoryFrames;
+    return static_cast<int32_t>(std::max<int64_t>(0, needed));
+}
+
+int32_t Resampler::getTailFrames() const {
+    // The frames whose output instant still falls on the input, however much silence follows.
+    for (int32_t frames = 0;; ++frames) {
+        int64_t base;
+        if (mExact) {
+            base = mBase + mStepWhole * frames + (mPhase + mStepPhase * frames) / mNumPhases;
+        } else {
+            base = mBase + static_cast<int64_t>((mFraction + mStepFixed * static_cast<uint64_t>(frames)) >> 32);
+        }
+        if (base >= mHistoryFrames) {
+            return frames;
+        }
+    }
+}
+
+int32_t Resampler::drain(float* output, int32_t outputCapacity) {
+    const int32_t frames = std::min(getTailFrames(), outputCapacity);
+    int32_t       silence = getInputFramesRequired(frames);
+    int32_t       produced = 0;
+    while (true) {
+        produced += produce(output + static_cast<size_t>(produced) * mChannelCount, frames - produced);
+        if (produced == frames || silence == 0) {
+            break;
+        }
+        compact();
+        const int32_t count = std::min(mHistoryCapacity - mHistoryFrames, silence);
+        if (count == 0) {
+            break;
+        }
+        for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+            std::fill_n(&mHistory[static_cast<size_t>(ch) * mHistoryCapacity + mHistoryFrames], count, 0.0f);
+        }
+        mHistoryFrames += count;
+        silence -= count;
+    }
+    return produced;
+}
+
+int32_t Resampler::process(const float* input,
+                           int32_t      inputFrames,
+                           float*       output,
+                           int32_t      outputCapacity,
+                           int32_t*     inputConsumed) {
+    int32_t produced = 0;
+    int32_t consumed = 0;
+    while (true) {
+        produced += produce(output + static_cast<size_t>(produced) * mChannelCount, outputCapacity - produced);
+        if (produced == outputCapacity || consumed == inputFrames) {
+            break;
+        }
+        compact();
+        const int32_t count = std::min(mHistoryCapacity - mHistoryFrames, inputFrames - consumed);
+        if (count == 0) {
+            break;
+        }
+        const float* src = input + static_cast<size_t>(consumed) * mChannelCount;
+        for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+            float* dst = &mHistory[static_cast<size_t>(ch) * mHistoryCapacity + mHistoryFrames];
+            for (int32_t i = 0; i < count; ++i) {
+                dst[i] = src[i * mChannelCount + ch];
+            }
+        }
+        mHistoryFrames += count;
+        consumed += count;
+    }
+    if (inputConsumed != nullptr) {
+        *inputConsumed = consumed;
+    }
+    return produced;
+}
+
+int32_t Resampler::produce(float* output, int32_t outputCapacity) {
+    const int32_t half = mTaps / 2;
+    int32_t       count = 0;
+    while (count < outputCapacity && mBase + half < mHistoryFrames) {
+        const int32_t start = mBase - (half - 1);
+        float*        out = output + static_cast<size_t>(count) * mChannelCount;
+        if (mExact) {
+            const float* row = &mCoefficients[static_cast<size_t>(mPhase) * mTaps];
+            for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+                out[ch] = simd::dot(&mHistory[static_cast<size_t>(ch) * mHistoryCapacity + start], row, mTaps);
+            }
+            mPhase += mStepPhase;
+            mBase += mStepWhole;
+            if (mPhase >= mNumPhases) {
+                mPhase -= mNumPhases;
+                mBase += 1;
+            }
+        } else {
+            const uint64_t scaled = mFraction * static_cast<uint64_t>(mNumPhases);
+            const int32_t  phase = static_cast<int32_t>(scaled >> 32);
+            const float    alpha = static_cast<float>(scaled & 0xffffffffu) * (1.0f / 4294967296.0f);
+            const float*   row0 = &mCoefficients[static_cast<size_t>(phase) * mTaps];
+            const float*   row1 = row0 + mTaps;
+            for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+                const float* x = &mHistory[static_cast<size_t>(ch) * mHistoryCapacity + start];
+                const float  y0 = simd::dot(x, row0, mTaps);
+                const float  y1 = simd::dot(x, row1, mTaps);
+                out[ch] = y0 + alpha * (y1 - y0);
+            }
+            const uint64_t position = mFraction + mStepFixed;
+            mBase += static_cast<int32_t>(position >> 32);
+            mFraction = position & 0xffffffffu;
+        }
+        ++count;
+    }
+    return count;
+}
+
+void Resampler::compact() {
+    const int32_t shift = std::min(mBase - (mTaps / 2 - 1), mHistoryFrames);
+    if (shift <= 0) {
+        return;
+    }
+    const int32_t keep = mHistoryFrames - shift;
+    for (int32_t ch = 0; ch < mChannelCount; ++ch) {
+        float* row = &mHistory[static_cast<size_t>(ch) * mHistoryCapacity];
+        std::memmove(row, row + shift, static_cast<size_t>(keep) * sizeof(float));
+    }
+    mHistoryFrames = keep;
+    mBase -= shift;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/**
+ * Streaming windowed-sinc polyphase resampler for interleaved float audio.
+ *
+ * The filter phase and the last input frames are carried between calls, so splitting a signal into
+ * blocks of any size gives exactly the same output as processing it in one go. Up- and down-sampling
+ * at any ratio is supported. When outputRate / inputRate reduces to a fraction with a small enough
+ * numerator the phases are exact, otherwise neighbouring phases are interpolated.
+ *
+ * The group delay of the filter is compensated, so output frame n lines up with input time
+ * n * inputRate / outputRate.
+ *
+ * process() never allocates, so it can run on the audio thread.
+ */
+class Resampler {
+  public:
+    // Taps per phase when not downsampling, a multiple of 4 so the SIMD dot product has no tail.
+    static constexpr int32_t kDefaultTaps = 32;
+    static constexpr int32_t kMaxExactPhases = 512;
+    static constexpr int32_t kInterpolatedPhases = 256;
+    // Input frames the internal history can take per refill.
+    static constexpr int32_t kBlockFrames = 1024;
+
+    Resampler(int32_t inputRate, int32_t outputRate, int32_t channelCount, int32_t taps = kDefaultTaps);
+
+    int32_t getInputRate() const { return mInputRate; }
+
+    int32_t getOutputRate() const { return mOutputRate; }
+
+    int32_t getChannelCount() const { return mChannelCount; }
+
+    /**
+     * Number of input frames that still have to be supplied for process() to produce exactly
+     * outputFrames more frames.
+     */
+    int32_t getInputFramesRequired(int32_t outputFrames) const;
+
+    /**
+     * Resample interleaved input into interleaved output.
+     *
+     * Consumes input until either all of it is used or the output is full. Frames which cannot be
+     * produced yet stay in the filter history for the next call.
+     *
+     * @param inputConsumed - optional, receives the number of input frames used
+     * @return the number of output frames written
+     */
+    int32_t process(const float* input,
+                    int32_t      inputFrames,
+                    float*       output,
+                    int32_t      outputCapacity,
+                    int32_t*     inputConsumed = nullptr);
+
+    /**
+     * Output frames of the input supplied so far that process() cannot produce yet, because their
+     * filter reaches past the last input frame: about half the filter's length at the output rate.
+     */
+    int32_t getTailFrames() const;
+
+    /**
+     * Produce the tail at the end of a signal, as if it were followed by silence, so that the output
+     * lines up with the whole input. outputCapacity should hold getTailFrames(): what does not fit is
+     * lost, as the silence fed in has become part of the history.
+     * @return the number of output frames written
+     */
+    int32_t drain(float* output, int32_t outputCapacity);
+
+    /**
+     * Forget the history and the phase, as if the object had just been created.
+     */
+    void reset();
+
+  private:
+    void    buildTable(double cutoff);
+    int32_t produce(float* output, int32_t outputCapacity);
+    void    compact();
+
+    int32_t mInputRate;
+    int32_t mOutputRate;
+    int32_t mChannelCount;
+    int32_t mTaps;
+
+    // Phase stepping. With an exact table mPhase counts in 1/mNumPhases of an input frame and
+    // advances by mStep per output frame. Otherwise mFraction is a 32.32 fixed point position.
+    bool     mExact = true;
+    int32_t  mNumPhases = 0;
+    int64_t  mStepWhole = 0;
+    int64_t  mStepPhase = 0;
+    int64_t  mPhase = 0;
+    uint64_t mStepFixed = 0;
+    uint64_t mFraction = 0;
+
+    std::vector<float> mCoefficients;  // (mNumPhases + 1) rows of mTaps
+
+    // Planar input history, one row of mHistoryCapacity per channel. mBase is the index of the
+    // input frame at or just before the next output instant.
+    std::vector<float> mHistory;
+    int32_t            mHistoryCapacity = 0;
+    int32_t            mHistoryFrames = 0;
+    int32_t            mBase = 0;
+};
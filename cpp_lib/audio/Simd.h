@@ -0,0 +1,518 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A minimal 4-lane float vector used by the audio kernels, with the few integer lane operations the
+ * dither and the ADPCM decoder need. It maps to NEON on arm64, SSE on the x86 host build and to plain
+ * scalar code elsewhere, so each kernel is written once.
+ */
+#if defined(__ARM_NEON)
+#    include <arm_neon.h>
+#    define AUDIO_SIMD_NEON 1
+#elif defined(__SSE2__)
+#    include <emmintrin.h>
+#    define AUDIO_SIMD_SSE 1
+#endif
+
+namespace simd {
+
+#if AUDIO_SIMD_NEON
+    using float4 = float32x4_t;
+
+    inline float4 load(const float* p) { return vld1q_f32(p); }
+
+    inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+
+    inline float4 set1(float v) { return vdupq_n_f32(v); }
+
+    inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+
+    inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+
+    inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+
+    // a + b * c
+    inline float4 madd(float4 a, float4 b, float4 c) { return vfmaq_f32(a, b, c); }
+
+    inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+
+    inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+
+    inline float hsum(float4 v) { return vaddvq_f32(v); }
+
+    using mask4 = uint32x4_t;
+
+    inline mask4 greater(float4 a, float4 b) { return vcgtq_f32(a, b); }
+
+    inline mask4 greaterEqual(float4 a, float4 b) { return vcgeq_f32(a, b); }
+
+    // mask ? a : b per lane
+    inline float4 select(mask4 mask, float4 a, float4 b) { return vbslq_f32(mask, a, b); }
+
+    // Store a and b interleaved: a0 b0 a1 b1 ...
+    inline void storeInterleaved(float* p, float4 a, float4 b) { vst2q_f32(p, float32x4x2_t {{a, b}}); }
+
+    // Load eight interleaved floats into a = p0 p2 p4 p6 and b = p1 p3 p5 p7.
+    inline void loadDeinterleaved(const float* p, float4& a, float4& b) {
+        const float32x4x2_t pair = vld2q_f32(p);
+        a = pair.val[0];
+        b = pair.val[1];
+    }
+
+    using uint4 = uint32x4_t;
+
+    inline uint4 set4u(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        const uint32_t values[4] = {a, b, c, d};
+        return vld1q_u32(values);
+    }
+
+    // One xorshift32 step per lane.
+    inline uint4 xorshift(uint4 x) {
+        x = veorq_u32(x, vshlq_n_u32(x, 13));
+        x = veorq_u32(x, vshrq_n_u32(x, 17));
+        return veorq_u32(x, vshlq_n_u32(x, 5));
+    }
+
+    // A float in [0, 1) from the top 23 bits of each lane.
+    inline float4 unitFloat(uint4 x) {
+        const uint4 one = vorrq_u32(vshrq_n_u32(x, 9), vdupq_n_u32(0x3f800000));
+        return vsubq_f32(vreinterpretq_f32_u32(one), vdupq_n_f32(1.0f));
+    }
+
+    // Round a then b to the nearest integer and store them as eight saturated int16.
+    inline void storeI16(int16_t* p, float4 a, float4 b) {
+        vst1q_s16(p, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+
+    // Transpose the 4x4 matrix whose rows are a, b, c and d.
+    inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+        const float32x4x2_t ab = vtrnq_f32(a, b);
+        const float32x4x2_t cd = vtrnq_f32(c, d);
+        a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+    }
+
+    using int4 = int32x4_t;
+
+    inline int4 load(const int32_t* p) { return vld1q_s32(p); }
+
+    inline void store(int32_t* p, int4 v) { vst1q_s32(p, v); }
+
+    inline int4 set1i(int32_t v) { return vdupq_n_s32(v); }
+
+    inline int4 add(int4 a, int4 b) { return vaddq_s32(a, b); }
+
+    inline int4 sub(int4 a, int4 b) { return vsubq_s32(a, b); }
+
+    inline int4 min(int4 a, int4 b) { return vminq_s32(a, b); }
+
+    inline int4 max(int4 a, int4 b) { return vmaxq_s32(a, b); }
+
+    inline int4 bitAnd(int4 a, int4 b) { return vandq_s32(a, b); }
+
+    inline int4 bitXor(int4 a, int4 b) { return veorq_s32(a, b); }
+
+    // Arithmetic shift right by a constant.
+    template <int N>
+    inline int4 shiftRight(int4 a) {
+        return vshrq_n_s32(a, N);
+    }
+
+    inline float4 toFloat(int4 a) { return vcvtq_f32_s32(a); }
+#elif AUDIO_SIMD_SSE
+    using float4 = __m128;
+
+    inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+
+    inline void store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+
+    inline float4 set1(float v) { return _mm_set1_ps(v); }
+
+    inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+
+    inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+
+    inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+
+    // a + b * c
+    inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+
+    inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+
+    inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+
+    inline float hsum(float4 v) {
+        __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        sums = _mm_add_ss(sums, shuf);
+        return _mm_cvtss_f32(sums);
+    }
+
+    using mask4 = __m128;
+
+    inline mask4 greater(float4 a, float4 b) { return _mm_cmpgt_ps(a, b); }
+
+    inline mask4 greaterEqual(float4 a, float4 b) { return _mm_cmpge_ps(a, b); }
+
+    // mask ? a : b per lane
+    inline float4 select(mask4 mask, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    // Store a and b interleaved: a0 b0 a1 b1 ...
+    inline void storeInterleaved(float* p, float4 a, float4 b) {
+        _mm_storeu_ps(p, _mm_unpacklo_ps(a, b));
+        _mm_storeu_ps(p + 4, _mm_unpackhi_ps(a, b));
+    }
+
+    // Load eight interleaved floats into a = p0 p2 p4 p6 and b = p1 p3 p5 p7.
+    inline void loadDeinterleaved(const float* p, float4& a, float4& b) {
+        const __m128 lo = _mm_loadu_ps(p);
+        const __m128 hi = _mm_loadu_ps(p + 4);
+        a = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+        b = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+
+    using uint4 = __m128i;
+
+    inline uint4 set4u(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        return _mm_setr_epi32(static_cast<int>(a), static_cast<int>(b), static_cast<int>(c), static_cast<int>(d));
+    }
+
+    // One xorshift32 step per lane.
+    inline uint4 xorshift(uint4 x) {
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    }
+
+    // A float in [0, 1) from the top 23 bits of each lane.
+    inline float4 unitFloat(uint4 x) {
+        const uint4 one = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+        return _mm_sub_ps(_mm_castsi128_ps(one), _mm_set1_ps(1.0f));
+    }
+
+    // Round a then b to the nearest integer and store them as eight saturated int16. The values must
+    // fit an int32.
+    inline void storeI16(int16_t* p, float4 a, float4 b) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+
+    // Transpose the 4x4 matrix whose rows are a, b, c and d.
+    inline void transpose(float4& a, float4& b, float4& c, float4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+    using int4 = __m128i;
+
+    inline int4 load(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+
+    inline void store(int32_t* p, int4 v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+
+    inline int4 set1i(int32_t v) { return _mm_set1_epi32(v); }
+
+    inline int4 add(int4 a, int4 b) { return _mm_add_epi32(a, b); }
+
+    inline int4 sub(int4 a, int4 b) { return _mm_sub_epi32(a, b); }
+
+    // SSE2 has no 32 bit min and max.
+    inline int4 min(int4 a, int4 b) {
+        const __m128i greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+    }
+
+    inline int4 max(int4 a, int4 b) {
+        const __m128i greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+    }
+
+    inline int4 bitAnd(int4 a, int4 b) { return _mm_and_si128(a, b); }
+
+    inline int4 bitXor(int4 a, int4 b) { return _mm_xor_si128(a, b); }
+
+    // Arithmetic shift right by a constant.
+    template <int N>
+    inline int4 shiftRight(int4 a) {
+        return _mm_srai_epi32(a, N);
+    }
+
+    inline float4 toFloat(int4 a) { return _mm_cvtepi32_ps(a); }
+#else
+    struct float4 {
+        float v[4];
+    };
+
+    inline float4 load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+
+    inline void store(float* p, float4 a) {
+        for (int i = 0; i < 4; ++i) p[i] = a.v[i];
+    }
+
+    inline float4 set1(float v) { return {{v, v, v, v}}; }
+
+    inline float4 add(float4 a, float4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+
+    inline float4 sub(float4 a, float4 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; }
+
+    inline float4 mul(float4 a, float4 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+
+    inline float4 madd(float4 a, float4 b, float4 c) { return add(a, mul(b, c)); }
+
+    inline float4 min(float4 a, float4 b) {
+        float4 r;
+        for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    inline float4 max(float4 a, float4 b) {
+        float4 r;
+        for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    inline float hsum(float4 a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+
+    struct mask4 {
+        bool v[4];
+    };
+
+    inline mask4 greater(float4 a, float4 b) {
+        return {{a.v[0] > b.v[0], a.v[1] > b.v[1], a.v[2] > b.v[2], a.v[3] > b.v[3]}};
+    }
+
+    inline mask4 greaterEqual(float4 a, float4 b) {
+        return {{a.v[0] >= b.v[0], a.v[1] >= b.v[1], a.v[2] >= b.v[2], a.v[3] >= b.v[3]}};
+    }
+
+    inline float4 select(mask4 mask, float4 a, float4 b) {
+        float4 r;
+        for (int i = 0; i < 4; ++i) r.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    inline void storeInterleaved(float* p, float4 a, float4 b) {
+        for (int i = 0; i < 4; ++i) {
+            p[2 * i] = a.v[i];
+            p[2 * i + 1] = b.v[i];
+        }
+    }
+
+    inline void loadDeinterleaved(const float* p, float4& a, float4& b) {
+        for (int i = 0; i < 4; ++i) {
+            a.v[i] = p[2 * i];
+            b.v[i] = p[2 * i + 1];
+        }
+    }
+
+    struct uint4 {
+        uint32_t v[4];
+    };
+
+    inline uint4 set4u(uint32_t a, uint32_t b, uint32_t c, uint32_t d) { return {{a, b, c, d}}; }
+
+    inline uint4 xorshift(uint4 x) {
+        for (int i = 0; i < 4; ++i) {
+            x.v[i] ^= x.v[i] << 13;
+            x.v[i] ^= x.v[i] >> 17;
+            x.v[i] ^= x.v[i] << 5;
+        }
+        return x;
+    }
+
+    inline float4 unitFloat(uint4 x) {
+        float4 r;
+        for (int i = 0; i < 4; ++i) r.v[i] = static_cast<float>(x.v[i] >> 8) * (1.0f / 16777216.0f);
+        return r;
+    }
+
+    inline void storeI16(int16_t* p, float4 a, float4 b) {
+        for (int i = 0; i < 8; ++i) {
+            const long value = lrintf(i < 4 ? a.v[i] : b.v[i - 4]);
+            p[i] = static_cast<int16_t>(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+        }
+    }
+
+    inline void transpose(float4& a, float4& b, float4& c, float4& d) {
+        float4* rows[4] = {&a, &b, &c, &d};
+        for (int i = 0; i < 4; ++i) {
+            for (int j = i + 1; j < 4; ++j) {
+                const float t = rows[i]->v[j];
+                rows[i]->v[j] = rows[j]->v[i];
+                rows[j]->v[i] = t;
+            }
+        }
+    }
+
+    struct int4 {
+        int32_t v[4];
+    };
+
+    inline int4 load(const int32_t* p) { return {{p[0], p[1], p[2], p[3]}}; }
+
+    inline void store(int32_t* p, int4 a) {
+        for (int i = 0; i < 4; ++i) p[i] = a.v[i];
+    }
+
+    inline int4 set1i(int32_t v) { return {{v, v, v, v}}; }
+
+    inline int4 add(int4 a, int4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+
+    inline int4 sub(int4 a, int4 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; }
+
+    inline int4 min(int4 a, int4 b) {
+        int4 r;
+        for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    inline int4 max(int4 a, int4 b) {
+        int4 r;
+        for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    inline int4 bitAnd(int4 a, int4 b) {
+        for (int i = 0; i < 4; ++i) a.v[i] &= b.v[i];
+        return a;
+    }
+
+    inline int4 bitXor(int4 a, int4 b) {
+        for (int i = 0; i < 4; ++i) a.v[i] ^= b.v[i];
+        return a;
+    }
+
+    template <int N>
+    inline int4 shiftRight(int4 a) {
+        return {{a.v[0] >> N, a.v[1] >> N, a.v[2] >> N, a.v[3] >> N}};
+    }
+
+    inline float4 toFloat(int4 a) {
+        return {{static_cast<float>(a.v[0]), static_cast<float>(a.v[1]), static_cast<float>(a.v[2]),
+                 static_cast<float>(a.v[3])}};
+    }
+#endif
+
+    inline float4 set4(float a, float b, float c, float d) {
+        const float values[4] = {a, b, c, d};
+        return load(values);
+    }
+
+    inline int4 set4i(int32_t a, int32_t b, int32_t c, int32_t d) {
+        const int32_t values[4] = {a, b, c, d};
+        return load(values);
+    }
+
+    /**
+     * Sine and cosine of x in [-pi, pi], accurate to about 1e-7.
+     *
+     * The angle is folded into [-pi/2, pi/2], where an odd polynomial is evaluated. The cosine is
+     * the sine of x + pi/2, wrapped back into range.
+     */
+    inline float4 sin(float4 x) {
+        constexpr float kHalfPi = 1.57079632679f;
+        constexpr float kPi = 3.14159265359f;
+        // sin(x) == sin(pi - x) folds the outer quarters onto the inner half.
+        x = select(greater(x, set1(kHalfPi)), sub(set1(kPi), x), x);
+        x = select(greater(set1(-kHalfPi), x), sub(set1(-kPi), x), x);
+        const float4 x2 = mul(x, x);
+        // Taylor series to x^13, the truncation error is below 6e-8 on [-pi/2, pi/2].
+        float4 p = set1(1.0f / 6227020800.0f);
+        p = madd(set1(-1.0f / 39916800.0f), p, x2);
+        p = madd(set1(1.0f / 362880.0f), p, x2);
+        p = madd(set1(-1.0f / 5040.0f), p, x2);
+        p = madd(set1(1.0f / 120.0f), p, x2);
+        p = madd(set1(-1.0f / 6.0f), p, x2);
+        p = madd(set1(1.0f), p, x2);
+        return mul(p, x);
+    }
+
+    inline void sinCos(float4 x, float4& sine, float4& cosine) {
+        constexpr float kHalfPi = 1.57079632679f;
+        constexpr float kPi = 3.14159265359f;
+        sine = sin(x);
+        float4 shifted = add(x, set1(kHalfPi));
+        shifted = select(greater(shifted, set1(kPi)), sub(shifted, set1(2.0f * kPi)), shifted);
+        cosine = sin(shifted);
+    }
+
+    /**
+     * Dot product of two float arrays, count must be a multiple of 4.
+     */
+    inline float dot(const float* a, const float* b, size_t count) {
+        float4 acc0 = set1(0.0f);
+        float4 acc1 = set1(0.0f);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            acc0 = madd(acc0, load(a + i), load(b + i));
+            acc1 = madd(acc1, load(a + i + 4), load(b + i + 4));
+        }
+        if (i < count) {
+            acc0 = madd(acc0, load(a + i), load(b + i));
+        }
+        return hsum(add(acc0, acc1));
+    }
+
+    /**
+     * dst[i] += src[i] * gains[i % 4], so interleaved stereo gets a separate gain per channel.
+     */
+    inline void accumulate(float* dst, const float* src, size_t count, const float gains[4]) {
+        const float4 g = load(gains);
+        size_t       i = 0;
+        for (; i + 8 <= count; i += 8) {
+            store(dst + i, madd(load(dst + i), load(src + i), g));
+            store(dst + i + 4, madd(load(dst + i + 4), load(src + i + 4), g));
+        }
+        for (; i + 4 <= count; i += 4) {
+            store(dst + i, madd(load(dst + i), load(src + i), g));
+        }
+        for (; i < count; ++i) {
+            dst[i] += src[i] * gains[i % 4];
+        }
+    }
+
+    /**
+     * accumulate for int16 samples, scaled to [-1, 1).
+     */
+    inline void accumulateI16(float* dst, const int16_t* src, size_t count, const float gains[4]) {
+        const float4 g = mul(load(gains), set1(1.0f / 32768.0f));
+        size_t       i = 0;
+        for (; i + 4 <= count; i += 4) {
+            store(dst + i, madd(load(dst + i), set4(src[i], src[i + 1], src[i + 2], src[i + 3]), g));
+        }
+        for (; i < count; ++i) {
+            dst[i] += src[i] * (gains[i % 4] / 32768.0f);
+        }
+    }
+
+    /**
+     * Sum of the squares and the largest magnitude of the samples, for their RMS and peak.
+     */
+    inline void sumSquaresAndPeak(const float* data, size_t count, float& sumSquares, float& peak) {
+        float4 acc = set1(0.0f);
+        float4 hi = set1(0.0f);
+        float4 lo = set1(0.0f);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const float4 x = load(data + i);
+            acc = madd(acc, x, x);
+            hi = max(hi, x);
+            lo = min(lo, x);
+        }
+        float his[4];
+        float los[4];
+        store(his, hi);
+        store(los, lo);
+        sumSquares = hsum(acc);
+        peak = 0.0f;
+        for (int lane = 0; lane < 4; ++lane) {
+            peak = his[lane] > peak ? his[lane] : peak;
+            peak = -los[lane] > peak ? -los[lane] : peak;
+        }
+        for (; i < count; ++i) {
+            sumSquares += data[i] * data[i];
+            peak = data[i] > peak ? data[i] : (-data[i] > peak ? -data[i] : peak);
+        }
+    }
+
+}  // namespace simd
@@ -1,9 +1,12 @@
 
 #include "SoundGenerator.h"
 
+#include <algorithm>
+
 SoundGenerator::SoundGenerator(int32_t sampleRate, int32_t channelCount) :
         TappableAudioSource(sampleRate, channelCount)
-        , mOscillators(std::make_unique<Oscillator[]>(channelCount)){
+        , mOscillators(std::make_unique<Oscillator[]>(channelCount))
+        , mInterleave(channels::getInterleaver(channelCount)) {
 
     double frequency = 440.0;
     constexpr double interval = 110.0;
@@ -18,14 +21,38 @@ SoundGenerator::SoundGenerator(int32_t sampleRate, int32_t channelCount) :
     }
 }
 
+void SoundGenerator::setSampleRate(int32_t sampleRate) {
+    mSampleRate = sampleRate;
+    for (int i = 0; i < mChannelCount; ++i) {
+        mOscillators[i].setSampleRate(sampleRate);
+    }
+}
+
 void SoundGenerator::renderAudio(float *audioData, int32_t numFrames) {
-    // Render each oscillator into its own channel
-    std::fill_n(mBuffer.get(), kSharedBufferSize, 0);
+    if (mChannelCount == 1) {
+        mOscillators[0].renderAudio(audioData, numFrames);
+        return;
+    }
+    if (mInterleave == nullptr) {
+        // More channels than the kernels cover: each oscillator writes its own channel in place
+        for (int i = 0; i < mChannelCount; ++i) {
+            mOscillators[i].renderAudio(audioData + i, numFrames, mChannelCount);
+        }
+        return;
+    }
+
+    // Render a small block of each channel, then interleave them with the kernel for this layout
+    alignas(16) float planes[channels::kMaxChannels][kBlockFrames];
+    const float* planePointers[channels::kMaxChannels];
     for (int i = 0; i < mChannelCount; ++i) {
-        mOscillators[i].renderAudio(mBuffer.get(), numFrames);
-        for (int j = 0; j < numFrames; ++j) {
-            audioData[(j * mChannelCount) + i] = mBuffer[j];
+        planePointers[i] = planes[i];
+    }
+    for (int32_t done = 0; done < numFrames; done += kBlockFrames) {
+        const int32_t frames = std::min(kBlockFrames, numFrames - done);
+        for (int i = 0; i < mChannelCount; ++i) {
+            mOscillators[i].renderAudio(planes[i], frames);
         }
+        mInterleave(planePointers, audioData + done * mChannelCount, frames);
     }
 }
 
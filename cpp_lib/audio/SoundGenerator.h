@@ -1,4 +1,5 @@
 #pragma once
+#include "ChannelConvert.h"
 #include "Oscillator.h"
 #include "TappableAudioSource.h"
 
@@ -7,7 +8,8 @@
  * Implements RenderableTap (sound source with toggle) which is required for AudioEngines.
  */
 class SoundGenerator : public TappableAudioSource {
-    static constexpr size_t kSharedBufferSize = 1024;
+    // Frames per channel rendered on the stack before a block is interleaved.
+    static constexpr int32_t kBlockFrames = 64;
 public:
     /**
      * Create a new SoundGenerator object.
@@ -25,6 +27,11 @@ public:
     SoundGenerator(SoundGenerator&& other) = default;
     SoundGenerator& operator= (SoundGenerator&& other) = default;
 
+    /**
+     * Follow a new stream's sample rate. The tones keep their phase and on/off state.
+     */
+    void setSampleRate(int32_t sampleRate);
+
     // Switch the tones on
     void tap(bool isOn) override;
 
@@ -32,7 +39,7 @@ public:
 
 private:
     std::unique_ptr<Oscillator[]> mOscillators;
-    std::unique_ptr<float[]> mBuffer = std::make_unique<float[]>(kSharedBufferSize);
+    channels::InterleaveFunction  mInterleave;  // nullptr above channels::kMaxChannels
 };
 
 
@@ -0,0 +1,172 @@
+#include "SpectrumAnalyzer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "ndk_utils/cpu_topology.h"
+#include "ndk_utils/log.h"
+#include "Simd.h"
+
+namespace {
+    int32_t supportedSize(int32_t fftSize) {
+        if (RealFft::isSupported(fftSize)) {
+            return fftSize;
+        }
+        LOGW("FFT size %d is not supported, using %d", fftSize, SpectrumAnalyzer::kDefaultFftSize);
+        return SpectrumAnalyzer::kDefaultFftSize;
+    }
+}  // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(int32_t fftSize) : mFftSize(supportedSize(fftSize)), mFft(mFftSize) {
+    mMono.assign(mFftSize, 0.0f);
+    mWindow.resize(mFftSize);
+    mWindowed.resize(mFftSize);
+    mPower.resize(mFft.getBinCount());
+    double sumSquares = 0.0;
+    for (int32_t n = 0; n < mFftSize; ++n) {
+        mWindow[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * n / mFftSize));
+        sumSquares += double(mWindow[n]) * mWindow[n];
+    }
+    // Half the power of a windowed sine of amplitude 1 falls in the positive bins: N * sum(w^2) / 4.
+    mPowerScale = static_cast<float>(4.0 / (mFftSize * sumSquares));
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() { stopWorker(); }
+
+void SpectrumAnalyzer::prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) {
+    stopWorker();
+    mSampleRate = sampleRate;
+    mChannelCount = channelCount;
+    const int32_t hopFrames = mFftSize / 2;
+    mRing = std::make_unique<SpscRingBuffer<float>>(
+            static_cast<size_t>(std::max(mFftSize * kRingFfts, maxFrames)) * channelCount);
+    mHop.assign(static_cast<size_t>(hopFrames) * channelCount, 0.0f);
+    mDownmix.setLayout(channelCount, 1);
+    std::fill(mMono.begin(), mMono.end(), 0.0f);
+    mFramesAnalyzed = 0;
+    mDroppedFrames.store(0, std::memory_order_relaxed);
+
+    // Bands evenly spaced in log frequency, each at least one bin wide.
+    const float nyquist = sampleRate / 2.0f;
+    const float ratio = std::pow(nyquist / kMinFrequency, 1.0f / kBandCount);
+    const int32_t lastBin = mFft.getBinCount() - 1;
+    mBandBins.assign(kBandCount + 1, 0);
+    mBandBins[0] = std::max(1, static_cast<int32_t>(std::lround(kMinFrequency * mFftSize / sampleRate)));
+    for (int32_t band = 0; band <= kBandCount; ++band) {
+        mBandEdges[band] = kMinFrequency * std::pow(ratio, static_cast<float>(band));
+        if (band > 0) {
+            const auto edgeBin = static_cast<int32_t>(std::lround(mBandEdges[band] * mFftSize / sampleRate));
+            mBandBins[band] = std::min(std::max(edgeBin, mBandBins[band - 1] + 1), lastBin + 1);
+        }
+    }
+    mBandBins[kBandCount] = lastBin + 1;
+    if (mEnabled) {
+        startWorker();
+    }
+}
+
+void SpectrumAnalyzer::process(float* audioData, int32_t numFrames) {
+    if (!mWorkerRunning.load(std::memory_order_relaxed) || mRing == nullptr) {
+        return;
+    }
+    const size_t count = static_cast<size_t>(numFrames) * mChannelCount;
+    const size_t written = mRing->write(audioData, count);
+    if (written < count) {
+        mDroppedFrames.fetch_add((count - written) / mChannelCount, std::memory_order_relaxed);
+    }
+}
+
+void SpectrumAnalyzer::start() {
+    mEnabled = true;
+    startWorker();
+}
+
+void SpectrumAnalyzer::stop() {
+    mEnabled = false;
+    stopWorker();
+}
+
+void SpectrumAnalyzer::startWorker() {
+    if (mWorker.joinable() || mRing == nullptr) {
+        return;
+    }
+    // Start from what is played from now on.
+    mRing->skipTo(mRing->writePosition());
+    mWorkerRunning = true;
+    mWorker = std::thread(&SpectrumAnalyzer::workerLoop, this);
+}
+
+void SpectrumAnalyzer::stopWorker() {
+    mWorkerRunning = false;
+    if (mWorker.joinable()) {
+        mWorker.join();
+    }
+}
+
+void SpectrumAnalyzer::workerLoop() {
+    cpu_topology::placeCurrentThread(cpu_topology::ThreadRole::Decoder);
+    const int32_t hopFrames = mFftSize / 2;
+    while (mWorkerRunning) {
+        if (mRing->availableToRead() < mHop.size()) {
+            usleep(kWorkerIdleMicros);
+            continue;
+        }
+        mRing->read(mHop.data(), mHop.size());
+        std::memmove(mMono.data(), mMono.data() + hopFrames, static_cast<size_t>(hopFrames) * sizeof(float));
+        mDownmix(mHop.data(), mMono.data() + hopFrames, hopFrames);
+        mFramesAnalyzed += hopFrames;
+        analyze();
+    }
+}
+
+void SpectrumAnalyzer::analyze() {
+    for (int32_t n = 0; n < mFftSize; n += 4) {
+        simd::store(mWindowed.data() + n, simd::mul(simd::load(mMono.data() + n), simd::load(mWindow.data() + n)));
+    }
+    mFft.power(mWindowed.data(), mPower.data());
+    float bandsDb[kBandCount];
+    for (int32_t band = 0; band < kBandCount; ++band) {
+        float sum = 0.0f;
+        for (int32_t bin = mBandBins[band]; bin < mBandBins[band + 1]; ++bin) {
+            sum += mPower[bin];
+        }
+        bandsDb[band] = std::max(kFloorDb, 10.0f * std::log10(sum * mPowerScale + 1e-20f));
+    }
+    publish(bandsDb);
+}
+
+void SpectrumAnalyzer::publish(const float* bandsDb) {
+    const uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int32_t band = 0; band < kBandCount; ++band) {
+        mBandsDb[band].store(bandsDb[band], std::memory_order_relaxed);
+    }
+    mFramePosition.store(mFramesAnalyzed, std::memory_order_relaxed);
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SpectrumAnalyzer::read(Spectrum& spectrum) const {
+    for (int32_t attempt = 0; attempt < kReadAttempts; ++attempt) {
+        const uint64_t before = mSequence.load(std::memory_order_acquire);
+        if (before == 0) {
+            return false;
+        }
+        if ((before & 1) != 0) {
+            continue;
+        }
+        for (int32_t band = 0; band < kBandCount; ++band) {
+            spectrum.bandsDb[band] = mBandsDb[band].load(std::memory_order_relaxed);
+        }
+        spectrum.framePosition = mFramePosition.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mSequence.load(std::memory_order_relaxed) == before) {
+            spectrum.sequence = before / 2;
+            return true;
+        }
+    }
+    return false;
+}
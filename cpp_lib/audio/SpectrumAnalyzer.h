@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AudioGraph.h"
+#include "ChannelConvert.h"
+#include "RealFft.h"
+#include "SpscRingBuffer.h"
+
+/**
+ * Band energies of the audio passing through, for the renderer, measured off the audio thread.
+ *
+ * As a node of an AudioGraph it leaves the audio untouched and copies each block into a lock-free
+ * ring, which is all the audio thread pays. A worker thread reads the ring, mixes it down to mono and
+ * every half FFT, so the windows overlap by half, runs a Hann windowed RealFft. The power of the bins
+ * is summed into kBandCount bands spaced evenly in log frequency from kMinFrequency to Nyquist, and
+ * published in dB through a sequence lock with a single writer, like EnvelopeFollower.
+ *
+ * If the worker falls behind by more than the ring holds the frames which do not fit are dropped and
+ * counted. While the worker is stopped the node copies nothing.
+ */
+class SpectrumAnalyzer : public AudioNode {
+  public:
+    static constexpr int32_t kDefaultFftSize = 1024;
+    static constexpr int32_t kBandCount = 16;
+    static constexpr float   kMinFrequency = 50.0f;
+    static constexpr float   kFloorDb = -100.0f;
+    static constexpr int32_t kRingFfts = 8;  // the ring holds this many FFTs of frames
+    static constexpr int     kWorkerIdleMicros = 2000;
+    static constexpr int32_t kReadAttempts = 4;
+
+    struct Spectrum {
+        float    bandsDb[kBandCount] = {};  // 0 dB is a full scale sine
+        int64_t  framePosition = 0;         // frames through the node up to the end of the window
+        uint64_t sequence = 0;              // counts the spectra published
+    };
+
+    /**
+     * @param fftSize - @see RealFft::isSupported, kDefaultFftSize is used otherwise
+     */
+    explicit SpectrumAnalyzer(int32_t fftSize = kDefaultFftSize);
+
+    ~SpectrumAnalyzer() override;
+
+    /**
+     * Size the ring and the bands for the format. The worker is stopped meanwhile and the frame count
+     * starts over.
+     */
+    void prepare(int32_t sampleRate, int32_t channelCount, int32_t maxFrames) override;
+
+    void process(float* audioData, int32_t numFrames) override;
+
+    /**
+     * Start and stop the worker thread, from the thread which calls prepare(). Started before the
+     * first prepare() it runs from then on.
+     */
+    void start();
+
+    void stop();
+
+    bool isRunning() const { return mWorkerRunning.load(std::memory_order_relaxed); }
+
+    /**
+     * Copy the latest spectrum. Any thread.
+     * @return false if nothing was published yet, or every attempt raced with the worker
+     */
+    bool read(Spectrum& spectrum) const;
+
+    int32_t getFftSize() const { return mFftSize; }
+
+    /**
+     * The lowest frequency of a band, band kBandCount is Nyquist.
+     */
+    float getBandEdge(int32_t band) const { return mBandEdges[band]; }
+
+    uint64_t getDroppedFrames() const { return mDroppedFrames.load(std::memory_order_relaxed); }
+
+  private:
+    void startWorker();
+    void stopWorker();
+    void workerLoop();
+    void analyze();
+    void publish(const float* bandsDb);
+
+    const int32_t mFftSize;
+    int32_t       mSampleRate = 0;
+    int32_t       mChannelCount = 0;
+
+    std::unique_ptr<SpscRingBuffer<float>> mRing;
+    std::atomic<uint64_t>                  mDroppedFrames { 0 };
+
+    // Worker only, sized by prepare().
+    RealFft              mFft;
+    channels::Converter  mDownmix;
+    std::vector<float>   mHop;       // half an FFT of interleaved frames from the ring
+    std::vector<float>   mMono;      // the last FFT of frames, mixed down
+    std::vector<float>   mWindow;    // Hann
+    std::vector<float>   mWindowed;
+    std::vector<float>   mPower;
+    std::vector<int32_t> mBandBins;  // first bin of each band, then the end of the last one
+    float                mBandEdges[kBandCount + 1] = {};
+    float                mPowerScale = 0.0f;
+    int64_t              mFramesAnalyzed = 0;
+
+    bool              mEnabled = false;  // control thread
+    std::thread       mWorker;
+    std::atomic<bool> mWorkerRunning { false };
+
+    // Odd while a write is in progress.
+    std::atomic<uint64_t> mSequence { 0 };
+    std::atomic<float>    mBandsDb[kBandCount] = {};
+    std::atomic<int64_t>  mFramePosition { 0 };
+};
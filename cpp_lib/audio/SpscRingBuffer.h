@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+/**
+ * A single-producer/single-consumer lock-free ring buffer.
+ *
+ * One thread may call the producer methods (write, writePosition) and one other thread may call
+ * the consumer methods (read, peek, skipTo, readPosition). Neither side ever blocks or allocates,
+ * which makes it safe to use from the audio callback.
+ *
+ * Read and write positions are monotonic 64-bit counters, so a position taken on the producer side
+ * (@see writePosition) can be handed to the consumer to discard everything written before it
+ * (@see skipTo).
+ */
+template <typename T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRingBuffer only holds trivially copyable types");
+
+  public:
+    /**
+     * @param minCapacity - the number of elements the buffer must be able to hold, it is rounded up
+     * to a power of two.
+     */
+    explicit SpscRingBuffer(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) {
+            capacity <<= 1;
+        }
+        mCapacity = capacity;
+        mMask = capacity - 1;
+        mData = std::make_unique<T[]>(capacity);
+    }
+
+    size_t capacity() const { return mCapacity; }
+
+    // Producer side
+
+    size_t availableToWrite() const {
+        return mCapacity - static_cast<size_t>(mWriteIndex.load(std::memory_order_relaxed)
+                                               - mReadIndex.load(std::memory_order_acquire));
+    }
+
+    uint64_t writePosition() const { return mWriteIndex.load(std::memory_order_relaxed); }
+
+    /**
+     * Copy up to count elements into the buffer.
+     * @return the number of elements actually written
+     */
+    size_t write(const T* data, size_t count) {
+        const uint64_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        count = std::min(count, availableToWrite());
+        copyIn(writeIndex, data, count);
+        mWriteIndex.store(writeIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side
+
+    size_t availableToRead() const {
+        return static_cast<size_t>(mWriteIndex.load(std::memory_order_acquire)
+                                   - mReadIndex.load(std::memory_order_relaxed));
+    }
+
+    uint64_t readPosition() const { return mReadIndex.load(std::memory_order_relaxed); }
+
+    /**
+     * Copy up to count elements out of the buffer without consuming them.
+     * @return the number of elements copied
+     */
+    size_t peek(T* out, size_t count) const {
+        const uint64_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+        count = std::min(count, availableToRead());
+        copyOut(readIndex, out, count);
+        return count;
+    }
+
+    /**
+     * Move up to count elements out of the buffer.
+     * @return the number of elements read
+     */
+    size_t read(T* out, size_t count) {
+        count = peek(out, count);
+        mReadIndex.store(mReadIndex.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Drop everything written before the given producer position. Positions already consumed or not
+     * yet written are clamped, so this never moves the read index backwards or past the write index.
+     */
+    void skipTo(uint64_t position) {
+        const uint64_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+        const uint64_t writeIndex = mWriteIndex.load(std::memory_order_acquire);
+        position = std::clamp(position, readIndex, writeIndex);
+        mReadIndex.store(position, std::memory_order_release);
+    }
+
+  private:
+    void copyIn(uint64_t index, const T* data, size_t count) {
+        const size_t offset = static_cast<size_t>(index & mMask);
+        const size_t first = std::min(count, mCapacity - offset);
+        std::memcpy(&mData[offset], data, first * sizeof(T));
+        std::memcpy(&mData[0], data + first, (count - first) * sizeof(T));
+    }
+
+    void copyOut(uint64_t index, T* out, size_t count) const {
+        const size_t offset = static_cast<size_t>(index & mMask);
+        const size_t first = std::min(count, mCapacity - offset);
+        std::memcpy(out, &mData[offset], first * sizeof(T));
+        std::memcpy(out + first, &mData[0], (count - first) * sizeof(T));
+    }
+
+    std::unique_ptr<T[]> mData;
+    size_t               mCapacity = 0;
+    size_t               mMask = 0;
+
+    // Keep the indices on separate cache lines so the two threads do not false-share.
+    alignas(64) std::atomic<uint64_t> mWriteIndex { 0 };
+    alignas(64) std::atomic<uint64_t> mReadIndex { 0 };
+};
@@ -0,0 +1,83 @@
+#include "StreamingSoundGenerator.h"
+
+#include "ndk_utils/log.h"
+
+oboe::ResultWithValue<std::shared_ptr<StreamingSoundGenerator>> StreamingSoundGenerator::createFromBuf(
+        const void* data, size_t size, int32_t deviceSampleRate, int32_t deviceChannelCount,
+        std::shared_ptr<const Mp3FrameIndex> mp3Index) {
+    auto decoder = PcmDecoder::open(data, size, std::move(mp3Index));
+    if (!decoder) {
+        return oboe::ResultWithValue<std::shared_ptr<StreamingSoundGenerator>>(oboe::Result::ErrorNull);
+    }
+    LOGI("%s stream, %d ch, %d Hz", PcmDecoder::formatToText(decoder->getFormat()), decoder->getChannelCount(),
+         decoder->getSampleRate());
+    return oboe::ResultWithValue(
+            std::make_shared<StreamingSoundGenerator>(std::move(decoder), deviceSampleRate, deviceChannelCount));
+}
+
+StreamingSoundGenerator::StreamingSoundGenerator(std::unique_ptr<PcmDecoder> decoder,
+                                                 int32_t                     deviceSampleRate,
+                                                 int32_t                     deviceChannelCount)
+    : DecodeAheadSource(deviceSampleRate, deviceChannelCount, "Stream")
+    , mFormat(decoder->getFormat()) {
+    setDecoder(std::move(decoder));
+}
+
+StreamingSoundGenerator::~StreamingSoundGenerator() { stop(); }
+
+void StreamingSoundGenerator::resetData(const void* data, size_t size,
+                                        std::shared_ptr<const Mp3FrameIndex> mp3Index) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPendingData = data;
+    mPendingSize = size;
+    mPendingIndex = std::move(mp3Index);
+    mPendingSeek = kNoSeek;
+}
+
+void StreamingSoundGenerator::seekTo(uint64_t frame) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPendingSeek = frame;
+}
+
+void StreamingSoundGenerator::prime() {
+    beginClip();
+    // Prime the ring so the first callback does not underrun while the thread spins up.
+    for (int i = 0; i < 2; ++i) {
+        if (!decodeChunk()) {
+            onDecoderEnd();
+            break;
+        }
+    }
+}
+
+void StreamingSoundGenerator::pollRequests() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mPendingData != nullptr) {
+        if (auto decoder = PcmDecoder::open(mPendingData, mPendingSize, std::move(mPendingIndex))) {
+            setDecoder(std::move(decoder));
+            mFormat.store(mDecoder->getFormat(), std::memory_order_relaxed);
+            LOGI("%s stream reset, %d ch, %d Hz", PcmDecoder::formatToText(mDecoder->getFormat()), mChannelCount,
+                 mSampleRate);
+            resetResampler();
+            beginClip();
+        } else {
+            // What the ring holds of the last clip plays out.
+            endClip();
+        }
+        mPendingData = nullptr;
+        mPendingIndex.reset();
+    }
+    if (mPendingSeek != kNoSeek) {
+        const bool ok = mDecoder->seek(mPendingSeek);
+        if (!ok) {
+            LOGE("%s stream cannot seek to frame %llu", PcmDecoder::formatToText(mDecoder->getFormat()),
+                 (unsigned long long)mPendingSeek);
+        }
+        resetResampler();
+        beginClip();
+        if (!ok) {
+            endClip();
+        }
+        mPendingSeek = kNoSeek;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "DecodeAheadSource.h"
+#include "PcmDecoder.h"
+#include "oboe/Definitions.h"
+#include "oboe/Oboe.h"
+
+/**
+ * Streams an MP3, WAV or FLAC clip held in memory, @see PcmDecoder.
+ *
+ * The clip is decoded ahead into the ring of a DecodeAheadSource. Only the encoded bytes and the
+ * bounded ring are held in memory, never the whole decoded clip.
+ */
+class StreamingSoundGenerator : public DecodeAheadSource {
+  public:
+    /**
+     * Open a clip to be played at the given device format. The data is not copied and has to
+     * outlive the generator.
+     * @param mp3Index - seek points of an MP3 clip, which make seekTo() O(log n), @see Mp3FrameIndex
+     */
+    static oboe::ResultWithValue<std::shared_ptr<StreamingSoundGenerator>> createFromBuf(
+            const void* data, size_t size, int32_t deviceSampleRate, int32_t deviceChannelCount,
+            std::shared_ptr<const Mp3FrameIndex> mp3Index = nullptr);
+
+    StreamingSoundGenerator(std::unique_ptr<PcmDecoder> decoder, int32_t deviceSampleRate, int32_t deviceChannelCount);
+
+    ~StreamingSoundGenerator() override;
+
+    /**
+     * Switch to another clip. The decoder thread opens it, the audio callback never waits for it.
+     * The data has to outlive the generator.
+     */
+    void resetData(const void* data, size_t size, std::shared_ptr<const Mp3FrameIndex> mp3Index = nullptr);
+
+    /**
+     * Play on from a frame of the clip, counted at the clip's own rate. The decoder thread seeks, like
+     * resetData() the frames already in the ring are dropped.
+     */
+    void seekTo(uint64_t frame);
+
+    PcmDecoder::Format getFormat() const { return mFormat.load(std::memory_order_relaxed); }
+
+  protected:
+    void prime() override;
+    void pollRequests() override;
+
+  private:
+    static constexpr uint64_t kNoSeek = UINT64_MAX;
+
+    std::atomic<PcmDecoder::Format> mFormat;
+
+    std::mutex                           mMutex;
+    const void*                          mPendingData = nullptr;  // guarded by mMutex
+    size_t                               mPendingSize = 0;
+    std::shared_ptr<const Mp3FrameIndex> mPendingIndex;
+    uint64_t                             mPendingSeek = kNoSeek;  // guarded by mMutex
+};
@@ -3,18 +3,23 @@
 #include <atomic>
 #include <math.h>
 #include <memory>
+#include <algorithm>
+#include <array>
 #include "IRenderableAudio.h"
-constexpr float kDefaultFrequency = 440.0;
-constexpr int32_t kDefaultSampleRate = 48000;
-constexpr float kPi = M_PI;
-constexpr float kTwoPi = kPi * 2;
-constexpr int32_t kNumSineWaves = 5;
-constexpr float kSustainMultiplier = 0.99999;
-constexpr float kReleaseMultiplier = 0.999;
-// Stop playing music below this cutoff
-constexpr float kMasterAmplitudeCutOff = 0.01;
+#include "ITappable.h"
+#include "Simd.h"
 
-class SynthSound : public IRenderableAudio {
+class SynthSound : public IRenderableAudio, public ITappable {
+    // Class scoped so this header can be used together with Oscillator.h.
+    static constexpr float kDefaultFrequency = 440.0;
+    static constexpr int32_t kDefaultSampleRate = 48000;
+    static constexpr float kPi = M_PI;
+    static constexpr float kTwoPi = kPi * 2;
+    static constexpr int32_t kNumSineWaves = 5;
+    static constexpr float kSustainMultiplier = 0.99999;
+    static constexpr float kReleaseMultiplier = 0.999;
+    // Stop playing music below this cutoff
+    static constexpr float kMasterAmplitudeCutOff = 0.01;
 
 public:
     SynthSound() {
@@ -34,6 +39,15 @@ public:
         mAmplitudeScaler = kReleaseMultiplier;
     }
 
+    // Note on while down, so a VoiceMixer can schedule notes to the frame, @see VoiceMixer::tap
+    void tap(bool isDown) override {
+        if (isDown) {
+            noteOn();
+        } else {
+            noteOff();
+        }
+    }
+
     void setSampleRate(int32_t sampleRate) {
         mSampleRate = sampleRate;
         updatePhaseIncrement();
@@ -52,26 +66,82 @@ public:
     };
     // From IRenderableAudio
     void renderAudio(float *audioData, int32_t numFrames) override {
-        for (int i = 0; i < numFrames; ++i) {
-            if (mTrigger.exchange(false)) {
-                mMasterAmplitude = 1.0;
-                mPhase = 0.0f;
-            } else {
-                mMasterAmplitude *= mAmplitudeScaler;
-            }
+        // The parameters are read once per block, the trigger is taken at the start of the block.
+        const bool triggered = mTrigger.exchange(false);
+        if (triggered) {
+            mPhase = 0.0f;
+        }
+        const float scaler = mAmplitudeScaler.load(std::memory_order_relaxed);
+        const float increment = mPhaseIncrement.load(std::memory_order_relaxed);
+        const float first = triggered ? 1.0f : mMasterAmplitude * scaler;
+        if (first < kMasterAmplitudeCutOff) {
+            std::fill_n(audioData, numFrames, 0.0f);
+            mMasterAmplitude = first;
+            return;
+        }
+        simd::float4 amplitudes[kNumSineWaves];
+        for (int j = 0; j < kNumSineWaves; ++j) {
+            amplitudes[j] = simd::set1(mAmplitudes[j].load(std::memory_order_relaxed));
+        }
 
-            audioData[i] = 0;
-            if (mMasterAmplitude < kMasterAmplitudeCutOff) {
-                continue;
-            }
-            for (int j = 0; j < kNumSineWaves; ++j) {
-                audioData[i] += sinf(mPhase * (j + 1)) * mAmplitudes[j] * mMasterAmplitude;
+        // Lane i holds frame i of a group of four.
+        const float scaler2 = scaler * scaler;
+        simd::float4 master = simd::mul(simd::set1(first), simd::set4(1.0f, scaler, scaler2, scaler2 * scaler));
+        const simd::float4 masterStep = simd::set1(scaler2 * scaler2);
+        simd::float4 phase = simd::set4(mPhase, mPhase + increment, mPhase + 2.0f * increment,
+                                        mPhase + 3.0f * increment);
+        const simd::float4 step = simd::set1(4.0f * increment);
+        const simd::float4 pi = simd::set1(kPi);
+        const simd::float4 twoPi = simd::set1(kTwoPi);
+        const simd::float4 cutOff = simd::set1(kMasterAmplitudeCutOff);
+        const simd::float4 zero = simd::set1(0.0f);
+        phase = wrap(phase, twoPi);
+
+        for (int i = 0; i < numFrames; i += 4) {
+            // sin(k * phase) for the harmonics from sin and cos of phase, with
+            // sin((k + 1)x) = 2 cos(x) sin(kx) - sin((k - 1)x). The kernel takes [-pi, pi), so
+            // evaluate at phase - pi and flip the signs.
+            simd::float4 sine;
+            simd::float4 cosine;
+            simd::sinCos(simd::sub(phase, pi), sine, cosine);
+            sine = simd::sub(zero, sine);
+            const simd::float4 twoCos = simd::mul(simd::set1(-2.0f), cosine);
+
+            simd::float4 previous = zero;
+            simd::float4 current = sine;
+            simd::float4 sum = simd::mul(current, amplitudes[0]);
+            for (int j = 1; j < kNumSineWaves; ++j) {
+                const simd::float4 next = simd::sub(simd::mul(twoCos, current), previous);
+                previous = current;
+                current = next;
+                sum = simd::madd(sum, current, amplitudes[j]);
             }
-            mPhase += mPhaseIncrement;
-            if (mPhase > kTwoPi) {
-                mPhase -=  kTwoPi;
+            sum = simd::mul(sum, master);
+            // Samples whose envelope has decayed below the cutoff are silent
+            const simd::float4 out = simd::select(simd::greaterEqual(master, cutOff), sum, zero);
+
+            const int count = std::min(4, numFrames - i);
+            float masters[4];
+            simd::store(masters, master);
+            if (count == 4) {
+                simd::store(audioData + i, out);
+            } else {
+                float values[4];
+                float phases[4];
+                simd::store(values, out);
+                simd::store(phases, phase);
+                std::copy_n(values, count, audioData + i);
+                mMasterAmplitude = masters[count - 1];
+                mPhase = phases[count];
+                return;
             }
+            mMasterAmplitude = masters[3];
+            master = simd::mul(master, masterStep);
+            phase = wrap(simd::add(phase, step), twoPi);
         }
+        float phases[4];
+        simd::store(phases, phase);
+        mPhase = phases[0];
     };
 
 private:
@@ -83,6 +153,12 @@ private:
     std::atomic<float> mPhaseIncrement { 0 };
     std::atomic<float> mFrequency { kDefaultFrequency };
     std::atomic<int32_t> mSampleRate { kDefaultSampleRate };
+    // Bring phases back into [0, 2pi), a step is at most four increments of up to pi each.
+    static simd::float4 wrap(simd::float4 phase, simd::float4 twoPi) {
+        phase = simd::select(simd::greaterEqual(phase, twoPi), simd::sub(phase, twoPi), phase);
+        return simd::select(simd::greaterEqual(phase, twoPi), simd::sub(phase, twoPi), phase);
+    }
+
     void updatePhaseIncrement(){
         // Note how there is a division here. If this file is changed so that updatePhaseIncrement
         // is called more frequently, please cache 1/mSampleRate. This allows this operation to not
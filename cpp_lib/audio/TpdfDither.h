@@ -0,0 +1,65 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "Simd.h"
+
+/**
+ * Converts float samples to int16 with triangular (TPDF) dither, eight samples at a time.
+ *
+ * Samples are clamped to [-1, 1] and scaled by 32767, then the difference of two uniform random
+ * values (+-1 LSB) is added before rounding. That makes the rounding error independent of the
+ * signal: quiet passages and fades turn into a little white noise instead of distortion. The noise
+ * comes from eight xorshift32 generators, two per SIMD lane, so nothing is shared between threads
+ * and the cost is a few integer operations per sample.
+ *
+ * Each stream should have its own instance; process() is meant for one thread.
+ */
+class TpdfDither {
+  public:
+    static constexpr float kScale = 32767.0f;
+
+    // xorshift never leaves zero, so every seed is made odd.
+    explicit TpdfDither(uint32_t seed = 0x9e3779b9u)
+        : mState {simd::set4u(seed | 1, (seed ^ 0x6c8e9cf5u) | 1, (seed ^ 0x2545f491u) | 1, (seed ^ 0x1b873593u) | 1),
+                  simd::set4u((seed ^ 0xcc9e2d51u) | 1, (seed ^ 0xe6546b64u) | 1, (seed ^ 0xc2b2ae35u) | 1,
+                              (seed ^ 0x27d4eb2fu) | 1)}
+        , mTailState((seed ^ 0x85ebca6bu) | 1) { }
+
+    void process(const float* in, int16_t* out, size_t count) {
+        const simd::float4 scale = simd::set1(kScale);
+        const simd::float4 hi = simd::set1(1.0f);
+        const simd::float4 lo = simd::set1(-1.0f);
+        size_t             i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const simd::float4 a = simd::min(simd::max(simd::load(in + i), lo), hi);
+            const simd::float4 b = simd::min(simd::max(simd::load(in + i + 4), lo), hi);
+            // Two independent generators keep the xorshift dependency chains short.
+            const simd::uint4  first0 = simd::xorshift(mState[0]);
+            const simd::uint4  second0 = simd::xorshift(mState[1]);
+            mState[0] = simd::xorshift(first0);
+            mState[1] = simd::xorshift(second0);
+            const simd::float4 ditherA = simd::sub(simd::unitFloat(first0), simd::unitFloat(second0));
+            const simd::float4 ditherB = simd::sub(simd::unitFloat(mState[0]), simd::unitFloat(mState[1]));
+            simd::storeI16(out + i, simd::madd(ditherA, a, scale), simd::madd(ditherB, b, scale));
+        }
+        for (; i < count; ++i) {
+            const float x = in[i] > 1.0f ? 1.0f : (in[i] < -1.0f ? -1.0f : in[i]);
+            const float dither = nextUnit() - nextUnit();
+            const long  value = lrintf(x * kScale + dither);
+            out[i] = static_cast<int16_t>(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+        }
+    }
+
+  private:
+    float nextUnit() {
+        mTailState ^= mTailState << 13;
+        mTailState ^= mTailState >> 17;
+        mTailState ^= mTailState << 5;
+        return static_cast<float>(mTailState >> 8) * (1.0f / 16777216.0f);
+    }
+
+    simd::uint4 mState[2];
+    uint32_t    mTailState;
+};
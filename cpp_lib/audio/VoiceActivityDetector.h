@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Simd.h"
+
+/**
+ * Tells speech from silence and steady noise in captured audio, cheaply enough to run on the capture
+ * thread so that heavier processing only has to wake up for speech.
+ *
+ * The audio is cut into kWindowMillis windows, and each one's energy and zero crossing rate are taken
+ * in one SIMD pass. A window is speech-like when its energy is kEnergyRatio over the noise floor and
+ * its crossing rate is below that of hiss, which crosses zero on about every other sample. The noise
+ * floor follows the quiet windows. Speech starts after kOnsetWindows speech-like windows in a row and
+ * ends after kHangoverWindows without one, so short pauses do not split it.
+ *
+ * process() runs on the capture thread. The state is published through atomics, any thread can read
+ * it without holding up the capture thread.
+ */
+class VoiceActivityDetector {
+  public:
+    static constexpr int32_t kWindowMillis = 10;
+    static constexpr float   kEnergyRatio = 8.0f;             // 9 dB over the noise floor
+    static constexpr float   kMinEnergy = 1e-7f;              // mean square, -70 dBFS
+    static constexpr float   kMaxZeroCrossingRate = 0.35f;    // crossings per sample
+    static constexpr float   kFloorFall = 0.5f;               // per quieter window
+    static constexpr float   kFloorRise = 0.02f;              // per window of noise
+    static constexpr float   kFloorRiseInSpeech = 0.001f;     // so a step up in the noise is learnt too
+    static constexpr int32_t kOnsetWindows = 3;
+    static constexpr int32_t kHangoverWindows = 30;
+
+    struct Window {
+        float energy = 0.0f;            // mean square
+        float zeroCrossingRate = 0.0f;  // sign changes per sample
+    };
+
+    /**
+     * Measure a window. samples[-1], the sample before it, must be readable: the crossing into the
+     * window is counted.
+     */
+    static Window measure(const float* samples, int32_t count) {
+        const simd::float4 zero = simd::set1(0.0f);
+        const simd::float4 one = simd::set1(1.0f);
+        simd::float4       energy = zero;
+        simd::float4       crossings = zero;
+        int32_t            i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const simd::float4 x = simd::load(samples + i);
+            const simd::float4 before = simd::load(samples + i - 1);
+            energy = simd::madd(energy, x, x);
+            crossings = simd::add(crossings, simd::select(simd::greater(zero, simd::mul(x, before)), one, zero));
+        }
+        float sumSquares = simd::hsum(energy);
+        float sumCrossings = simd::hsum(crossings);
+        for (; i < count; ++i) {
+            sumSquares += samples[i] * samples[i];
+            sumCrossings += samples[i] * samples[i - 1] < 0.0f ? 1.0f : 0.0f;
+        }
+        return {sumSquares / static_cast<float>(count), sumCrossings / static_cast<float>(count)};
+    }
+
+    /**
+     * Set the sample rate and reset. Only call this while process() is not running.
+     * @param firstFrame - the position of the next frame fed, so speech is reported in the positions of
+     * whatever else the audio goes to
+     */
+    void prepare(int32_t sampleRate, int64_t firstFrame = 0) {
+        mWindowFrames = std::max(4, sampleRate * kWindowMillis / 1000);
+        mWindow.assign(mWindowFrames + 1, 0.0f);
+        mFill = 0;
+        mFrame = firstFrame;
+        mFloor = -1.0f;
+        mRun = 0;
+        mQuiet = 0;
+        mActive = false;
+        mSpeech.store(false, std::memory_order_relaxed);
+        mSpeechStart.store(-1, std::memory_order_relaxed);
+        mSpeechEnd.store(-1, std::memory_order_relaxed);
+        mSegments.store(0, std::memory_order_release);
+    }
+
+    /**
+     * Feed mono frames, in capture order. Capture thread only.
+     */
+    void process(const float* samples, int32_t numFrames) {
+        while (numFrames > 0 && mWindowFrames > 0) {
+            const int32_t frames = std::min(numFrames, mWindowFrames - mFill);
+            std::copy_n(samples, frames, mWindow.data() + 1 + mFill);
+            mFill += frames;
+            samples += frames;
+            numFrames -= frames;
+            if (mFill == mWindowFrames) {
+                classify(measure(mWindow.data() + 1, mWindowFrames));
+                mWindow[0] = mWindow[mWindowFrames];
+                mFill = 0;
+                mFrame += mWindowFrames;
+            }
+        }
+    }
+
+    bool isSpeech() const { return mSpeech.load(std::memory_order_acquire); }
+
+    /**
+     * Captured frame the current or last speech began on, -1 if there was none. It is a window or so
+     * before the first speech-like one, which is often quieter.
+     */
+    int64_t getSpeechStartFrame() const { return mSpeechStart.load(std::memory_order_acquire); }
+
+    /**
+     * Frame the last speech ended on, -1 while the first has not ended.
+     */
+    int64_t getSpeechEndFrame() const { return mSpeechEnd.load(std::memory_order_acquire); }
+
+    /**
+     * Number of times speech has started.
+     */
+    uint64_t getSegmentCount() const { return mSegments.load(std::memory_order_acquire); }
+
+    float getNoiseFloor() const { return mPublishedFloor.load(std::memory_order_relaxed); }
+
+  private:
+    void classify(const Window& window) {
+        if (mFloor < 0.0f) {
+            mFloor = std::max(window.energy, kMinEnergy);
+        }
+        const bool speechLike = window.energy > std::max(mFloor, kMinEnergy) * kEnergyRatio
+                                && window.zeroCrossingRate < kMaxZeroCrossingRate;
+        if (window.energy < mFloor) {
+            mFloor += (window.energy - mFloor) * kFloorFall;
+        } else {
+            mFloor += (window.energy - mFloor) * (speechLike ? kFloorRiseInSpeech : kFloorRise);
+        }
+        mPublishedFloor.store(mFloor, std::memory_order_relaxed);
+
+        if (speechLike) {
+            ++mRun;
+            mQuiet = 0;
+            mLastSpeechEnd = mFrame + mWindowFrames;
+            if (!mActive && mRun == kOnsetWindows) {
+                mActive = true;
+                const int64_t start = mFrame - static_cast<int64_t>(kOnsetWindows) * mWindowFrames;
+                mSpeechStart.store(std::max<int64_t>(0, start), std::memory_order_relaxed);
+                mSegments.store(mSegments.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                mSpeech.store(true, std::memory_order_release);
+            }
+        } else {
+            mRun = 0;
+            if (mActive && ++mQuiet == kHangoverWindows) {
+                mActive = false;
+                mSpeechEnd.store(mLastSpeechEnd, std::memory_order_relaxed);
+                mSpeech.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    int32_t            mWindowFrames = 0;
+    std::vector<float> mWindow;  // the last sample of the window before, then the window
+    int32_t            mFill = 0;
+    int64_t            mFrame = 0;  // first frame of the window being filled
+    float              mFloor = -1.0f;
+    int32_t            mRun = 0;
+    int32_t            mQuiet = 0;
+    bool               mActive = false;
+    int64_t            mLastSpeechEnd = 0;
+
+    std::atomic<bool>     mSpeech {false};
+    std::atomic<int64_t>  mSpeechStart {-1};
+    std::atomic<int64_t>  mSpeechEnd {-1};
+    std::atomic<uint64_t> mSegments {0};
+    std::atomic<float>    mPublishedFloor {0.0f};
+};
@@ -0,0 +1,277 @@
+#include "VoiceMixer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ImaAdpcm.h"
+#include "Simd.h"
+
+VoiceMixer::VoiceMixer(int32_t sampleRate, int32_t channelCount, int32_t maxVoices)
+    : mSampleRate(sampleRate), mChannelCount(channelCount), mCommands(kCommandQueueSize), mVoices(maxVoices) {
+    mPending.reserve(kCommandQueueSize);
+    for (Voice& voice : mVoices) {
+        voice.decoded.resize(ima_adpcm::kGroupSamples);
+    }
+}
+
+VoiceMixer::~VoiceMixer() {
+    for (Voice& voice : mVoices) {
+        releaseVoice(voice);
+    }
+    Command command;
+    while (mCommands.read(&command, 1) == 1) {
+        mPending.push_back(command);
+    }
+    for (const Command& pending : mPending) {
+        if (pending.type == CommandType::Play) {
+            pending.clip->release();
+        }
+    }
+}
+
+void VoiceMixer::setFormat(int32_t sampleRate, int32_t channelCount) {
+    mSampleRate = sampleRate;
+    mChannelCount = channelCount;
+
+    // Clips decoded for the old format would be mixed with the wrong frame size, past their end.
+    auto isStale = [&](const PcmClip* clip) {
+        return clip->sampleRate != sampleRate || clip->channelCount != channelCount;
+    };
+    for (Voice& voice : mVoices) {
+        if (voice.clip != nullptr && isStale(voice.clip)) {
+            releaseVoice(voice);
+        }
+    }
+    takeCommands();
+    size_t kept = 0;
+    for (Command& command : mPending) {
+        if (command.type == CommandType::Play && isStale(command.clip)) {
+            command.clip->release();
+        } else if (command.type != CommandType::Tap) {
+            command.frame = 0;
+            mPending[kept++] = command;
+        }
+    }
+    mPending.resize(kept);
+    mFramePosition = 0;
+    mRenderedFrames.store(0, std::memory_order_relaxed);
+}
+
+uint32_t VoiceMixer::play(const PcmClip* clip, float gain, float pan, int32_t priority, int64_t frame) {
+    if (clip == nullptr) {
+        return kInvalidVoice;
+    }
+    if (++mNextVoiceId == kInvalidVoice) {
+        ++mNextVoiceId;
+    }
+    clip->retain();
+    if (!push({.type = CommandType::Play, .frame = frame, .voiceId = mNextVoiceId, .clip = clip, .gain = gain,
+               .pan = std::clamp(pan, -1.0f, 1.0f), .priority = priority})) {
+        clip->release();
+        return kInvalidVoice;
+    }
+    return mNextVoiceId;
+}
+
+bool VoiceMixer::stop(uint32_t voiceId, int64_t frame) {
+    return push({.type = CommandType::Stop, .frame = frame, .voiceId = voiceId});
+}
+
+bool VoiceMixer::stopAll(int64_t frame) {
+    return push({.type = CommandType::StopAll, .frame = frame});
+}
+
+bool VoiceMixer::tap(ITappable* target, bool isDown, int64_t frame) {
+    return target != nullptr && push({.type = CommandType::Tap, .frame = frame, .target = target, .isDown = isDown});
+}
+
+bool VoiceMixer::push(const Command& command) {
+    return mCommands.write(&command, 1) == 1;
+}
+
+void VoiceMixer::renderAudio(float* audioData, int32_t numFrames) {
+    IRenderableAudio* source = mStreamSource.load(std::memory_order_acquire);
+    const int64_t     firstFrame = mFramePosition;
+    int32_t           active = 0;
+    // Mix up to the next scheduled command, run it, and carry on from there.
+    for (int32_t done = 0; done < numFrames;) {
+        const int32_t frames = applyCommands(numFrames - done);
+        active = mix(audioData + static_cast<size_t>(done) * mChannelCount, frames, source);
+        done += frames;
+        mFramePosition += frames;
+    }
+    mEnvelope.process(audioData, numFrames, mChannelCount, mSampleRate, firstFrame);
+    mActiveVoices.store(active, std::memory_order_relaxed);
+    mRenderedFrames.store(mFramePosition, std::memory_order_relaxed);
+}
+
+/**
+ * Mix the stream source and the voices into one span of the burst.
+ * @return the number of voices still playing
+ */
+int32_t VoiceMixer::mix(float* audioData, int32_t numFrames, IRenderableAudio* source) {
+    if (source != nullptr) {
+        source->renderAudio(audioData, numFrames);
+    } else {
+        std::memset(audioData, 0, static_cast<size_t>(numFrames) * mChannelCount * sizeof(float));
+    }
+
+    int32_t active = 0;
+    for (Voice& voice : mVoices) {
+        if (voice.clip == nullptr) {
+            continue;
+        }
+        const int32_t frames = std::min(numFrames, voice.clip->frames - voice.position);
+        const size_t offset = static_cast<size_t>(voice.position) * mChannelCount;
+        const size_t count = static_cast<size_t>(frames) * mChannelCount;
+        if (voice.clip->isCompressed()) {
+            mixCompressed(audioData, frames, voice);
+        } else if (voice.clip->mappedI16 != nullptr) {
+            simd::accumulateI16(audioData, voice.clip->mappedI16 + offset, count, voice.gains);
+        } else {
+            simd::accumulate(audioData, voice.clip->floatSamples() + offset, count, voice.gains);
+        }
+        voice.position += frames;
+        if (voice.position >= voice.clip->frames) {
+            releaseVoice(voice);
+        } else {
+            ++active;
+        }
+    }
+    return active;
+}
+
+/**
+ * Mix the frames from the voice's position, decoding each group of the clip once as it is reached.
+ */
+void VoiceMixer::mixCompressed(float* audioData, int32_t numFrames, Voice& voice) {
+    const int32_t groupFrames = ima_adpcm::groupFrames(mChannelCount);
+    for (int32_t done = 0; done < numFrames;) {
+        const int32_t position = voice.position + done;
+        const int32_t group = position / groupFrames;
+        if (group != voice.decodedGroup) {
+            ima_adpcm::decodeGroup(&voice.clip->adpcm[group * ima_adpcm::kGroupBytes], mChannelCount,
+                                   voice.decoded.data());
+            voice.decodedGroup = group;
+        }
+        const int32_t offset = position - group * groupFrames;
+        const int32_t frames = std::min(numFrames - done, groupFrames - offset);
+        simd::accumulate(audioData + static_cast<size_t>(done) * mChannelCount,
+                         &voice.decoded[static_cast<size_t>(offset) * mChannelCount],
+                         static_cast<size_t>(frames) * mChannelCount, voice.gains);
+        done += frames;
+    }
+}
+
+/**
+ * Move queued commands to the pending list. Whatever does not fit stays queued for the next burst.
+ */
+void VoiceMixer::takeCommands() {
+    while (mPending.size() < mPending.capacity()) {
+        Command command;
+        if (mCommands.read(&command, 1) != 1) {
+            break;
+        }
+        mPending.push_back(command);
+    }
+}
+
+/**
+ * Run every command due at the current frame, in the order they were issued.
+ * @return the number of frames to mix before the next one is due, at most maxFrames
+ */
+int32_t VoiceMixer::applyCommands(int32_t maxFrames) {
+    takeCommands();
+    int64_t next = mFramePosition + maxFrames;
+    size_t  kept = 0;
+    for (const Command& command : mPending) {
+        if (command.frame <= mFramePosition) {
+            applyCommand(command);
+        } else {
+            next = std::min(next, command.frame);
+            mPending[kept++] = command;
+        }
+    }
+    mPending.resize(kept);
+    return static_cast<int32_t>(next - mFramePosition);
+}
+
+void VoiceMixer::applyCommand(const Command& command) {
+    switch (command.type) {
+        case CommandType::Play:
+            startVoice(command);
+            break;
+        case CommandType::Stop:
+            for (Voice& voice : mVoices) {
+                if (voice.id == command.voiceId) {
+                    releaseVoice(voice);
+                }
+            }
+            break;
+        case CommandType::StopAll:
+            for (Voice& voice : mVoices) {
+                releaseVoice(voice);
+            }
+            break;
+        case CommandType::Tap:
+            command.target->tap(command.isDown);
+            break;
+    }
+}
+
+void VoiceMixer::startVoice(const Command& command) {
+    const PcmClip* clip = command.clip;
+    // A clip decoded for a previous stream format would play at the wrong speed.
+    if (clip->sampleRate != mSampleRate || clip->channelCount != mChannelCount) {
+        clip->release();
+        return;
+    }
+    Voice* voice = findVoiceSlot(command.priority);
+    if (voice == nullptr) {
+        clip->release();
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (voice->clip != nullptr) {
+        releaseVoice(*voice);
+        mStolen.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    voice->clip = clip;
+    voice->id = command.voiceId;
+    voice->priority = command.priority;
+    voice->position = 0;
+    voice->decodedGroup = -1;
+    voice->startOrder = ++mStartCounter;
+    if (mChannelCount == 2) {
+        // The clips are stereo already, so pan is a balance control: centre leaves both sides untouched.
+        const float left = command.gain * std::min(1.0f, 1.0f - command.pan);
+        const float right = command.gain * std::min(1.0f, 1.0f + command.pan);
+        voice->gains[0] = voice->gains[2] = left;
+        voice->gains[1] = voice->gains[3] = right;
+    } else {
+        std::fill(std::begin(voice->gains), std::end(voice->gains), command.gain);
+    }
+}
+
+VoiceMixer::Voice* VoiceMixer::findVoiceSlot(int32_t priority) {
+    Voice* victim = nullptr;
+    for (Voice& voice : mVoices) {
+        if (voice.clip == nullptr) {
+            return &voice;
+        }
+        if (victim == nullptr || voice.priority < victim->priority
+            || (voice.priority == victim->priority && voice.startOrder < victim->startOrder)) {
+            victim = &voice;
+        }
+    }
+    return victim != nullptr && victim->priority <= priority ? victim : nullptr;
+}
+
+void VoiceMixer::releaseVoice(Voice& voice) {
+    if (voice.clip != nullptr) {
+        voice.clip->release();
+        voice.clip = nullptr;
+        voice.id = kInvalidVoice;
+    }
+}
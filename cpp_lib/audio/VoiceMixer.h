@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "EnvelopeFollower.h"
+#include "IRenderableAudio.h"
+#include "ITappable.h"
+#include "PcmClip.h"
+#include "SpscRingBuffer.h"
+
+/**
+ * Mixes any number of overlapping clips over an optional stream source.
+ *
+ * The voice slots are allocated up front. Clips are triggered through a lock-free command queue, so
+ * renderAudio() never allocates, locks or decodes: each voice is a multiply-accumulate of already
+ * decoded samples into the output; a voice of an IMA-ADPCM clip first decodes the next group of the
+ * clip into its own buffer, allocated with the slot, and the int16 samples of a PcmPack clip are
+ * scaled as they are added. When every slot is busy the voice with the lowest priority, and among
+ * those the oldest, is stolen.
+ *
+ * Commands can be scheduled for a frame of the mixer's timeline, which counts the frames rendered since
+ * setFormat() and so matches the frame position of the stream playing it. renderAudio() splits the
+ * burst at that frame, so a clip starts or a source is tapped on the exact frame wherever the callback
+ * boundaries fall. Frames already rendered mean as soon as possible.
+ *
+ * The mix is not clamped, overs are left to the limiter after it. Its envelope is measured after each
+ * burst, @see getEnvelope.
+ *
+ * The command queue has a single producer: play(), stop(), stopAll() and tap() must all be called
+ * from one thread, in OboeEngine the app thread which triggers sounds. renderAudio() consumes the
+ * queue on the audio thread. setFormat() consumes it too, so it may only run while no stream is open
+ * on the mixer, as OboeEngine's stream control thread does between closing a stream and starting the
+ * next; the producer may go on queueing meanwhile.
+ */
+class VoiceMixer : public IRenderableAudio {
+  public:
+    static constexpr int32_t kDefaultMaxVoices = 16;
+    static constexpr size_t  kCommandQueueSize = 64;
+    // Returned by play() when the command could not be queued.
+    static constexpr uint32_t kInvalidVoice = 0;
+
+    VoiceMixer(int32_t sampleRate, int32_t channelCount, int32_t maxVoices = kDefaultMaxVoices);
+
+    ~VoiceMixer() override;
+
+    /**
+     * Set the format of the stream. Only call this while no stream is open on the mixer.
+     *
+     * The timeline restarts at zero for the new stream. Commands scheduled on the old one become due
+     * at once, except taps, whose targets may not outlive the old stream. Voices and pending clips
+     * decoded for another format are released.
+     */
+    void setFormat(int32_t sampleRate, int32_t channelCount);
+
+    /**
+     * Set the source mixed under the voices. The source must outlive its use by the mixer.
+     */
+    void setStreamSource(IRenderableAudio* source) { mStreamSource.store(source, std::memory_order_release); }
+
+    IRenderableAudio* getStreamSource() const { return mStreamSource.load(std::memory_order_acquire); }
+
+    /**
+     * Start a clip on a free voice, or steal one.
+     * @param gain - linear gain
+     * @param pan - -1 is left, 0 center and 1 right. Ignored unless the stream is stereo.
+     * @param priority - a voice is only stolen for a clip of the same or a higher priority
+     * @param frame - frame of the timeline the clip starts at, @see getFramePosition
+     * @return an id for stop(), or kInvalidVoice if the command queue is full
+     */
+    uint32_t play(const PcmClip* clip, float gain = 1.0f, float pan = 0.0f, int32_t priority = 0,
+                  int64_t frame = 0);
+
+    /**
+     * Stop a voice started by play(). Does nothing if it has already finished.
+     */
+    bool stop(uint32_t voiceId, int64_t frame = 0);
+
+    bool stopAll(int64_t frame = 0);
+
+    /**
+     * Tap a source, usually the stream source, from the audio thread at the given frame. The target
+     * must stay alive until the command has run or the format is set again.
+     */
+    bool tap(ITappable* target, bool isDown, int64_t frame = 0);
+
+    void renderAudio(float* audioData, int32_t numFrames) override;
+
+    /**
+     * Frames rendered since setFormat(), the start of the next burst. Any thread may read it.
+     */
+    int64_t getFramePosition() const { return mRenderedFrames.load(std::memory_order_relaxed); }
+
+    /**
+     * Level of the mix, published after every burst. Any thread may read it.
+     */
+    const EnvelopeFollower& getEnvelope() const { return mEnvelope; }
+
+    int32_t getMaxVoices() const { return static_cast<int32_t>(mVoices.size()); }
+
+    int32_t getActiveVoiceCount() const { return mActiveVoices.load(std::memory_order_relaxed); }
+
+    // Voices cut off to make room for a new clip.
+    uint64_t getStolenCount() const { return mStolen.load(std::memory_order_relaxed); }
+
+    // Clips not played because every voice had a higher priority.
+    uint64_t getDroppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+
+  private:
+    enum class CommandType : int32_t { Play, Stop, StopAll, Tap };
+
+    struct Command {
+        CommandType    type = CommandType::Play;
+        int64_t        frame = 0;
+        uint32_t       voiceId = kInvalidVoice;
+        const PcmClip* clip = nullptr;
+        float          gain = 0.0f;
+        float          pan = 0.0f;
+        int32_t        priority = 0;
+        ITappable*     target = nullptr;
+        bool           isDown = false;
+    };
+
+    struct Voice {
+        const PcmClip*     clip = nullptr;
+        uint32_t           id = kInvalidVoice;
+        int32_t            priority = 0;
+        int32_t            position = 0;
+        uint64_t           startOrder = 0;
+        float              gains[4] = {};  // per interleaved sample, repeating every 4
+        int32_t            decodedGroup = -1;  // of a compressed clip, in decoded
+        std::vector<float> decoded;
+    };
+
+    bool    push(const Command& command);
+    void    takeCommands();
+    int32_t applyCommands(int32_t maxFrames);
+    void    applyCommand(const Command& command);
+    int32_t mix(float* audioData, int32_t numFrames, IRenderableAudio* source);
+    void    mixCompressed(float* audioData, int32_t numFrames, Voice& voice);
+    void    startVoice(const Command& command);
+    void    releaseVoice(Voice& voice);
+    Voice*  findVoiceSlot(int32_t priority);
+
+    int32_t mSampleRate;
+    int32_t mChannelCount;
+
+    SpscRingBuffer<Command>        mCommands;
+    std::atomic<IRenderableAudio*> mStreamSource { nullptr };
+    uint32_t                       mNextVoiceId = kInvalidVoice;  // control thread only
+
+    // Audio thread only.
+    std::vector<Voice>   mVoices;
+    std::vector<Command> mPending;  // taken off the queue, waiting for their frame
+    uint64_t             mStartCounter = 0;
+    int64_t              mFramePosition = 0;
+
+    EnvelopeFollower      mEnvelope;
+    std::atomic<int64_t>  mRenderedFrames { 0 };
+    std::atomic<int32_t>  mActiveVoices { 0 };
+    std::atomic<uint64_t> mStolen { 0 };
+    std::atomic<uint64_t> mDropped { 0 };
+};
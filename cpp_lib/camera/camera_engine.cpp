@@ -149,36 +149,6 @@ void CameraEngine::OnCameraParameterChanged(int32_t code, int64_t val) {
     camera_->UpdateCameraRequestParameter(code, val);
 }
 
-[[maybe_unused]] static inline uint32_t YUV2RGBA(int nY, int nU, int nV) {
-    static const int kMaxChannelValue = 262143;
-    nY -= 16;
-    nU -= 128;
-    nV -= 128;
-    if (nY < 0)
-        nY = 0;
-
-    // This is the floating point equivalent. We do the conversion in integer
-    // because some Android devices do not have floating point in hardware.
-    // nR = (int)(1.164 * nY + 1.596 * nV);
-    // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
-    // nB = (int)(1.164 * nY + 2.018 * nU);
-
-    int nR = (int)(1192 * nY + 1634 * nV);
-    int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
-    int nB = (int)(1192 * nY + 2066 * nU);
-
-    nR = std::min(kMaxChannelValue, std::max(0, nR));
-    nG = std::min(kMaxChannelValue, std::max(0, nG));
-    nB = std::min(kMaxChannelValue, std::max(0, nB));
-
-    nR = (nR >> 10) & 0xff;
-    nG = (nG >> 10) & 0xff;
-    nB = (nB >> 10) & 0xff;
-
-    uint32_t color = 0xff000000 | (nB << 16) | (nG << 8) | nR;
-    return color;
-}
-
 /**
  * Get RGBA image data from preview ImageReader
  * @param buf out buffer 
@@ -0,0 +1,54 @@
+#include "frame_converter.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "ndk_utils/cpu_topology.h"
+
+namespace yuv {
+    FrameConverter::FrameConverter()
+        : FrameConverter(std::min(kMaxThreads, static_cast<int32_t>(cpu_topology::getPlacement().inference.size())),
+                         cpu_topology::getPlacement().inference) { }
+
+    FrameConverter::FrameConverter(int32_t threadCount, const std::vector<int>& cpus)
+        : mPool(std::max(threadCount, 1), cpus) { }
+
+    int32_t FrameConverter::getBandCount(const Rect& crop) const {
+        return mPool.getTaskCount(static_cast<int64_t>(crop.width) * crop.height, kMinBandPixels);
+    }
+
+    Rect FrameConverter::getBand(const Rect& crop, int32_t index, int32_t count) {
+        auto start = [&](int32_t band) {
+            if (band <= 0) {
+                return 0;
+            }
+            if (band >= count) {
+                return crop.height;
+            }
+            const int32_t rows = static_cast<int32_t>(static_cast<int64_t>(crop.height) * band / count);
+            return std::min(crop.height, rows / kBandAlignment * kBandAlignment + (crop.top & 1));
+        };
+        const int32_t first = start(index);
+        return {crop.left, crop.top + first, crop.width, start(index + 1) - first};
+    }
+
+    void FrameConverter::convert(const Image& image, const Rect& crop, int32_t rotation, uint32_t* out,
+                                 int32_t outStride) {
+        const int32_t bandCount = getBandCount(crop);
+        mPool.run(bandCount, [&](int32_t index) {
+            const Rect    band = getBand(crop, index, bandCount);
+            const int32_t first = band.top - crop.top;
+            // Where the band's corner lands: its rows in the output are those of the whole crop from
+            // first, or from the end of the band counted back from the last when they run backwards.
+            const int32_t fromEnd = crop.height - first - band.height;
+            switch (rotation) {
+                case 90: convertRotate90(image, band, out + fromEnd, outStride); break;
+                case 180:
+                    convertRotate180(image, band, out + static_cast<size_t>(fromEnd) * outStride, outStride);
+                    break;
+                case 270: convertRotate270(image, band, out + first, outStride); break;
+                default: yuv::convert(image, band, out + static_cast<size_t>(first) * outStride, outStride);
+            }
+        });
+    }
+}  // namespace yuv
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ndk_utils/worker_pool.h"
+#include "yuv_convert.h"
+
+namespace yuv {
+    /**
+     * Converts camera frames with the functions of yuv_convert.h on several cores.
+     *
+     * Each frame is split into bands of rows, one per thread, which run on a WorkerPool that lives as
+     * long as the converter. The bands start on even rows of the image, so no two share a chroma row,
+     * and are a multiple of 4 rows high from the top of the crop, so the rotated tiles do not shrink.
+     * Frames with fewer than kMinBandPixels pixels a band to give each thread stay on the caller.
+     */
+    class FrameConverter {
+      public:
+        // About a tenth of a millisecond of conversion, an order of magnitude above waking a worker.
+        static constexpr int32_t kMinBandPixels = 128 * 1024;
+        static constexpr int32_t kMaxThreads = 4;
+        static constexpr int32_t kBandAlignment = 4;
+
+        /**
+         * A thread for each core the placement leaves to inference, up to kMaxThreads, each worker
+         * pinned to one of them. @see cpu_topology::Placement
+         */
+        FrameConverter();
+
+        /**
+         * @param threadCount - the threads converting a frame, counting the caller; 1 for none
+         * @param cpus - the CPUs to pin the workers to, or none to leave them to the scheduler
+         */
+        explicit FrameConverter(int32_t threadCount, const std::vector<int>& cpus = {});
+
+        /**
+         * Convert the crop into out, turned clockwise by rotation degrees, 0, 90, 180 or 270, as
+         * convert(), convertRotate90(), convertRotate180() and convertRotate270() do.
+         */
+        void convert(const Image& image, const Rect& crop, int32_t rotation, uint32_t* out, int32_t outStride);
+
+        /**
+         * The bands convert() splits the crop into.
+         */
+        int32_t getBandCount(const Rect& crop) const;
+
+        /**
+         * Band index of count, up to the start of the next. Each but the first starts a multiple of
+         * kBandAlignment rows into the crop, one more if the crop starts on an odd row of the image.
+         */
+        static Rect getBand(const Rect& crop, int32_t index, int32_t count);
+
+        int32_t getThreadCount() const { return mPool.getThreadCount(); }
+
+      private:
+        WorkerPool mPool;
+    };
+}  // namespace yuv
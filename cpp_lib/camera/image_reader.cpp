@@ -17,7 +17,9 @@
 
 #include <dirent.h>
 #include "ndk_utils/log.h"
+#include "yuv_convert.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <functional>
@@ -144,56 +146,31 @@ void ImageReader::DeleteImage(AImage* image) {
 }
 
 /**
- * Helper function for YUV_420 to RGB conversion. Courtesy of Tensorflow
- * ImageClassifier Sample:
- * https://github.com/tensorflow/tensorflow/blob/master/tensorflow/examples/android/jni/yuv2rgb.cc
- * The difference is that here we have to swap UV plane when calling it.
+ * The planes of a YUV_420_888 image, and its crop rectangle
  */
-#ifndef MAX
-#define MAX(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a > _b ? _a : _b;      \
-  })
-#define MIN(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a < _b ? _a : _b;      \
-  })
-#endif
-
-// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
-// ranges
-// are normalized to eight bits.
-static const int kMaxChannelValue = 262143;
-
-static inline uint32_t YUV2RGB(int nY, int nU, int nV) {
-  nY -= 16;
-  nU -= 128;
-  nV -= 128;
-  if (nY < 0) nY = 0;
-
-  // This is the floating point equivalent. We do the conversion in integer
-  // because some Android devices do not have floating point in hardware.
-  // nR = (int)(1.164 * nY + 1.596 * nV);
-  // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
-  // nB = (int)(1.164 * nY + 2.018 * nU);
-
-  int nR = (int)(1192 * nY + 1634 * nV);
-  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
-  int nB = (int)(1192 * nY + 2066 * nU);
-
-  nR = MIN(kMaxChannelValue, MAX(0, nR));
-  nG = MIN(kMaxChannelValue, MAX(0, nG));
-  nB = MIN(kMaxChannelValue, MAX(0, nB));
-
-  nR = (nR >> 10) & 0xff;
-  nG = (nG >> 10) & 0xff;
-  nB = (nB >> 10) & 0xff;
-
-  return 0xff000000 | (nB << 16) | (nG << 8) | nR;
+static yuv::Image GetYuvImage(AImage* image, yuv::Rect* crop) {
+  AImageCropRect srcRect;
+  AImage_getCropRect(image, &srcRect);
+  crop->left = srcRect.left;
+  crop->top = srcRect.top;
+  crop->width = srcRect.right - srcRect.left;
+  crop->height = srcRect.bottom - srcRect.top;
+
+  yuv::Image yuvImage;
+  uint8_t *yPixel, *uPixel, *vPixel;
+  int32_t yLen, uLen, vLen;
+  AImage_getPlaneRowStride(image, 0, &yuvImage.yRowStride);
+  AImage_getPlaneRowStride(image, 1, &yuvImage.uvRowStride);
+  AImage_getPlanePixelStride(image, 1, &yuvImage.uvPixelStride);
+  AImage_getPlaneData(image, 0, &yPixel, &yLen);
+  AImage_getPlaneData(image, 1, &uPixel, &uLen);
+  AImage_getPlaneData(image, 2, &vPixel, &vLen);
+  yuvImage.y = yPixel;
+  yuvImage.u = uPixel;
+  yuvImage.v = vPixel;
+  LOGV("yPixel %p, yLen %d, yStride %d, uvPixelStride %d, uPixel %p, uLen %d, uvStride %d, vPixel %p, vLen %d",
+       yPixel, yLen, yuvImage.yRowStride, yuvImage.uvPixelStride, uPixel, uLen, yuvImage.uvRowStride, vPixel, vLen);
+  return yuvImage;
 }
 
 /**
@@ -247,39 +224,14 @@ bool ImageReader::DisplayImage(ANativeWindow_Buffer* buf, AImage* image) {
  *   Refer to:
  * https://mathbits.com/MathBits/TISection/Geometry/Transformations2.htm
  */
-void ImageReader::PresentImage(ANativeWindow_Buffer * buf, AImage* image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-    LOGI("yPixel %p, yLen %d, yStride %d, uvPixelStride %d, uPixel %p, uLen %d, uvStride %d, vPixel %p, vLen %d", yPixel, yLen, yStride, uvPixelStride, uPixel, uLen, uvStride, vPixel, vLen);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t* out = static_cast<uint32_t*>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t* pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t* pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t* pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += buf->stride;
-  }
+void ImageReader::PresentImage(ANativeWindow_Buffer* buf, AImage* image) {
+  yuv::Rect crop;
+  const yuv::Image yuvImage = GetYuvImage(image, &crop);
+  crop.height = std::min(buf->height, crop.height);
+  crop.width = std::min(buf->width, crop.width);
+
+  converter_.convert(yuvImage, crop, 0, static_cast<uint32_t*>(buf->bits),
+                     buf->stride);
 }
 
 /*
@@ -288,39 +240,14 @@ void ImageReader::PresentImage(ANativeWindow_Buffer * buf, AImage* image) {
  *   Rotation image anti-clockwise 90 degree -- (x, y) --> (-y, x)
  */
 void ImageReader::PresentImage90(ANativeWindow_Buffer* buf, AImage* image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t* out = static_cast<uint32_t*>(buf->bits);
-  out += height - 1;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t* pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t* pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t* pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // [x, y]--> [-y, x]
-      out[x * buf->stride] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= 1;  // move to the next column
-  }
+  yuv::Rect crop;
+  const yuv::Image yuvImage = GetYuvImage(image, &crop);
+  crop.height = std::min(buf->width, crop.height);
+  crop.width = std::min(buf->height, crop.width);
+
+  // [x, y]--> [-y, x], converted and transposed a tile at a time
+  converter_.convert(yuvImage, crop, 90, static_cast<uint32_t*>(buf->bits),
+                     buf->stride);
 }
 
 /*
@@ -329,41 +256,14 @@ void ImageReader::PresentImage90(ANativeWindow_Buffer* buf, AImage* image) {
  *   Rotate image 180 degree: (x, y) --> (-x, -y)
  */
 void ImageReader::PresentImage180(ANativeWindow_Buffer* buf, AImage* image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-    LOGI("yPixel %p, yLen %d, yStride %d, uvPixelStride %d, uPixel %p, uLen %d, uvStride %d, vPixel %p, vLen %d", yPixel, yLen, yStride, uvPixelStride, uPixel, uLen, uvStride, vPixel, vLen);
-
-  uint32_t* out = static_cast<uint32_t*>(buf->bits);
-  out += (height - 1) * buf->stride;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t* pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t* pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t* pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // mirror image since we are using front camera
-      out[width - 1 - x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-      // out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= buf->stride;
-  }
+  yuv::Rect crop;
+  const yuv::Image yuvImage = GetYuvImage(image, &crop);
+  crop.height = std::min(buf->height, crop.height);
+  crop.width = std::min(buf->width, crop.width);
+
+  // mirror image since we are using front camera
+  converter_.convert(yuvImage, crop, 180, static_cast<uint32_t*>(buf->bits),
+                     buf->stride);
 }
 
 /*
@@ -372,39 +272,13 @@ void ImageReader::PresentImage180(ANativeWindow_Buffer* buf, AImage* image) {
  *   Rotate Image counter-clockwise 270 degree: (x, y) --> (y, x)
  */
 void ImageReader::PresentImage270(ANativeWindow_Buffer* buf, AImage* image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-    LOGI("yPixel %p, yLen %d, yStride %d, uvPixelStride %d, uPixel %p, uLen %d, uvStride %d, vPixel %p, vLen %d", yPixel, yLen, yStride, uvPixelStride, uPixel, uLen, uvStride, vPixel, vLen);
-
-  uint32_t* out = static_cast<uint32_t*>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t* pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
+  yuv::Rect crop;
+  const yuv::Image yuvImage = GetYuvImage(image, &crop);
+  crop.height = std::min(buf->width, crop.height);
+  crop.width = std::min(buf->height, crop.width);
 
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t* pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t* pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[(width - 1 - x) * buf->stride] =
-          YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += 1;  // move to the next column
-  }
+  converter_.convert(yuvImage, crop, 270, static_cast<uint32_t*>(buf->bits),
+                     buf->stride);
 }
 void ImageReader::SetPresentRotation(int32_t angle) {
   presentRotation_ = angle;
@@ -19,6 +19,8 @@
 #include <media/NdkImageReader.h>
 
 #include <functional>
+
+#include "frame_converter.h"
 /*
  * ImageFormat:
  *     A Data Structure to communicate resolution between camera and ImageReader
@@ -106,6 +108,9 @@ class ImageReader {
   std::function<void(void* ctx, const char* fileName)> callback_;
   void* callbackCtx_;
 
+  // Converts the frames in row bands on a pool of pinned threads
+  yuv::FrameConverter converter_;
+
   void PresentImage(ANativeWindow_Buffer* buf, AImage* image);
   void PresentImage90(ANativeWindow_Buffer* buf, AImage* image);
   void PresentImage180(ANativeWindow_Buffer* buf, AImage* image);
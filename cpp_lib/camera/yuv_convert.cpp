@@ -0,0 +1,356 @@
+#include "yuv_convert.h"
+
+#include <cstddef>
+
+#if defined(__ARM_NEON)
+#    include <arm_neon.h>
+#    define YUV_SIMD_NEON 1
+#elif defined(__SSE2__)
+#    include <emmintrin.h>
+#    define YUV_SIMD_SSE 1
+#endif
+
+namespace yuv {
+    namespace {
+        constexpr int32_t kVectorPixels = 16;
+        constexpr int32_t kTileRows = 4;
+
+        struct RowPlanes {
+            const uint8_t* y;
+            const uint8_t* u;
+            const uint8_t* v;
+        };
+
+        RowPlanes rowPlanes(const Image& image, int32_t row) {
+            const size_t uvOffset = static_cast<size_t>(row >> 1) * image.uvRowStride;
+            return {image.y + static_cast<size_t>(row) * image.yRowStride, image.u + uvOffset, image.v + uvOffset};
+        }
+
+        // Where pixel (x, y) of the crop goes when rotated, @see convertRotate90() and convertRotate270().
+        inline uint32_t* rotatedPixel(const Rect& crop, bool rotate90, uint32_t* out, int32_t outStride, int32_t x,
+                                      int32_t y) {
+            return rotate90 ? out + static_cast<size_t>(x) * outStride + (crop.height - 1 - y)
+                            : out + static_cast<size_t>(crop.width - 1 - x) * outStride + y;
+        }
+
+        // Columns x from xBegin to xEnd of rows y from yBegin to yEnd of the crop, pixel by pixel.
+        void convertRotatedPixels(const Image& image, const Rect& crop, int32_t xBegin, int32_t xEnd, int32_t yBegin,
+                                  int32_t yEnd, bool rotate90, uint32_t* out, int32_t outStride) {
+            for (int32_t y = yBegin; y < yEnd; ++y) {
+                const RowPlanes planes = rowPlanes(image, crop.top + y);
+                for (int32_t x = xBegin; x < xEnd; ++x) {
+                    const int32_t column = crop.left + x;
+                    const size_t  chroma = static_cast<size_t>(column >> 1) * image.uvPixelStride;
+                    *rotatedPixel(crop, rotate90, out, outStride, x, y) =
+                            toRgba(planes.y[column], planes.u[chroma], planes.v[chroma]);
+                }
+            }
+        }
+
+#if YUV_SIMD_NEON
+        // Shift the 32 bit sums down by 10 and saturate them to 8 bits, as the clamp of toRgba() does.
+        inline uint8x8_t narrow(int32x4_t low, int32x4_t high) {
+            return vqmovn_u16(vcombine_u16(vqshrun_n_s32(low, 10), vqshrun_n_s32(high, 10)));
+        }
+
+        inline uint8x8x4_t convert8(uint8x8_t y8, uint8x8_t u8, uint8x8_t v8) {
+            const int16x8_t y = vmaxq_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y8)), vdupq_n_s16(16)),
+                                          vdupq_n_s16(0));
+            const int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), vdupq_n_s16(128));
+            const int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), vdupq_n_s16(128));
+            const int32x4_t yLow = vmull_n_s16(vget_low_s16(y), 1192);
+            const int32x4_t yHigh = vmull_n_s16(vget_high_s16(y), 1192);
+            uint8x8x4_t     rgba;
+            rgba.val[0] = narrow(vmlal_n_s16(yLow, vget_low_s16(v), 1634), vmlal_n_s16(yHigh, vget_high_s16(v), 1634));
+            rgba.val[1] = narrow(vmlsl_n_s16(vmlsl_n_s16(yLow, vget_low_s16(v), 833), vget_low_s16(u), 400),
+                                 vmlsl_n_s16(vmlsl_n_s16(yHigh, vget_high_s16(v), 833), vget_high_s16(u), 400));
+            rgba.val[2] = narrow(vmlal_n_s16(yLow, vget_low_s16(u), 2066), vmlal_n_s16(yHigh, vget_high_s16(u), 2066));
+            rgba.val[3] = vdup_n_u8(0xff);
+            return rgba;
+        }
+
+        // 16 pixels from an even column, with the 8 chroma samples they share, as two groups of 8.
+        template <int32_t kUvPixelStride>
+        inline void convert16(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8x8x4_t& low,
+                              uint8x8x4_t& high) {
+            uint8x8_t u8;
+            uint8x8_t v8;
+            if constexpr (kUvPixelStride == 1) {
+                u8 = vld1_u8(u);
+                v8 = vld1_u8(v);
+            } else {
+                u8 = vld2_u8(u).val[0];
+                v8 = vld2_u8(v).val[0];
+            }
+            const uint8x8x2_t uPairs = vzip_u8(u8, u8);
+            const uint8x8x2_t vPairs = vzip_u8(v8, v8);
+            const uint8x16_t  y16 = vld1q_u8(y);
+            low = convert8(vget_low_u8(y16), uPairs.val[0], vPairs.val[0]);
+            high = convert8(vget_high_u8(y16), uPairs.val[1], vPairs.val[1]);
+        }
+
+        template <int32_t kUvPixelStride>
+        inline void convert16(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* out) {
+            uint8x8x4_t low;
+            uint8x8x4_t high;
+            convert16<kUvPixelStride>(y, u, v, low, high);
+            auto* bytes = reinterpret_cast<uint8_t*>(out);
+            vst4_u8(bytes, low);
+            vst4_u8(bytes + 32, high);
+        }
+
+        using Pixels4 = uint32x4_t;
+
+        // The same 16 pixels kept in registers, four to a vector.
+        template <int32_t kUvPixelStride>
+        inline void convert16(const uint8_t* y, const uint8_t* u, const uint8_t* v, Pixels4 (&pixels)[4]) {
+            uint8x8x4_t halves[2];
+            convert16<kUvPixelStride>(y, u, v, halves[0], halves[1]);
+            for (int32_t half = 0; half < 2; ++half) {
+                const uint8x8x2_t rg = vzip_u8(halves[half].val[0], halves[half].val[1]);
+                const uint8x8x2_t ba = vzip_u8(halves[half].val[2], halves[half].val[3]);
+                for (int32_t quarter = 0; quarter < 2; ++quarter) {
+                    const uint16x4x2_t rgba = vzip_u16(vreinterpret_u16_u8(rg.val[quarter]),
+                                                       vreinterpret_u16_u8(ba.val[quarter]));
+                    pixels[2 * half + quarter] = vreinterpretq_u32_u16(vcombine_u16(rgba.val[0], rgba.val[1]));
+                }
+            }
+        }
+
+        inline void store(uint32_t* out, Pixels4 pixels) { vst1q_u32(out, pixels); }
+
+        // Rows of four pixels to columns.
+        inline void transpose(Pixels4& a, Pixels4& b, Pixels4& c, Pixels4& d) {
+            const uint32x4x2_t ab = vtrnq_u32(a, b);
+            const uint32x4x2_t cd = vtrnq_u32(c, d);
+            a = vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0]));
+            b = vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1]));
+            c = vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0]));
+            d = vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]));
+        }
+#elif YUV_SIMD_SSE
+        // Shift the 32 bit sums down by 10 and pack them to 16 bits, saturated to 8 bits by the caller.
+        inline __m128i narrow(__m128i low, __m128i high) {
+            return _mm_packs_epi32(_mm_srai_epi32(low, 10), _mm_srai_epi32(high, 10));
+        }
+
+        // 8 pixels as 16 bit lanes, the channels come back as 16 bit lanes. Each sum is one multiply-add
+        // of interleaved pairs of lanes.
+        inline void convert8(__m128i y, __m128i u, __m128i v, __m128i& r, __m128i& g, __m128i& b) {
+            const __m128i zero = _mm_setzero_si128();
+            y = _mm_max_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), zero);
+            u = _mm_sub_epi16(u, _mm_set1_epi16(128));
+            v = _mm_sub_epi16(v, _mm_set1_epi16(128));
+            const __m128i yvLow = _mm_unpacklo_epi16(y, v);
+            const __m128i yvHigh = _mm_unpackhi_epi16(y, v);
+            const __m128i yuLow = _mm_unpacklo_epi16(y, u);
+            const __m128i yuHigh = _mm_unpackhi_epi16(y, u);
+            const __m128i uLow = _mm_unpacklo_epi16(u, zero);
+            const __m128i uHigh = _mm_unpackhi_epi16(u, zero);
+            const __m128i red = _mm_setr_epi16(1192, 1634, 1192, 1634, 1192, 1634, 1192, 1634);
+            const __m128i green = _mm_setr_epi16(1192, -833, 1192, -833, 1192, -833, 1192, -833);
+            const __m128i greenU = _mm_setr_epi16(-400, 0, -400, 0, -400, 0, -400, 0);
+            const __m128i blue = _mm_setr_epi16(1192, 2066, 1192, 2066, 1192, 2066, 1192, 2066);
+            r = narrow(_mm_madd_epi16(yvLow, red), _mm_madd_epi16(yvHigh, red));
+            g = narrow(_mm_add_epi32(_mm_madd_epi16(yvLow, green), _mm_madd_epi16(uLow, greenU)),
+                       _mm_add_epi32(_mm_madd_epi16(yvHigh, green), _mm_madd_epi16(uHigh, greenU)));
+            b = narrow(_mm_madd_epi16(yuLow, blue), _mm_madd_epi16(yuHigh, blue));
+        }
+
+        using Pixels4 = __m128i;
+
+        // 16 pixels from an even column, with the 8 chroma samples they share, four to a vector.
+        template <int32_t kUvPixelStride>
+        inline void convert16(const uint8_t* y, const uint8_t* u, const uint8_t* v, Pixels4 (&pixels)[4]) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i       u16;
+            __m128i       v16;
+            if constexpr (kUvPixelStride == 1) {
+                u16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u)), zero);
+                v16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v)), zero);
+            } else {
+                const __m128i evenBytes = _mm_set1_epi16(0x00ff);
+                u16 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u)), evenBytes);
+                v16 = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v)), evenBytes);
+            }
+            const __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y));
+            __m128i       r[2];
+            __m128i       g[2];
+            __m128i       b[2];
+            convert8(_mm_unpacklo_epi8(y8, zero), _mm_unpacklo_epi16(u16, u16), _mm_unpacklo_epi16(v16, v16), r[0],
+                     g[0], b[0]);
+            convert8(_mm_unpackhi_epi8(y8, zero), _mm_unpackhi_epi16(u16, u16), _mm_unpackhi_epi16(v16, v16), r[1],
+                     g[1], b[1]);
+            const __m128i red = _mm_packus_epi16(r[0], r[1]);
+            const __m128i green = _mm_packus_epi16(g[0], g[1]);
+            const __m128i blue = _mm_packus_epi16(b[0], b[1]);
+            const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+            const __m128i rgLow = _mm_unpacklo_epi8(red, green);
+            const __m128i rgHigh = _mm_unpackhi_epi8(red, green);
+            const __m128i baLow = _mm_unpacklo_epi8(blue, alpha);
+            const __m128i baHigh = _mm_unpackhi_epi8(blue, alpha);
+            pixels[0] = _mm_unpacklo_epi16(rgLow, baLow);
+            pixels[1] = _mm_unpackhi_epi16(rgLow, baLow);
+            pixels[2] = _mm_unpacklo_epi16(rgHigh, baHigh);
+            pixels[3] = _mm_unpackhi_epi16(rgHigh, baHigh);
+        }
+
+        inline void store(uint32_t* out, Pixels4 pixels) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), pixels);
+        }
+
+        template <int32_t kUvPixelStride>
+        inline void convert16(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* out) {
+            Pixels4 pixels[4];
+            convert16<kUvPixelStride>(y, u, v, pixels);
+            for (int32_t i = 0; i < 4; ++i) {
+                store(out + 4 * i, pixels[i]);
+            }
+        }
+
+        // Rows of four pixels to columns.
+        inline void transpose(Pixels4& a, Pixels4& b, Pixels4& c, Pixels4& d) {
+            const __m128i ab01 = _mm_unpacklo_epi32(a, b);
+            const __m128i cd01 = _mm_unpacklo_epi32(c, d);
+            const __m128i ab23 = _mm_unpackhi_epi32(a, b);
+            const __m128i cd23 = _mm_unpackhi_epi32(c, d);
+            a = _mm_unpacklo_epi64(ab01, cd01);
+            b = _mm_unpackhi_epi64(ab01, cd01);
+            c = _mm_unpacklo_epi64(ab23, cd23);
+            d = _mm_unpackhi_epi64(ab23, cd23);
+        }
+#endif
+
+#if YUV_SIMD_NEON || YUV_SIMD_SSE
+        template <int32_t kUvPixelStride>
+        void convertRowVector(const Image& image, int32_t row, int32_t left, int32_t width, uint32_t* out) {
+            const RowPlanes planes = rowPlanes(image, row);
+            int32_t         x = 0;
+            // Start the vectors on a pair of pixels which share their chroma.
+            if ((left & 1) != 0 && width > 0) {
+                const size_t chroma = static_cast<size_t>(left >> 1) * kUvPixelStride;
+                out[0] = toRgba(planes.y[left], planes.u[chroma], planes.v[chroma]);
+                x = 1;
+            }
+            // Semi-planar chroma is loaded 16 bytes for 8 samples; the last byte belongs to the sample of
+            // the pixel after the vector, which must be in the row.
+            const int32_t lastVector = width - kVectorPixels - (kUvPixelStride == 2 ? 1 : 0);
+            for (; x <= lastVector; x += kVectorPixels) {
+                const int32_t column = left + x;
+                const size_t  chroma = static_cast<size_t>(column >> 1) * kUvPixelStride;
+                convert16<kUvPixelStride>(planes.y + column, planes.u + chroma, planes.v + chroma, out + x);
+            }
+            for (; x < width; ++x) {
+                const int32_t column = left + x;
+                const size_t  chroma = static_cast<size_t>(column >> 1) * kUvPixelStride;
+                out[x] = toRgba(planes.y[column], planes.u[chroma], planes.v[chroma]);
+            }
+        }
+
+        /**
+         * Tiles of kTileRows rows by kVectorPixels columns, from column tileLeft (even in the image) to
+         * tileRight and from row 0 to tileBottom of the crop. Each row of a tile is converted into four
+         * vectors, each 4 by 4 block of them is transposed and the columns are stored as rows of out.
+         *
+         * The tiles go down a strip of columns before the next one, so the kVectorPixels rows of out a
+         * strip lands in are each written front to back, whole cache lines at a time. Bands of rows
+         * across the width measured slower and noisier: they leave every row of out a partial line.
+         */
+        template <int32_t kUvPixelStride, bool kRotate90>
+        void convertRotatedTiles(const Image& image, const Rect& crop, int32_t tileLeft, int32_t tileRight,
+                                 int32_t tileBottom, uint32_t* out, int32_t outStride) {
+            for (int32_t x = tileLeft; x < tileRight; x += kVectorPixels) {
+                const int32_t column = crop.left + x;
+                const size_t  chroma = static_cast<size_t>(column >> 1) * kUvPixelStride;
+                for (int32_t y = 0; y < tileBottom; y += kTileRows) {
+                    // In the order the rows land in the output: bottom up when rotating by 90.
+                    Pixels4 pixels[kTileRows][4];
+                    for (int32_t row = 0; row < kTileRows; ++row) {
+                        const RowPlanes planes = rowPlanes(image, crop.top + y + row);
+                        convert16<kUvPixelStride>(planes.y + column, planes.u + chroma, planes.v + chroma,
+                                                  pixels[kRotate90 ? kTileRows - 1 - row : row]);
+                    }
+                    for (int32_t group = 0; group < 4; ++group) {
+                        transpose(pixels[0][group], pixels[1][group], pixels[2][group], pixels[3][group]);
+                        for (int32_t i = 0; i < 4; ++i) {
+                            const int32_t sourceColumn = x + 4 * group + i;
+                            const size_t  outRow = kRotate90 ? sourceColumn : crop.width - 1 - sourceColumn;
+                            uint32_t*     first = out + outRow * outStride
+                                                + (kRotate90 ? crop.height - kTileRows - y : y);
+                            store(first, pixels[i][group]);
+                        }
+                    }
+                }
+            }
+        }
+#endif
+
+        void convertRotated(const Image& image, const Rect& crop, bool rotate90, uint32_t* out, int32_t outStride) {
+            int32_t tileLeft = 0;
+            int32_t tileRight = 0;
+            int32_t tileBottom = 0;
+#if YUV_SIMD_NEON || YUV_SIMD_SSE
+            if (image.uvPixelStride == 1 || image.uvPixelStride == 2) {
+                // As for the rows, tiles start on an even column and leave the last pixel to semi-planar chroma.
+                tileLeft = crop.left & 1;
+                const int32_t spare = image.uvPixelStride == 2 ? 1 : 0;
+                tileRight = tileLeft + std::max(0, (crop.width - tileLeft - spare) / kVectorPixels) * kVectorPixels;
+                tileBottom = crop.height / kTileRows * kTileRows;
+                const auto tiles = image.uvPixelStride == 1
+                                           ? (rotate90 ? convertRotatedTiles<1, true> : convertRotatedTiles<1, false>)
+                                           : (rotate90 ? convertRotatedTiles<2, true> : convertRotatedTiles<2, false>);
+                tiles(image, crop, tileLeft, tileRight, tileBottom, out, outStride);
+            }
+#endif
+            // What the tiles leave out: the first column, the last columns and the last rows.
+            convertRotatedPixels(image, crop, 0, tileLeft, 0, crop.height, rotate90, out, outStride);
+            convertRotatedPixels(image, crop, tileRight, crop.width, 0, crop.height, rotate90, out, outStride);
+            convertRotatedPixels(image, crop, tileLeft, tileRight, tileBottom, crop.height, rotate90, out, outStride);
+        }
+    }  // namespace
+
+    void convertRow(const Image& image, int32_t row, int32_t left, int32_t width, uint32_t* out) {
+#if YUV_SIMD_NEON || YUV_SIMD_SSE
+        if (image.uvPixelStride == 1) {
+            convertRowVector<1>(image, row, left, width, out);
+            return;
+        }
+        if (image.uvPixelStride == 2) {
+            convertRowVector<2>(image, row, left, width, out);
+            return;
+        }
+#endif
+        convertRowReference(image, row, left, width, out);
+    }
+
+    void convertRowReference(const Image& image, int32_t row, int32_t left, int32_t width, uint32_t* out) {
+        const RowPlanes planes = rowPlanes(image, row);
+        for (int32_t x = 0; x < width; ++x) {
+            const int32_t column = left + x;
+            const size_t  chroma = static_cast<size_t>(column >> 1) * image.uvPixelStride;
+            out[x] = toRgba(planes.y[column], planes.u[chroma], planes.v[chroma]);
+        }
+    }
+
+    void convert(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride) {
+        for (int32_t row = 0; row < crop.height; ++row) {
+            convertRow(image, crop.top + row, crop.left, crop.width, out + static_cast<size_t>(row) * outStride);
+        }
+    }
+
+    void convertRotate90(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride) {
+        convertRotated(image, crop, true, out, outStride);
+    }
+
+    void convertRotate270(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride) {
+        convertRotated(image, crop, false, out, outStride);
+    }
+
+    void convertRotate180(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride) {
+        for (int32_t row = 0; row < crop.height; ++row) {
+            uint32_t* outRow = out + static_cast<size_t>(crop.height - 1 - row) * outStride;
+            convertRow(image, crop.top + row, crop.left, crop.width, outRow);
+            std::reverse(outRow, outRow + crop.width);
+        }
+    }
+}  // namespace yuv
@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * YUV_420_888 to RGBA_8888 conversion for the camera preview.
+ *
+ * The math is the integer BT.601 video range conversion of the NDK camera sample (from the Tensorflow
+ * yuv2rgb code), kept bit exact: toRgba() is the scalar reference, convertRow() runs the same math
+ * 16 pixels at a time with NEON on arm64 and SSE2 on the x86 host build, and the reference on what is
+ * left of the row. Both chroma layouts YUV_420_888 comes in are handled: planar (I420, a pixel stride
+ * of 1) and semi-planar (NV12 or NV21, a pixel stride of 2, with u and v pointing into the same
+ * interleaved plane). Other pixel strides take the reference path.
+ *
+ * The rotated conversions work on tiles of 4 rows by 16 columns, converted into registers, transposed
+ * there in blocks of 4 by 4 and stored as whole rows of the output, rather than walking a column of
+ * the output for each row of the image.
+ */
+namespace yuv {
+    /**
+     * The planes of a YUV_420_888 image, as AImage reports them. The chroma planes are subsampled by
+     * two in both directions.
+     */
+    struct Image {
+        const uint8_t* y = nullptr;
+        const uint8_t* u = nullptr;
+        const uint8_t* v = nullptr;
+        int32_t        yRowStride = 0;
+        int32_t        uvRowStride = 0;
+        int32_t        uvPixelStride = 1;
+    };
+
+    struct Rect {
+        int32_t left = 0;
+        int32_t top = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    // 2^18 - 1, the channels are clamped to it before they are scaled down to 8 bits.
+    constexpr int kMaxChannelValue = 262143;
+
+    /**
+     * One pixel, as a little endian RGBA word: R in the lowest byte and an opaque alpha.
+     */
+    inline uint32_t toRgba(int y, int u, int v) {
+        y = std::max(0, y - 16);
+        u -= 128;
+        v -= 128;
+        // In floating point: r = 1.164 y + 1.596 v, g = 1.164 y - 0.813 v - 0.391 u, b = 1.164 y + 2.018 u
+        const uint32_t r = std::clamp(1192 * y + 1634 * v, 0, kMaxChannelValue) >> 10;
+        const uint32_t g = std::clamp(1192 * y - 833 * v - 400 * u, 0, kMaxChannelValue) >> 10;
+        const uint32_t b = std::clamp(1192 * y + 2066 * u, 0, kMaxChannelValue) >> 10;
+        return 0xff000000u | (b << 16) | (g << 8) | r;
+    }
+
+    /**
+     * Convert width pixels of a row of the image, from column left on, into out.
+     */
+    void convertRow(const Image& image, int32_t row, int32_t left, int32_t width, uint32_t* out);
+
+    /**
+     * The same with toRgba() for every pixel, to check convertRow() against.
+     */
+    void convertRowReference(const Image& image, int32_t row, int32_t left, int32_t width, uint32_t* out);
+
+    /**
+     * Convert the pixels of the image inside crop into out, whose rows are outStride pixels apart.
+     */
+    void convert(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride);
+
+    /**
+     * The same turned a quarter clockwise: pixel (x, y) of the crop goes to row x, column
+     * crop.height - 1 - y of out.
+     */
+    void convertRotate90(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride);
+
+    /**
+     * The same turned a quarter counter-clockwise: pixel (x, y) of the crop goes to row
+     * crop.width - 1 - x, column y of out.
+     */
+    void convertRotate270(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride);
+
+    /**
+     * The same turned half a turn: pixel (x, y) of the crop goes to row crop.height - 1 - y, column
+     * crop.width - 1 - x of out.
+     */
+    void convertRotate180(const Image& image, const Rect& crop, uint32_t* out, int32_t outStride);
+}  // namespace yuv
@@ -0,0 +1,246 @@
+/**
+ * Host benchmark for the IMA-ADPCM clip storage.
+ *
+ * It caches the robot clips as float and as IMA-ADPCM and compares their memory with the MP3 files,
+ * checks the SIMD group decoder against the scalar one bit for bit for 1, 2 and 4 channels, the
+ * quality of the round trip, and that the mixer plays a compressed clip exactly as decoded whatever
+ * the burst sizes. Then it times the callback: mixing voices of float clips, of IMA-ADPCM clips, and
+ * decoding the MP3s in the callback instead.
+ *
+ * Usage: adpcm_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClipCache.h"
+#include "ImaAdpcm.h"
+#include "PcmDecoder.h"
+#include "VoiceMixer.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int32_t kVoices = 8;
+    constexpr int     kDecodePasses = 2000;
+    constexpr double  kMinSnrDb = 18.0;
+    constexpr double  kMinCompression = 7.0;  // against float
+    const char* const kClipNames[] = {"robot_boot.mp3", "robot_random_code.mp3", "robot_thankyou.mp3"};
+
+    std::vector<float> decodeAll(const PcmClip& clip, bool simd) {
+        std::vector<float> out(ima_adpcm::groupCount(clip.frames, clip.channelCount) * ima_adpcm::kGroupSamples);
+        for (size_t group = 0; group * ima_adpcm::kGroupBytes < clip.adpcm.size(); ++group) {
+            const uint8_t* data = clip.adpcm.data() + group * ima_adpcm::kGroupBytes;
+            float*         samples = out.data() + group * ima_adpcm::kGroupSamples;
+            if (simd) {
+                ima_adpcm::decodeGroup(data, clip.channelCount, samples);
+            } else {
+                ima_adpcm::decodeGroupScalar(data, clip.channelCount, samples);
+            }
+        }
+        out.resize(static_cast<size_t>(clip.frames) * clip.channelCount);
+        return out;
+    }
+
+    double snrDb(const std::vector<float>& reference, const std::vector<float>& decoded) {
+        double signal = 0.0;
+        double noise = 0.0;
+        for (size_t i = 0; i < reference.size(); ++i) {
+            signal += double(reference[i]) * reference[i];
+            noise += (double(decoded[i]) - reference[i]) * (double(decoded[i]) - reference[i]);
+        }
+        return 10.0 * std::log10(signal / std::max(noise, 1e-20));
+    }
+
+    // The SIMD decoder gives the scalar one's samples, and the round trip sounds like the clip.
+    bool checkRoundTrip(const PcmClip& original, double& snr) {
+        PcmClip clip;
+        clip.name = original.name;
+        clip.samples = original.samples;
+        clip.frames = original.frames;
+        clip.sampleRate = original.sampleRate;
+        clip.channelCount = original.channelCount;
+        ClipCache::compress(clip);
+        const std::vector<float> simd = decodeAll(clip, true);
+        const std::vector<float> scalar = decodeAll(clip, false);
+        snr = snrDb(original.samples, simd);
+        return check(clip.isCompressed() && simd == scalar, "the SIMD decoder differs from the scalar one");
+    }
+
+    // Render a clip through the mixer in bursts of varying size.
+    std::vector<float> renderClip(const PcmClip& clip, float gain) {
+        VoiceMixer         mixer(clip.sampleRate, clip.channelCount);
+        std::vector<float> out;
+        std::vector<float> burst(static_cast<size_t>(kBurstFrames) * clip.channelCount);
+        mixer.play(&clip, gain);
+        for (int32_t frames = 0, burstFrames = 1; frames < clip.frames; frames += burstFrames) {
+            burstFrames = 1 + (frames * 7 + 13) % kBurstFrames;
+            mixer.renderAudio(burst.data(), burstFrames);
+            out.insert(out.end(), burst.begin(), burst.begin() + static_cast<size_t>(burstFrames) * clip.channelCount);
+        }
+        out.resize(static_cast<size_t>(clip.frames) * clip.channelCount);
+        return out;
+    }
+
+    // Mean and worst callback time of kVoices voices of the clips, restarted whenever they end.
+    void timeMixer(const std::vector<const PcmClip*>& clips, double& meanNanos, double& maxNanos) {
+        VoiceMixer         mixer(kSampleRate, clips[0]->channelCount, kVoices);
+        std::vector<float> burst(static_cast<size_t>(kBurstFrames) * clips[0]->channelCount);
+        for (int32_t voice = 0; voice < kVoices; ++voice) {
+            mixer.play(clips[voice % clips.size()], 0.1f);
+        }
+        int64_t total = 0;
+        int64_t worst = 0;
+        int     bursts = 0;
+        for (int pass = 0; pass < kDecodePasses; ++pass, ++bursts) {
+            for (int32_t voice = mixer.getActiveVoiceCount(); voice < kVoices; ++voice) {
+                mixer.play(clips[voice % clips.size()], 0.1f);
+            }
+            const int64_t start = benchNowNanos();
+            mixer.renderAudio(burst.data(), kBurstFrames);
+            const int64_t nanos = benchNowNanos() - start;
+            total += nanos;
+            worst = std::max(worst, nanos);
+        }
+        meanNanos = double(total) / bursts;
+        maxNanos = double(worst);
+    }
+
+    // Mean time to decode a burst of every clip's MP3, what the callback would spend without a cache.
+    double timeMp3(const std::vector<std::vector<uint8_t>>& files) {
+        std::vector<std::unique_ptr<PcmDecoder>> decoders;
+        std::vector<float>                       burst(kBurstFrames * 2);
+        int64_t                                  total = 0;
+        int                                      bursts = 0;
+        for (int pass = 0; pass < kDecodePasses; ++pass) {
+            for (int32_t voice = 0; voice < kVoices; ++voice) {
+                if (decoders.size() <= static_cast<size_t>(voice)) {
+                    decoders.push_back(nullptr);
+                }
+                if (decoders[voice] == nullptr) {
+                    const std::vector<uint8_t>& file = files[voice % files.size()];
+                    decoders[voice] = PcmDecoder::open(file.data(), file.size());
+                }
+                const int64_t start = benchNowNanos();
+                const bool    ended = decoders[voice]->read(burst.data(), kBurstFrames) < kBurstFrames;
+                total += benchNowNanos() - start;
+                if (ended) {
+                    decoders[voice].reset();
+                }
+            }
+            ++bursts;
+        }
+        return double(total) / bursts;
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    std::vector<std::vector<uint8_t>> files;
+    for (const char* name : kClipNames) {
+        files.push_back(readFile(assetDir + "/" + name));
+        if (files.back().empty()) {
+            fprintf(stderr, "Cannot read %s/%s\n", assetDir.c_str(), name);
+            return 1;
+        }
+    }
+
+    // Memory of each tier, stereo at 48 kHz
+    ClipCache floatCache;
+    ClipCache adpcmCache;
+    floatCache.setFormat(kSampleRate, 2);
+    adpcmCache.setFormat(kSampleRate, 2);
+    adpcmCache.setStorage(ClipStorage::Adpcm);
+    size_t                      mp3Bytes = 0;
+    std::vector<const PcmClip*> floatClips;
+    std::vector<const PcmClip*> adpcmClips;
+    for (size_t i = 0; i < files.size(); ++i) {
+        floatClips.push_back(floatCache.insert(kClipNames[i], files[i].data(), files[i].size()));
+        adpcmClips.push_back(adpcmCache.insert(kClipNames[i], files[i].data(), files[i].size()));
+        mp3Bytes += files[i].size();
+        ok &= check(floatClips.back() != nullptr && adpcmClips.back() != nullptr && adpcmClips.back()->isCompressed(),
+                    "a clip could not be cached");
+    }
+    if (!ok) {
+        return 1;
+    }
+    printf("%-28s %10s %8s\n", "Stereo clips at 48 kHz", "bytes", "x float");
+    printf("%-28s %10zu %8.2f\n", "float", floatCache.getBytesUsed(), 1.0);
+    printf("%-28s %10zu %8.2f\n", "IMA-ADPCM", adpcmCache.getBytesUsed(),
+           double(floatCache.getBytesUsed()) / adpcmCache.getBytesUsed());
+    printf("%-28s %10zu %8.2f\n", "MP3 files", mp3Bytes, double(floatCache.getBytesUsed()) / mp3Bytes);
+    printf("IMA-ADPCM cache reports %zu bytes saved\n", adpcmCache.getBytesSaved());
+    ok &= check(double(floatCache.getBytesUsed()) / adpcmCache.getBytesUsed() >= kMinCompression,
+                "IMA-ADPCM takes more memory than expected");
+    ok &= check(adpcmCache.getBytesUsed() + adpcmCache.getBytesSaved() >= floatCache.getBytesUsed() - 1024
+                && adpcmCache.getBytesUsed() + adpcmCache.getBytesSaved() <= floatCache.getBytesUsed() + 1024,
+                "the bytes saved do not add up");
+
+    // Round trips in 1, 2 and 4 channels
+    printf("\n%-28s %8s\n", "Round trip", "SNR dB");
+    for (int32_t channels : {1, 2, 4}) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            auto   clip = ClipCache::decode(kClipNames[i], files[i].data(), files[i].size(), kSampleRate, channels);
+            double snr = 0.0;
+            ok &= clip != nullptr && checkRoundTrip(*clip, snr);
+            char label[64];
+            snprintf(label, sizeof(label), "%s, %d ch", kClipNames[i], channels);
+            printf("%-28s %8.1f\n", label, snr);
+            ok &= check(snr >= kMinSnrDb, "the IMA-ADPCM round trip is too noisy");
+        }
+    }
+    ok &= check(!ima_adpcm::isSupported(3) && !ima_adpcm::isSupported(6), "3 or 6 channels claimed to be supported");
+
+    // The mixer plays the decoded samples, from group to group, whatever the bursts.
+    for (const PcmClip* clip : adpcmClips) {
+        std::vector<float> expected = decodeAll(*clip, false);
+        for (float& sample : expected) {
+            sample = std::clamp(sample * 0.5f, -1.0f, 1.0f);
+        }
+        ok &= check(renderClip(*clip, 0.5f) == expected, "the mixer does not play the decoded clip");
+    }
+
+    // Callback cost
+    std::vector<float> group(ima_adpcm::kGroupSamples);
+    int64_t            start = benchNowNanos();
+    for (int pass = 0; pass < kDecodePasses; ++pass) {
+        ima_adpcm::decodeGroup(adpcmClips[0]->adpcm.data(), 2, group.data());
+        benchKeep(group[0]);
+    }
+    const double simdNanos = double(benchNowNanos() - start) / kDecodePasses;
+    start = benchNowNanos();
+    for (int pass = 0; pass < kDecodePasses; ++pass) {
+        ima_adpcm::decodeGroupScalar(adpcmClips[0]->adpcm.data(), 2, group.data());
+        benchKeep(group[0]);
+    }
+    const double scalarNanos = double(benchNowNanos() - start) / kDecodePasses;
+    printf("\nDecode of a %d sample group: SIMD %.0f ns, scalar %.0f ns (%.2f ns per sample)\n",
+           ima_adpcm::kGroupSamples, simdNanos, scalarNanos, simdNanos / ima_adpcm::kGroupSamples);
+
+    double floatMean = 0.0;
+    double floatMax = 0.0;
+    double adpcmMean = 0.0;
+    double adpcmMax = 0.0;
+    timeMixer(floatClips, floatMean, floatMax);
+    timeMixer(adpcmClips, adpcmMean, adpcmMax);
+    const double mp3Mean = timeMp3(files);
+    const double deadlineNanos = 1e9 * kBurstFrames / kSampleRate;
+    printf("\n%d stereo voices per %d frame burst    mean us   max us  %% of deadline\n", kVoices, kBurstFrames);
+    printf("%-36s %8.2f %8.2f %8.2f\n", "float clips", floatMean / 1000, floatMax / 1000,
+           100.0 * floatMean / deadlineNanos);
+    printf("%-36s %8.2f %8.2f %8.2f\n", "IMA-ADPCM clips", adpcmMean / 1000, adpcmMax / 1000,
+           100.0 * adpcmMean / deadlineNanos);
+    printf("%-36s %8.2f %8s %8.2f\n", "MP3 decoded in the callback", mp3Mean / 1000, "",
+           100.0 * mp3Mean / deadlineNanos);
+    ok &= check(adpcmMean < mp3Mean, "IMA-ADPCM costs the callback more than MP3");
+
+    printf("%s\n", ok ? "All checks passed" : "Some checks FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Helpers shared by the host benchmarks.
+
+inline int64_t benchNowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Keep the optimizer from discarding a result.
+template <typename T>
+inline void benchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Report a failed check on stderr and pass the condition on, to be folded into the exit status.
+inline bool check(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+    }
+    return condition;
+}
+
+// The whole file, or nothing if it cannot be read.
+inline std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
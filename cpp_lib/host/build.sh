@@ -0,0 +1,56 @@
+# Build the host (Linux) benchmarks for the native library.
+# Usage: bash cpp_lib/host/build.sh [bench_name ...]
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd -P)"
+SRC_DIR="$(dirname "$SCRIPT_DIR")"
+OUT_DIR=build/host
+[[ -d $OUT_DIR ]] || mkdir -p $OUT_DIR
+
+CXX=${CXX:-c++}
+CXXFLAGS="-std=c++20 -O2 -Wall -Wextra ${HOST_CXXFLAGS}"
+INCLUDES="-I$SCRIPT_DIR/shim -I$SRC_DIR -I$SRC_DIR/audio"
+
+# Library sources each benchmark links against.
+declare -A BENCH_SOURCES=(
+    [adpcm_bench]="audio/ClipCache.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/Resampler.cpp audio/VoiceMixer.cpp host/dr_libs.cpp"
+    [capture_bench]="audio/CaptureCallback.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp host/dr_libs.cpp"
+    [channel_convert_bench]=""
+    [cpu_topology_probe]="ndk_utils/cpu_topology.cpp"
+    [dither_bench]=""
+    [frame_convert_bench]="camera/frame_converter.cpp camera/yuv_convert.cpp ndk_utils/cpu_topology.cpp ndk_utils/worker_pool.cpp"
+    [fft_bench]="audio/RealFft.cpp audio/SpectrumAnalyzer.cpp ndk_utils/cpu_topology.cpp"
+    [graph_bench]="audio/AudioGraph.cpp audio/AudioNodes.cpp"
+    [clip_cache_bench]="audio/ClipCache.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/Resampler.cpp audio/VoiceMixer.cpp host/dr_libs.cpp"
+    [decode_bench]="audio/DecodeAheadSource.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/Resampler.cpp audio/StreamingSoundGenerator.cpp host/dr_libs.cpp host/render_harness.cpp ndk_utils/cpu_topology.cpp"
+    [mp3_index]="audio/Mp3FrameIndex.cpp host/dr_libs.cpp"
+    [mp3_index_bench]="audio/DecodeAheadSource.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/Resampler.cpp audio/StreamingSoundGenerator.cpp host/dr_libs.cpp ndk_utils/cpu_topology.cpp"
+    [pcm_pack]="audio/ClipCache.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/PcmPack.cpp audio/Resampler.cpp host/dr_libs.cpp"
+    [pcm_pack_bench]="audio/ClipCache.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/PcmPack.cpp audio/Resampler.cpp audio/VoiceMixer.cpp host/dr_libs.cpp"
+    [voice_mixer_bench]="audio/VoiceMixer.cpp"
+    [yuv_bench]="camera/yuv_convert.cpp"
+    [resampler_bench]="audio/Resampler.cpp"
+    [render_bench]="audio/ClipCache.cpp audio/DecodeAheadSource.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/Resampler.cpp audio/SoundGenerator.cpp audio/StreamingSoundGenerator.cpp audio/VoiceMixer.cpp host/dr_libs.cpp host/render_harness.cpp ndk_utils/cpu_topology.cpp"
+    [synth_bench]="audio/SoundGenerator.cpp host/dr_libs.cpp host/render_harness.cpp"
+    [sequencer_bench]="audio/ClipSequencer.cpp audio/DecodeAheadSource.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/Resampler.cpp host/dr_libs.cpp ndk_utils/cpu_topology.cpp"
+    [rt_check_run]="audio/AudioGraph.cpp audio/AudioNodes.cpp audio/CallbackStats.cpp audio/CaptureCallback.cpp audio/ClipCache.cpp audio/ClipSequencer.cpp audio/DecodeAheadSource.cpp audio/LatencyTuningCallback.cpp audio/Mp3FrameIndex.cpp audio/PcmDecoder.cpp audio/RealFft.cpp audio/Resampler.cpp audio/SpectrumAnalyzer.cpp audio/StreamingSoundGenerator.cpp audio/VoiceMixer.cpp host/dr_libs.cpp ndk_utils/cpu_topology.cpp ndk_utils/rt_check.cpp"
+)
+
+# Extra compiler flags per benchmark.
+declare -A BENCH_FLAGS=(
+    [graph_bench]="-Wno-mismatched-new-delete"  # it counts allocations with an operator new over malloc
+    [rt_check_run]="-DAUDIO_RT_CHECK=1 -rdynamic"  # -rdynamic names the frames in stack traces
+)
+
+benches=("$@")
+if [[ ${#benches[@]} -eq 0 ]]; then
+    benches=("${!BENCH_SOURCES[@]}")
+fi
+
+for bench in "${benches[@]}"; do
+    sources=""
+    for src in ${BENCH_SOURCES[$bench]}; do
+        sources="$sources $SRC_DIR/$src"
+    done
+    echo "Building $bench"
+    $CXX $CXXFLAGS ${BENCH_FLAGS[$bench]} $INCLUDES $SCRIPT_DIR/$bench.cpp $sources -o $OUT_DIR/$bench -lpthread -ldl \
+        || exit 1
+done
@@ -0,0 +1,400 @@
+/**
+ * Host benchmark for CaptureCallback and its VoiceActivityDetector, with a WAV file standing in for
+ * the microphone.
+ *
+ * It writes a 48 kHz stereo recording: low noise, robot_boot, a pause, a burst of loud hiss, another
+ * pause, robot_thankyou and more noise. The detector must find speech in both clips, starting near
+ * their first loud window, and nowhere in the noise or the hiss. Then the recording is played through
+ * a fake input stream at several times real time, to a consumer thread which sleeps until there is
+ * speech and reads from its start: it must wake once per speech segment, read exactly the mono mix of
+ * the recording there, and nothing may be dropped. The I16 path must find the same speech. The
+ * capture is then reopened again and again, alternating the sample rate, while a consumer thread keeps
+ * reading: the ring must carry on with the consumer's position, and each stream start where the last
+ * one stopped.
+ * It also times the SIMD window measurement against a scalar one, and the callback per burst.
+ *
+ * Usage: capture_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CaptureCallback.h"
+#include "PcmDecoder.h"
+#include "bench_util.h"
+#include "fake_capture_stream.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannelCount = 2;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr float   kNoiseRms = 0.00316f;  // -50 dBFS
+    constexpr float   kHissRms = 0.0316f;    // -30 dBFS
+    constexpr double  kStreamSpeed = 4.0;
+    constexpr int32_t kRestarts = 20;
+    constexpr int32_t kOnsetToleranceMillis = 50;
+    constexpr int     kTimingPasses = 20000;
+    const char* const kWavPath = "/tmp/capture_bench.wav";
+
+    // Where things are in the recording, in frames.
+    struct Region {
+        const char* name;
+        int64_t     begin;
+        int64_t     end;
+        bool        speech;
+    };
+
+    struct Segment {
+        int64_t begin;
+        int64_t end;
+    };
+
+    std::vector<float> decode(const std::string& path) {
+        std::vector<uint8_t> data = readFile(path);
+        std::vector<float>   pcm;
+        auto                 decoder = PcmDecoder::open(data.data(), data.size());
+        if (!decoder || decoder->getSampleRate() != kSampleRate || decoder->getChannelCount() != kChannelCount) {
+            return pcm;
+        }
+        std::vector<float> chunk(4096 * kChannelCount);
+        while (uint64_t frames = decoder->read(chunk.data(), 4096)) {
+            pcm.insert(pcm.end(), chunk.begin(), chunk.begin() + frames * kChannelCount);
+        }
+        return pcm;
+    }
+
+    class Noise {
+      public:
+        // Uniform noise of the given RMS, independent per channel.
+        float next(float rms) {
+            mSeed = mSeed * 1664525u + 1013904223u;
+            return rms * 1.7320508f * (static_cast<float>(mSeed >> 8) / 8388608.0f - 1.0f);
+        }
+
+      private:
+        uint32_t mSeed = 12345;
+    };
+
+    void appendNoise(std::vector<float>& out, Noise& noise, double seconds, float rms) {
+        for (int64_t i = 0; i < static_cast<int64_t>(seconds * kSampleRate) * kChannelCount; ++i) {
+            out.push_back(noise.next(rms));
+        }
+    }
+
+    void appendClip(std::vector<float>& out, Noise& noise, const std::vector<float>& clip) {
+        for (float sample : clip) {
+            out.push_back(sample + noise.next(kNoiseRms));
+        }
+    }
+
+    int64_t frames(const std::vector<float>& samples) { return static_cast<int64_t>(samples.size()) / kChannelCount; }
+
+    bool writeWav(const std::vector<float>& samples) {
+        drwav_data_format format;
+        format.container = drwav_container_riff;
+        format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+        format.channels = kChannelCount;
+        format.sampleRate = kSampleRate;
+        format.bitsPerSample = 32;
+        drwav wav;
+        if (!drwav_init_file_write(&wav, kWavPath, &format, nullptr)) {
+            return false;
+        }
+        const bool written = drwav_write_pcm_frames(&wav, frames(samples), samples.data())
+                             == static_cast<drwav_uint64>(frames(samples));
+        drwav_uninit(&wav);
+        return written;
+    }
+
+    // The first window of a clip whose level is clearly over the noise.
+    int64_t firstLoudFrame(const std::vector<float>& mono, const Region& clip, int32_t windowFrames) {
+        for (int64_t frame = clip.begin; frame + windowFrames <= clip.end; frame += windowFrames) {
+            if (VoiceActivityDetector::measure(mono.data() + frame, windowFrames).energy
+                > VoiceActivityDetector::kEnergyRatio * kNoiseRms * kNoiseRms) {
+                return frame;
+            }
+        }
+        return clip.end;
+    }
+
+    std::vector<Segment> detect(const std::vector<float>& mono) {
+        VoiceActivityDetector detector;
+        detector.prepare(kSampleRate);
+        std::vector<Segment> segments;
+        for (size_t frame = 0; frame < mono.size(); frame += kBurstFrames) {
+            const uint64_t count = detector.getSegmentCount();
+            const bool     wasSpeech = detector.isSpeech();
+            detector.process(mono.data() + frame, static_cast<int32_t>(std::min<size_t>(kBurstFrames,
+                                                                                        mono.size() - frame)));
+            if (detector.getSegmentCount() != count) {
+                segments.push_back({detector.getSpeechStartFrame(), -1});
+            }
+            if (wasSpeech && !detector.isSpeech()) {
+                segments.back().end = detector.getSpeechEndFrame();
+            }
+        }
+        if (!segments.empty() && segments.back().end < 0) {
+            segments.back().end = static_cast<int64_t>(mono.size());
+        }
+        return segments;
+    }
+
+    bool checkSegments(const std::vector<Segment>& segments, const std::vector<Region>& regions,
+                       const std::vector<float>& mono) {
+        bool          ok = true;
+        const int32_t windowFrames = kSampleRate * VoiceActivityDetector::kWindowMillis / 1000;
+        const int64_t tolerance = kSampleRate * kOnsetToleranceMillis / 1000;
+        for (const Segment& segment : segments) {
+            printf("  speech %7.3f s to %7.3f s\n", segment.begin / double(kSampleRate),
+                   segment.end / double(kSampleRate));
+            // Each segment starts in a clip, or just before it, and ends before the clip's hangover does.
+            bool inClip = false;
+            for (const Region& region : regions) {
+                inClip |= region.speech && segment.begin >= region.begin - tolerance && segment.begin < region.end
+                          && segment.end <= region.end + tolerance;
+            }
+            ok &= check(inClip, "speech found outside the clips");
+        }
+        for (const Region& region : regions) {
+            if (!region.speech) {
+                continue;
+            }
+            const int64_t onset = firstLoudFrame(mono, region, windowFrames);
+            const auto    first = std::find_if(segments.begin(), segments.end(), [&](const Segment& segment) {
+                return segment.end > region.begin && segment.begin < region.end;
+            });
+            if (!check(first != segments.end(), "a clip had no speech")) {
+                ok = false;
+                continue;
+            }
+            printf("  %-20s first loud window at %7.3f s, speech from %7.3f s\n", region.name,
+                   onset / double(kSampleRate), first->begin / double(kSampleRate));
+            ok &= check(std::abs(first->begin - onset) <= tolerance, "speech onset too far from the clip's");
+        }
+        return ok;
+    }
+
+    struct ConsumerResult {
+        std::vector<int64_t> wakes;  // the speech start of every wake-up
+        int64_t              framesRead = 0;
+        bool                 matches = true;
+    };
+
+    // Sleep until speech, read it from its start while it lasts, drop the rest.
+    void consume(CaptureCallback& capture, const FakeCaptureStream& stream, const std::vector<float>& mono,
+                 ConsumerResult& result) {
+        const size_t       keepFrames = static_cast<size_t>(kSampleRate) * 100 / 1000;
+        std::vector<float> block(kBurstFrames);
+        while (stream.isRunning()) {
+            if (!capture.waitForSpeech(20)) {
+                capture.keepLatest(keepFrames);
+                continue;
+            }
+            const int64_t start = capture.getVoiceActivity().getSpeechStartFrame();
+            result.wakes.push_back(start);
+            capture.skipTo(static_cast<uint64_t>(start));
+            while (capture.getVoiceActivity().isSpeech() || capture.availableToRead() > 0) {
+                const uint64_t position = capture.getReadPosition();
+                const size_t   count = capture.read(block.data(), block.size());
+                if (count == 0) {
+                    if (!stream.isRunning()) {
+                        break;
+                    }
+                    usleep(CaptureCallback::kConsumerIdleMicros);
+                    continue;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    const size_t frame = position + i;
+                    result.matches &= frame < mono.size() ? block[i] == mono[frame] : block[i] == 0.0f;
+                }
+                result.framesRead += count;
+                if (!capture.getVoiceActivity().isSpeech()) {
+                    break;  // the tail after the speech is dropped with the silence
+                }
+            }
+        }
+    }
+
+    VoiceActivityDetector::Window measureScalar(const float* samples, int32_t count) {
+        float sumSquares = 0.0f;
+        float crossings = 0.0f;
+        for (int32_t i = 0; i < count; ++i) {
+            sumSquares += samples[i] * samples[i];
+            crossings += samples[i] * samples[i - 1] < 0.0f ? 1.0f : 0.0f;
+        }
+        return {sumSquares / count, crossings / count};
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    const std::vector<float> boot = decode(assetDir + "/robot_boot.mp3");
+    const std::vector<float> thanks = decode(assetDir + "/robot_thankyou.mp3");
+    if (!check(!boot.empty() && !thanks.empty(), "the 48 kHz stereo robot clips could not be decoded")) {
+        return 1;
+    }
+
+    Noise               noise;
+    std::vector<float>  recording;
+    std::vector<Region> regions;
+    auto add = [&](const char* name, bool speech, auto append) {
+        const int64_t begin = frames(recording);
+        append();
+        regions.push_back({name, begin, frames(recording), speech});
+    };
+    add("noise", false, [&] { appendNoise(recording, noise, 1.0, kNoiseRms); });
+    add("robot_boot.mp3", true, [&] { appendClip(recording, noise, boot); });
+    add("noise", false, [&] { appendNoise(recording, noise, 1.5, kNoiseRms); });
+    add("hiss", false, [&] { appendNoise(recording, noise, 1.0, kHissRms); });
+    add("noise", false, [&] { appendNoise(recording, noise, 1.0, kNoiseRms); });
+    add("robot_thankyou.mp3", true, [&] { appendClip(recording, noise, thanks); });
+    add("noise", false, [&] { appendNoise(recording, noise, 1.0, kNoiseRms); });
+    if (!check(writeWav(recording), "cannot write the test recording")) {
+        return 1;
+    }
+
+    auto stream = FakeCaptureStream::fromWavFile(kWavPath, kBurstFrames);
+    if (!check(stream != nullptr && stream->getSamples() == recording, "the test recording reads back wrong")) {
+        return 1;
+    }
+    std::vector<float> mono(frames(recording));
+    channels::Converter(kChannelCount, 1)(recording.data(), mono.data(), mono.size());
+    printf("Recording: %.2f s at %d Hz, %d channels, %s\n", mono.size() / double(kSampleRate), kSampleRate,
+           kChannelCount, kWavPath);
+
+    // Detection
+    const std::vector<Segment> segments = detect(mono);
+    ok &= checkSegments(segments, regions, mono);
+
+    // Through the capture stream to a consumer which sleeps until speech
+    {
+        CaptureCallback capture;
+        capture.useStream(std::shared_ptr<oboe::AudioStream>(stream.get(), [](oboe::AudioStream*) { }));
+        ConsumerResult result;
+        stream->start(&capture, kStreamSpeed);
+        std::thread consumer([&] { consume(capture, *stream, mono, result); });
+        stream->join();
+        consumer.join();
+        printf("Stream at %.0fx real time: %llu callbacks, %zu wake-ups, read %lld of %zu frames, %llu dropped\n",
+               kStreamSpeed, static_cast<unsigned long long>(capture.getCallbackCount()), result.wakes.size(),
+               static_cast<long long>(result.framesRead), mono.size(),
+               static_cast<unsigned long long>(capture.getDroppedFrames()));
+        ok &= check(capture.getDroppedFrames() == 0, "frames were dropped");
+        ok &= check(result.matches, "the consumer read something else than the mono mix");
+        bool sameSpeech = result.wakes.size() == segments.size();
+        for (size_t i = 0; sameSpeech && i < segments.size(); ++i) {
+            sameSpeech = result.wakes[i] == segments[i].begin;
+        }
+        ok &= check(sameSpeech, "the consumer did not wake once at the start of every speech");
+        ok &= check(result.framesRead < static_cast<int64_t>(mono.size()) / 2, "the consumer read the silence");
+    }
+
+    // The I16 path finds the same speech and reads the mix to within the 16 bit step.
+    {
+        FakeCaptureStream i16(recording, kSampleRate, kChannelCount, kBurstFrames, oboe::AudioFormat::I16);
+        CaptureCallback   capture(static_cast<int32_t>(mono.size() * 1000 / kSampleRate) + 1000);
+        capture.useStream(std::shared_ptr<oboe::AudioStream>(&i16, [](oboe::AudioStream*) { }));
+        i16.start(&capture, 0.0);
+        i16.join();
+        std::vector<float> captured(capture.availableToRead());
+        capture.read(captured.data(), captured.size());
+        float error = 0.0f;
+        for (size_t i = 0; i < mono.size() && i < captured.size(); ++i) {
+            error = std::max(error, std::abs(captured[i] - mono[i]));
+        }
+        printf("I16 stream: %llu speech segments, max error %.2e\n",
+               static_cast<unsigned long long>(capture.getVoiceActivity().getSegmentCount()), error);
+        ok &= check(captured.size() >= mono.size() && error <= 1.0f / 32768.0f, "the I16 capture is off");
+        ok &= check(capture.getVoiceActivity().getSegmentCount() == segments.size(),
+                    "the I16 capture found other speech");
+    }
+
+    // Reopened while a consumer reads.
+    {
+        CaptureCallback   capture;
+        std::atomic<bool> producing {true};
+        int64_t           framesRead = 0;
+        bool              matches = true;
+        std::thread       consumer([&] {
+            std::vector<float> block(kBurstFrames);
+            while (producing.load() || capture.availableToRead() > 0) {
+                const uint64_t position = capture.getReadPosition();
+                const size_t   count = capture.read(block.data(), block.size());
+                if (count == 0) {
+                    usleep(CaptureCallback::kConsumerIdleMicros);
+                    continue;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    matches &= position + i < mono.size() && block[i] == mono[position + i];
+                }
+                framesRead += count;
+            }
+        });
+        const int64_t bursts = frames(recording) / kBurstFrames;
+        uint32_t      streams = 0;
+        bool          startsOk = true;
+        for (int64_t burst = 0; burst < bursts; ++burst) {
+            if (burst % (bursts / kRestarts) == 0) {
+                capture.setFormat(streams % 2 == 0 ? kSampleRate : 44100, kChannelCount, oboe::AudioFormat::Float,
+                                  kBurstFrames);
+                startsOk &= capture.getStreamStartPosition() == static_cast<uint64_t>(burst * kBurstFrames);
+                ++streams;
+            }
+            while (capture.availableToRead() > static_cast<size_t>(kSampleRate)) {
+                usleep(CaptureCallback::kConsumerIdleMicros);
+            }
+            capture.onAudioReady(stream.get(), recording.data() + burst * kBurstFrames * kChannelCount, kBurstFrames);
+        }
+        producing = false;
+        consumer.join();
+        printf("%u streams while a consumer read: %lld of %lld frames read in order\n", streams,
+               static_cast<long long>(framesRead), static_cast<long long>(bursts * kBurstFrames));
+        ok &= check(startsOk && capture.getStreamGeneration() == streams, "a reopened stream did not carry on");
+        ok &= check(matches && framesRead == bursts * kBurstFrames, "the consumer lost its place across reopens");
+    }
+
+    // Timing
+    {
+        const int32_t windowFrames = kSampleRate * VoiceActivityDetector::kWindowMillis / 1000;
+        const float*  window = mono.data() + regions[1].begin + windowFrames * 20;
+        int64_t       start = benchNowNanos();
+        for (int pass = 0; pass < kTimingPasses; ++pass) {
+            benchKeep(VoiceActivityDetector::measure(window, windowFrames));
+        }
+        const double simdNanos = double(benchNowNanos() - start) / kTimingPasses;
+        start = benchNowNanos();
+        for (int pass = 0; pass < kTimingPasses; ++pass) {
+            benchKeep(measureScalar(window, windowFrames));
+        }
+        const double scalarNanos = double(benchNowNanos() - start) / kTimingPasses;
+        const VoiceActivityDetector::Window simd = VoiceActivityDetector::measure(window, windowFrames);
+        const VoiceActivityDetector::Window scalar = measureScalar(window, windowFrames);
+        ok &= check(std::abs(simd.energy - scalar.energy) <= 1e-5f * scalar.energy
+                    && simd.zeroCrossingRate == scalar.zeroCrossingRate, "the SIMD measurement is off");
+        printf("Energy and zero crossings of a %d frame window: SIMD %.0f ns, scalar %.0f ns\n", windowFrames,
+               simdNanos, scalarNanos);
+
+        CaptureCallback capture;
+        capture.setFormat(kSampleRate, kChannelCount, oboe::AudioFormat::Float, kBurstFrames);
+        const int64_t bursts = frames(recording) / kBurstFrames;
+        start = benchNowNanos();
+        for (int64_t burst = 0; burst < bursts; ++burst) {
+            capture.onAudioReady(stream.get(), recording.data() + burst * kBurstFrames * kChannelCount, kBurstFrames);
+            capture.keepLatest(0);
+        }
+        printf("Capture callback, %d stereo frames: %.0f ns\n", kBurstFrames,
+               double(benchNowNanos() - start) / bursts);
+    }
+
+    printf("%s\n", ok ? "All checks passed" : "Some checks FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/**
+ * Host benchmark for the channel layout kernels in ChannelConvert.h.
+ *
+ * It first checks every specialized kernel from 1 to kMaxChannels channels, and the fallback above,
+ * against the run time loop, and that interleaving and deinterleaving round trip. Then it times the
+ * kernels against the per-sample loops they replaced for 1->2, 2->2 and 2->1 in 192 frame bursts,
+ * and the stereo interleave against the per-sample scatter SoundGenerator used.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "ChannelConvert.h"
+#include "bench_util.h"
+
+namespace legacy {
+    // The loops the kernels replaced, kept as the reference. The channel counts are read at run time.
+
+    // Mp3SoundGenerator::renderAudio, which tested the source count per sample. Stereo to mono kept
+    // the left channel.
+    void convertMp3(const float* in, int32_t inChannels, float* out, int32_t outChannels, size_t frames) {
+        for (size_t j = 0; j < frames; ++j) {
+            for (int i = 0; i < outChannels; ++i) {
+                if (inChannels == 2) {
+                    out[(j * outChannels) + i] = in[j * 2 + i];
+                } else if (inChannels == 1) {
+                    out[(j * outChannels) + i] = in[j];
+                }
+            }
+        }
+    }
+
+    // DecodeAheadSource::decodeChunk and ClipCache::convert.
+    void convertStreaming(const float* in, int32_t inChannels, float* out, int32_t outChannels, size_t frames) {
+        for (size_t j = 0; j < frames; ++j) {
+            const float* frame = in + j * inChannels;
+            float*       dst = out + j * outChannels;
+            if (outChannels == 1 && inChannels == 2) {
+                dst[0] = 0.5f * (frame[0] + frame[1]);
+            } else {
+                for (int32_t i = 0; i < outChannels; ++i) {
+                    dst[i] = frame[std::min(i, inChannels - 1)];
+                }
+            }
+        }
+    }
+
+    // SoundGenerator scattered each rendered channel into the interleaved output.
+    void scatter(const float* const* planes, int32_t channelCount, float* out, size_t frames) {
+        for (int i = 0; i < channelCount; ++i) {
+            for (size_t j = 0; j < frames; ++j) {
+                out[(j * channelCount) + i] = planes[i][j];
+            }
+        }
+    }
+}  // namespace legacy
+
+namespace {
+    constexpr size_t  kBurstFrames = 192;
+    constexpr int32_t kBursts = 200000;
+    constexpr size_t  kCheckFrames[] = {0, 1, 3, 4, 5, 8, 31, 192, 1001};
+
+    std::vector<float> makeInput(size_t samples) {
+        std::vector<float> input(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            input[i] = static_cast<float>((i * 7919) % 2001) / 1000.0f - 1.0f;
+        }
+        return input;
+    }
+
+    bool checkConvert(int32_t inChannels, int32_t outChannels) {
+        channels::Converter converter(inChannels, outChannels);
+        for (size_t frames : kCheckFrames) {
+            const std::vector<float> input = makeInput(frames * inChannels);
+            // One extra sample catches a kernel which writes past the end.
+            std::vector<float> expected(frames * outChannels + 1, -2.0f);
+            std::vector<float> actual(frames * outChannels + 1, -2.0f);
+            legacy::convertStreaming(input.data(), inChannels, expected.data(), outChannels, frames);
+            converter(input.data(), actual.data(), frames);
+            if (actual != expected) {
+                printf("  FAIL: %d -> %d channels differs from the reference at %zu frames\n", inChannels,
+                       outChannels, frames);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool checkInterleave(int32_t channelCount) {
+        const channels::InterleaveFunction   interleave = channels::getInterleaver(channelCount);
+        const channels::DeinterleaveFunction deinterleave = channels::getDeinterleaver(channelCount);
+        for (size_t frames : kCheckFrames) {
+            std::vector<std::vector<float>> planes;
+            std::vector<const float*>       planePointers;
+            for (int32_t i = 0; i < channelCount; ++i) {
+                planes.push_back(makeInput(frames + i));
+                planePointers.push_back(planes.back().data());
+            }
+            std::vector<float> expected(frames * channelCount + 1, -2.0f);
+            std::vector<float> actual(frames * channelCount + 1, -2.0f);
+            legacy::scatter(planePointers.data(), channelCount, expected.data(), frames);
+            interleave(planePointers.data(), actual.data(), frames);
+            if (actual != expected) {
+                printf("  FAIL: interleaving %d channels differs at %zu frames\n", channelCount, frames);
+                return false;
+            }
+
+            std::vector<std::vector<float>> split(channelCount, std::vector<float>(frames + 1, -2.0f));
+            std::vector<float*>             splitPointers;
+            for (auto& plane : split) {
+                splitPointers.push_back(plane.data());
+            }
+            deinterleave(actual.data(), splitPointers.data(), frames);
+            for (int32_t i = 0; i < channelCount; ++i) {
+                if (!std::equal(split[i].begin(), split[i].begin() + frames, planes[i].begin())
+                    || split[i][frames] != -2.0f) {
+                    printf("  FAIL: deinterleaving %d channels does not round trip at %zu frames\n", channelCount,
+                           frames);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool checkKernels() {
+        bool ok = true;
+        for (int32_t in = 1; in <= channels::kMaxChannels; ++in) {
+            for (int32_t out = 1; out <= channels::kMaxChannels; ++out) {
+                ok = checkConvert(in, out) && ok;
+            }
+            ok = checkInterleave(in) && ok;
+        }
+        // Past the specialized counts the converter falls back to the run time loop.
+        ok = checkConvert(channels::kMaxChannels + 2, 2) && ok;
+        ok = checkConvert(1, channels::kMaxChannels + 1) && ok;
+        if (channels::getConverter(channels::kMaxChannels + 1, 2) != nullptr
+            || channels::getInterleaver(channels::kMaxChannels + 1) != nullptr) {
+            printf("  FAIL: a kernel for more than %d channels\n", channels::kMaxChannels);
+            ok = false;
+        }
+        printf("%s: %d x %d converters, %d interleavers\n", ok ? "kernels match" : "kernels differ",
+               channels::kMaxChannels, channels::kMaxChannels, channels::kMaxChannels);
+        return ok;
+    }
+
+    template <typename Convert>
+    double timeNanosPerFrame(const std::vector<float>& input, std::vector<float>& output, Convert convert) {
+        const int64_t start = benchNowNanos();
+        for (int32_t burst = 0; burst < kBursts; ++burst) {
+            convert(input.data(), output.data());
+            benchKeep(output[0]);
+        }
+        return static_cast<double>(benchNowNanos() - start) / (static_cast<double>(kBursts) * kBurstFrames);
+    }
+
+    void benchConvert(int32_t inChannels, int32_t outChannels) {
+        // Read the counts through a volatile so the legacy loops are not specialized by the compiler.
+        volatile int32_t         runtimeIn = inChannels;
+        volatile int32_t         runtimeOut = outChannels;
+        const std::vector<float> input = makeInput(kBurstFrames * inChannels);
+        std::vector<float>       output(kBurstFrames * outChannels);
+        channels::Converter      converter(inChannels, outChannels);
+
+        const double mp3 = timeNanosPerFrame(input, output, [&](const float* in, float* out) {
+            legacy::convertMp3(in, runtimeIn, out, runtimeOut, kBurstFrames);
+        });
+        const double streaming = timeNanosPerFrame(input, output, [&](const float* in, float* out) {
+            legacy::convertStreaming(in, runtimeIn, out, runtimeOut, kBurstFrames);
+        });
+        const double kernel = timeNanosPerFrame(input, output, [&](const float* in, float* out) {
+            converter(in, out, kBurstFrames);
+        });
+        printf("%d -> %d: per-sample mp3 loop %.3f ns/frame, streaming loop %.3f, kernel %.3f (%.1fx, %.1fx)\n",
+               inChannels, outChannels, mp3, streaming, kernel, mp3 / kernel, streaming / kernel);
+    }
+
+    void benchInterleave() {
+        volatile int32_t                   runtimeChannels = 2;
+        const std::vector<float>           left = makeInput(kBurstFrames);
+        const std::vector<float>           right = makeInput(kBurstFrames + 1);
+        const float*                       planes[] = {left.data(), right.data()};
+        std::vector<float>                 output(kBurstFrames * 2);
+        const channels::InterleaveFunction interleave = channels::getInterleaver(2);
+
+        const double scatter = timeNanosPerFrame(left, output, [&](const float*, float* out) {
+            legacy::scatter(planes, runtimeChannels, out, kBurstFrames);
+        });
+        const double kernel = timeNanosPerFrame(left, output, [&](const float*, float* out) {
+            interleave(planes, out, kBurstFrames);
+        });
+        printf("interleave 2: per-sample scatter %.3f ns/frame, kernel %.3f (%.1fx)\n", scatter, kernel,
+               scatter / kernel);
+    }
+}  // namespace
+
+int main() {
+    const bool ok = checkKernels();
+    benchConvert(1, 2);
+    benchConvert(2, 2);
+    benchConvert(2, 1);
+    benchInterleave();
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/**
+ * Host benchmark for ClipCache and VoiceMixer.
+ *
+ * For every MP3 in the asset directory it measures the time from a trigger to the first rendered
+ * burst, once when the clip has to be decoded (a miss) and once when it is served from the cache (a
+ * hit). It also checks that both paths render the same samples, that eviction stays within the
+ * budget and that a clip which is playing is never evicted.
+ *
+ * Usage: clip_cache_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ClipCache.h"
+#include "VoiceMixer.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannels = 2;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int     kHitRepeats = 1000;
+
+    const char* kAssets[] = {"robot_boot.mp3", "robot_random_code.mp3", "robot_thankyou.mp3", "test.mp3"};
+
+    // Trigger a clip alone and render the first burst, as the next audio callback would.
+    void triggerAndRender(VoiceMixer& player, const PcmClip* clip, std::vector<float>& burst) {
+        player.stopAll();
+        player.play(clip);
+        player.renderAudio(burst.data(), kBurstFrames);
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    std::vector<std::vector<uint8_t>> files;
+    for (const char* name : kAssets) {
+        files.push_back(readFile(assetDir + "/" + name));
+        if (files.back().empty()) {
+            fprintf(stderr, "Cannot read %s/%s\n", assetDir.c_str(), name);
+            return 1;
+        }
+    }
+
+    ClipCache cache;
+    cache.setFormat(kSampleRate, kChannels);
+    VoiceMixer         player(kSampleRate, kChannels);
+    std::vector<float> missBurst(kBurstFrames * kChannels);
+    std::vector<float> hitBurst(kBurstFrames * kChannels);
+
+    printf("%-24s %10s %12s %12s %10s\n", "clip", "frames", "miss (us)", "hit (us)", "KiB");
+    for (size_t i = 0; i < files.size(); ++i) {
+        const std::string name = kAssets[i];
+
+        int64_t        start = benchNowNanos();
+        const PcmClip* clip = cache.find(name);
+        if (clip == nullptr) {
+            clip = cache.insert(name, files[i].data(), files[i].size());
+        }
+        ok &= check(clip != nullptr, "insert");
+        if (clip == nullptr) {
+            continue;
+        }
+        triggerAndRender(player, clip, missBurst);
+        const int64_t missNanos = benchNowNanos() - start;
+
+        start = benchNowNanos();
+        for (int r = 0; r < kHitRepeats; ++r) {
+            triggerAndRender(player, cache.find(name), hitBurst);
+            benchKeep(hitBurst[0]);
+        }
+        const int64_t hitNanos = (benchNowNanos() - start) / kHitRepeats;
+
+        ok &= check(std::memcmp(missBurst.data(), hitBurst.data(), hitBurst.size() * sizeof(float)) == 0,
+                    "cached clip renders the same samples");
+        printf("%-24s %10d %12.1f %12.2f %10zu\n", name.c_str(), clip->frames, missNanos / 1e3, hitNanos / 1e3,
+               clip->sizeInBytes() / 1024);
+    }
+    player.stopAll();
+    player.renderAudio(hitBurst.data(), kBurstFrames);
+    printf("hits %llu, misses %llu, %zu bytes used\n", (unsigned long long)cache.getHitCount(),
+           (unsigned long long)cache.getMissCount(), cache.getBytesUsed());
+
+    // Shrink the budget below two clips: older clips go, a playing clip stays.
+    const PcmClip* playing = cache.find(kAssets[0]);
+    player.play(playing);
+    player.renderAudio(hitBurst.data(), kBurstFrames);
+    cache.setBudget(playing->sizeInBytes() + 1);
+    ok &= check(cache.getBytesUsed() <= cache.getBudget(), "eviction keeps the cache within budget");
+    ok &= check(cache.find(kAssets[0]) == playing, "a playing clip is not evicted");
+    ok &= check(cache.insert(kAssets[3], files[3].data(), files[3].size()) == nullptr,
+                "a clip that does not fit while the others play is rejected");
+    player.stopAll();
+    player.renderAudio(hitBurst.data(), kBurstFrames);
+    ok &= check(!playing->isPlaying(), "the mixer releases a stopped clip");
+    printf("evictions %llu, %zu bytes used after shrinking the budget\n", (unsigned long long)cache.getEvictionCount(),
+           cache.getBytesUsed());
+
+    // A format change drops every clip.
+    cache.setFormat(44100, kChannels);
+    ok &= check(cache.getBytesUsed() == 0 && cache.find(kAssets[0]) == nullptr, "format change drops clips");
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+/**
+ * Host check for the CPU topology probe and the thread placement policy.
+ *
+ * It builds fake sysfs trees for a few SoC layouts (big.LITTLE, tri-cluster with a prime core,
+ * homogeneous, no cpu_capacity, no cpufreq, offline cores) and checks the clusters found and the placement: the
+ * roles must not share a CPU, the callback must not land on a little core and a lone prime core
+ * goes to inference. Without any sysfs, inference must still get every online CPU. Then it prints
+ * the topology and placement of this machine and pins the calling thread to each role.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <sched.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ndk_utils/cpu_topology.h"
+
+namespace {
+    struct FakeCpu {
+        int         id;
+        int64_t     maxFrequencyKHz;  // 0 leaves out cpufreq
+        int64_t     capacity;         // 0 leaves out cpu_capacity
+        std::string relatedCpus;      // empty leaves out related_cpus
+        int         clusterId = -1;   // negative leaves out topology/cluster_id
+    };
+
+    struct Case {
+        const char*                   name;
+        std::vector<FakeCpu>          cpus;
+        const char*                   online;  // nullptr leaves out the online file
+        std::vector<std::vector<int>> expectedClusters;
+        std::vector<int>              expectedAudio;
+        std::vector<int>              expectedDecoder;
+        std::vector<int>              expectedInference;
+    };
+
+    void writeFile(const std::string& path, const std::string& contents) {
+        std::ofstream(path) << contents << "\n";
+    }
+
+    void makeDirs(const std::string& path) {
+        for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+            mkdir(path.substr(0, slash).c_str(), 0755);
+        }
+        mkdir(path.c_str(), 0755);
+    }
+
+    std::string makeTree(const std::string& root, const Case& test) {
+        const std::string dir = root + "/" + test.name;
+        makeDirs(dir);
+        if (test.online != nullptr) {
+            writeFile(dir + "/online", test.online);
+        }
+        for (const FakeCpu& cpu : test.cpus) {
+            const std::string cpuDir = dir + "/cpu" + std::to_string(cpu.id);
+            makeDirs(cpuDir);
+            if (cpu.maxFrequencyKHz > 0) {
+                makeDirs(cpuDir + "/cpufreq");
+                writeFile(cpuDir + "/cpufreq/cpuinfo_max_freq", std::to_string(cpu.maxFrequencyKHz));
+                if (!cpu.relatedCpus.empty()) {
+                    writeFile(cpuDir + "/cpufreq/related_cpus", cpu.relatedCpus);
+                }
+            }
+            if (cpu.capacity > 0) {
+                writeFile(cpuDir + "/cpu_capacity", std::to_string(cpu.capacity));
+            }
+            if (cpu.clusterId >= 0) {
+                makeDirs(cpuDir + "/topology");
+                writeFile(cpuDir + "/topology/cluster_id", std::to_string(cpu.clusterId));
+            }
+        }
+        return dir;
+    }
+
+    std::string toString(const std::vector<int>& cpus) {
+        std::string text;
+        for (int cpu : cpus) {
+            text += (text.empty() ? "" : ",") + std::to_string(cpu);
+        }
+        return "[" + text + "]";
+    }
+
+    bool expectCpus(const char* what, const std::vector<int>& actual, const std::vector<int>& expected) {
+        if (actual == expected) {
+            return true;
+        }
+        printf("  FAIL: %s %s, expected %s\n", what, toString(actual).c_str(), toString(expected).c_str());
+        return false;
+    }
+
+    bool overlaps(const std::vector<int>& a, const std::vector<int>& b) {
+        return std::any_of(a.begin(), a.end(), [&b](int cpu) { return std::find(b.begin(), b.end(), cpu) != b.end(); });
+    }
+
+    bool checkCase(const std::string& root, const Case& test) {
+        const cpu_topology::Topology  topology = cpu_topology::probe(makeTree(root, test));
+        const cpu_topology::Placement placement = cpu_topology::place(topology);
+        printf("%s\n  %s\n  %s\n", test.name, topology.toString().c_str(), placement.toString().c_str());
+
+        bool ok = true;
+        if (topology.clusters.size() != test.expectedClusters.size()) {
+            printf("  FAIL: %zu clusters, expected %zu\n", topology.clusters.size(), test.expectedClusters.size());
+            ok = false;
+        } else {
+            for (size_t i = 0; i < topology.clusters.size(); ++i) {
+                ok = expectCpus("cluster", topology.clusters[i].cpus, test.expectedClusters[i]) && ok;
+            }
+        }
+        ok = expectCpus("audio", placement.audio, test.expectedAudio) && ok;
+        ok = expectCpus("decoder", placement.decoder, test.expectedDecoder) && ok;
+        ok = expectCpus("inference", placement.inference, test.expectedInference) && ok;
+
+        if (topology.cpus.size() >= 3
+            && (overlaps(placement.audio, placement.decoder) || overlaps(placement.audio, placement.inference)
+                || overlaps(placement.decoder, placement.inference))) {
+            printf("  FAIL: roles share a CPU\n");
+            ok = false;
+        }
+        if (topology.isHeterogeneous() && overlaps(placement.audio, topology.clusters.front().cpus)) {
+            printf("  FAIL: audio on a little core\n");
+            ok = false;
+        }
+        return ok;
+    }
+
+    std::vector<Case> makeCases() {
+        std::vector<Case> cases;
+
+        // Four little and four big cores, one frequency domain each.
+        Case bigLittle {"big_little", {}, "0-7", {{0, 1, 2, 3}, {4, 5, 6, 7}}, {7}, {0}, {4, 5, 6}};
+        for (int id = 0; id < 8; ++id) {
+            bigLittle.cpus.push_back(id < 4 ? FakeCpu {id, 1800000, 410, "0-3"} : FakeCpu {id, 2400000, 1024, "4-7"});
+        }
+        cases.push_back(bigLittle);
+
+        // Little, mid and a single prime core: audio stays off the prime core, which goes to inference.
+        Case triCluster {"tri_cluster", {}, "0-7", {{0, 1, 2, 3}, {4, 5, 6}, {7}}, {6}, {0}, {4, 5, 7}};
+        for (int id = 0; id < 8; ++id) {
+            if (id < 4) {
+                triCluster.cpus.push_back({id, 1800000, 325, "0 1 2 3"});
+            } else if (id < 7) {
+                triCluster.cpus.push_back({id, 2500000, 870, "4 5 6"});
+            } else {
+                triCluster.cpus.push_back({id, 3000000, 1024, "7"});
+            }
+        }
+        cases.push_back(triCluster);
+
+        // Two frequency domains of identical cores are one cluster.
+        Case homogeneous {"homogeneous", {}, "0-7", {{0, 1, 2, 3, 4, 5, 6, 7}}, {7}, {0}, {1, 2, 3, 4, 5, 6}};
+        for (int id = 0; id < 8; ++id) {
+            homogeneous.cpus.push_back({id, 2000000, 1024, id < 4 ? "0-3" : "4-7"});
+        }
+        cases.push_back(homogeneous);
+
+        // No cpu_capacity, and the mid and prime cores share a top frequency: their frequency domains
+        // keep them apart.
+        Case sharedMaxFrequency {
+                "shared_max_frequency", {}, "0-7", {{0, 1, 2, 3}, {4, 5, 6}, {7}}, {6}, {0}, {4, 5, 7}};
+        for (int id = 0; id < 8; ++id) {
+            if (id < 4) {
+                sharedMaxFrequency.cpus.push_back({id, 1800000, 0, "0-3"});
+            } else {
+                sharedMaxFrequency.cpus.push_back({id, 2800000, 0, id < 7 ? "4-6" : "7"});
+            }
+        }
+        cases.push_back(sharedMaxFrequency);
+
+        // No cpufreq and no online file: the cpuN directories tell what exists, and the cluster ids are
+        // all that tells the cores apart.
+        Case clusterIdOnly {"cluster_id_only", {}, nullptr, {{0, 1, 2, 3}, {4, 5}}, {5}, {0}, {4}};
+        for (int id = 0; id < 6; ++id) {
+            clusterIdOnly.cpus.push_back({id, 0, 0, "", id < 4 ? 0 : 1});
+        }
+        cases.push_back(clusterIdOnly);
+
+        // Too few cores to keep the roles apart.
+        Case twoCpus {"two_cpus", {{0, 1500000, 0, "0-1"}, {1, 1500000, 0, "0-1"}}, "0-1", {{0, 1}}, {1}, {0}, {0, 1}};
+        cases.push_back(twoCpus);
+
+        // Hotplugged cores are left out.
+        Case offline {"offline", {}, "0-2,4-5", {{0, 1, 2}, {4, 5}}, {5}, {0}, {4}};
+        for (int id = 0; id < 8; ++id) {
+            offline.cpus.push_back(id < 4 ? FakeCpu {id, 1700000, 400, "0-3"} : FakeCpu {id, 2800000, 1024, "4-7"});
+        }
+        cases.push_back(offline);
+
+        return cases;
+    }
+
+    // Without sysfs there is no topology, but inference still gets every online CPU.
+    bool checkUnreadable(const std::string& root) {
+        const cpu_topology::Topology  topology = cpu_topology::probe(root + "/missing");
+        const cpu_topology::Placement placement = cpu_topology::place(topology);
+        printf("unreadable\n  %s\n", placement.toString().c_str());
+        std::vector<int> online;
+        for (int cpu = 0; cpu < std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L); ++cpu) {
+            online.push_back(cpu);
+        }
+        bool ok = expectCpus("audio", placement.audio, {});
+        ok = expectCpus("decoder", placement.decoder, {}) && ok;
+        return expectCpus("inference", placement.inference, online) && ok;
+    }
+
+    bool checkHost() {
+        const cpu_topology::Topology  topology = cpu_topology::probe();
+        const cpu_topology::Placement placement = cpu_topology::place(topology);
+        printf("this machine (%zu CPUs)\n  %s\n  %s\n", topology.cpus.size(), topology.toString().c_str(),
+               placement.toString().c_str());
+
+        cpu_set_t original;
+        sched_getaffinity(0, sizeof(original), &original);
+        bool ok = true;
+        for (auto role : {cpu_topology::ThreadRole::Audio, cpu_topology::ThreadRole::Decoder,
+                          cpu_topology::ThreadRole::Inference}) {
+            const std::vector<int>& cpus = placement.forRole(role);
+            if (!cpu_topology::setCurrentThreadAffinity(cpus)) {
+                // A container may not allow every CPU sysfs lists.
+                printf("  could not pin to %s\n", toString(cpus).c_str());
+                continue;
+            }
+            cpu_set_t set;
+            sched_getaffinity(0, sizeof(set), &set);
+            if (CPU_COUNT(&set) != static_cast<int>(cpus.size())) {
+                printf("  FAIL: pinned to %d CPUs, expected %s\n", CPU_COUNT(&set), toString(cpus).c_str());
+                ok = false;
+            }
+        }
+        sched_setaffinity(0, sizeof(original), &original);
+        return ok;
+    }
+}  // namespace
+
+int main() {
+    char root[] = "/tmp/cpu_topology_XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    bool ok = true;
+    for (const Case& test : makeCases()) {
+        ok = checkCase(root, test) && ok;
+    }
+    ok = checkUnreadable(root) && ok;
+    ok = checkHost() && ok;
+    system((std::string("rm -rf ") + root).c_str());
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
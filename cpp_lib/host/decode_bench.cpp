@@ -0,0 +1,339 @@
+/**
+ * Host benchmark for PcmDecoder and StreamingSoundGenerator.
+ *
+ * The MP3 asset is memory mapped and decoded in place, then transcoded to 16-bit WAV and FLAC in
+ * memory so all three formats hold the same audio. It reports how long each format takes to decode
+ * per second of audio, checks that WAV and FLAC decode losslessly, and streams every format in real
+ * time at 48 kHz stereo to check the decoder thread keeps up.
+ *
+ * The FLAC encoder below only exists to make test data: fixed predictors and one Rice partition.
+ *
+ * Usage: decode_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "PcmDecoder.h"
+#include "StreamingSoundGenerator.h"
+#include "bench_util.h"
+#include "dr_wav.h"
+#include "render_harness.h"
+
+namespace {
+    constexpr int32_t  kSampleRate = 48000;
+    constexpr int32_t  kChannels = 2;
+    constexpr uint64_t kChunkFrames = StreamingSoundGenerator::kDecodeChunkFrames;
+    constexpr double   kMinBenchSeconds = 0.5;
+    constexpr double   kStreamSeconds = 2.0;
+    constexpr int32_t  kFlacBlockFrames = 4096;
+
+    // Read-only mapping of a whole file.
+    struct MappedFile {
+        const uint8_t* data = nullptr;
+        size_t         size = 0;
+
+        explicit MappedFile(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+                if (fd >= 0) close(fd);
+                return;
+            }
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const uint8_t*>(mapped);
+                size = info.st_size;
+            }
+        }
+
+        ~MappedFile() {
+            if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+        }
+    };
+
+    class BitWriter {
+      public:
+        void put(uint32_t value, int bits) {
+            for (int i = bits - 1; i >= 0; --i) {
+                mCurrent = static_cast<uint8_t>((mCurrent << 1) | ((value >> i) & 1));
+                if (++mBits == 8) {
+                    mBytes.push_back(mCurrent);
+                    mBits = 0;
+                }
+            }
+        }
+
+        void putUnary(uint32_t zeros) {
+            for (; zeros >= 32; zeros -= 32) put(0, 32);
+            put(1, zeros + 1);
+        }
+
+        void alignToByte() {
+            if (mBits != 0) put(0, 8 - mBits);
+        }
+
+        std::vector<uint8_t>& bytes() { return mBytes; }
+
+      private:
+        std::vector<uint8_t> mBytes;
+        uint8_t              mCurrent = 0;
+        int                  mBits = 0;
+    };
+
+    uint8_t crc8(const uint8_t* data, size_t size) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < size; ++i) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : crc << 1;
+        }
+        return crc;
+    }
+
+    uint16_t crc16(const uint8_t* data, size_t size) {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < size; ++i) {
+            crc ^= static_cast<uint16_t>(data[i] << 8);
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    // Residual of the fixed FLAC predictor of the given order at sample i.
+    int32_t fixedResidual(const int32_t* x, int32_t i, int order) {
+        switch (order) {
+            case 0: return x[i];
+            case 1: return x[i] - x[i - 1];
+            case 2: return x[i] - 2 * x[i - 1] + x[i - 2];
+            case 3: return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            default: return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        }
+    }
+
+    void encodeSubframe(BitWriter& writer, const int32_t* x, int32_t frames) {
+        int      bestOrder = 0;
+        uint64_t bestCost = UINT64_MAX;
+        for (int order = 0; order <= std::min(4, frames - 1); ++order) {
+            uint64_t cost = 0;
+            for (int32_t i = order; i < frames; ++i) cost += std::abs(fixedResidual(x, i, order));
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestOrder = order;
+            }
+        }
+        const uint64_t mean = bestCost / std::max(1, frames - bestOrder);
+        int            rice = 0;
+        while (rice < 14 && (2ull << rice) <= mean) ++rice;
+
+        writer.put(0, 1);
+        writer.put(0x08 | bestOrder, 6);  // SUBFRAME_FIXED
+        writer.put(0, 1);                 // no wasted bits
+        for (int i = 0; i < bestOrder; ++i) writer.put(static_cast<uint16_t>(x[i]), 16);
+        writer.put(0, 2);  // 4-bit Rice parameters
+        writer.put(0, 4);  // a single partition
+        writer.put(rice, 4);
+        for (int32_t i = bestOrder; i < frames; ++i) {
+            const int32_t  r = fixedResidual(x, i, bestOrder);
+            const uint32_t folded = r >= 0 ? static_cast<uint32_t>(r) << 1 : (static_cast<uint32_t>(-r) << 1) - 1;
+            writer.putUnary(folded >> rice);
+            if (rice > 0) writer.put(folded & ((1u << rice) - 1), rice);
+        }
+    }
+
+    std::vector<uint8_t> encodeFlac(const std::vector<int16_t>& pcm, int32_t sampleRate, int32_t channels) {
+        const uint64_t totalFrames = pcm.size() / channels;
+        BitWriter      writer;
+        for (char c : std::string("fLaC")) writer.put(c, 8);
+        writer.put(0x80, 8);  // last metadata block, STREAMINFO
+        writer.put(34, 24);
+        writer.put(kFlacBlockFrames, 16);
+        writer.put(kFlacBlockFrames, 16);
+        writer.put(0, 24);
+        writer.put(0, 24);
+        writer.put(sampleRate, 20);
+        writer.put(channels - 1, 3);
+        writer.put(15, 5);
+        writer.put(static_cast<uint32_t>(totalFrames >> 32), 4);
+        writer.put(static_cast<uint32_t>(totalFrames), 32);
+        for (int i = 0; i < 16; ++i) writer.put(0, 8);  // no MD5
+
+        std::vector<int32_t> channel(kFlacBlockFrames);
+        uint32_t             frameNumber = 0;
+        for (uint64_t start = 0; start < totalFrames; start += kFlacBlockFrames, ++frameNumber) {
+            const int32_t frames = static_cast<int32_t>(std::min<uint64_t>(kFlacBlockFrames, totalFrames - start));
+            const size_t  frameStart = writer.bytes().size();
+            writer.put(0xfff8, 16);  // sync, fixed block size
+            writer.put(frames == kFlacBlockFrames ? 12 : 7, 4);
+            writer.put(0, 4);  // sample rate from STREAMINFO
+            writer.put(channels - 1, 4);
+            writer.put(4, 3);  // 16 bits per sample
+            writer.put(0, 1);
+            // The frame number as UTF-8.
+            if (frameNumber < 0x80) {
+                writer.put(frameNumber, 8);
+            } else {
+                int continuation = frameNumber < 0x800 ? 1 : frameNumber < 0x10000 ? 2 : 3;
+                writer.put(((0xff80 >> continuation) & 0xff) | (frameNumber >> (6 * continuation)), 8);
+                for (int i = continuation - 1; i >= 0; --i) writer.put(0x80 | ((frameNumber >> (6 * i)) & 0x3f), 8);
+            }
+            if (frames != kFlacBlockFrames) writer.put(frames - 1, 16);
+            writer.put(crc8(&writer.bytes()[frameStart], writer.bytes().size() - frameStart), 8);
+
+            for (int32_t ch = 0; ch < channels; ++ch) {
+                for (int32_t i = 0; i < frames; ++i) channel[i] = pcm[(start + i) * channels + ch];
+                encodeSubframe(writer, channel.data(), frames);
+            }
+            writer.alignToByte();
+            writer.put(crc16(&writer.bytes()[frameStart], writer.bytes().size() - frameStart), 16);
+        }
+        return std::move(writer.bytes());
+    }
+
+    std::vector<uint8_t> encodeWav(const std::vector<int16_t>& pcm, int32_t sampleRate, int32_t channels) {
+        drwav_data_format format;
+        format.container = drwav_container_riff;
+        format.format = DR_WAVE_FORMAT_PCM;
+        format.channels = channels;
+        format.sampleRate = sampleRate;
+        format.bitsPerSample = 16;
+        void*  data = nullptr;
+        size_t size = 0;
+        drwav  wav;
+        if (!drwav_init_memory_write(&wav, &data, &size, &format, nullptr)) {
+            return {};
+        }
+        drwav_write_pcm_frames(&wav, pcm.size() / channels, pcm.data());
+        drwav_uninit(&wav);
+        std::vector<uint8_t> result(static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+        drwav_free(data, nullptr);
+        return result;
+    }
+
+    std::vector<float> decodeAll(const uint8_t* data, size_t size) {
+        auto               decoder = PcmDecoder::open(data, size);
+        std::vector<float> pcm;
+        if (!decoder) {
+            return pcm;
+        }
+        std::vector<float> chunk(kChunkFrames * decoder->getChannelCount());
+        while (uint64_t frames = decoder->read(chunk.data(), kChunkFrames)) {
+            pcm.insert(pcm.end(), chunk.begin(), chunk.begin() + frames * decoder->getChannelCount());
+        }
+        return pcm;
+    }
+
+    /**
+     * Decode the clip in streaming sized chunks until kMinBenchSeconds have passed.
+     * @return microseconds of decoding per second of audio
+     */
+    double benchDecode(const uint8_t* data, size_t size, double clipSeconds) {
+        std::vector<float> chunk(kChunkFrames * 8);
+        int                passes = 0;
+        const int64_t      start = benchNowNanos();
+        int64_t            elapsed = 0;
+        do {
+            // Opening is part of the cost of a trigger, so it is timed too.
+            auto decoder = PcmDecoder::open(data, size);
+            while (decoder->read(chunk.data(), kChunkFrames) != 0) {
+                benchKeep(chunk[0]);
+            }
+            ++passes;
+            elapsed = benchNowNanos() - start;
+        } while (elapsed < kMinBenchSeconds * 1e9);
+        return elapsed / 1e3 / (passes * clipSeconds);
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    MappedFile mp3(assetDir + "/test.mp3");
+    if (mp3.data == nullptr) {
+        fprintf(stderr, "Cannot map %s/test.mp3\n", assetDir.c_str());
+        return 1;
+    }
+    auto probe = PcmDecoder::open(mp3.data, mp3.size);
+    if (!probe) {
+        fprintf(stderr, "Cannot decode %s/test.mp3\n", assetDir.c_str());
+        return 1;
+    }
+    const int32_t      sourceRate = probe->getSampleRate();
+    const int32_t      sourceChannels = probe->getChannelCount();
+    std::vector<float> decoded = decodeAll(mp3.data, mp3.size);
+    const double       clipSeconds = static_cast<double>(decoded.size() / sourceChannels) / sourceRate;
+
+    std::vector<int16_t> pcm(decoded.size());
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        pcm[i] = static_cast<int16_t>(std::lrint(std::clamp(decoded[i], -1.0f, 32767.0f / 32768.0f) * 32768.0f));
+    }
+    const std::vector<uint8_t> wav = encodeWav(pcm, sourceRate, sourceChannels);
+    const std::vector<uint8_t> flac = encodeFlac(pcm, sourceRate, sourceChannels);
+    printf("test.mp3: %.1f s, %d Hz, %d ch\n", clipSeconds, sourceRate, sourceChannels);
+
+    // WAV and FLAC hold the same 16-bit samples, both have to give them back exactly.
+    {
+        ok &= check(PcmDecoder::detectFormat(mp3.data, mp3.size) == PcmDecoder::Format::Mp3, "MP3 is detected");
+        ok &= check(PcmDecoder::detectFormat(wav.data(), wav.size()) == PcmDecoder::Format::Wav, "WAV is detected");
+        ok &= check(PcmDecoder::detectFormat(flac.data(), flac.size()) == PcmDecoder::Format::Flac, "FLAC is detected");
+        const std::vector<float> fromWav = decodeAll(wav.data(), wav.size());
+        const std::vector<float> fromFlac = decodeAll(flac.data(), flac.size());
+        bool wavExact = fromWav.size() == pcm.size();
+        for (size_t i = 0; wavExact && i < pcm.size(); ++i) wavExact = fromWav[i] == pcm[i] / 32768.0f;
+        ok &= check(wavExact, "WAV decodes to the encoded samples");
+        ok &= check(fromFlac == fromWav, "FLAC decodes to the same samples as WAV");
+    }
+
+    struct Format {
+        const char*    name;
+        const uint8_t* data;
+        size_t         size;
+    };
+    const Format formats[] = {
+            {"MP3", mp3.data, mp3.size},
+            {"FLAC", flac.data(), flac.size()},
+            {"WAV", wav.data(), wav.size()},
+    };
+
+    printf("\n%-6s %10s %18s %14s\n", "format", "size (KB)", "us per s of audio", "x real time");
+    for (const Format& format : formats) {
+        const double micros = benchDecode(format.data, format.size, clipSeconds);
+        printf("%-6s %10.1f %18.1f %14.0f\n", format.name, format.size / 1024.0, micros, 1e6 / micros);
+    }
+
+    // Stream each format at the device rate with the decoder thread racing a real-time consumer.
+    printf("\nStreaming at %d Hz, %d ch, %.0f s each\n", kSampleRate, kChannels, kStreamSeconds);
+    RenderStats::printHeader();
+    for (const Format& format : formats) {
+        auto generator = StreamingSoundGenerator::createFromBuf(format.data, format.size, kSampleRate, kChannels);
+        if (!check(generator.error() == oboe::Result::OK, "the generator opens")) {
+            ok = false;
+            continue;
+        }
+        generator.value()->start();
+        RenderConfig config;
+        config.sampleRate = kSampleRate;
+        config.channelCount = kChannels;
+        config.seconds = std::min(kStreamSeconds, clipSeconds);
+        config.realtime = true;
+        const RenderStats stats = renderOffline(*generator.value(), config);
+        stats.print((std::string(format.name) + " stream").c_str());
+        ok &= check(generator.value()->getUnderrunCount() == 0, "the decoder thread keeps up");
+        ok &= check(stats.peak > 0.0f, "the stream is not silent");
+    }
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/**
+ * Host benchmark for the float to int16 conversion of the I16 output path (TpdfDither).
+ *
+ * It checks that every sample lands within the dither of the exact value, that full scale and
+ * beyond clip cleanly, that the error has the mean and variance of rounding plus TPDF dither, and
+ * that a DC level below one LSB survives on average where plain rounding loses it. Then it times the
+ * kernel against the per-sample undithered conversion Oboe applies to a float stream and a
+ * per-sample dithered one, for 192 frame stereo bursts.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "TpdfDither.h"
+#include "bench_util.h"
+
+namespace legacy {
+    // What a conversion stage without dither does: scale, truncate and clip every sample.
+    void convertUndithered(const float* in, int16_t* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const int32_t value = static_cast<int32_t>(in[i] * 32768.0f);
+            out[i] = static_cast<int16_t>(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+        }
+    }
+
+    // TPDF dither one sample at a time.
+    class ScalarDither {
+      public:
+        void process(const float* in, int16_t* out, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                const float x = in[i] > 1.0f ? 1.0f : (in[i] < -1.0f ? -1.0f : in[i]);
+                const long  value = lrintf(x * TpdfDither::kScale + nextUnit() - nextUnit());
+                out[i] = static_cast<int16_t>(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+            }
+        }
+
+      private:
+        float nextUnit() {
+            mState ^= mState << 13;
+            mState ^= mState >> 17;
+            mState ^= mState << 5;
+            return static_cast<float>(mState >> 8) * (1.0f / 16777216.0f);
+        }
+
+        uint32_t mState = 0x12345679u;
+    };
+}  // namespace legacy
+
+namespace {
+    constexpr int32_t kChannels = 2;
+    constexpr size_t  kBurstSamples = 192 * kChannels;
+    constexpr int32_t kBursts = 200000;
+    constexpr size_t  kStatSamples = 1 << 20;
+
+    std::vector<float> makeSignal(size_t count, float amplitude) {
+        std::vector<float> signal(count);
+        for (size_t i = 0; i < count; ++i) {
+            const float t = static_cast<float>(i);
+            signal[i] = amplitude * std::sin(t * 0.0123f) * std::cos(t * 0.00071f);
+        }
+        return signal;
+    }
+
+    bool checkBounds() {
+        TpdfDither dither;
+        bool       ok = true;
+        // Odd counts run the scalar tail as well.
+        for (size_t count : {size_t {0}, size_t {1}, size_t {7}, size_t {8}, size_t {13}, size_t {4099}}) {
+            const std::vector<float> signal = makeSignal(count, 1.0f);
+            std::vector<int16_t>     out(count + 1, 12345);
+            dither.process(signal.data(), out.data(), count);
+            for (size_t i = 0; i < count; ++i) {
+                if (std::fabs(out[i] - signal[i] * TpdfDither::kScale) > 1.5f) {
+                    printf("  FAIL: sample %zu of %zu is %d for %f\n", i, count, out[i], signal[i]);
+                    ok = false;
+                    break;
+                }
+            }
+            if (out[count] != 12345) {
+                printf("  FAIL: wrote past %zu samples\n", count);
+                ok = false;
+            }
+        }
+
+        std::vector<float>   loud(1003);
+        std::vector<int16_t> out(loud.size());
+        for (size_t i = 0; i < loud.size(); ++i) {
+            loud[i] = i % 2 == 0 ? 2.5f : -7.0f;
+        }
+        dither.process(loud.data(), out.data(), loud.size());
+        for (size_t i = 0; i < loud.size(); ++i) {
+            if (i % 2 == 0 ? out[i] < 32766 : out[i] > -32766) {
+                printf("  FAIL: %f clipped to %d\n", loud[i], out[i]);
+                ok = false;
+                break;
+            }
+        }
+        printf("bounds: %s\n", ok ? "every sample within the dither, full scale clips" : "FAILED");
+        return ok;
+    }
+
+    bool checkStatistics() {
+        TpdfDither               dither;
+        const std::vector<float> signal = makeSignal(kStatSamples, 0.5f);
+        std::vector<int16_t>     out(kStatSamples);
+        dither.process(signal.data(), out.data(), kStatSamples);
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        for (size_t i = 0; i < kStatSamples; ++i) {
+            const double error = out[i] - static_cast<double>(signal[i]) * TpdfDither::kScale;
+            sum += error;
+            sumSquares += error * error;
+        }
+        const double mean = sum / kStatSamples;
+        // Rounding a dithered value: 1/12 LSB^2 from rounding plus 1/6 from the triangular dither.
+        const double variance = sumSquares / kStatSamples - mean * mean;
+
+        // A DC level of 0.3 LSB: plain rounding gives 0, dither keeps it on average.
+        const float          level = 0.3f / TpdfDither::kScale;
+        std::vector<float>   dc(kStatSamples, level);
+        std::vector<int16_t> dcOut(kStatSamples);
+        dither.process(dc.data(), dcOut.data(), kStatSamples);
+        double dcSum = 0.0;
+        for (int16_t sample : dcOut) {
+            dcSum += sample;
+        }
+        const double dcMean = dcSum / kStatSamples;
+
+        const bool ok =
+                std::fabs(mean) < 0.01 && variance > 0.22 && variance < 0.28 && std::fabs(dcMean - 0.3) < 0.02;
+        printf("error: mean %.4f LSB, variance %.4f LSB^2 (0.25 expected), 0.3 LSB DC comes out as %.3f: %s\n", mean,
+               variance, dcMean, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    template <typename Convert>
+    double timeNanosPerSample(const std::vector<float>& input, std::vector<int16_t>& output, Convert convert) {
+        const int64_t start = benchNowNanos();
+        for (int32_t burst = 0; burst < kBursts; ++burst) {
+            convert(input.data(), output.data(), input.size());
+            benchKeep(output[0]);
+        }
+        return static_cast<double>(benchNowNanos() - start) / (static_cast<double>(kBursts) * input.size());
+    }
+
+    void bench() {
+        const std::vector<float> input = makeSignal(kBurstSamples, 0.8f);
+        std::vector<int16_t>     output(kBurstSamples);
+        TpdfDither               dither;
+        legacy::ScalarDither     scalarDither;
+
+        const double undithered = timeNanosPerSample(input, output, legacy::convertUndithered);
+        const double scalar = timeNanosPerSample(input, output, [&](const float* in, int16_t* out, size_t count) {
+            scalarDither.process(in, out, count);
+        });
+        const double kernel = timeNanosPerSample(input, output, [&](const float* in, int16_t* out, size_t count) {
+            dither.process(in, out, count);
+        });
+        printf("192 frame stereo bursts: undithered per-sample %.3f ns/sample, dithered per-sample %.3f, "
+               "TpdfDither %.3f (%.1fx, %.1fx)\n",
+               undithered, scalar, kernel, undithered / kernel, scalar / kernel);
+        printf("TpdfDither: %.2f us per burst, %.4f%% of the 4 ms deadline\n", kernel * kBurstSamples / 1e3,
+               kernel * kBurstSamples / 4e6 * 100.0);
+    }
+}  // namespace
+
+int main() {
+    bool ok = checkBounds();
+    ok = checkStatistics() && ok;
+    bench();
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
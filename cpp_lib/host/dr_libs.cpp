@@ -0,0 +1,8 @@
+// The dr_libs decoder implementations for the host benchmarks. On Android they are compiled into
+// the app's translation unit, @see app_engine.hpp.
+#define DR_FLAC_IMPLEMENTATION
+#include "dr_flac.h"
+#define DR_MP3_IMPLEMENTATION
+#include "dr_mp3.h"
+#define DR_WAV_IMPLEMENTATION
+#include "dr_wav.h"
@@ -0,0 +1,134 @@
+#pragma once
+// A fake input stream that plays recorded audio into an Oboe data callback from its own thread, so
+// capture code can run on a Linux host the way the device runs it, @see host/fake_stream.h.
+#include <oboe/Oboe.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dr_wav.h"
+
+class FakeCaptureStream : public oboe::AudioStream {
+  public:
+    /**
+     * @param samples - interleaved float samples, the "microphone" input
+     */
+    FakeCaptureStream(std::vector<float> samples, int32_t sampleRate, int32_t channelCount, int32_t framesPerBurst,
+                      oboe::AudioFormat format = oboe::AudioFormat::Float)
+        : mSamples(std::move(samples)), mSampleRate(sampleRate), mChannelCount(channelCount),
+          mFramesPerBurst(framesPerBurst), mFormat(format),
+          mBuffer(static_cast<size_t>(framesPerBurst) * channelCount),
+          mBuffer16(static_cast<size_t>(framesPerBurst) * channelCount) { }
+
+    /**
+     * The stand-in for a microphone: a WAV file, in whatever format it was written.
+     * @return nullptr if it cannot be read
+     */
+    static std::unique_ptr<FakeCaptureStream> fromWavFile(const std::string& path, int32_t framesPerBurst,
+                                                          oboe::AudioFormat format = oboe::AudioFormat::Float) {
+        unsigned int sampleRate = 0;
+        unsigned int channelCount = 0;
+        drwav_uint64 frames = 0;
+        float* data = drwav_open_file_and_read_pcm_frames_f32(path.c_str(), &channelCount, &sampleRate, &frames,
+                                                              nullptr);
+        if (data == nullptr) {
+            return nullptr;
+        }
+        std::vector<float> samples(data, data + frames * channelCount);
+        drwav_free(data, nullptr);
+        return std::make_unique<FakeCaptureStream>(std::move(samples), static_cast<int32_t>(sampleRate),
+                                                   static_cast<int32_t>(channelCount), framesPerBurst, format);
+    }
+
+    ~FakeCaptureStream() override { stop(); }
+
+    int32_t getSampleRate() const override { return mSampleRate; }
+
+    int32_t getChannelCount() const override { return mChannelCount; }
+
+    oboe::AudioFormat getFormat() const override { return mFormat; }
+
+    oboe::Direction getDirection() const override { return oboe::Direction::Input; }
+
+    int32_t getFramesPerBurst() override { return mFramesPerBurst; }
+
+    int64_t getFramesRead() override { return mFramesRead.load(std::memory_order_relaxed); }
+
+    int64_t getFrameCount() const { return static_cast<int64_t>(mSamples.size()) / mChannelCount; }
+
+    const std::vector<float>& getSamples() const { return mSamples; }
+
+    /**
+     * Call the callback once per burst on a new thread until the recording ends, the callback returns
+     * Stop or stop() is called. The last burst is padded with silence.
+     * @param speed - pace the bursts like a device this many times faster than real time, 0 to run as
+     * fast as the callback allows
+     */
+    void start(oboe::AudioStreamDataCallback* callback, double speed) {
+        stop();
+        mRunning = true;
+        mThread = std::thread([this, callback, speed]() {
+            const auto period = std::chrono::nanoseconds(
+                    speed > 0.0 ? static_cast<int64_t>(1e9 * mFramesPerBurst / mSampleRate / speed) : 0);
+            auto       deadline = std::chrono::steady_clock::now();
+            for (int64_t frame = 0; frame < getFrameCount() && mRunning; frame += mFramesPerBurst) {
+                if (speed > 0.0) {
+                    std::this_thread::sleep_until(deadline);
+                    deadline += period;
+                }
+                if (callback->onAudioReady(this, nextBurst(frame), mFramesPerBurst)
+                    != oboe::DataCallbackResult::Continue) {
+                    break;
+                }
+                mFramesRead.fetch_add(mFramesPerBurst, std::memory_order_relaxed);
+            }
+            mRunning = false;
+        });
+    }
+
+    bool isRunning() const { return mRunning; }
+
+    void join() {
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    void stop() {
+        mRunning = false;
+        join();
+    }
+
+  private:
+    void* nextBurst(int64_t frame) {
+        const size_t begin = static_cast<size_t>(frame) * mChannelCount;
+        const size_t count = std::min(mBuffer.size(), mSamples.size() - begin);
+        std::fill(std::copy_n(mSamples.begin() + begin, count, mBuffer.begin()), mBuffer.end(), 0.0f);
+        if (mFormat != oboe::AudioFormat::I16) {
+            return mBuffer.data();
+        }
+        for (size_t i = 0; i < mBuffer.size(); ++i) {
+            mBuffer16[i] = static_cast<int16_t>(std::clamp(std::lrint(mBuffer[i] * 32768.0f), -32768L, 32767L));
+        }
+        return mBuffer16.data();
+    }
+
+    std::vector<float> mSamples;
+    int32_t            mSampleRate;
+    int32_t            mChannelCount;
+    int32_t            mFramesPerBurst;
+    oboe::AudioFormat  mFormat;
+
+    std::vector<float>   mBuffer;
+    std::vector<int16_t> mBuffer16;
+    std::thread          mThread;
+    std::atomic<bool>    mRunning { false };
+    std::atomic<int64_t> mFramesRead { 0 };
+};
@@ -0,0 +1,87 @@
+#pragma once
+// A fake output stream that drives an Oboe data callback from its own thread, so callback code can
+// run on a Linux host the way the device runs it.
+#include <oboe/Oboe.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+class FakeAudioStream : public oboe::AudioStream {
+  public:
+    FakeAudioStream(int32_t sampleRate, int32_t channelCount, int32_t framesPerBurst,
+                    oboe::AudioFormat format = oboe::AudioFormat::Float)
+        : mSampleRate(sampleRate), mChannelCount(channelCount), mFramesPerBurst(framesPerBurst), mFormat(format),
+          mBuffer(static_cast<size_t>(framesPerBurst) * channelCount), mBufferSizeInFrames(framesPerBurst * 2) { }
+
+    ~FakeAudioStream() override { stop(); }
+
+    int32_t getSampleRate() const override { return mSampleRate; }
+
+    int32_t getChannelCount() const override { return mChannelCount; }
+
+    oboe::AudioFormat getFormat() const override { return mFormat; }
+
+    int32_t getFramesPerBurst() override { return mFramesPerBurst; }
+
+    int64_t getFramesWritten() override { return mFramesWritten.load(std::memory_order_relaxed); }
+
+    int32_t getBufferSizeInFrames() override { return mBufferSizeInFrames.load(std::memory_order_relaxed); }
+
+    oboe::ResultWithValue<int32_t> getXRunCount() override { return mXRunCount.load(std::memory_order_relaxed); }
+
+    // Simulate what the device and the LatencyTuner do to a running stream.
+    void setBufferSizeInFrames(int32_t frames) { mBufferSizeInFrames.store(frames, std::memory_order_relaxed); }
+
+    void addXRuns(int32_t count) { mXRunCount.fetch_add(count, std::memory_order_relaxed); }
+
+    /**
+     * Call the callback once per burst on a new thread, paced in real time, until it returns Stop,
+     * maxBursts have been rendered or stop() is called.
+     */
+    void start(oboe::AudioStreamDataCallback* callback, int64_t maxBursts) {
+        stop();
+        mRunning = true;
+        mThread = std::thread([this, callback, maxBursts]() {
+            const auto period = std::chrono::nanoseconds(1000000000LL * mFramesPerBurst / mSampleRate);
+            auto       deadline = std::chrono::steady_clock::now();
+            for (int64_t burst = 0; burst < maxBursts && mRunning; ++burst) {
+                std::this_thread::sleep_until(deadline);
+                if (callback->onAudioReady(this, mBuffer.data(), mFramesPerBurst) != oboe::DataCallbackResult::Continue) {
+                    break;
+                }
+                mFramesWritten.fetch_add(mFramesPerBurst, std::memory_order_relaxed);
+                deadline += period;
+            }
+            mRunning = false;
+        });
+    }
+
+    void join() {
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    void stop() {
+        mRunning = false;
+        join();
+    }
+
+    // Float samples, or int16 ones for an I16 stream.
+    const std::vector<float>& lastBurst() const { return mBuffer; }
+
+  private:
+    int32_t           mSampleRate;
+    int32_t           mChannelCount;
+    int32_t           mFramesPerBurst;
+    oboe::AudioFormat mFormat;
+
+    std::vector<float>   mBuffer;
+    std::thread          mThread;
+    std::atomic<bool>    mRunning { false };
+    std::atomic<int64_t> mFramesWritten { 0 };
+    std::atomic<int32_t> mBufferSizeInFrames;
+    std::atomic<int32_t> mXRunCount { 0 };
+};
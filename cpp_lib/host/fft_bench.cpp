@@ -0,0 +1,255 @@
+/**
+ * Host benchmark for RealFft and the SpectrumAnalyzer tap.
+ *
+ * Checks RealFft against a DFT in double precision for every size up to 4096, so with both an odd
+ * and an even number of radix-4 stages, then times it for each size against the textbook scalar
+ * radix-2 FFT run over the real samples as complex ones. For the analyzer it reports what a 64 frame
+ * block costs the audio thread, checks that the worker keeps up with the ring, that a sine shows in
+ * the band of its frequency at its level, that silence reads as the floor, and that a stopped
+ * analyzer copies nothing.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+#include "RealFft.h"
+#include "SpectrumAnalyzer.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannelCount = 2;
+    constexpr int32_t kBlockFrames = 64;
+    constexpr int32_t kMaxCheckedSize = 4096;  // the DFT is quadratic
+    constexpr double  kMaxError = 2e-6;        // relative to the largest bin
+    constexpr int64_t kBenchNanos = 50000000;
+    constexpr int32_t kBlocksPerBatch = 32;    // a quarter of the ring, then the worker catches up
+    constexpr int32_t kBatches = 500;
+    constexpr float   kSineFrequency = 1000.0f;
+    constexpr float   kSineAmplitude = 0.5f;  // -6 dB
+    constexpr float   kMaxLevelErrorDb = 1.0f;
+
+    std::vector<float> makeNoise(uint32_t seed, size_t count) {
+        std::vector<float> noise(count);
+        for (float& sample : noise) {
+            seed = seed * 1664525u + 1013904223u;
+            sample = static_cast<float>(seed >> 8) / 16777216.0f * 2.0f - 1.0f;
+        }
+        return noise;
+    }
+
+    // Largest difference of the bins to a DFT in double precision, relative to the largest bin.
+    double dftError(const std::vector<float>& input, const std::vector<float>& re, const std::vector<float>& im) {
+        const size_t size = input.size();
+        double       maxError = 0.0;
+        double       maxMagnitude = 0.0;
+        for (size_t k = 0; k <= size / 2; ++k) {
+            std::complex<double> sum;
+            for (size_t n = 0; n < size; ++n) {
+                sum += double(input[n]) * std::polar(1.0, -2.0 * M_PI * double((k * n) % size) / double(size));
+            }
+            maxError = std::max(maxError, std::abs(sum - std::complex<double>(re[k], im[k])));
+            maxMagnitude = std::max(maxMagnitude, std::abs(sum));
+        }
+        return maxError / maxMagnitude;
+    }
+
+    /**
+     * In place iterative radix-2 FFT of complex samples with a table of twiddle factors, the scalar
+     * way to get the spectrum of real samples without RealFft.
+     */
+    class ScalarFft {
+      public:
+        explicit ScalarFft(int32_t size) : mSize(size), mTwiddles(size / 2), mData(size) {
+            for (int32_t k = 0; k < size / 2; ++k) {
+                mTwiddles[k] = std::polar(1.0f, static_cast<float>(-2.0 * M_PI * k / size));
+            }
+        }
+
+        void power(const float* input, float* power) {
+            // In locals, or the compiler reloads the members after every store
+            const int32_t                    size = mSize;
+            std::complex<float>*             data = mData.data();
+            const std::complex<float>* const twiddles = mTwiddles.data();
+            for (int32_t n = 0, reversed = 0; n < size; ++n) {
+                data[reversed] = input[n];
+                for (int32_t bit = size / 2; (reversed ^= bit) < bit; bit /= 2) {
+                }
+            }
+            for (int32_t length = 2; length <= size; length *= 2) {
+                const int32_t step = size / length;
+                for (int32_t start = 0; start < size; start += length) {
+                    for (int32_t k = 0; k < length / 2; ++k) {
+                        // Multiplied out, std::complex would check for infinities
+                        const std::complex<float> a = data[start + k];
+                        const std::complex<float> c = data[start + k + length / 2];
+                        const std::complex<float> w = twiddles[k * step];
+                        const std::complex<float> b(c.real() * w.real() - c.imag() * w.imag(),
+                                                    c.real() * w.imag() + c.imag() * w.real());
+                        data[start + k] = a + b;
+                        data[start + k + length / 2] = a - b;
+                    }
+                }
+            }
+            for (int32_t k = 0; k <= size / 2; ++k) {
+                power[k] = data[k].real() * data[k].real() + data[k].imag() * data[k].imag();
+            }
+        }
+
+      private:
+        int32_t                          mSize;
+        std::vector<std::complex<float>> mTwiddles;
+        std::vector<std::complex<float>> mData;
+    };
+
+    // Nanoseconds per call, over about kBenchNanos.
+    template <typename Fft>
+    double timePower(Fft& fft, const std::vector<float>& input, std::vector<float>& power) {
+        int64_t calls = 0;
+        int64_t elapsed = 0;
+        for (int32_t batch = 16; elapsed < kBenchNanos; batch *= 2) {
+            const int64_t start = benchNowNanos();
+            for (int32_t i = 0; i < batch; ++i) {
+                fft.power(input.data(), power.data());
+                benchKeep(power[1]);
+            }
+            elapsed += benchNowNanos() - start;
+            calls += batch;
+        }
+        return double(elapsed) / double(calls);
+    }
+
+    // Play blocks of a sine through the analyzer about as fast as the worker takes them.
+    void playSine(SpectrumAnalyzer& analyzer, float amplitude, int32_t blocks) {
+        std::vector<float> block(static_cast<size_t>(kBlockFrames) * kChannelCount);
+        for (int32_t i = 0; i < blocks; ++i) {
+            for (int32_t frame = 0; frame < kBlockFrames; ++frame) {
+                const int64_t position = int64_t(i) * kBlockFrames + frame;
+                const float   sample = amplitude * std::sin(2.0f * float(M_PI) * kSineFrequency
+                                                            * float(position % kSampleRate) / kSampleRate);
+                block[2 * frame] = sample;
+                block[2 * frame + 1] = sample;
+            }
+            analyzer.process(block.data(), kBlockFrames);
+            if ((i + 1) % kBlocksPerBatch == 0) {
+                usleep(SpectrumAnalyzer::kWorkerIdleMicros * 3);
+            }
+        }
+        usleep(SpectrumAnalyzer::kWorkerIdleMicros * 3);
+    }
+}  // namespace
+
+int main() {
+    bool ok = true;
+
+    // Every size against the DFT, sizes whose log2 is even end with a radix-2 stage.
+    for (int32_t size = RealFft::kMinSize; size <= kMaxCheckedSize; size *= 2) {
+        RealFft                  fft(size);
+        const std::vector<float> input = makeNoise(uint32_t(size), size);
+        std::vector<float>       re(fft.getBinCount());
+        std::vector<float>       im(fft.getBinCount());
+        fft.forward(input.data(), re.data(), im.data());
+        const double error = dftError(input, re, im);
+        printf("RealFft %5d: max error %.2g relative to the largest bin\n", size, error);
+        ok &= check(error < kMaxError, "RealFft differs from the DFT");
+    }
+    ok &= check(!RealFft::isSupported(RealFft::kMinSize / 2) && !RealFft::isSupported(1000)
+                && !RealFft::isSupported(RealFft::kMaxSize * 2),
+                "RealFft accepts a size it does not support");
+
+    printf("\n%6s %14s %14s %8s %18s\n", "size", "RealFft ns", "radix-2 ns", "speedup", "% of a hop at 48k");
+    for (int32_t size = RealFft::kMinSize; size <= RealFft::kMaxSize; size *= 2) {
+        RealFft                  fft(size);
+        ScalarFft                scalar(size);
+        const std::vector<float> input = makeNoise(7, size);
+        std::vector<float>       power(fft.getBinCount());
+        std::vector<float>       scalarPower(fft.getBinCount());
+        const double             fftNanos = timePower(fft, input, power);
+        const double             scalarNanos = timePower(scalar, input, scalarPower);
+        // The analyzer runs one FFT every half FFT of frames.
+        const double hopNanos = 1e9 * (size / 2) / kSampleRate;
+        printf("%6d %14.0f %14.0f %7.1fx %17.3f%%\n", size, fftNanos, scalarNanos, scalarNanos / fftNanos,
+               100.0 * fftNanos / hopNanos);
+        float maxPower = 0.0f;
+        float maxDifference = 0.0f;
+        for (size_t k = 0; k < power.size(); ++k) {
+            maxPower = std::max(maxPower, scalarPower[k]);
+            maxDifference = std::max(maxDifference, std::abs(power[k] - scalarPower[k]));
+        }
+        ok &= check(maxDifference <= 1e-4f * maxPower, "RealFft and the radix-2 FFT disagree");
+        ok &= check(fftNanos < scalarNanos, "RealFft is slower than the radix-2 FFT");
+    }
+
+    // The audio thread's share: a copy into the ring, while the worker keeps up.
+    SpectrumAnalyzer analyzer;
+    analyzer.prepare(kSampleRate, kChannelCount, kBlockFrames);
+    analyzer.start();
+    {
+        const std::vector<float> block = makeNoise(3, size_t(kBlockFrames) * kChannelCount);
+        std::vector<float>       buffer = block;
+        int64_t                  elapsed = 0;
+        for (int32_t batch = 0; batch < kBatches; ++batch) {
+            const int64_t start = benchNowNanos();
+            for (int32_t i = 0; i < kBlocksPerBatch; ++i) {
+                analyzer.process(buffer.data(), kBlockFrames);
+            }
+            elapsed += benchNowNanos() - start;
+            usleep(SpectrumAnalyzer::kWorkerIdleMicros * 3);
+        }
+        const double blockNanos = double(elapsed) / (kBatches * kBlocksPerBatch);
+        printf("\nanalyzer tap: %.1f ns per %d frame stereo block, %.3f%% of real time, %llu frames dropped\n",
+               blockNanos, kBlockFrames, 100.0 * blockNanos / (1e9 * kBlockFrames / kSampleRate),
+               (unsigned long long)analyzer.getDroppedFrames());
+        ok &= check(analyzer.getDroppedFrames() == 0, "the worker falls behind the ring");
+        ok &= check(buffer == block, "the analyzer changes the audio");
+    }
+
+    // A sine reads at its level in its band, the others far below.
+    analyzer.prepare(kSampleRate, kChannelCount, kBlockFrames);
+    playSine(analyzer, kSineAmplitude, kSampleRate / 4 / kBlockFrames);
+    SpectrumAnalyzer::Spectrum spectrum;
+    ok &= check(analyzer.read(spectrum), "the analyzer published nothing");
+    int32_t sineBand = 0;
+    while (analyzer.getBandEdge(sineBand + 1) <= kSineFrequency) {
+        ++sineBand;
+    }
+    const float expectedDb = 20.0f * std::log10(kSineAmplitude);
+    float       otherDb = SpectrumAnalyzer::kFloorDb;
+    for (int32_t band = 0; band < SpectrumAnalyzer::kBandCount; ++band) {
+        if (std::abs(band - sineBand) > 1) {
+            otherDb = std::max(otherDb, spectrum.bandsDb[band]);
+        }
+    }
+    printf("sine %.0f Hz at %.1f dB: band %d (%.0f-%.0f Hz) %.1f dB, farther bands at most %.1f dB, "
+           "spectrum %llu at frame %lld\n",
+           kSineFrequency, expectedDb, sineBand, analyzer.getBandEdge(sineBand),
+           analyzer.getBandEdge(sineBand + 1), spectrum.bandsDb[sineBand], otherDb,
+           (unsigned long long)spectrum.sequence, (long long)spectrum.framePosition);
+    ok &= check(std::abs(spectrum.bandsDb[sineBand] - expectedDb) < kMaxLevelErrorDb, "the sine's level is off");
+    ok &= check(otherDb < expectedDb - 40.0f, "the sine leaks into distant bands");
+    ok &= check(spectrum.framePosition > 0 && spectrum.framePosition % (analyzer.getFftSize() / 2) == 0,
+                "the frame position is not a whole number of hops");
+
+    // Silence reads as the floor once the sine has left the window.
+    playSine(analyzer, 0.0f, 4 * analyzer.getFftSize() / kBlockFrames);
+    ok &= check(analyzer.read(spectrum), "the analyzer published nothing");
+    ok &= check(*std::max_element(spectrum.bandsDb, spectrum.bandsDb + SpectrumAnalyzer::kBandCount)
+                == SpectrumAnalyzer::kFloorDb,
+                "silence is not at the floor");
+
+    // Stopped, it neither copies nor publishes.
+    analyzer.stop();
+    ok &= check(!analyzer.isRunning(), "the worker is still running");
+    const uint64_t sequence = spectrum.sequence;
+    playSine(analyzer, kSineAmplitude, 4 * analyzer.getFftSize() / kBlockFrames);
+    ok &= check(analyzer.read(spectrum) && spectrum.sequence == sequence, "a stopped analyzer published");
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
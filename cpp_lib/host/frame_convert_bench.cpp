@@ -0,0 +1,169 @@
+/**
+ * Host benchmark for converting camera frames in row bands on a worker pool, camera/frame_converter.h.
+ *
+ * Checks that the bands cover the crop, start on even rows of the image and keep the rotated tiles
+ * whole, that small frames stay on one thread, and that every rotation of I420 and NV21 frames, with
+ * odd crops, comes out the same with 1 to 8 threads as the per-pixel reference. Then times the pool
+ * waking its workers for an empty job, and 720p and 1080p frames with 1 to 8 threads.
+ *
+ * The scaling is only meaningful with as many free cores as threads; the number of CPUs is printed.
+ * Exits with a non-zero status if any check fails.
+ */
+#include <cstdio>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench_util.h"
+#include "camera/frame_converter.h"
+#include "camera/yuv_convert.h"
+#include "ndk_utils/worker_pool.h"
+#include "yuv_test_image.h"
+
+namespace {
+    constexpr int32_t kMaxThreads = 8;
+    constexpr int32_t kFrames = 50;
+    constexpr int32_t kEmptyJobs = 2000;
+    constexpr int32_t kRotations[] = {0, 90, 180, 270};
+
+    // Pixel by pixel with toRgba(), turned as FrameConverter::convert() documents.
+    std::vector<uint32_t> referenceConvert(const yuv::Image& image, const yuv::Rect& crop, int32_t rotation) {
+        const bool            turned = rotation == 90 || rotation == 270;
+        const int32_t         outStride = turned ? crop.height : crop.width;
+        std::vector<uint32_t> out(static_cast<size_t>(crop.width) * crop.height);
+        for (int32_t y = 0; y < crop.height; ++y) {
+            const int32_t row = crop.top + y;
+            for (int32_t x = 0; x < crop.width; ++x) {
+                const int32_t column = crop.left + x;
+                const size_t  chroma = static_cast<size_t>(row >> 1) * image.uvRowStride
+                                      + static_cast<size_t>(column >> 1) * image.uvPixelStride;
+                int32_t outRow = y;
+                int32_t outColumn = x;
+                switch (rotation) {
+                    case 90: outRow = x, outColumn = crop.height - 1 - y; break;
+                    case 180: outRow = crop.height - 1 - y, outColumn = crop.width - 1 - x; break;
+                    case 270: outRow = crop.width - 1 - x, outColumn = y; break;
+                }
+                out[static_cast<size_t>(outRow) * outStride + outColumn] =
+                        yuv::toRgba(image.y[static_cast<size_t>(row) * image.yRowStride + column], image.u[chroma],
+                                    image.v[chroma]);
+            }
+        }
+        return out;
+    }
+
+    bool checkBands(const yuv::Rect& crop, int32_t count) {
+        int32_t next = crop.top;
+        for (int32_t index = 0; index < count; ++index) {
+            const yuv::Rect band = yuv::FrameConverter::getBand(crop, index, count);
+            if (band.top != next || band.height < 0 || band.left != crop.left || band.width != crop.width) {
+                return false;
+            }
+            const int32_t first = band.top - crop.top;
+            if (index > 0 && band.height > 0
+                && (band.top % 2 != 0 || (first - (crop.top & 1)) % yuv::FrameConverter::kBandAlignment != 0)) {
+                return false;
+            }
+            next = band.top + band.height;
+        }
+        return next == crop.top + crop.height;
+    }
+
+    // Milliseconds per frame.
+    template <typename Convert>
+    double timeFrames(Convert convert) {
+        convert();
+        const int64_t start = benchNowNanos();
+        for (int32_t frame = 0; frame < kFrames; ++frame) {
+            convert();
+        }
+        return double(benchNowNanos() - start) / kFrames / 1e6;
+    }
+}  // namespace
+
+int main() {
+    bool ok = true;
+
+    bool bandsOk = true;
+    for (int32_t top : {0, 1, 2, 3}) {
+        for (int32_t height : {0, 1, 5, 16, 17, 63, 480, 721, 1080}) {
+            for (int32_t count = 1; count <= kMaxThreads; ++count) {
+                bandsOk &= checkBands({0, top, 64, height}, count);
+            }
+        }
+    }
+    printf("bands cover the crop from even image rows, %d-row aligned: %s\n", yuv::FrameConverter::kBandAlignment,
+           bandsOk ? "yes" : "NO");
+    ok &= check(bandsOk, "the bands do not split the crop as documented");
+
+    yuv::FrameConverter converter(kMaxThreads);
+    printf("bands with %d threads:", kMaxThreads);
+    const std::pair<int32_t, int32_t> sizes[] = {{320, 240}, {640, 480}, {1280, 720}, {1920, 1080}};
+    for (auto [width, height] : sizes) {
+        printf(" %dx%d %d,", width, height, converter.getBandCount({0, 0, width, height}));
+    }
+    printf("\n");
+    ok &= check(converter.getBandCount({0, 0, 320, 240}) == 1, "a 320x240 frame is split");
+    ok &= check(converter.getBandCount({0, 0, 1920, 1080}) == kMaxThreads, "a 1080p frame is not split");
+
+    // Every thread count on a cropped frame of each layout, against the reference.
+    for (Layout layout : {Layout::I420, Layout::NV21}) {
+        TestImage       image(layout, 1283, 731, 1344, 7);
+        const yuv::Rect crop {3, 5, 1277, 723};
+        bool            layoutOk = true;
+        for (int32_t rotation : kRotations) {
+            const std::vector<uint32_t> expected = referenceConvert(image.image, crop, rotation);
+            const int32_t               outStride = rotation == 90 || rotation == 270 ? crop.height : crop.width;
+            for (int32_t threads = 1; threads <= kMaxThreads; ++threads) {
+                yuv::FrameConverter   threaded(threads);
+                std::vector<uint32_t> out(expected.size());
+                threaded.convert(image.image, crop, rotation, out.data(), outStride);
+                layoutOk &= out == expected;
+            }
+        }
+        printf("%s: 0/90/180/270 with 1 to %d threads vs. the reference: %s\n", layoutName(layout), kMaxThreads,
+               layoutOk ? "identical" : "DIFFERENT");
+        ok &= check(layoutOk, "the banded conversion differs from the reference");
+    }
+
+    printf("\n%u CPUs\n%-28s", std::thread::hardware_concurrency(), "empty job us");
+    for (int32_t threads = 2; threads <= kMaxThreads; ++threads) {
+        WorkerPool    pool(threads);
+        const int64_t start = benchNowNanos();
+        for (int32_t job = 0; job < kEmptyJobs; ++job) {
+            pool.run(threads, [](int32_t index) { benchKeep(index); });
+        }
+        printf(" %d:%.1f", threads, double(benchNowNanos() - start) / kEmptyJobs / 1e3);
+    }
+    printf("\n\n%-28s", "ms per frame (speedup)");
+    for (int32_t threads = 1; threads <= kMaxThreads; ++threads) {
+        printf(" %12d", threads);
+    }
+    printf("\n");
+    const std::pair<int32_t, int32_t> frameSizes[] = {{1280, 720}, {1920, 1080}};
+    for (auto [width, height] : frameSizes) {
+        TestImage       image(Layout::NV21, width, height, width, 1);
+        const yuv::Rect crop {0, 0, width, height};
+        for (int32_t rotation : {0, 90}) {
+            std::vector<uint32_t> out(static_cast<size_t>(width) * height);
+            const int32_t         outStride = rotation == 90 ? height : width;
+            char                  name[64];
+            snprintf(name, sizeof(name), "%dx%d NV21 %d", width, height, rotation);
+            printf("%-28s", name);
+            double singleMs = 0.0;
+            for (int32_t threads = 1; threads <= kMaxThreads; ++threads) {
+                yuv::FrameConverter threaded(threads);
+                const double        ms = timeFrames([&]() {
+                    threaded.convert(image.image, crop, rotation, out.data(), outStride);
+                    benchKeep(out[0]);
+                });
+                singleMs = threads == 1 ? ms : singleMs;
+                printf(" %5.2f (%3.1fx)", ms, singleMs / ms);
+            }
+            printf("\n");
+        }
+    }
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
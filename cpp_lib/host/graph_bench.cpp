@@ -0,0 +1,381 @@
+/**
+ * Host benchmark for AudioGraph and its nodes.
+ *
+ * Checks the block SIMD biquad against the direct form for every response, mono and stereo, that a
+ * compiled graph shares buffers where it can and renders the same whatever the burst sizes, that a
+ * gain ramp moves smoothly to its target, and that no sample leaves the limiter above the threshold
+ * while a quiet signal passes it untouched. Rendering a compiled graph must not allocate. Then reports
+ * the cost of each node per 64 frame block.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "AudioGraph.h"
+#include "AudioNodes.h"
+#include "bench_util.h"
+
+namespace {
+    std::atomic<uint64_t> gAllocations {0};
+}  // namespace
+
+// Count every allocation, rendering a compiled graph must make none.
+void* operator new(size_t size) {
+    ++gAllocations;
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kBlockFrames = AudioGraph::kBlockFrames;
+    constexpr int32_t kCheckFrames = kSampleRate;
+    constexpr int32_t kBenchBlocks = 200000;
+    constexpr float   kMaxError = 1e-5f;
+
+    std::vector<float> makeNoise(uint32_t seed, size_t count, float amplitude) {
+        std::vector<float> noise(count);
+        for (float& sample : noise) {
+            seed = seed * 1664525u + 1013904223u;
+            sample = (static_cast<float>(seed >> 8) / 16777216.0f * 2.0f - 1.0f) * amplitude;
+        }
+        return noise;
+    }
+
+    // Plays interleaved samples over and over.
+    class LoopSource : public IRenderableAudio {
+      public:
+        LoopSource(std::vector<float> samples, int32_t channelCount)
+            : mSamples(std::move(samples)), mChannelCount(channelCount) {}
+
+        void renderAudio(float* audioData, int32_t numFrames) override {
+            for (size_t i = 0; i < static_cast<size_t>(numFrames) * mChannelCount; ++i) {
+                audioData[i] = mSamples[mPosition];
+                mPosition = mPosition + 1 == mSamples.size() ? 0 : mPosition + 1;
+            }
+        }
+
+      private:
+        std::vector<float> mSamples;
+        int32_t            mChannelCount;
+        size_t             mPosition = 0;
+    };
+
+    // The direct form, one sample at a time, in float like the node or in double for the exact output.
+    template <typename T>
+    void referenceBiquad(const BiquadNode::Coefficients& c, T* data, int32_t frames, int32_t channelCount) {
+        for (int32_t ch = 0; ch < channelCount; ++ch) {
+            T x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+            for (int32_t i = 0; i < frames; ++i) {
+                const T x = data[i * channelCount + ch];
+                const T y = c.b0 * x + c.b1 * x1 + c.b2 * x2 - c.a1 * y1 - c.a2 * y2;
+                x2 = x1, x1 = x, y2 = y1, y1 = y;
+                data[i * channelCount + ch] = y;
+            }
+        }
+    }
+
+    template <typename T>
+    double maxDifference(const std::vector<float>& a, const std::vector<T>& b) {
+        double difference = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            difference = std::max(difference, std::fabs(static_cast<double>(a[i]) - static_cast<double>(b[i])));
+        }
+        return difference;
+    }
+
+    // Process in blocks of varying size, like a graph fed by bursts which are not a block multiple.
+    void processInBlocks(AudioNode& node, float* data, int32_t frames, int32_t channelCount) {
+        const int32_t sizes[] = {kBlockFrames, 61, 3, kBlockFrames, 17, 1};
+        for (int32_t done = 0, k = 0; done < frames; ++k) {
+            const int32_t n = std::min(sizes[k % std::size(sizes)], frames - done);
+            node.process(data + static_cast<size_t>(done) * channelCount, n);
+            done += n;
+        }
+    }
+
+    bool checkBiquads() {
+        struct Design {
+            const char*      name;
+            BiquadNode::Type type;
+            float            frequency;
+            float            q;
+            float            gainDb;
+        };
+        const Design designs[] = {
+                {"low pass", BiquadNode::Type::LowPass, 1000.0f, 0.7071f, 0.0f},
+                {"high pass", BiquadNode::Type::HighPass, 80.0f, 0.7071f, 0.0f},
+                {"peaking", BiquadNode::Type::Peaking, 3000.0f, 2.0f, 6.0f},
+                {"low shelf", BiquadNode::Type::LowShelf, 200.0f, 0.7071f, -6.0f},
+                {"high shelf", BiquadNode::Type::HighShelf, 8000.0f, 0.7071f, 4.0f},
+        };
+        bool ok = true;
+        for (const Design& design : designs) {
+            for (int32_t channelCount = 1; channelCount <= 3; ++channelCount) {
+                const std::vector<float> input = makeNoise(7, static_cast<size_t>(kCheckFrames) * channelCount, 0.5f);
+                std::vector<double>      exact(input.begin(), input.end());
+                std::vector<float>       direct = input;
+                std::vector<float>       block = input;
+                BiquadNode               node(design.type, design.frequency, design.q, design.gainDb);
+                node.prepare(kSampleRate, channelCount, kBlockFrames);
+                referenceBiquad(node.getCoefficients(), exact.data(), kCheckFrames, channelCount);
+                referenceBiquad(node.getCoefficients(), direct.data(), kCheckFrames, channelCount);
+                processInBlocks(node, block.data(), kCheckFrames, channelCount);
+                // Low corners amplify rounding in either form, the block form rounds a few more products.
+                const double directError = maxDifference(direct, exact);
+                const double blockError = maxDifference(block, exact);
+                printf("biquad %-10s %d ch: max error %.2g, direct form %.2g\n", design.name, channelCount,
+                       blockError, directError);
+                ok &= check(blockError <= 4.0 * directError + kMaxError,
+                            "the block biquad is within a few times the rounding of the direct form");
+            }
+        }
+        return ok;
+    }
+
+    bool checkGraph() {
+        constexpr int32_t channelCount = 2;
+        const auto        noise = makeNoise(3, static_cast<size_t>(kCheckFrames) * channelCount, 0.3f);
+        bool              ok = true;
+
+        // A chain runs in place in the stream's buffer.
+        {
+            LoopSource source(noise, channelCount);
+            AudioGraph graph;
+            auto       id = graph.addSource(&source);
+            id = graph.addNode(std::make_shared<BiquadNode>(BiquadNode::Type::HighPass, 80.0f), id);
+            id = graph.addNode(std::make_shared<GainRampNode>(0.5f), id);
+            id = graph.addNode(std::make_shared<LimiterNode>(), id);
+            graph.setOutput(id);
+            ok &= check(graph.compile(kSampleRate, channelCount), "the chain compiles");
+            ok &= check(graph.getStepCount() == 4 && graph.getBufferCount() == 1,
+                        "a chain takes a step per node and a single buffer");
+        }
+
+        // Two branches of a source summed, against the same nodes run by hand.
+        LoopSource source(noise, channelCount);
+        AudioGraph graph;
+        const auto input = graph.addSource(&source);
+        const auto low = graph.addNode(std::make_shared<BiquadNode>(BiquadNode::Type::LowPass, 500.0f), input);
+        const auto high = graph.addNode(std::make_shared<BiquadNode>(BiquadNode::Type::HighPass, 4000.0f), input);
+        const auto unused = graph.addNode(std::make_shared<GainRampNode>(2.0f), input);
+        const auto mix = graph.addMix({low, high});
+        graph.setOutput(graph.addNode(std::make_shared<GainRampNode>(0.5f), mix));
+        ok &= check(unused != AudioGraph::kInvalidNode && graph.addNode(nullptr, mix) == AudioGraph::kInvalidNode
+                            && graph.addMix({mix, 99}) == AudioGraph::kInvalidNode,
+                    "nodes are only added over existing inputs");
+        graph.compile(kSampleRate, channelCount);
+        ok &= check(graph.getStepCount() == 6 && graph.getBufferCount() == 2,
+                    "a fork copies once, its last branch runs in place and unused nodes are left out");
+
+        BiquadNode lowRef(BiquadNode::Type::LowPass, 500.0f);
+        BiquadNode highRef(BiquadNode::Type::HighPass, 4000.0f);
+        lowRef.prepare(kSampleRate, channelCount, kCheckFrames);
+        highRef.prepare(kSampleRate, channelCount, kCheckFrames);
+        std::vector<float> lowOut = noise;
+        std::vector<float> highOut = noise;
+        lowRef.process(lowOut.data(), kCheckFrames);
+        highRef.process(highOut.data(), kCheckFrames);
+
+        // Bursts which are not a multiple of the block size.
+        std::vector<float> output(noise.size());
+        const int32_t      bursts[] = {192, 96, 240, 1, 333, 64};
+        for (int32_t done = 0, k = 0; done < kCheckFrames; ++k) {
+            const int32_t n = std::min(bursts[k % std::size(bursts)], kCheckFrames - done);
+            graph.renderAudio(output.data() + static_cast<size_t>(done) * channelCount, n);
+            done += n;
+        }
+        float maxError = 0.0f;
+        for (size_t i = 0; i < output.size(); ++i) {
+            maxError = std::max(maxError, std::fabs(output[i] - 0.5f * (lowOut[i] + highOut[i])));
+        }
+        ok &= check(maxError < kMaxError, "the graph renders the same as its nodes run by hand");
+        printf("graph: fork of two biquads summed and scaled, %zu steps, %d buffers, max error %.2g\n",
+               graph.getStepCount(), graph.getBufferCount(), maxError);
+
+        const uint64_t before = gAllocations.load();
+        for (int i = 0; i < 1000; ++i) {
+            graph.renderAudio(output.data(), 192);
+        }
+        const uint64_t allocations = gAllocations.load() - before;
+        ok &= check(allocations == 0, "rendering a compiled graph does not allocate");
+        printf("graph: %llu allocations in 1000 callbacks\n", (unsigned long long)allocations);
+
+        AudioGraph empty;
+        ok &= check(!empty.compile(kSampleRate, channelCount), "a graph needs an output");
+        empty.renderAudio(output.data(), 192);
+        ok &= check(std::all_of(output.begin(), output.begin() + 384, [](float x) { return x == 0.0f; }),
+                    "a graph without an output renders silence");
+        return ok;
+    }
+
+    bool checkGainRamp() {
+        constexpr int32_t channelCount = 2;
+        const int32_t     rampFrames = kSampleRate * GainRampNode::kRampMillis / 1000;
+        GainRampNode      node(1.0f);
+        node.prepare(kSampleRate, channelCount, kBlockFrames);
+        std::vector<float> ones(static_cast<size_t>(kCheckFrames / 4) * channelCount, 1.0f);
+        node.setGain(0.25f);
+        processInBlocks(node, ones.data(), kCheckFrames / 4, channelCount);
+
+        float maxStep = 0.0f;
+        bool  monotonic = true;
+        for (size_t i = channelCount; i < ones.size(); ++i) {
+            maxStep = std::max(maxStep, std::fabs(ones[i] - ones[i - channelCount]));
+            monotonic &= ones[i] <= ones[i - channelCount];
+        }
+        bool ok = check(monotonic && ones[0] < 1.0f, "the ramp moves toward the target from the first frame");
+        ok &= check(maxStep <= 0.75f / rampFrames * 1.01f, "the ramp is linear over kRampMillis");
+        ok &= check(ones[static_cast<size_t>(rampFrames - 1) * channelCount] == 0.25f && ones.back() == 0.25f,
+                    "the ramp ends on the target");
+        printf("gain ramp 1 -> 0.25: largest step %.2g, on target after %d frames\n", maxStep, rampFrames);
+        return ok;
+    }
+
+    bool checkLimiter() {
+        constexpr int32_t channelCount = 2;
+        LimiterNode       node;
+        node.prepare(kSampleRate, channelCount, kBlockFrames);
+        const int32_t latency = node.getLatencyFrames();
+
+        // Noise with bursts up to 12 dB over full scale, single sample spikes among them.
+        std::vector<float> input = makeNoise(11, static_cast<size_t>(kCheckFrames) * channelCount, 0.5f);
+        for (size_t i = 0; i < input.size(); ++i) {
+            const size_t frame = i / channelCount;
+            input[i] *= (frame / 4800) % 3 == 1 ? 8.0f : 1.0f;
+            if (frame % 7919 == 0) {
+                input[i] = 4.0f;
+            }
+        }
+        std::vector<float> output = input;
+        processInBlocks(node, output.data(), kCheckFrames, channelCount);
+        float peak = 0.0f;
+        for (float sample : output) {
+            peak = std::max(peak, std::fabs(sample));
+        }
+        bool ok = check(peak <= node.getThreshold() * (1.0f + 1e-6f),
+                        "no sample leaves the limiter over the threshold");
+
+        // Below the threshold the signal is only delayed.
+        LimiterNode quiet;
+        quiet.prepare(kSampleRate, channelCount, kBlockFrames);
+        std::vector<float> soft = makeNoise(5, static_cast<size_t>(kCheckFrames) * channelCount, 0.5f);
+        std::vector<float> delayed = soft;
+        processInBlocks(quiet, delayed.data(), kCheckFrames, channelCount);
+        bool untouched = true;
+        for (size_t i = static_cast<size_t>(latency) * channelCount; i < soft.size(); ++i) {
+            untouched &= delayed[i] == soft[i - static_cast<size_t>(latency) * channelCount];
+        }
+        ok &= check(untouched, "a signal under the threshold passes untouched");
+        printf("limiter: input peak 8, output peak %.4f for a threshold of %.4f, latency %d frames\n", peak,
+               node.getThreshold(), latency);
+        return ok;
+    }
+
+    // Time a process of a fresh block of noise, less the copy of the block.
+    template <typename Process>
+    double nanosPerBlock(const std::vector<float>& noise, int32_t channelCount, Process process) {
+        const size_t       blockSamples = static_cast<size_t>(kBlockFrames) * channelCount;
+        const size_t       blocks = noise.size() / blockSamples;
+        std::vector<float> block(blockSamples);
+        auto               run = [&](bool processing) {
+            const int64_t start = benchNowNanos();
+            for (int32_t i = 0; i < kBenchBlocks; ++i) {
+                std::copy_n(noise.data() + (i % blocks) * blockSamples, blockSamples, block.data());
+                if (processing) {
+                    process(block.data(), i);
+                }
+                benchKeep(block);
+            }
+            return static_cast<double>(benchNowNanos() - start) / kBenchBlocks;
+        };
+        return run(true) - run(false);
+    }
+
+    void bench() {
+        const double blockNanos = kBlockFrames * 1e9 / kSampleRate;
+        for (int32_t channelCount = 1; channelCount <= 2; ++channelCount) {
+            const auto noise = makeNoise(1, static_cast<size_t>(kBlockFrames) * 64 * channelCount, 0.5f);
+            auto       report = [&](const char* name, double nanos) {
+                printf("%d ch %-26s %7.1f ns per %d frame block, %.2f%% of real time\n", channelCount, name, nanos,
+                       kBlockFrames, nanos / blockNanos * 100.0);
+            };
+
+            BiquadNode biquad(BiquadNode::Type::Peaking, 3000.0f, 2.0f, 6.0f);
+            biquad.prepare(kSampleRate, channelCount, kBlockFrames);
+            const BiquadNode::Coefficients coefficients = biquad.getCoefficients();
+            report("biquad, direct form", nanosPerBlock(noise, channelCount, [&](float* block, int32_t) {
+                       referenceBiquad(coefficients, block, kBlockFrames, channelCount);
+                   }));
+            report("biquad, block SIMD", nanosPerBlock(noise, channelCount, [&](float* block, int32_t) {
+                       biquad.process(block, kBlockFrames);
+                   }));
+
+            GainRampNode gain(0.5f);
+            gain.prepare(kSampleRate, channelCount, kBlockFrames);
+            report("gain, constant", nanosPerBlock(noise, channelCount, [&](float* block, int32_t) {
+                       gain.process(block, kBlockFrames);
+                   }));
+            GainRampNode ramp(1.0f);
+            ramp.prepare(kSampleRate, channelCount, kBlockFrames);
+            report("gain, ramping", nanosPerBlock(noise, channelCount, [&](float* block, int32_t i) {
+                       ramp.setGain(i % 2 == 0 ? 0.5f : 1.0f);
+                       ramp.process(block, kBlockFrames);
+                   }));
+            LimiterNode limiter;
+            limiter.prepare(kSampleRate, channelCount, kBlockFrames);
+            report("limiter", nanosPerBlock(noise, channelCount, [&](float* block, int32_t i) {
+                       // Every other block is over the threshold.
+                       if (i % 2 == 0) {
+                           block[0] = 2.0f;
+                       }
+                       limiter.process(block, kBlockFrames);
+                   }));
+
+            // What the graph adds: a source rendered through no nodes, then through three.
+            std::vector<float> output(static_cast<size_t>(kBlockFrames) * channelCount);
+            LoopSource         source(noise, channelCount);
+            AudioGraph         graph;
+            auto               id = graph.addSource(&source);
+            graph.setOutput(id);
+            graph.compile(kSampleRate, channelCount);
+            auto render = [&]() {
+                const int64_t start = benchNowNanos();
+                for (int32_t i = 0; i < kBenchBlocks; ++i) {
+                    graph.renderAudio(output.data(), kBlockFrames);
+                    benchKeep(output);
+                }
+                return static_cast<double>(benchNowNanos() - start) / kBenchBlocks;
+            };
+            report("graph, source only", render());
+            id = graph.addNode(std::make_shared<BiquadNode>(BiquadNode::Type::HighPass, 80.0f), id);
+            id = graph.addNode(std::make_shared<GainRampNode>(0.5f), id);
+            graph.setOutput(graph.addNode(std::make_shared<LimiterNode>(), id));
+            graph.compile(kSampleRate, channelCount);
+            report("graph, biquad+gain+limiter", render());
+        }
+    }
+}  // namespace
+
+int main() {
+    bool ok = checkBiquads();
+    ok = checkGraph() && ok;
+    ok = checkGainRamp() && ok;
+    ok = checkLimiter() && ok;
+    bench();
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+/**
+ * Writes the Mp3FrameIndex of each MP3 given to <out_dir>/<name>.idx, for scripts/build_pack.sh to
+ * add next to the MP3 in the APK. The app then opens and seeks the clip without walking it.
+ *
+ * Usage: mp3_index <out_dir> <file.mp3> ...
+ * Exits with a non-zero status if a file cannot be indexed or written.
+ */
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Mp3FrameIndex.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <out_dir> <file.mp3> ...\n", argv[0]);
+        return 2;
+    }
+    const std::string outDir = argv[1];
+    int               failed = 0;
+    for (int i = 2; i < argc; ++i) {
+        const std::string    path = argv[i];
+        std::ifstream        file(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto                 index = Mp3FrameIndex::build(data.data(), data.size());
+        if (index == nullptr) {
+            fprintf(stderr, "Cannot index %s\n", path.c_str());
+            ++failed;
+            continue;
+        }
+
+        const std::string          outPath = outDir + "/" + path.substr(path.find_last_of('/') + 1) + ".idx";
+        const std::vector<uint8_t> bytes = index->serialize();
+        std::ofstream              out(outPath, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+            ++failed;
+            continue;
+        }
+        printf("%s: %zu seek points, %llu frames, %zu bytes\n", outPath.c_str(), index->getPointCount(),
+               (unsigned long long)index->getTotalFrames(), bytes.size());
+    }
+    return failed == 0 ? 0 : 1;
+}
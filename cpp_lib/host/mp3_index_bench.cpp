@@ -0,0 +1,172 @@
+/**
+ * Host benchmark for Mp3FrameIndex with the MP3 assets.
+ *
+ * It checks that an index survives serialization, is only matched to the clip it was built from and
+ * knows the clip's length, also through Mp3SoundGenerator, and that a seek through it lands on exactly
+ * the samples decoding the clip from the start gives. It reports what the index saves: the walk
+ * opening a clip used to make for its length against an open which takes it from the index, and a
+ * seek from the nearest point against decoding up to the target.
+ *
+ * Usage: mp3_index_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Mp3FrameIndex.h"
+#include "Mp3SoundGenerator.h"
+#include "PcmDecoder.h"
+#include "bench_util.h"
+#include "dr_mp3.h"
+
+namespace {
+    constexpr int      kSeekTargets = 64;
+    constexpr uint64_t kCompareFrames = 1152;
+    constexpr int      kOpenPasses = 200;
+    const char* const  kAssets[] = {"robot_boot.mp3", "robot_random_code.mp3", "robot_thankyou.mp3", "test.mp3"};
+
+    std::vector<float> decodeAll(const std::vector<uint8_t>& data, int32_t& channelCount) {
+        auto decoder = PcmDecoder::open(data.data(), data.size());
+        channelCount = decoder->getChannelCount();
+        std::vector<float> pcm;
+        std::vector<float> chunk(4096 * channelCount);
+        while (uint64_t frames = decoder->read(chunk.data(), 4096)) {
+            pcm.insert(pcm.end(), chunk.begin(), chunk.begin() + frames * channelCount);
+        }
+        return pcm;
+    }
+
+    // Seek to each target, read on and compare with the clip decoded from the start.
+    // @return the largest difference, or a negative value if a seek failed
+    double checkSeeks(PcmDecoder& decoder, const std::vector<float>& pcm, const std::vector<uint64_t>& targets,
+                      double& micros) {
+        const int32_t      channelCount = decoder.getChannelCount();
+        std::vector<float> frames(kCompareFrames * channelCount);
+        double             maxDiff = 0.0;
+        int64_t            seekNanos = 0;
+        for (uint64_t target : targets) {
+            const int64_t start = benchNowNanos();
+            const bool    ok = decoder.seek(target);
+            seekNanos += benchNowNanos() - start;
+            if (!ok) {
+                return -1.0;
+            }
+            const uint64_t read = decoder.read(frames.data(), kCompareFrames);
+            const uint64_t expected = std::min<uint64_t>(kCompareFrames, pcm.size() / channelCount - target);
+            if (read != expected) {
+                return -1.0;
+            }
+            for (uint64_t i = 0; i < read * channelCount; ++i) {
+                maxDiff = std::max<double>(maxDiff, std::fabs(frames[i] - pcm[target * channelCount + i]));
+            }
+        }
+        micros = seekNanos / 1e3 / targets.size();
+        return maxDiff;
+    }
+
+    bool checkAsset(const std::string& assetDir, const char* name, const std::vector<uint8_t>& other) {
+        std::vector<uint8_t> data = readFile(assetDir + "/" + name);
+        int32_t              channelCount = 0;
+        const auto           pcm = decodeAll(data, channelCount);
+        const uint64_t       totalFrames = pcm.size() / std::max(channelCount, 1);
+
+        int64_t      start = benchNowNanos();
+        const auto   built = Mp3FrameIndex::build(data.data(), data.size());
+        const double buildMillis = (benchNowNanos() - start) / 1e6;
+        if (!check(built != nullptr, "the MP3 is indexed")) {
+            return false;
+        }
+
+        // The app only ever sees the serialized form.
+        const std::vector<uint8_t> bytes = built->serialize();
+        const auto                 index = Mp3FrameIndex::deserialize(bytes.data(), bytes.size());
+        bool ok = check(index != nullptr && index->serialize() == bytes, "the index survives serialization");
+        ok &= check(Mp3FrameIndex::deserialize(bytes.data(), bytes.size() - 1) == nullptr,
+                    "a truncated index is rejected");
+        if (index == nullptr) {
+            return false;
+        }
+        ok &= check(index->matches(data.data(), data.size()), "the index matches its clip");
+        ok &= check(!index->matches(other.data(), other.size()), "the index does not match another clip");
+        std::vector<uint8_t> edited = data;
+        edited[edited.size() - 2] ^= 1;
+        ok &= check(!index->matches(edited.data(), edited.size()), "the index does not match an edited clip");
+        ok &= check(index->getTotalFrames() == totalFrames, "the index knows the clip's length");
+
+        std::mt19937          random(7);
+        std::vector<uint64_t> targets = {0, totalFrames / 2, totalFrames - 1};
+        while (targets.size() < kSeekTargets) {
+            targets.push_back(std::uniform_int_distribution<uint64_t>(0, totalFrames - 1)(random));
+        }
+
+        double       indexedMicros = 0.0;
+        double       walkMicros = 0.0;
+        auto         indexed = PcmDecoder::open(data.data(), data.size(), index);
+        auto         plain = PcmDecoder::open(data.data(), data.size());
+        auto         mismatched = PcmDecoder::open(data.data(), data.size(),
+                                                   Mp3FrameIndex::build(other.data(), other.size()));
+        const double indexedDiff = checkSeeks(*indexed, pcm, targets, indexedMicros);
+        const double walkDiff = checkSeeks(*plain, pcm, targets, walkMicros);
+        double       ignoredMicros = 0.0;
+        ok &= check(indexedDiff == 0.0, "a seek through the index lands on the same samples");
+        ok &= check(walkDiff == 0.0, "a seek without an index lands on the same samples");
+        ok &= check(checkSeeks(*mismatched, pcm, targets, ignoredMicros) == 0.0,
+                    "an index of another clip is ignored");
+
+        auto generator = Mp3SoundGenerator::createFromBuf(reinterpret_cast<char*>(data.data()), data.size(), 2, index);
+        ok &= check(generator && generator.value()->getFrameCount() == totalFrames,
+                    "Mp3SoundGenerator takes the length from the index");
+        if (generator) {
+            generator.value()->startStreaming();
+            generator.value()->resetData(reinterpret_cast<char*>(data.data()), data.size(), index);
+            ok &= check(generator.value()->getFrameCount() == totalFrames && generator.value()->seekTo(totalFrames / 2),
+                        "a streaming Mp3SoundGenerator keeps the index across resetData");
+        }
+
+        // What opening used to cost: walking every frame header for the length.
+        start = benchNowNanos();
+        for (int pass = 0; pass < kOpenPasses; ++pass) {
+            drmp3 mp3;
+            drmp3_init_memory(&mp3, data.data(), data.size(), nullptr);
+            drmp3_uint64 mp3Frames = 0;
+            drmp3_uint64 pcmFrames = 0;
+            drmp3_get_mp3_and_pcm_frame_count(&mp3, &mp3Frames, &pcmFrames);
+            benchKeep(pcmFrames);
+            drmp3_uninit(&mp3);
+        }
+        const double walkOpenMicros = (benchNowNanos() - start) / 1e3 / kOpenPasses;
+        start = benchNowNanos();
+        for (int pass = 0; pass < kOpenPasses; ++pass) {
+            auto decoder = PcmDecoder::open(data.data(), data.size(), index);
+            benchKeep(decoder);
+        }
+        const double openMicros = (benchNowNanos() - start) / 1e3 / kOpenPasses;
+
+        printf("%-22s %7llu frames, %3zu points, %5zu bytes, built in %5.2f ms\n", name,
+               (unsigned long long)totalFrames, index->getPointCount(), bytes.size(), buildMillis);
+        printf("%-22s open: %8.1f us walking, %6.1f us with the index\n", "", walkOpenMicros, openMicros);
+        printf("%-22s seek: %8.1f us decoding from the start, %6.1f us from a point, max diff %g\n", "",
+               walkMicros, indexedMicros, indexedDiff);
+        return ok;
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+    for (size_t i = 0; i < std::size(kAssets); ++i) {
+        // Any other asset does as a clip the index must not match.
+        const std::vector<uint8_t> other = readFile(assetDir + "/" + kAssets[(i + 1) % std::size(kAssets)]);
+        if (other.empty()) {
+            fprintf(stderr, "Cannot read the assets in %s\n", assetDir.c_str());
+            return 1;
+        }
+        ok = checkAsset(assetDir, kAssets[i], other) && ok;
+    }
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/**
+ * Transcodes MP3, WAV or FLAC clips into one PcmPack, for scripts/build_pack.sh to add to the APK.
+ * The app then plays those clips from the mapped pack instead of decoding them.
+ *
+ * Usage: pcm_pack [-r rate] [-c channels] [-f i16|float] <out.pcmpack> <file> ...
+ * The defaults are 48000 Hz, 2 channels and int16. Clips are named by their file name, the name
+ * the app asks for them by. Exits with a non-zero status if a file cannot be decoded or the pack
+ * cannot be written.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClipCache.h"
+#include "PcmPack.h"
+
+int main(int argc, char** argv) {
+    int32_t               sampleRate = 48000;
+    int32_t               channelCount = 2;
+    PcmPack::SampleFormat format = PcmPack::SampleFormat::I16;
+    int                   arg = 1;
+    bool                  valid = true;
+    for (; valid && arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        const std::string option = argv[arg];
+        const std::string value = argv[arg + 1];
+        if (option == "-r") {
+            sampleRate = atoi(value.c_str());
+        } else if (option == "-c") {
+            channelCount = atoi(value.c_str());
+        } else if (option == "-f" && (value == "i16" || value == "float")) {
+            format = value == "float" ? PcmPack::SampleFormat::Float : PcmPack::SampleFormat::I16;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || argc - arg < 2 || sampleRate <= 0 || channelCount <= 0) {
+        fprintf(stderr, "Usage: %s [-r rate] [-c channels] [-f i16|float] <out.pcmpack> <file> ...\n", argv[0]);
+        return 2;
+    }
+
+    const std::string                     outPath = argv[arg];
+    std::vector<std::unique_ptr<PcmClip>> clips;
+    for (int i = arg + 1; i < argc; ++i) {
+        const std::string    path = argv[i];
+        std::ifstream        file(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const std::string    name = path.substr(path.find_last_of('/') + 1);
+        auto clip = ClipCache::decode(name, data.data(), data.size(), sampleRate, channelCount);
+        if (clip == nullptr) {
+            fprintf(stderr, "Cannot decode %s\n", path.c_str());
+            return 1;
+        }
+        clips.push_back(std::move(clip));
+    }
+
+    std::vector<const PcmClip*> views;
+    for (const auto& clip : clips) {
+        views.push_back(clip.get());
+    }
+    const std::vector<uint8_t> bytes = PcmPack::build(views, format);
+    std::ofstream              out(outPath, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (bytes.empty() || !out) {
+        fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+        return 1;
+    }
+    for (const auto& clip : clips) {
+        printf("%s: %d frames, %.2f s\n", clip->name.c_str(), clip->frames, (double)clip->frames / sampleRate);
+    }
+    printf("%s: %zu clips, %d Hz, %d ch, %s, %zu bytes\n", outPath.c_str(), clips.size(), sampleRate, channelCount,
+           format == PcmPack::SampleFormat::I16 ? "int16" : "float", bytes.size());
+    return 0;
+}
@@ -0,0 +1,253 @@
+/**
+ * Host benchmark for clips played from a PcmPack instead of decoded on the device.
+ *
+ * It packs the robot clips as float and as int16, the way host/pcm_pack.cpp does for the APK, maps
+ * the packs back and checks that every clip is found, page aligned and holds the decoded samples,
+ * that the mixer plays a mapped clip as it plays the decoded one, and that a cut short pack is
+ * refused. Then it compares startup, the time until every clip can be played, and the latency of a
+ * clip's first trigger up to its first rendered burst: decoding the MP3 into the cache as float or
+ * IMA-ADPCM on the trigger, against looking the clip up in the pack. The pack is timed with its
+ * pages dropped from the page cache, as after a reboot, with and without PcmPack::prefetch, and
+ * with its pages resident.
+ *
+ * Usage: pcm_pack_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClipCache.h"
+#include "PcmPack.h"
+#include "VoiceMixer.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannelCount = 2;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int     kPasses = 20;
+    constexpr double  kMinI16SnrDb = 60.0;  // the quietest clip peaks well below full scale
+    const char* const kClipNames[] = {"robot_boot.mp3", "robot_random_code.mp3", "robot_thankyou.mp3"};
+
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return !bytes.empty() && file.good();
+    }
+
+    // Drop the file's pages from the page cache, so the next read of them goes to the disk.
+    void evictFromPageCache(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+
+    double snrDb(const std::vector<float>& reference, const PcmClip& clip) {
+        double signal = 0.0;
+        double noise = 0.0;
+        for (size_t i = 0; i < reference.size(); ++i) {
+            const double error = clip.mappedI16[i] / 32768.0 - reference[i];
+            signal += double(reference[i]) * reference[i];
+            noise += error * error;
+        }
+        return 10.0 * std::log10(signal / std::max(noise, 1e-20));
+    }
+
+    // Render a clip through the mixer in bursts of varying size.
+    std::vector<float> renderClip(const PcmClip& clip, float gain) {
+        VoiceMixer         mixer(clip.sampleRate, clip.channelCount);
+        std::vector<float> out;
+        std::vector<float> burst(static_cast<size_t>(kBurstFrames) * clip.channelCount);
+        mixer.play(&clip, gain);
+        for (int32_t frames = 0, burstFrames = 1; frames < clip.frames; frames += burstFrames) {
+            burstFrames = 1 + (frames * 7 + 13) % kBurstFrames;
+            mixer.renderAudio(burst.data(), burstFrames);
+            out.insert(out.end(), burst.begin(), burst.begin() + static_cast<size_t>(burstFrames) * clip.channelCount);
+        }
+        out.resize(static_cast<size_t>(clip.frames) * clip.channelCount);
+        return out;
+    }
+
+    // Play a clip and render the burst it starts in, what a trigger costs after the clip is found.
+    void playFirstBurst(VoiceMixer& mixer, const PcmClip* clip, std::vector<float>& burst) {
+        mixer.play(clip);
+        mixer.renderAudio(burst.data(), kBurstFrames);
+        benchKeep(burst[0]);
+    }
+
+    struct Latency {
+        double startupNanos = 0.0;       // until every clip can be played
+        double firstTriggerNanos = 0.0;  // worst of the clips, none loaded ahead
+    };
+
+    // Decode each clip into a fresh cache on its first trigger, as the app does without a pack.
+    Latency timeCache(const std::vector<std::vector<uint8_t>>& files, ClipStorage storage) {
+        Latency            latency;
+        std::vector<float> burst(static_cast<size_t>(kBurstFrames) * kChannelCount);
+        for (int pass = 0; pass < kPasses; ++pass) {
+            ClipCache  cache;
+            VoiceMixer mixer(kSampleRate, kChannelCount);
+            cache.setFormat(kSampleRate, kChannelCount);
+            cache.setStorage(storage);
+            int64_t total = 0;
+            for (size_t i = 0; i < files.size(); ++i) {
+                const int64_t  start = benchNowNanos();
+                const PcmClip* clip = cache.insert(kClipNames[i], files[i].data(), files[i].size());
+                playFirstBurst(mixer, clip, burst);
+                const int64_t nanos = benchNowNanos() - start;
+                total += nanos;
+                latency.firstTriggerNanos = std::max(latency.firstTriggerNanos, double(nanos));
+            }
+            latency.startupNanos += double(total) / kPasses;
+        }
+        return latency;
+    }
+
+    // Map the pack and trigger each clip once.
+    Latency timePack(const std::string& path, bool cold, bool prefetch) {
+        Latency            latency;
+        std::vector<float> burst(static_cast<size_t>(kBurstFrames) * kChannelCount);
+        for (int pass = 0; pass < kPasses; ++pass) {
+            if (cold) {
+                evictFromPageCache(path);
+            }
+            std::unique_ptr<PcmPack> pack;  // outlives the voices
+            VoiceMixer               mixer(kSampleRate, kChannelCount);
+            const int64_t            start = benchNowNanos();
+            pack = PcmPack::openFile(path);
+            if (prefetch) {
+                pack->prefetch();
+            }
+            latency.startupNanos += double(benchNowNanos() - start) / kPasses;
+            for (const char* name : kClipNames) {
+                const int64_t triggered = benchNowNanos();
+                playFirstBurst(mixer, pack->find(name), burst);
+                latency.firstTriggerNanos = std::max(latency.firstTriggerNanos,
+                                                     double(benchNowNanos() - triggered));
+            }
+        }
+        return latency;
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    std::vector<std::vector<uint8_t>>     files;
+    std::vector<std::unique_ptr<PcmClip>> decoded;
+    std::vector<const PcmClip*>           clips;
+    for (const char* name : kClipNames) {
+        files.push_back(readFile(assetDir + "/" + name));
+        decoded.push_back(ClipCache::decode(name, files.back().data(), files.back().size(), kSampleRate,
+                                            kChannelCount));
+        if (decoded.back() == nullptr) {
+            fprintf(stderr, "Cannot decode %s/%s\n", assetDir.c_str(), name);
+            return 1;
+        }
+        clips.push_back(decoded.back().get());
+    }
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string           floatPath = dir / "pcm_pack_bench_float.pcmpack";
+    const std::string           i16Path = dir / "pcm_pack_bench_i16.pcmpack";
+    const std::vector<uint8_t>  floatBytes = PcmPack::build(clips, PcmPack::SampleFormat::Float);
+    const std::vector<uint8_t>  i16Bytes = PcmPack::build(clips, PcmPack::SampleFormat::I16);
+    if (!check(writeFile(floatPath, floatBytes) && writeFile(i16Path, i16Bytes), "the packs cannot be written")) {
+        return 1;
+    }
+    auto floatPack = PcmPack::openFile(floatPath);
+    auto i16Pack = PcmPack::openFile(i16Path);
+    if (!check(floatPack != nullptr && i16Pack != nullptr, "the packs cannot be opened")) {
+        return 1;
+    }
+
+    size_t mp3Bytes = 0;
+    for (const std::vector<uint8_t>& file : files) {
+        mp3Bytes += file.size();
+    }
+    printf("%-28s %10s\n", "Stereo clips at 48 kHz", "bytes");
+    printf("%-28s %10zu\n", "MP3 files", mp3Bytes);
+    printf("%-28s %10zu\n", "float pack", floatPack->getSize());
+    printf("%-28s %10zu\n", "int16 pack", i16Pack->getSize());
+
+    // Every clip is there, on its own pages, and holds the decoded samples.
+    printf("\n%-28s %8s\n", "int16 pack", "SNR dB");
+    for (const PcmClip* clip : clips) {
+        const PcmClip* asFloat = floatPack->find(clip->name);
+        const PcmClip* asI16 = i16Pack->find(clip->name);
+        if (!check(asFloat != nullptr && asI16 != nullptr, "a clip is missing from a pack")) {
+            return 1;
+        }
+        ok &= check(reinterpret_cast<uintptr_t>(asFloat->mappedFloat) % PcmPack::kPageSize == 0
+                    && reinterpret_cast<uintptr_t>(asI16->mappedI16) % PcmPack::kPageSize == 0,
+                    "a clip does not start on a page");
+        ok &= check(asFloat->frames == clip->frames && asI16->frames == clip->frames
+                    && asFloat->sampleRate == kSampleRate && asFloat->channelCount == kChannelCount,
+                    "a mapped clip has the wrong format");
+        ok &= check(std::equal(clip->samples.begin(), clip->samples.end(), asFloat->mappedFloat),
+                    "the float pack does not hold the decoded samples");
+        const double snr = snrDb(clip->samples, *asI16);
+        printf("%-28s %8.1f\n", clip->name.c_str(), snr);
+        ok &= check(snr >= kMinI16SnrDb, "the int16 pack is too noisy");
+
+        // The mixer plays a mapped clip like the decoded one, int16 scaled by 1 / 32768.
+        ok &= check(renderClip(*asFloat, 0.5f) == renderClip(*clip, 0.5f),
+                    "the mixer does not play the mapped float clip");
+        std::vector<float> expected(static_cast<size_t>(clip->frames) * kChannelCount);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            expected[i] = asI16->mappedI16[i] * (0.5f / 32768.0f);
+        }
+        ok &= check(renderClip(*asI16, 0.5f) == expected, "the mixer does not play the mapped int16 clip");
+    }
+    ok &= check(PcmPack::open(i16Bytes.data(), i16Bytes.size() - 1) == nullptr
+                && PcmPack::open(i16Bytes.data(), 16) == nullptr,
+                "a cut short pack was opened");
+    // Sample rate, channel count and the first clip's frames, after the 24 byte header and its name.
+    const size_t framesAt = 24 + 2 + (i16Bytes[24] | i16Bytes[25] << 8) + 8;
+    const size_t fields[] = {8, 12, framesAt};
+    for (size_t field : fields) {
+        std::vector<uint8_t> corrupt = i16Bytes;
+        std::fill_n(corrupt.begin() + field, 4, field == framesAt ? 0xff : 0);
+        ok &= check(PcmPack::open(corrupt.data(), corrupt.size()) == nullptr,
+                    "a pack with no rate, no channels or negative frames was opened");
+    }
+    floatPack.reset();
+    i16Pack.reset();
+
+    // Startup and first trigger
+    const Latency mp3Float = timeCache(files, ClipStorage::Float);
+    const Latency mp3Adpcm = timeCache(files, ClipStorage::Adpcm);
+    const Latency cold = timePack(i16Path, true, false);
+    const Latency coldPrefetch = timePack(i16Path, true, true);
+    const Latency warm = timePack(i16Path, false, false);
+    const Latency warmFloat = timePack(floatPath, false, false);
+    printf("\n%-36s %12s %18s\n", "3 clips", "startup us", "first trigger us");
+    const auto row = [](const char* label, const Latency& latency) {
+        printf("%-36s %12.1f %18.1f\n", label, latency.startupNanos / 1000, latency.firstTriggerNanos / 1000);
+    };
+    row("MP3 decoded into the cache, float", mp3Float);
+    row("MP3 decoded into the cache, ADPCM", mp3Adpcm);
+    row("int16 pack, cold page cache", cold);
+    row("int16 pack, cold, prefetched", coldPrefetch);
+    row("int16 pack, resident", warm);
+    row("float pack, resident", warmFloat);
+    ok &= check(warm.startupNanos < mp3Float.startupNanos && warm.firstTriggerNanos < mp3Float.firstTriggerNanos,
+                "the pack is not faster than decoding");
+
+    std::filesystem::remove(floatPath);
+    std::filesystem::remove(i16Path);
+    printf("%s\n", ok ? "All checks passed" : "Some checks FAILED");
+    return ok ? 0 : 1;
+}
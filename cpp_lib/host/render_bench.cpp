@@ -0,0 +1,187 @@
+/**
+ * Renders the app's audio sources offline through the render harness and reports per-callback
+ * time percentiles against the burst deadline.
+ *
+ * Usage: render_bench [options]
+ *   --source NAME    tone, oscillator, synth, mp3, mp3-stream or mixer, may be repeated (default all)
+ *   --rate HZ        stream sample rate (48000)
+ *   --channels N     stream channel count for the sources which follow it (2)
+ *   --burst FRAMES   frames per callback (192)
+ *   --seconds S      audio rendered per source (5)
+ *   --variable       vary the callback size between 1 and the burst
+ *   --wav-dir DIR    write DIR/<source>.wav
+ *   --assets DIR     where the MP3 assets are (assets)
+ *
+ * Exits with a non-zero status if a source misses its deadline at the 99th percentile, or is silent.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClipCache.h"
+#include "Mp3SoundGenerator.h"
+#include "Oscillator.h"
+#include "SoundGenerator.h"
+#include "SynthSound.h"
+#include "VoiceMixer.h"
+#include "bench_util.h"
+#include "render_harness.h"
+
+namespace {
+    const char* kAllSources[] = {"tone", "oscillator", "synth", "mp3", "mp3-stream", "mixer"};
+    const char* kClipAssets[] = {"robot_boot.mp3", "robot_random_code.mp3", "robot_thankyou.mp3", "test.mp3"};
+
+    /**
+     * A source together with whatever it needs to stay alive while it renders.
+     */
+    struct Source {
+        std::shared_ptr<IRenderableAudio>  audio;
+        std::shared_ptr<void>              keepAlive;
+        int32_t                            channelCount = 0;  // fixed by the source, 0 if it follows the stream
+        bool                               realtime = false;
+    };
+
+    bool makeSource(const std::string& name, const RenderConfig& config, const std::string& assetDir, Source& source) {
+        if (name == "tone") {
+            auto tone = std::make_shared<SoundGenerator>(config.sampleRate, config.channelCount);
+            tone->tap(true);
+            source.audio = tone;
+        } else if (name == "oscillator") {
+            auto oscillator = std::make_shared<Oscillator>();
+            oscillator->setSampleRate(config.sampleRate);
+            oscillator->setAmplitude(0.5f);
+            oscillator->setWaveOn(true);
+            source.audio = oscillator;
+            source.channelCount = 1;
+        } else if (name == "synth") {
+            auto synth = std::make_shared<SynthSound>();
+            synth->setSampleRate(config.sampleRate);
+            synth->setFrequency(440.0f);
+            synth->setAmplitude(0.3f);
+            synth->noteOn();
+            source.audio = synth;
+            source.channelCount = 1;
+        } else if (name == "mp3" || name == "mp3-stream") {
+            auto data = std::make_shared<std::vector<uint8_t>>(readFile(assetDir + "/test.mp3"));
+            if (data->empty()) {
+                fprintf(stderr, "Cannot read %s/test.mp3\n", assetDir.c_str());
+                return false;
+            }
+            auto mp3 = Mp3SoundGenerator::createFromBuf(reinterpret_cast<char*>(data->data()), data->size(),
+                                                        config.channelCount)
+                               .value();
+            mp3->setSampleRate(config.sampleRate);
+            if (name == "mp3-stream") {
+                mp3->startStreaming();
+                // The decoder thread only keeps up with a consumer running in real time.
+                source.realtime = true;
+            }
+            source.audio = mp3;
+            source.keepAlive = data;
+        } else if (name == "mixer") {
+            auto cache = std::make_shared<ClipCache>();
+            cache->setFormat(config.sampleRate, config.channelCount);
+            auto mixer = std::make_shared<VoiceMixer>(config.sampleRate, config.channelCount);
+            for (const char* asset : kClipAssets) {
+                std::vector<uint8_t> data = readFile(assetDir + "/" + asset);
+                const PcmClip*       clip = cache->insert(asset, data.data(), data.size());
+                if (clip == nullptr) {
+                    fprintf(stderr, "Cannot load %s/%s\n", assetDir.c_str(), asset);
+                    return false;
+                }
+                mixer->play(clip, 0.25f);
+            }
+            source.audio = mixer;
+            source.keepAlive = cache;
+        } else {
+            fprintf(stderr, "Unknown source %s\n", name.c_str());
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    RenderConfig             config;
+    std::string              assetDir = "assets";
+    std::string              wavDir;
+    std::vector<std::string> names;
+    std::vector<int32_t>     channelCounts;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const char*       value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--variable") {
+            config.variableBursts = true;
+            continue;
+        }
+        if (value == nullptr) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return 2;
+        }
+        ++i;
+        if (arg == "--source") {
+            names.push_back(value);
+            channelCounts.push_back(config.channelCount);
+        } else if (arg == "--rate") {
+            config.sampleRate = atoi(value);
+        } else if (arg == "--channels") {
+            config.channelCount = atoi(value);
+        } else if (arg == "--burst") {
+            config.burstFrames = atoi(value);
+        } else if (arg == "--seconds") {
+            config.seconds = atof(value);
+        } else if (arg == "--wav-dir") {
+            wavDir = value;
+        } else if (arg == "--assets") {
+            assetDir = value;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (names.empty()) {
+        names.assign(std::begin(kAllSources), std::end(kAllSources));
+        channelCounts.assign(names.size(), config.channelCount);
+    }
+    if (config.sampleRate <= 0 || config.channelCount <= 0 || config.burstFrames <= 0 || config.seconds <= 0) {
+        fprintf(stderr, "Invalid stream configuration\n");
+        return 2;
+    }
+
+    printf("%d Hz, %d frame bursts%s, %.1f s per source\n", config.sampleRate, config.burstFrames,
+           config.variableBursts ? " (variable)" : "", config.seconds);
+    RenderStats::printHeader();
+    bool ok = true;
+    for (size_t i = 0; i < names.size(); ++i) {
+        RenderConfig sourceConfig = config;
+        sourceConfig.channelCount = channelCounts[i];
+        Source source;
+        if (!makeSource(names[i], sourceConfig, assetDir, source)) {
+            return 2;
+        }
+        if (source.channelCount != 0) {
+            sourceConfig.channelCount = source.channelCount;
+        }
+        sourceConfig.realtime = source.realtime;
+        if (!wavDir.empty()) {
+            sourceConfig.wavPath = wavDir + "/" + names[i] + ".wav";
+        }
+
+        const RenderStats stats = renderOffline(*source.audio, sourceConfig);
+        const std::string label = names[i] + " (" + std::to_string(sourceConfig.channelCount) + " ch)";
+        stats.print(label.c_str());
+        if (stats.callbacks == 0 || stats.p99Micros > stats.deadlineMicros) {
+            ok = false;
+        }
+        if (stats.peak == 0.0f) {
+            fprintf(stderr, "%s rendered silence\n", names[i].c_str());
+            ok = false;
+        }
+    }
+    printf(ok ? "PASS\n" : "FAIL: a source missed its deadline or was silent\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include "render_harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "dr_wav.h"
+
+#include "bench_util.h"
+
+namespace {
+    double percentile(const std::vector<int64_t>& sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+        return sorted[index] / 1e3;
+    }
+}  // namespace
+
+void RenderStats::printHeader() {
+    printf("%-28s %9s %9s %9s %9s %9s %9s %9s %8s %7s %6s\n", "source", "deadline", "mean", "p50", "p90", "p99",
+           "p99.9", "max", "overruns", "load", "peak");
+    printf("%-28s %9s %9s %9s %9s %9s %9s %9s %8s %7s %6s\n", "", "(us)", "(us)", "(us)", "(us)", "(us)", "(us)",
+           "(us)", "", "(%)", "");
+}
+
+void RenderStats::print(const char* name) const {
+    printf("%-28s %9.1f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %8lld %7.3f %6.3f\n", name, deadlineMicros, meanMicros,
+           p50Micros, p90Micros, p99Micros, p999Micros, maxMicros, static_cast<long long>(overruns), load * 100.0, peak);
+}
+
+RenderStats renderOffline(IRenderableAudio& source, const RenderConfig& config) {
+    RenderStats stats;
+    drwav       wav;
+    const bool  writeWav = !config.wavPath.empty();
+    if (writeWav) {
+        drwav_data_format format;
+        format.container = drwav_container_riff;
+        format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+        format.channels = static_cast<drwav_uint32>(config.channelCount);
+        format.sampleRate = static_cast<drwav_uint32>(config.sampleRate);
+        format.bitsPerSample = 32;
+        if (!drwav_init_file_write(&wav, config.wavPath.c_str(), &format, nullptr)) {
+            fprintf(stderr, "Cannot write %s\n", config.wavPath.c_str());
+            return stats;
+        }
+    }
+
+    const int64_t        totalFrames = static_cast<int64_t>(config.seconds * config.sampleRate);
+    std::vector<float>   buffer(static_cast<size_t>(config.burstFrames) * config.channelCount);
+    std::vector<int64_t> durations;
+    durations.reserve(static_cast<size_t>(totalFrames / config.burstFrames + 1) * (config.variableBursts ? 2 : 1));
+
+    const double nanosPerFrame = 1e9 / config.sampleRate;
+    const auto   startTime = std::chrono::steady_clock::now();
+    int64_t      busyNanos = 0;
+    uint32_t     seed = 1;
+    while (stats.frames < totalFrames) {
+        int32_t frames = config.burstFrames;
+        if (config.variableBursts) {
+            seed = seed * 1664525u + 1013904223u;
+            frames = 1 + static_cast<int32_t>((seed >> 8) % config.burstFrames);
+        }
+        frames = static_cast<int32_t>(std::min<int64_t>(frames, totalFrames - stats.frames));
+        if (config.realtime) {
+            std::this_thread::sleep_until(startTime + std::chrono::nanoseconds(
+                                                          static_cast<int64_t>(stats.frames * nanosPerFrame)));
+        }
+
+        const int64_t begin = benchNowNanos();
+        source.renderAudio(buffer.data(), frames);
+        const int64_t elapsed = benchNowNanos() - begin;
+
+        durations.push_back(elapsed);
+        busyNanos += elapsed;
+        if (elapsed > frames * nanosPerFrame) {
+            ++stats.overruns;
+        }
+        for (size_t i = 0; i < static_cast<size_t>(frames) * config.channelCount; ++i) {
+            stats.peak = std::max(stats.peak, std::fabs(buffer[i]));
+        }
+        if (writeWav) {
+            drwav_write_pcm_frames(&wav, static_cast<drwav_uint64>(frames), buffer.data());
+        }
+        stats.frames += frames;
+        ++stats.callbacks;
+    }
+    if (writeWav) {
+        drwav_uninit(&wav);
+    }
+
+    std::sort(durations.begin(), durations.end());
+    stats.deadlineMicros = config.burstFrames * nanosPerFrame / 1e3;
+    stats.meanMicros = stats.callbacks > 0 ? busyNanos / 1e3 / stats.callbacks : 0.0;
+    stats.p50Micros = percentile(durations, 0.5);
+    stats.p90Micros = percentile(durations, 0.9);
+    stats.p99Micros = percentile(durations, 0.99);
+    stats.p999Micros = percentile(durations, 0.999);
+    stats.maxMicros = durations.empty() ? 0.0 : durations.back() / 1e3;
+    stats.load = stats.frames > 0 ? busyNanos / (stats.frames * nanosPerFrame) : 0.0;
+    return stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+// Offline driver for IRenderableAudio sources: calls renderAudio the way a stream would, times
+// every callback against its deadline and can write the output to a WAV file for diffing.
+// This is the harness the audio benchmarks build on.
+#include <cstdint>
+#include <string>
+
+#include "IRenderableAudio.h"
+
+struct RenderConfig {
+    int32_t     sampleRate = 48000;
+    int32_t     channelCount = 2;
+    int32_t     burstFrames = 192;
+    double      seconds = 5.0;
+    // Vary the callback size between 1 and burstFrames, as some streams do.
+    bool        variableBursts = false;
+    // Sleep until each callback is due, for sources fed by another thread (e.g. a decoder).
+    bool        realtime = false;
+    // Write the rendered audio as 32-bit float WAV when set.
+    std::string wavPath;
+};
+
+struct RenderStats {
+    int64_t callbacks = 0;
+    int64_t frames = 0;
+    // Callbacks which took longer than the duration of the frames they rendered.
+    int64_t overruns = 0;
+    double  deadlineMicros = 0.0;  // of a full burst
+    double  meanMicros = 0.0;
+    double  p50Micros = 0.0;
+    double  p90Micros = 0.0;
+    double  p99Micros = 0.0;
+    double  p999Micros = 0.0;
+    double  maxMicros = 0.0;
+    // Mean callback time as a fraction of real time.
+    double  load = 0.0;
+    // Largest absolute sample, to spot silent or clipping output.
+    float   peak = 0.0f;
+
+    static void printHeader();
+    void        print(const char* name) const;
+};
+
+/**
+ * Render config.seconds of audio from source in callbacks of config.burstFrames.
+ * @return the timing statistics, callbacks is 0 if the WAV file could not be opened
+ */
+RenderStats renderOffline(IRenderableAudio& source, const RenderConfig& config);
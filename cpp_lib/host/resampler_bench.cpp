@@ -0,0 +1,196 @@
+/**
+ * Host benchmark for Resampler.
+ *
+ * For each rate pair it first checks that block processing is seamless: the output of a sine
+ * processed in random block sizes, and pulled in callback sized bursts, must match processing it in
+ * one go, and the result must stay close to an ideal sine at the output rate. Draining after the
+ * last block must give every output frame of the input, as if silence followed it. Then it reports the
+ * cost in ns per output frame when pulled in 192 frame bursts.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Resampler.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kChannels = 2;
+    constexpr double  kToneHz = 997.0;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr double  kMinSnrDb = 70.0;
+    constexpr double  kMaxBlockError = 1e-6;
+
+    struct RatePair {
+        int32_t in;
+        int32_t out;
+    };
+
+    std::vector<float> makeTone(int32_t rate, int32_t frames) {
+        std::vector<float> signal(static_cast<size_t>(frames) * kChannels);
+        for (int32_t i = 0; i < frames; ++i) {
+            const float v = 0.5f * static_cast<float>(std::sin(2.0 * M_PI * kToneHz * i / rate));
+            for (int32_t ch = 0; ch < kChannels; ++ch) {
+                signal[static_cast<size_t>(i) * kChannels + ch] = ch == 0 ? v : -v;
+            }
+        }
+        return signal;
+    }
+
+    std::vector<float> runOneBlock(const RatePair& rates, const std::vector<float>& input) {
+        Resampler          resampler(rates.in, rates.out, kChannels);
+        const int32_t      frames = static_cast<int32_t>(input.size() / kChannels);
+        std::vector<float> output((static_cast<size_t>(frames) * rates.out / rates.in + 8) * kChannels);
+        int32_t produced = resampler.process(input.data(), frames, output.data(), static_cast<int32_t>(output.size() / kChannels));
+        output.resize(static_cast<size_t>(produced) * kChannels);
+        return output;
+    }
+
+    std::vector<float> runRandomBlocks(const RatePair& rates, const std::vector<float>& input, bool drain = false) {
+        Resampler          resampler(rates.in, rates.out, kChannels);
+        const int32_t      frames = static_cast<int32_t>(input.size() / kChannels);
+        std::vector<float> output((static_cast<size_t>(frames) * rates.out / rates.in + 8) * kChannels);
+        uint32_t seed = 12345;
+        int32_t  consumed = 0;
+        int32_t  produced = 0;
+        while (consumed < frames) {
+            seed = seed * 1664525u + 1013904223u;
+            const int32_t block = std::min<int32_t>(1 + static_cast<int32_t>((seed >> 8) % 700), frames - consumed);
+            int32_t used = 0;
+            produced += resampler.process(&input[static_cast<size_t>(consumed) * kChannels], block,
+                                          &output[static_cast<size_t>(produced) * kChannels],
+                                          static_cast<int32_t>(output.size() / kChannels) - produced, &used);
+            consumed += used;
+        }
+        if (drain) {
+            produced += resampler.drain(&output[static_cast<size_t>(produced) * kChannels],
+                                        static_cast<int32_t>(output.size() / kChannels) - produced);
+        }
+        output.resize(static_cast<size_t>(produced) * kChannels);
+        return output;
+    }
+
+    // Pull fixed size bursts the way an audio callback would.
+    std::vector<float> runBursts(const RatePair& rates, const std::vector<float>& input, int32_t outputFrames) {
+        Resampler          resampler(rates.in, rates.out, kChannels);
+        std::vector<float> output(static_cast<size_t>(outputFrames) * kChannels);
+        size_t             cursor = 0;
+        for (int32_t done = 0; done + kBurstFrames <= outputFrames; done += kBurstFrames) {
+            const int32_t needed = resampler.getInputFramesRequired(kBurstFrames);
+            int32_t       produced = resampler.process(&input[cursor], needed, &output[static_cast<size_t>(done) * kChannels],
+                                                       kBurstFrames);
+            if (produced != kBurstFrames) {
+                printf("  burst produced %d frames, expected %d\n", produced, kBurstFrames);
+                return {};
+            }
+            cursor += static_cast<size_t>(needed) * kChannels;
+        }
+        return output;
+    }
+
+    double maxDifference(const std::vector<float>& a, const std::vector<float>& b, size_t count) {
+        double worst = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            worst = std::max(worst, static_cast<double>(std::fabs(a[i] - b[i])));
+        }
+        return worst;
+    }
+
+    double snrDb(const RatePair& rates, const std::vector<float>& output, int32_t skipFrames) {
+        double signal = 0.0;
+        double noise = 0.0;
+        const int32_t frames = static_cast<int32_t>(output.size() / kChannels);
+        for (int32_t i = skipFrames; i < frames - skipFrames; ++i) {
+            const double ideal = 0.5 * std::sin(2.0 * M_PI * kToneHz * i / rates.out);
+            const double error = output[static_cast<size_t>(i) * kChannels] - ideal;
+            signal += ideal * ideal;
+            noise += error * error;
+        }
+        return 10.0 * std::log10(signal / std::max(noise, 1e-30));
+    }
+
+    // Random blocks, then drain(): every output frame of the input, the same as padding it with silence.
+    bool checkDrain(const RatePair& rates, const std::vector<float>& input) {
+        const int32_t      frames = static_cast<int32_t>(input.size() / kChannels);
+        const int32_t      expected =
+                static_cast<int32_t>((static_cast<int64_t>(frames) * rates.out + rates.in - 1) / rates.in);
+        std::vector<float> padded = input;
+        padded.resize(input.size() + 4096 * kChannels, 0.0f);
+        std::vector<float> reference = runOneBlock(rates, padded);
+        reference.resize(static_cast<size_t>(expected) * kChannels);
+
+        std::vector<float> drained = runRandomBlocks(rates, input, true);
+        const double       error = maxDifference(reference, drained, std::min(reference.size(), drained.size()));
+        printf("  drained %zu of %d frames, tail error %.2e\n", drained.size() / kChannels, expected, error);
+        if (drained.size() != reference.size() || error > kMaxBlockError) {
+            printf("  FAIL: drain does not end the output with the input\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool checkPair(const RatePair& rates) {
+        const int32_t      inputFrames = rates.in;  // one second
+        std::vector<float> input = makeTone(rates.in, inputFrames);
+
+        std::vector<float> whole = runOneBlock(rates, input);
+        std::vector<float> blocks = runRandomBlocks(rates, input);
+        const int32_t      burstFrames = static_cast<int32_t>(whole.size() / kChannels) / 2 / kBurstFrames * kBurstFrames;
+        std::vector<float> bursts = runBursts(rates, input, burstFrames);
+
+        bool ok = true;
+        if (blocks.size() != whole.size()) {
+            printf("  random blocks produced %zu samples, one block %zu\n", blocks.size(), whole.size());
+            ok = false;
+        }
+        const double blockError = maxDifference(whole, blocks, std::min(whole.size(), blocks.size()));
+        const double burstError = bursts.empty() ? 1.0 : maxDifference(whole, bursts, bursts.size());
+        const double snr = snrDb(rates, whole, 64);
+        printf("  block boundary error %.2e, burst boundary error %.2e, SNR %.1f dB\n", blockError, burstError, snr);
+        if (blockError > kMaxBlockError || burstError > kMaxBlockError) {
+            printf("  FAIL: output depends on block boundaries\n");
+            ok = false;
+        }
+        if (snr < kMinSnrDb) {
+            printf("  FAIL: SNR below %.0f dB\n", kMinSnrDb);
+            ok = false;
+        }
+        return checkDrain(rates, input) && ok;
+    }
+
+    void benchPair(const RatePair& rates) {
+        const int32_t      seconds = 10;
+        std::vector<float> input = makeTone(rates.in, rates.in * seconds + 4096);
+        const int32_t      outputFrames = rates.out * seconds;
+        std::vector<float> output(static_cast<size_t>(kBurstFrames) * kChannels);
+
+        Resampler resampler(rates.in, rates.out, kChannels);
+        size_t    cursor = 0;
+        int64_t   start = benchNowNanos();
+        for (int32_t done = 0; done + kBurstFrames <= outputFrames; done += kBurstFrames) {
+            const int32_t needed = resampler.getInputFramesRequired(kBurstFrames);
+            resampler.process(&input[cursor], needed, output.data(), kBurstFrames);
+            cursor += static_cast<size_t>(needed) * kChannels;
+            benchKeep(output[0]);
+        }
+        int64_t elapsed = benchNowNanos() - start;
+        printf("  %.2f ns/frame (stereo), %.3f%% of real time\n", static_cast<double>(elapsed) / outputFrames,
+               100.0 * elapsed / (seconds * 1e9));
+    }
+}  // namespace
+
+int main() {
+    const RatePair pairs[] = {
+            {44100, 48000}, {48000, 44100}, {22050, 48000}, {48000, 16000}, {16000, 48000}, {44100, 48001},
+    };
+    bool ok = true;
+    for (const auto& rates : pairs) {
+        printf("%d -> %d Hz\n", rates.in, rates.out);
+        ok = checkPair(rates) && ok;
+        benchPair(rates);
+    }
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+/**
+ * Runs the audio callback path on a fake stream with the real-time safety checker compiled in
+ * (AUDIO_RT_CHECK=1, @see ndk_utils/rt_check.h).
+ *
+ * 1. A source which allocates, locks, writes a file and logs must be caught on every count.
+ * 2. The app's path, LatencyTuningCallback -> the master AudioGraph (VoiceMixer over a streaming
+ *    Mp3SoundGenerator, gain ramp, limiter, spectrum analyzer tap with its worker running) with float
+ *    and IMA-ADPCM clips triggered, the master gain changed and the callback statistics read from other
+ *    threads, must not make a single blocking call. The statistics must account for every callback,
+ *    xrun and buffer size change, and count the xruns of a restarted stream from zero.
+ * 3. The same path on an I16 stream, rendered as float and converted with dither in the callback,
+ *    must not block either and must produce sound.
+ * 4. The master graph over a ClipSequencer, with clips queued and cleared while it plays, must not block.
+ * 5. The capture callback on an I16 input stream, with a consumer waiting for speech and reading it,
+ *    must not block and must detect the tone bursts played into it.
+ * 6. The non-streaming Mp3SoundGenerator path is run for information only, it is known to block.
+ *
+ * Usage: rt_check_run [asset_dir]
+ * Exits with a non-zero status if 1, 2, 3, 4 or 5 fails.
+ */
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioGraph.h"
+#include "AudioNodes.h"
+#include "CaptureCallback.h"
+#include "ClipCache.h"
+#include "ClipSequencer.h"
+#include "LatencyTuningCallback.h"
+#include "Mp3SoundGenerator.h"
+#include "SpectrumAnalyzer.h"
+#include "VoiceMixer.h"
+#include "bench_util.h"
+#include "fake_capture_stream.h"
+#include "fake_stream.h"
+#include "ndk_utils/rt_check.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannels = 2;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int64_t kBursts = kSampleRate / kBurstFrames;  // one second
+
+    // Everything an audio callback must not do.
+    class BlockingSource : public IRenderableAudio {
+      public:
+        void renderAudio(float* audioData, int32_t numFrames) override {
+            std::vector<float> scratch(static_cast<size_t>(numFrames) * kChannels);
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                std::copy(scratch.begin(), scratch.end(), audioData);
+            }
+            if (FILE* file = fopen("/dev/null", "w")) {
+                fclose(file);
+            }
+            LOGD("rendered %d frames", numFrames);
+        }
+
+      private:
+        std::mutex mMutex;
+    };
+
+    uint64_t run(const std::shared_ptr<IRenderableAudio>&                    source,
+                 const std::function<void(FakeAudioStream&, const CallbackStats&)>& whileRunning = {},
+                 CallbackStats::Snapshot*                                           stats = nullptr,
+                 oboe::AudioFormat                                                  format = oboe::AudioFormat::Float) {
+        auto callback = std::make_shared<LatencyTuningCallback>();
+        callback->setSource(source);
+        auto stream = std::make_shared<FakeAudioStream>(kSampleRate, kChannels, kBurstFrames, format);
+        callback->useStream(stream);
+
+        const uint64_t before = rt_check::getViolationCount();
+        stream->start(callback.get(), kBursts);
+        if (whileRunning) {
+            whileRunning(*stream, callback->getStats());
+        }
+        stream->join();
+        if (stats != nullptr) {
+            *stats = callback->getStats().snapshot();
+        }
+        return rt_check::getViolationCount() - before;
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    const uint64_t blocking = run(std::make_shared<BlockingSource>());
+    printf("blocking source: %llu violations\n", (unsigned long long)blocking);
+    // At least an allocation, a free, a lock, an fopen and a log per callback.
+    if (blocking < 5 * kBursts) {
+        fprintf(stderr, "FAILED: the checker missed blocking calls\n");
+        ok = false;
+    }
+
+    std::vector<uint8_t> stream = readFile(assetDir + "/test.mp3");
+    std::vector<uint8_t> clipData = readFile(assetDir + "/robot_thankyou.mp3");
+    if (stream.empty() || clipData.empty()) {
+        fprintf(stderr, "Cannot read the MP3 assets in %s\n", assetDir.c_str());
+        return 1;
+    }
+
+    ClipCache cache;
+    cache.setFormat(kSampleRate, kChannels);
+    const PcmClip* clip = cache.insert("robot_thankyou.mp3", clipData.data(), clipData.size());
+    ClipCache      compressedCache;
+    compressedCache.setFormat(kSampleRate, kChannels);
+    compressedCache.setStorage(ClipStorage::Adpcm);
+    const PcmClip* compressedClip = compressedCache.insert("robot_thankyou.mp3", clipData.data(), clipData.size());
+    auto mp3 =
+            Mp3SoundGenerator::createFromBuf(reinterpret_cast<char*>(stream.data()), stream.size(), kChannels).value();
+    mp3->setSampleRate(kSampleRate);
+    mp3->startStreaming();
+    auto mixer = std::make_shared<VoiceMixer>(kSampleRate, kChannels);
+    mixer->setStreamSource(mp3.get());
+    // The engine's master chain.
+    auto masterGain = std::make_shared<GainRampNode>();
+    auto master = std::make_shared<AudioGraph>();
+    AudioGraph::NodeId node = master->addNode(masterGain, master->addSource(mixer.get()));
+    node = master->addNode(std::make_shared<LimiterNode>(), node);
+    auto spectrum = std::make_shared<SpectrumAnalyzer>();
+    spectrum->start();
+    master->setOutput(master->addNode(spectrum, node));
+    master->compile(kSampleRate, kChannels);
+
+    CallbackStats::Snapshot stats;
+    uint64_t                snapshots = 0;
+    const uint64_t          appPath = run(
+            master,
+            [&](FakeAudioStream& fakeStream, const CallbackStats& callbackStats) {
+                std::atomic<bool> reading { true };
+                std::thread       reader([&]() {
+                    while (reading) {
+                        benchKeep(callbackStats.snapshot());
+                        ++snapshots;
+                    }
+                });
+                for (int i = 0; i < 8; ++i) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    mixer->play(i % 2 == 0 ? clip : compressedClip, 0.5f, i % 2 == 0 ? -0.5f : 0.5f);
+                    masterGain->setGain(i % 2 == 0 ? 1.5f : 0.8f);
+                    if (i == 2) {
+                        fakeStream.addXRuns(1);
+                    }
+                    if (i == 4) {
+                        mp3->resetData(reinterpret_cast<char*>(stream.data()), stream.size());
+                    }
+                    if (i == 6) {
+                        fakeStream.setBufferSizeInFrames(kBurstFrames * 3);
+                    }
+                }
+                reading = false;
+                reader.join();
+            },
+            &stats);
+    printf("app path (master graph over the mixer and streaming mp3): %llu violations\n", (unsigned long long)appPath);
+    if (appPath != 0) {
+        fprintf(stderr, "FAILED: the app's callback path blocks\n");
+        ok = false;
+    }
+    printf("callback stats, %llu snapshots taken while running: %llu callbacks, mean %.1fus, p99 < %.0fus, "
+           "%llu xruns, buffer %d -> %d frames\n",
+           (unsigned long long)snapshots, (unsigned long long)stats.callbacks, stats.meanMicros,
+           stats.durationPercentileMicros(0.99), (unsigned long long)stats.xRuns, stats.previousBufferSizeFrames,
+           stats.bufferSizeFrames);
+    uint64_t histogramTotal = 0;
+    for (uint32_t count : stats.durationHistogram) {
+        histogramTotal += count;
+    }
+    if (stats.callbacks != static_cast<uint64_t>(kBursts) || histogramTotal != stats.callbacks || stats.xRuns != 1
+        || stats.xRunCallbacks != 1 || stats.bufferSizeChanges != 1 || stats.bufferSizeFrames != kBurstFrames * 3) {
+        fprintf(stderr, "FAILED: the callback stats do not match the run\n");
+        ok = false;
+    }
+    // A restarted stream counts its xruns from zero, even up to more than the old one had.
+    CallbackStats restarted;
+    restarted.beginStream();
+    for (const int32_t xRuns : {0, 2, 3}) {
+        restarted.record(1000, 4000000, kBurstFrames, xRuns, kBurstFrames);
+    }
+    restarted.beginStream();
+    for (const int32_t xRuns : {4, 5}) {
+        restarted.record(1000, 4000000, kBurstFrames, xRuns, kBurstFrames);
+    }
+    const CallbackStats::Snapshot restartedStats = restarted.snapshot();
+    if (restartedStats.xRuns != 8 || restartedStats.xRunCallbacks != 4) {
+        fprintf(stderr, "FAILED: %llu xruns in %llu callbacks counted over a restart, 8 in 4 expected\n",
+                (unsigned long long)restartedStats.xRuns, (unsigned long long)restartedStats.xRunCallbacks);
+        ok = false;
+    }
+
+    // Keep a clip playing so the last burst is not silent.
+    int32_t        peak = 0;
+    const uint64_t i16Path = run(
+            master,
+            [&](FakeAudioStream& fakeStream, const CallbackStats&) {
+                mixer->play(clip);
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                const int16_t* samples = reinterpret_cast<const int16_t*>(fakeStream.lastBurst().data());
+                for (int32_t i = 0; i < kBurstFrames * kChannels; ++i) {
+                    peak = std::max(peak, std::abs(static_cast<int32_t>(samples[i])));
+                }
+            },
+            nullptr, oboe::AudioFormat::I16);
+    printf("app path on an I16 stream: %llu violations, peak %d\n", (unsigned long long)i16Path, peak);
+    if (i16Path != 0 || peak < 256) {
+        fprintf(stderr, "FAILED: the I16 output path blocks or is silent\n");
+        ok = false;
+    }
+    mixer->stopAll();
+    mp3->stopStreaming();
+
+    auto sequencer = std::make_shared<ClipSequencer>(kSampleRate, kChannels);
+    sequencer->start();
+    mixer->setStreamSource(sequencer.get());
+    const uint64_t sequencerPath = run(master, [&](FakeAudioStream&, const CallbackStats&) {
+        for (int i = 0; i < 8; ++i) {
+            const std::vector<uint8_t>& data = i % 2 == 0 ? clipData : stream;
+            sequencer->enqueue(data.data(), data.size());
+            if (i == 5) {
+                sequencer->clear();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+    printf("app path over the clip sequencer: %llu violations, %llu clips started\n",
+           (unsigned long long)sequencerPath, (unsigned long long)sequencer->getClipsStarted());
+    if (sequencerPath != 0 || sequencer->getClipsStarted() < 2) {
+        fprintf(stderr, "FAILED: the clip sequencer blocks or does not play\n");
+        ok = false;
+    }
+    mixer->setStreamSource(nullptr);
+    sequencer->stop();
+
+    // A second of faint noise with two 200 ms tone bursts in it, further apart than the detector's hangover,
+    // as a stereo 16 bit microphone.
+    std::vector<float> input(static_cast<size_t>(kSampleRate) * kChannels);
+    uint32_t           seed = 1;
+    for (size_t frame = 0; frame < input.size() / kChannels; ++frame) {
+        const size_t millis = frame * 1000 / kSampleRate;
+        const bool   burst = (millis >= 100 && millis < 300) || (millis >= 700 && millis < 900);
+        const float  tone = burst ? 0.3f * std::sin(6.2831853f * 300.0f * frame / kSampleRate) : 0.0f;
+        for (int32_t channel = 0; channel < kChannels; ++channel) {
+            seed = seed * 1664525u + 1013904223u;
+            input[frame * kChannels + channel] = tone + 0.001f * (static_cast<float>(seed >> 8) / 8388608.0f - 1.0f);
+        }
+    }
+    FakeCaptureStream micStream(std::move(input), kSampleRate, kChannels, kBurstFrames, oboe::AudioFormat::I16);
+    CaptureCallback   capture;
+    capture.useStream(std::shared_ptr<oboe::AudioStream>(&micStream, [](oboe::AudioStream*) { }));
+    uint64_t captured = 0;
+    const uint64_t beforeCapture = rt_check::getViolationCount();
+    micStream.start(&capture, 1.0);
+    std::thread consumer([&] {
+        std::vector<float> block(kBurstFrames);
+        while (micStream.isRunning()) {
+            if (!capture.waitForSpeech(10)) {
+                capture.keepLatest(kBurstFrames);
+                continue;
+            }
+            capture.skipTo(capture.getVoiceActivity().getSpeechStartFrame());
+            while (capture.getVoiceActivity().isSpeech() && micStream.isRunning()) {
+                captured += capture.read(block.data(), block.size());
+                usleep(CaptureCallback::kConsumerIdleMicros);
+            }
+        }
+    });
+    micStream.join();
+    consumer.join();
+    const uint64_t capturePath = rt_check::getViolationCount() - beforeCapture;
+    printf("capture path: %llu violations, %llu speech segments, %llu frames read, %llu dropped\n",
+           (unsigned long long)capturePath, (unsigned long long)capture.getVoiceActivity().getSegmentCount(),
+           (unsigned long long)captured, (unsigned long long)capture.getDroppedFrames());
+    if (capturePath != 0 || capture.getVoiceActivity().getSegmentCount() != 2 || captured == 0) {
+        fprintf(stderr, "FAILED: the capture path blocks or misses the speech\n");
+        ok = false;
+    }
+
+    auto legacy = Mp3SoundGenerator::createFromBuf(reinterpret_cast<char*>(stream.data()), stream.size(), kChannels)
+                          .value();
+    legacy->setSampleRate(kSampleRate);
+    printf("non-streaming mp3 (known to block): %llu violations\n", (unsigned long long)run(legacy));
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+/**
+ * Host benchmark for ClipSequencer with the robot clips.
+ *
+ * It checks that the MP3 encoder delay and padding are read from the LAME tag, then plays the clips
+ * which share a format back to back at that format, queueing them while the first plays, and checks
+ * the output is exactly the clips decoded one by one and joined: no gap, no overlap, no encoder
+ * silence. All three, resampled to 48 kHz stereo, must not underrun, and a clear() must cut to the
+ * next clip queued without reporting the clips it cut before they were heard. A change of the device
+ * channel count must not write past the callback's buffer.
+ * It also times what the pre-roll takes off the join: opening a clip and decoding its first frames.
+ *
+ * Usage: sequencer_bench [asset_dir]
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClipSequencer.h"
+#include "PcmDecoder.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int32_t kDeviceRate = 48000;
+    constexpr int32_t kDeviceChannels = 2;
+    constexpr int     kOpenPasses = 200;
+    const char* const kClipNames[] = {"robot_boot.mp3", "robot_random_code.mp3", "robot_thankyou.mp3"};
+
+    struct Clip {
+        std::string          name;
+        std::vector<uint8_t> data;
+        std::vector<float>   pcm;  // decoded on its own
+        int32_t              sampleRate = 0;
+        int32_t              channelCount = 0;
+        uint32_t             delay = 0;
+        uint32_t             padding = 0;
+    };
+
+    bool load(const std::string& assetDir, Clip& clip) {
+        clip.data = readFile(assetDir + "/" + clip.name);
+        auto decoder = PcmDecoder::open(clip.data.data(), clip.data.size());
+        if (!decoder) {
+            return false;
+        }
+        clip.sampleRate = decoder->getSampleRate();
+        clip.channelCount = decoder->getChannelCount();
+        clip.delay = decoder->getEncoderDelayFrames();
+        clip.padding = decoder->getEncoderPaddingFrames();
+        std::vector<float> chunk(ClipSequencer::kDecodeChunkFrames * clip.channelCount);
+        while (uint64_t frames = decoder->read(chunk.data(), ClipSequencer::kDecodeChunkFrames)) {
+            clip.pcm.insert(clip.pcm.end(), chunk.begin(), chunk.begin() + frames * clip.channelCount);
+        }
+        return true;
+    }
+
+    // Render like a stream would, a little faster than real time so the decoder thread has to keep up.
+    void render(ClipSequencer& sequencer, std::vector<float>& output, int32_t channelCount, int64_t frames) {
+        std::vector<float> burst(kBurstFrames * channelCount);
+        for (int64_t done = 0; done < frames; done += kBurstFrames) {
+            sequencer.renderAudio(burst.data(), kBurstFrames);
+            output.insert(output.end(), burst.begin(), burst.end());
+            std::this_thread::sleep_for(std::chrono::microseconds(1000));
+        }
+    }
+
+    bool checkGapless(const std::vector<Clip>& allClips) {
+        // The clips in the first one's format, with the first again at the end.
+        const int32_t            rate = allClips[0].sampleRate;
+        const int32_t            channelCount = allClips[0].channelCount;
+        std::vector<const Clip*> clips;
+        for (const Clip& clip : allClips) {
+            if (clip.sampleRate == rate && clip.channelCount == channelCount) {
+                clips.push_back(&clip);
+            }
+        }
+        clips.push_back(&allClips[0]);
+        std::vector<float> expected;
+        for (const Clip* clip : clips) {
+            expected.insert(expected.end(), clip->pcm.begin(), clip->pcm.end());
+        }
+        const int64_t totalFrames = static_cast<int64_t>(expected.size()) / channelCount;
+
+        // At the clips' own format nothing is resampled or mixed down, so the join has to be exact.
+        ClipSequencer sequencer(rate, channelCount);
+        sequencer.enqueue(clips[0]->data.data(), clips[0]->data.size());
+        sequencer.start();
+        // Give the first clip time to be decoded, the silence before it is not part of the check.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<float> output;
+        render(sequencer, output, channelCount, rate / 10);
+        for (size_t i = 1; i < clips.size(); ++i) {
+            sequencer.enqueue(clips[i]->data.data(), clips[i]->data.size());
+        }
+        const int64_t rendered = static_cast<int64_t>(output.size()) / channelCount;
+        render(sequencer, output, channelCount, totalFrames + rate / 5 - rendered);
+        sequencer.stop();
+
+        bool ok = check(std::equal(expected.begin(), expected.end(), output.begin()),
+                        "the sequence is the clips joined sample for sample");
+        ok &= check(std::all_of(output.begin() + expected.size(), output.end(), [](float x) { return x == 0.0f; }),
+                    "the sequence ends with the last clip");
+        ok &= check(sequencer.getClipsStarted() == clips.size() && sequencer.getPlayingClip() == 0,
+                    "every clip is reported started and the queue drained");
+        ok &= check(sequencer.getUnderrunCount() == 0, "the decoder thread keeps up");
+        printf("%d Hz, %d ch: %lld frames from %zu clips, identical to the clips joined, %llu underruns\n", rate,
+               channelCount, (long long)totalFrames, clips.size(), (unsigned long long)sequencer.getUnderrunCount());
+        return ok;
+    }
+
+    bool checkDevice(const std::vector<Clip>& clips) {
+        int64_t sourceFrames = 0;
+        for (const Clip& clip : clips) {
+            sourceFrames += static_cast<int64_t>(clip.pcm.size()) / clip.channelCount
+                            * kDeviceRate / clip.sampleRate;
+        }
+
+        ClipSequencer sequencer(kDeviceRate, kDeviceChannels);
+        sequencer.start();
+        for (const Clip& clip : clips) {
+            sequencer.enqueue(clip.data.data(), clip.data.size());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<float> output;
+        render(sequencer, output, kDeviceChannels, sourceFrames + kDeviceRate / 5);
+
+        // Not a sample of silence between the first sound and the last.
+        const auto first = std::find_if(output.begin(), output.end(), [](float x) { return x != 0.0f; });
+        const auto last = std::find_if(output.rbegin(), output.rend(), [](float x) { return x != 0.0f; }).base();
+        const int64_t heard = (last - first + kDeviceChannels - 1) / kDeviceChannels;
+        bool ok = check(sequencer.getUnderrunCount() == 0, "the decoder thread keeps up at 48 kHz");
+        ok &= check(sequencer.getClipsStarted() == clips.size(), "every clip plays at 48 kHz");
+        // Within the rounding of each clip's length, so no resampler tail is lost.
+        ok &= check(std::abs(heard - sourceFrames) <= static_cast<int64_t>(clips.size()),
+                    "the sequence lasts as long as the clips");
+
+        // A clear() cuts what is queued, the clip queued after it plays next.
+        sequencer.enqueue(clips[0].data.data(), clips[0].data.size());
+        sequencer.enqueue(clips[1].data.data(), clips[1].data.size());
+        render(sequencer, output, kDeviceChannels, kDeviceRate / 10);
+        sequencer.clear();
+        const uint32_t after = sequencer.enqueue(clips[2].data.data(), clips[2].data.size());
+        render(sequencer, output, kDeviceChannels, kDeviceRate / 10);
+        ok &= check(sequencer.getPlayingClip() == after, "the clip queued after a clear() plays next");
+        sequencer.stop();
+
+        printf("%d Hz, %d ch: %lld frames heard for %lld expected, %llu underruns, clear() cuts to the next clip: "
+               "%s\n",
+               kDeviceRate, kDeviceChannels, (long long)heard, (long long)sourceFrames,
+               (unsigned long long)sequencer.getUnderrunCount(), sequencer.getPlayingClip() == after ? "ok" : "no");
+        return ok;
+    }
+
+    // A clip cleared before the callback reached it is never reported, not even for a callback.
+    bool checkClearUnheard(const std::vector<Clip>& clips) {
+        ClipSequencer sequencer(kDeviceRate, kDeviceChannels);
+        sequencer.enqueue(clips[0].data.data(), clips[0].data.size());
+        sequencer.start();
+        // The clip fills the ring, its start is published but not rendered yet.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        sequencer.clear();
+        const uint32_t after = sequencer.enqueue(clips[1].data.data(), clips[1].data.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<float> output;
+        render(sequencer, output, kDeviceChannels, kDeviceRate / 10);
+        sequencer.stop();
+
+        bool ok = check(sequencer.getPlayingClip() == after, "the clip queued after a clear() plays");
+        ok &= check(sequencer.getClipsStarted() == 1, "the cleared clip is not reported started");
+        printf("clear() before the first callback: %llu clips started, clip %u plays\n",
+               (unsigned long long)sequencer.getClipsStarted(), sequencer.getPlayingClip());
+        return ok;
+    }
+
+    // A reopen on a device with another channel count, the callback's buffer shrinks and grows with it.
+    bool checkChannelChange(const std::vector<Clip>& clips) {
+        constexpr float kGuard = 12345.0f;
+        ClipSequencer   sequencer(kDeviceRate, kDeviceChannels);
+        const uint32_t  id = sequencer.enqueue(clips[0].data.data(), clips[0].data.size());
+        sequencer.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<float> output;
+        render(sequencer, output, kDeviceChannels, kDeviceRate / 10);
+
+        bool ok = true;
+        for (const int32_t channelCount : {1, kDeviceChannels}) {
+            sequencer.setChannelCount(channelCount);
+            // A burst of the new channel count followed by samples the source must not write.
+            std::vector<float> burst(kBurstFrames * channelCount + kBurstFrames, kGuard);
+            bool               heard = false;
+            for (int i = 0; i < 10; ++i) {
+                sequencer.renderAudio(burst.data(), kBurstFrames);
+                heard |= std::any_of(burst.begin(), burst.begin() + kBurstFrames * channelCount,
+                                     [](float x) { return x != 0.0f; });
+                std::this_thread::sleep_for(std::chrono::microseconds(1000));
+            }
+            ok &= check(sequencer.getChannelCount() == channelCount, "the channel count follows the device");
+            ok &= check(std::all_of(burst.begin() + kBurstFrames * channelCount, burst.end(),
+                                    [](float x) { return x == kGuard; }),
+                        "no sample is written past the callback's buffer");
+            ok &= check(heard && sequencer.getPlayingClip() == id, "the clip plays on after the change");
+        }
+        ok &= check(sequencer.getClipsStarted() == 1, "the clip is not reported started again");
+        ok &= check(sequencer.getUnderrunCount() == 0, "the ring is refilled before the next callback");
+        sequencer.stop();
+        printf("%d ch to 1 ch and back: clip %u plays on, %llu underruns\n", kDeviceChannels, id,
+               (unsigned long long)sequencer.getUnderrunCount());
+        return ok;
+    }
+
+    // What a switch that opens the decoder at the join costs, and what the pre-roll moves off it.
+    void benchPreRoll(const std::vector<Clip>& clips) {
+        for (const Clip& clip : clips) {
+            const uint64_t preRollFrames =
+                    static_cast<uint64_t>(clip.sampleRate) * ClipSequencer::kPreRollMillis / 1000;
+            std::vector<float> preRoll(preRollFrames * clip.channelCount);
+            const int64_t start = benchNowNanos();
+            for (int pass = 0; pass < kOpenPasses; ++pass) {
+                auto decoder = PcmDecoder::open(clip.data.data(), clip.data.size());
+                benchKeep(decoder->read(preRoll.data(), preRollFrames));
+            }
+            const double micros = (benchNowNanos() - start) / 1e3 / kOpenPasses;
+            printf("%-22s open + %d ms pre-roll: %6.1f us, %.0f%% of a %d frame burst at 48 kHz\n",
+                   clip.name.c_str(), ClipSequencer::kPreRollMillis, micros,
+                   micros / (kBurstFrames * 1e6 / kDeviceRate) * 100.0, kBurstFrames);
+        }
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string assetDir = argc > 1 ? argv[1] : "assets";
+    bool              ok = true;
+
+    std::vector<Clip> clips;
+    double            trimmedMillis = 0.0;
+    for (const char* name : kClipNames) {
+        Clip clip;
+        clip.name = name;
+        if (!load(assetDir, clip)) {
+            fprintf(stderr, "Cannot decode %s/%s\n", assetDir.c_str(), name);
+            return 1;
+        }
+        printf("%-22s %d Hz, %d ch, %zu frames, encoder delay %u and padding %u frames trimmed\n", name,
+               clip.sampleRate, clip.channelCount, clip.pcm.size() / clip.channelCount, clip.delay, clip.padding);
+        ok &= check(clip.delay > 0, "the encoder delay is read from the LAME tag");
+        trimmedMillis += (clip.delay + clip.padding) * 1000.0 / clip.sampleRate;
+        clips.push_back(std::move(clip));
+    }
+    printf("without trimming the joins would carry %.1f ms of encoder silence\n", trimmedMillis);
+
+    ok = checkGapless(clips) && ok;
+    ok = checkDevice(clips) && ok;
+    ok = checkClearUnheard(clips) && ok;
+    ok = checkChannelChange(clips) && ok;
+    benchPreRoll(clips);
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#pragma once
+// Host stand-in for the NDK logging header, so audio code can be built and benchmarked on Linux.
+#include <stdarg.h>
+#include <stdio.h>
+
+typedef enum android_LogPriority {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT,
+} android_LogPriority;
+
+static inline int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+    if (prio < ANDROID_LOG_INFO) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    int result = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Definitions.h"
+
+namespace oboe {
+
+    class AudioStream;
+
+    class AudioStreamDataCallback {
+      public:
+        virtual ~AudioStreamDataCallback() = default;
+
+        virtual DataCallbackResult onAudioReady(AudioStream* audioStream, void* audioData, int32_t numFrames) = 0;
+    };
+
+    class AudioStreamErrorCallback {
+      public:
+        virtual ~AudioStreamErrorCallback() = default;
+
+        virtual bool onError(AudioStream*, Result) { return false; }
+
+        virtual void onErrorBeforeClose(AudioStream*, Result) { }
+
+        virtual void onErrorAfterClose(AudioStream*, Result) { }
+    };
+
+    /**
+     * The stream properties the callbacks query. A fake stream overrides what it simulates.
+     */
+    class AudioStream {
+      public:
+        virtual ~AudioStream() = default;
+
+        virtual int32_t getSampleRate() const { return 48000; }
+
+        virtual int32_t getChannelCount() const { return 2; }
+
+        virtual AudioFormat getFormat() const { return AudioFormat::Float; }
+
+        virtual Direction getDirection() const { return Direction::Output; }
+
+        virtual AudioApi getAudioApi() const { return AudioApi::AAudio; }
+
+        virtual int32_t getFramesPerBurst() { return 192; }
+
+        virtual int32_t getBufferSizeInFrames() { return getFramesPerBurst() * 2; }
+
+        virtual int32_t getBufferCapacityInFrames() { return getFramesPerBurst() * 8; }
+
+        virtual ResultWithValue<int32_t> getXRunCount() { return 0; }
+
+        virtual int64_t getFramesWritten() { return 0; }
+
+        virtual int64_t getFramesRead() { return 0; }
+    };
+
+}  // namespace oboe
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+
+namespace oboe {
+
+    constexpr int32_t Unspecified = 0;
+
+    enum class Result : int32_t {
+        OK = 0,
+        ErrorDisconnected = -899,
+        ErrorIllegalArgument = -898,
+        ErrorInternal = -896,
+        ErrorInvalidState = -895,
+        ErrorUnimplemented = -890,
+        ErrorNull = -882,
+    };
+
+    enum class DataCallbackResult : int32_t { Continue, Stop };
+
+    enum class AudioApi : int32_t { Unspecified = 0, OpenSLES, AAudio };
+
+    enum class AudioFormat : int32_t { Invalid = -1, Unspecified = 0, I16, Float, I24, I32 };
+
+    enum class Direction : int32_t { Output, Input };
+
+    inline const char* convertToText(Result result) {
+        switch (result) {
+            case Result::OK: return "OK";
+            case Result::ErrorDisconnected: return "ErrorDisconnected";
+            case Result::ErrorIllegalArgument: return "ErrorIllegalArgument";
+            case Result::ErrorInternal: return "ErrorInternal";
+            case Result::ErrorInvalidState: return "ErrorInvalidState";
+            case Result::ErrorUnimplemented: return "ErrorUnimplemented";
+            case Result::ErrorNull: return "ErrorNull";
+        }
+        return "Unrecognized";
+    }
+
+    template <typename T>
+    class ResultWithValue {
+      public:
+        ResultWithValue(Result error) : mValue(), mError(error) { }
+
+        ResultWithValue(T value) : mValue(value), mError(Result::OK) { }
+
+        Result error() const { return mError; }
+
+        T value() const { return mValue; }
+
+        explicit operator bool() const { return mError == Result::OK; }
+
+        bool operator!() const { return mError != Result::OK; }
+
+      private:
+        T      mValue;
+        Result mError;
+    };
+
+}  // namespace oboe
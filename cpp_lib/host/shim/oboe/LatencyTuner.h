@@ -0,0 +1,16 @@
+#pragma once
+#include "AudioStreamCallback.h"
+
+namespace oboe {
+
+    // The host streams have no buffer to tune.
+    class LatencyTuner {
+      public:
+        explicit LatencyTuner(AudioStream&) { }
+
+        Result tune() { return Result::OK; }
+
+        bool isAtMaximumBufferSize() { return false; }
+    };
+
+}  // namespace oboe
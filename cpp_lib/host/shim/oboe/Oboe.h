@@ -0,0 +1,9 @@
+#pragma once
+// Host stand-in for the parts of the Oboe API the audio sources and callbacks use, so they can be
+// driven by a fake stream on Linux (@see host/fake_stream.h). Streams cannot be opened.
+#include <cstdint>
+#include <memory>
+
+#include "Definitions.h"
+#include "AudioStreamCallback.h"
+#include "LatencyTuner.h"
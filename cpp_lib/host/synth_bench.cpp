@@ -0,0 +1,279 @@
+/**
+ * Host benchmark for the block rendering of Oscillator, SoundGenerator and SynthSound.
+ *
+ * Each source is rendered at 48 kHz in 192 frame bursts next to a copy of its previous per-sample
+ * implementation. The outputs must match, then both are timed through the render harness.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Oscillator.h"
+#include "SoundGenerator.h"
+#include "SynthSound.h"
+#include "bench_util.h"
+#include "render_harness.h"
+
+namespace legacy {
+    // The per-sample implementations the block rendering replaced, kept as the reference.
+
+    class Oscillator : public IRenderableAudio {
+      public:
+        void setWaveOn(bool isWaveOn) { mIsWaveOn.store(isWaveOn); }
+
+        void setSampleRate(int32_t sampleRate) {
+            mSampleRate = sampleRate;
+            updatePhaseIncrement();
+        }
+
+        void setFrequency(double frequency) {
+            mFrequency = frequency;
+            updatePhaseIncrement();
+        }
+
+        void setAmplitude(float amplitude) { mAmplitude = amplitude; }
+
+        void renderAudio(float* audioData, int32_t numFrames) override {
+            if (mIsWaveOn) {
+                for (int i = 0; i < numFrames; ++i) {
+                    if (mPhase <= kPi) {
+                        audioData[i] = -mAmplitude;
+                    } else {
+                        audioData[i] = mAmplitude;
+                    }
+                    mPhase += mPhaseIncrement;
+                    if (mPhase > kTwoPi) mPhase -= kTwoPi;
+                }
+            } else {
+                memset(audioData, 0, sizeof(float) * numFrames);
+            }
+        }
+
+      private:
+        std::atomic<bool>   mIsWaveOn { false };
+        float               mPhase = 0.0;
+        std::atomic<float>  mAmplitude { 0 };
+        std::atomic<double> mPhaseIncrement { 0.0 };
+        double              mFrequency = kDefaultFrequency;
+        int32_t             mSampleRate = kDefaultSampleRate;
+
+        void updatePhaseIncrement() { mPhaseIncrement.store((kTwoPi * mFrequency) / static_cast<double>(mSampleRate)); }
+    };
+
+    class SoundGenerator : public IRenderableAudio {
+        static constexpr size_t kSharedBufferSize = 1024;
+
+      public:
+        SoundGenerator(int32_t sampleRate, int32_t channelCount)
+            : mChannelCount(channelCount), mOscillators(std::make_unique<Oscillator[]>(channelCount)) {
+            double frequency = 440.0;
+            for (int i = 0; i < mChannelCount; ++i) {
+                mOscillators[i].setFrequency(frequency);
+                mOscillators[i].setSampleRate(sampleRate);
+                mOscillators[i].setAmplitude(1.0f);
+                mOscillators[i].setWaveOn(true);
+                frequency += 110.0;
+            }
+        }
+
+        void renderAudio(float* audioData, int32_t numFrames) override {
+            std::fill_n(mBuffer.get(), kSharedBufferSize, 0);
+            for (int i = 0; i < mChannelCount; ++i) {
+                mOscillators[i].renderAudio(mBuffer.get(), numFrames);
+                for (int j = 0; j < numFrames; ++j) {
+                    audioData[(j * mChannelCount) + i] = mBuffer[j];
+                }
+            }
+        }
+
+      private:
+        int32_t                       mChannelCount;
+        std::unique_ptr<Oscillator[]> mOscillators;
+        std::unique_ptr<float[]>      mBuffer = std::make_unique<float[]>(kSharedBufferSize);
+    };
+
+    class SynthSound : public IRenderableAudio {
+        static constexpr float   kTwoPi = M_PI * 2;
+        static constexpr int32_t kNumSineWaves = 5;
+        static constexpr float   kMasterAmplitudeCutOff = 0.01;
+
+      public:
+        void noteOn() {
+            mTrigger = true;
+            mAmplitudeScaler = 0.99999f;
+        }
+
+        void setPhaseIncrement(int32_t sampleRate, float frequency) {
+            mPhaseIncrement = kTwoPi * frequency / static_cast<float>(sampleRate);
+        }
+
+        void setAmplitude(float amplitude) {
+            mAmplitudes[0] = amplitude * .2f;
+            mAmplitudes[1] = amplitude;
+            mAmplitudes[2] = amplitude * .1f;
+            mAmplitudes[3] = amplitude * .02f;
+            mAmplitudes[4] = amplitude * .15f;
+        }
+
+        void renderAudio(float* audioData, int32_t numFrames) override {
+            for (int i = 0; i < numFrames; ++i) {
+                if (mTrigger.exchange(false)) {
+                    mMasterAmplitude = 1.0;
+                    mPhase = 0.0f;
+                } else {
+                    mMasterAmplitude *= mAmplitudeScaler;
+                }
+                audioData[i] = 0;
+                if (mMasterAmplitude < kMasterAmplitudeCutOff) {
+                    continue;
+                }
+                for (int j = 0; j < kNumSineWaves; ++j) {
+                    audioData[i] += sinf(mPhase * (j + 1)) * mAmplitudes[j] * mMasterAmplitude;
+                }
+                mPhase += mPhaseIncrement;
+                if (mPhase > kTwoPi) {
+                    mPhase -= kTwoPi;
+                }
+            }
+        }
+
+      private:
+        std::atomic<bool>                             mTrigger { false };
+        float                                         mMasterAmplitude = 0.0f;
+        std::atomic<float>                            mAmplitudeScaler { 0.0f };
+        std::array<std::atomic<float>, kNumSineWaves> mAmplitudes;
+        float                                         mPhase = 0.0f;
+        std::atomic<float>                            mPhaseIncrement { 0 };
+    };
+}  // namespace legacy
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannels = 2;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int32_t kCheckBursts = 500;  // two seconds
+    constexpr double  kBenchSeconds = 20.0;
+
+    /**
+     * Render both sources for kCheckBursts and compare them.
+     * @return the largest absolute difference and the fraction of samples which differ by more than 1e-3
+     */
+    std::pair<float, double> compare(IRenderableAudio& reference, IRenderableAudio& candidate, int32_t channels) {
+        std::vector<float> a(kBurstFrames * channels);
+        std::vector<float> b(kBurstFrames * channels);
+        float              maxError = 0.0f;
+        int64_t            differing = 0;
+        for (int32_t burst = 0; burst < kCheckBursts; ++burst) {
+            reference.renderAudio(a.data(), kBurstFrames);
+            candidate.renderAudio(b.data(), kBurstFrames);
+            for (size_t i = 0; i < a.size(); ++i) {
+                const float error = std::fabs(a[i] - b[i]);
+                maxError = std::max(maxError, error);
+                differing += error > 1e-3f;
+            }
+        }
+        return {maxError, static_cast<double>(differing) / (static_cast<double>(kCheckBursts) * a.size())};
+    }
+
+    void setUp(Oscillator& oscillator) {
+        oscillator.setSampleRate(kSampleRate);
+        oscillator.setFrequency(440.0);
+        oscillator.setAmplitude(0.5f);
+        oscillator.setWaveOn(true);
+    }
+
+    void setUp(legacy::Oscillator& oscillator) {
+        oscillator.setSampleRate(kSampleRate);
+        oscillator.setFrequency(440.0);
+        oscillator.setAmplitude(0.5f);
+        oscillator.setWaveOn(true);
+    }
+
+    void setUp(SynthSound& synth) {
+        synth.setSampleRate(kSampleRate);
+        synth.setFrequency(440.0f);
+        synth.setAmplitude(0.3f);
+        synth.noteOn();
+    }
+
+    void setUp(legacy::SynthSound& synth) {
+        synth.setPhaseIncrement(kSampleRate, 440.0f);
+        synth.setAmplitude(0.3f);
+        synth.noteOn();
+    }
+
+    void bench(const char* name, IRenderableAudio& reference, IRenderableAudio& candidate, int32_t channels) {
+        RenderConfig config;
+        config.sampleRate = kSampleRate;
+        config.channelCount = channels;
+        config.burstFrames = kBurstFrames;
+        config.seconds = kBenchSeconds;
+        const RenderStats before = renderOffline(reference, config);
+        const RenderStats after = renderOffline(candidate, config);
+        before.print((std::string(name) + " per-sample").c_str());
+        after.print((std::string(name) + " block").c_str());
+        printf("%-28s %.2fx faster\n", "", before.meanMicros / after.meanMicros);
+    }
+}  // namespace
+
+int main() {
+    bool ok = true;
+
+    // A square wave only differs where float rounding moves an edge by a sample.
+    {
+        legacy::Oscillator reference;
+        Oscillator         candidate;
+        setUp(reference);
+        setUp(candidate);
+        auto [maxError, differing] = compare(reference, candidate, 1);
+        printf("oscillator: %.4f%% of samples differ\n", differing * 100.0);
+        ok &= check(differing < 0.002, "oscillator matches the per-sample version");
+    }
+    {
+        legacy::SoundGenerator reference(kSampleRate, kChannels);
+        SoundGenerator         candidate(kSampleRate, kChannels);
+        candidate.tap(true);
+        auto [maxError, differing] = compare(reference, candidate, kChannels);
+        printf("tone: %.4f%% of samples differ\n", differing * 100.0);
+        ok &= check(differing < 0.002, "tone matches the per-sample version");
+    }
+    {
+        legacy::SynthSound reference;
+        SynthSound         candidate;
+        setUp(reference);
+        setUp(candidate);
+        auto [maxError, differing] = compare(reference, candidate, 1);
+        printf("synth: max error %.2e\n", maxError);
+        ok &= check(maxError < 1e-3f, "synth matches the per-sample version");
+    }
+
+    printf("\n%d Hz, %d frame bursts, %.0f s per source\n", kSampleRate, kBurstFrames, kBenchSeconds);
+    RenderStats::printHeader();
+    {
+        legacy::Oscillator reference;
+        Oscillator         candidate;
+        setUp(reference);
+        setUp(candidate);
+        bench("oscillator", reference, candidate, 1);
+    }
+    {
+        legacy::SoundGenerator reference(kSampleRate, kChannels);
+        SoundGenerator         candidate(kSampleRate, kChannels);
+        candidate.tap(true);
+        bench("tone (stereo)", reference, candidate, kChannels);
+    }
+    {
+        legacy::SynthSound reference;
+        SynthSound         candidate;
+        setUp(reference);
+        setUp(candidate);
+        bench("synth", reference, candidate, 1);
+    }
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
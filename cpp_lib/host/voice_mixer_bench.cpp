@@ -0,0 +1,307 @@
+/**
+ * Host benchmark for VoiceMixer.
+ *
+ * Checks the SIMD mix against a scalar reference for every voice count, that voice stealing
+ * picks the oldest voice of the lowest priority, and that scheduled clips and taps land on their
+ * exact frame whatever the burst sizes. A new stream of another format must release the clips decoded
+ * for the old one, the envelope of the mix must match the signal, and a reader racing the audio thread
+ * must never see a torn envelope. Then reports the mixing cost per voice per
+ * 192 frame burst.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SynthSound.h"
+#include "VoiceMixer.h"
+#include "bench_util.h"
+
+namespace {
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kChannels = 2;
+    constexpr int32_t kBurstFrames = 192;
+    constexpr int32_t kClipFrames = kSampleRate * 4;
+    constexpr int32_t kMaxVoices = 32;
+    constexpr int32_t kBenchBursts = kClipFrames / kBurstFrames - 1;
+    constexpr float   kMaxError = 1e-5f;
+
+    std::unique_ptr<PcmClip> makeNoiseClip(uint32_t seed, int32_t frames) {
+        auto clip = std::make_unique<PcmClip>();
+        clip->frames = frames;
+        clip->sampleRate = kSampleRate;
+        clip->channelCount = kChannels;
+        clip->samples.resize(static_cast<size_t>(frames) * kChannels);
+        for (float& sample : clip->samples) {
+            seed = seed * 1664525u + 1013904223u;
+            // Quiet enough that kMaxVoices voices never clip.
+            sample = (static_cast<float>(seed >> 8) / 16777216.0f - 0.5f) * 0.05f;
+        }
+        return clip;
+    }
+
+    // Mix voices with the scalar reference and compare a few bursts against the mixer.
+    bool checkMix(const std::vector<std::unique_ptr<PcmClip>>& clips, int32_t voices) {
+        VoiceMixer         mixer(kSampleRate, kChannels, kMaxVoices);
+        std::vector<float> gains(voices * 2);
+        for (int32_t v = 0; v < voices; ++v) {
+            const float gain = 0.5f + 0.05f * v;
+            const float pan = -1.0f + 2.0f * v / std::max(1, voices - 1);
+            mixer.play(clips[v].get(), gain, pan);
+            gains[v * 2] = gain * std::min(1.0f, 1.0f - pan);
+            gains[v * 2 + 1] = gain * std::min(1.0f, 1.0f + pan);
+        }
+        // An odd burst size exercises the scalar tail.
+        constexpr int32_t  kOddFrames = 173;
+        std::vector<float> output(kOddFrames * kChannels);
+        float              maxError = 0.0f;
+        for (int32_t burst = 0; burst < 8; ++burst) {
+            mixer.renderAudio(output.data(), kOddFrames);
+            for (int32_t i = 0; i < kOddFrames * kChannels; ++i) {
+                float expected = 0.0f;
+                for (int32_t v = 0; v < voices; ++v) {
+                    expected += clips[v]->samples[burst * kOddFrames * kChannels + i] * gains[v * 2 + i % 2];
+                }
+                maxError = std::max(maxError, std::fabs(expected - output[i]));
+            }
+        }
+        mixer.stopAll();
+        mixer.renderAudio(output.data(), kOddFrames);
+        return check(maxError < kMaxError, "mix matches the scalar reference");
+    }
+
+    bool checkStealing(const std::vector<std::unique_ptr<PcmClip>>& clips) {
+        bool               ok = true;
+        VoiceMixer         mixer(kSampleRate, kChannels, 4);
+        std::vector<float> output(kBurstFrames * kChannels);
+        for (int32_t v = 0; v < 6; ++v) {
+            mixer.play(clips[v].get());
+            mixer.renderAudio(output.data(), kBurstFrames);
+        }
+        ok &= check(mixer.getStolenCount() == 2, "two voices stolen");
+        ok &= check(!clips[0]->isPlaying() && !clips[1]->isPlaying() && clips[2]->isPlaying(),
+                    "the oldest voices are stolen");
+
+        mixer.stopAll();
+        for (int32_t v = 0; v < 4; ++v) {
+            mixer.play(clips[v].get(), 1.0f, 0.0f, v == 0 ? 0 : 5);
+        }
+        mixer.play(clips[4].get(), 1.0f, 0.0f, 1);
+        mixer.play(clips[5].get(), 1.0f, 0.0f, 0);
+        mixer.renderAudio(output.data(), kBurstFrames);
+        ok &= check(!clips[0]->isPlaying() && clips[4]->isPlaying(), "the lowest priority voice is stolen");
+        ok &= check(!clips[5]->isPlaying() && mixer.getDroppedCount() == 1, "a lower priority clip is dropped");
+        mixer.stopAll();
+        mixer.renderAudio(output.data(), kBurstFrames);
+        ok &= check(mixer.getActiveVoiceCount() == 0 && !clips[4]->isPlaying(), "stopAll releases every voice");
+        return ok;
+    }
+
+    // A stream of another format releases the voices and the queued clips decoded for the old one.
+    bool checkFormatChange(const std::vector<std::unique_ptr<PcmClip>>& clips) {
+        VoiceMixer         mixer(kSampleRate, kChannels, 4);
+        std::vector<float> output(kBurstFrames * kChannels);
+        mixer.play(clips[0].get());
+        mixer.play(clips[1].get());
+        mixer.renderAudio(output.data(), kBurstFrames);
+        mixer.play(clips[2].get(), 1.0f, 0.0f, 0, kClipFrames);
+        mixer.setFormat(kSampleRate, kChannels);
+        bool ok = check(clips[0]->isPlaying() && clips[1]->isPlaying() && clips[2]->isPlaying(),
+                        "setFormat keeps the clips of the same format");
+
+        mixer.setFormat(44100, 1);
+        ok &= check(!clips[0]->isPlaying() && !clips[1]->isPlaying() && !clips[2]->isPlaying(),
+                    "setFormat releases the clips of another format");
+        mixer.renderAudio(output.data(), kBurstFrames);
+        ok &= check(mixer.getActiveVoiceCount() == 0
+                            && std::all_of(output.begin(), output.begin() + kBurstFrames,
+                                           [](float sample) { return sample == 0.0f; }),
+                    "no stale clip is mixed after setFormat");
+        return ok;
+    }
+
+    // Schedule clips and a note at frames that fall anywhere in randomly sized bursts.
+    bool checkScheduling() {
+        constexpr int32_t kClips = 24;
+        constexpr int32_t kFirstFrame = 1000;
+        constexpr int32_t kSpacing = 317;
+        constexpr int32_t kNoteFrame = kFirstFrame + kClips * kSpacing + 151;
+        constexpr int32_t kTotalFrames = kNoteFrame + 2000;
+
+        // The synth is mono, so the clip and the mixer are too.
+        auto dc = std::make_unique<PcmClip>();
+        dc->frames = 64;
+        dc->sampleRate = kSampleRate;
+        dc->channelCount = 1;
+        dc->samples.assign(dc->frames, 0.5f);
+
+        SynthSound synth;
+        synth.setSampleRate(kSampleRate);
+        synth.setAmplitude(0.2f);
+        VoiceMixer mixer(kSampleRate, 1);
+        mixer.setStreamSource(&synth);
+        for (int32_t k = 0; k < kClips; ++k) {
+            mixer.play(dc.get(), 1.0f, 0.0f, 0, kFirstFrame + k * kSpacing);
+        }
+        mixer.tap(&synth, true, kNoteFrame);
+
+        std::vector<float> output(kTotalFrames);
+        uint32_t           seed = 777;
+        for (int32_t done = 0; done < kTotalFrames;) {
+            seed = seed * 1664525u + 1013904223u;
+            const int32_t frames = std::min<int32_t>(1 + static_cast<int32_t>((seed >> 8) % 400), kTotalFrames - done);
+            mixer.renderAudio(output.data() + done, frames);
+            done += frames;
+        }
+
+        bool ok = check(mixer.getFramePosition() == kTotalFrames, "frame position counts rendered frames");
+        int32_t misplaced = 0;
+        for (int32_t k = 0; k < kClips; ++k) {
+            const int32_t start = kFirstFrame + k * kSpacing;
+            if (output[start - 1] != 0.0f || output[start] != 0.5f || output[start + dc->frames - 1] != 0.5f
+                || output[start + dc->frames] != 0.0f) {
+                ++misplaced;
+            }
+        }
+        ok &= check(misplaced == 0, "scheduled clips start on their frame");
+        // The note starts at phase zero, so its first sample is silent and the second is not.
+        const bool silentBefore = std::all_of(output.begin() + kFirstFrame + kClips * kSpacing,
+                                              output.begin() + kNoteFrame + 1, [](float sample) { return sample == 0.0f; });
+        ok &= check(silentBefore && output[kNoteFrame + 1] != 0.0f, "scheduled tap lands on its frame");
+
+        // Frames in the past play at the start of the next burst.
+        mixer.setStreamSource(nullptr);
+        mixer.play(dc.get(), 1.0f, 0.0f, 0, 10);
+        mixer.renderAudio(output.data(), 16);
+        ok &= check(output[0] == 0.5f, "a late clip plays at once");
+
+        // A new stream restarts the timeline and whatever was scheduled on the old one becomes due.
+        mixer.stopAll();
+        mixer.play(dc.get(), 1.0f, 0.0f, 0, kTotalFrames * 10);
+        SynthSound silent;
+        silent.setSampleRate(kSampleRate);
+        silent.setAmplitude(0.2f);
+        mixer.tap(&silent, true, kTotalFrames * 10);
+        mixer.renderAudio(output.data(), 16);
+        mixer.setFormat(kSampleRate, 1);
+        mixer.renderAudio(output.data(), 16);
+        ok &= check(mixer.getFramePosition() == 16 && output[0] == 0.5f, "setFormat makes scheduled clips due");
+        mixer.stopAll();
+        mixer.setStreamSource(&silent);
+        mixer.renderAudio(output.data(), 16);
+        mixer.setStreamSource(nullptr);
+        ok &= check(output[1] == 0.0f, "setFormat drops scheduled taps");
+        mixer.play(dc.get(), 1.0f, 0.0f, 0, 52);
+        mixer.renderAudio(output.data(), 32);
+        ok &= check(output[19] == 0.0f && output[20] == 0.5f, "frames count from the new stream's start");
+        mixer.stopAll();
+        mixer.renderAudio(output.data(), 16);
+        return ok;
+    }
+
+    bool checkEnvelope() {
+        // A full scale sine at -6 dB: RMS 0.5 / sqrt(2), peak 0.5.
+        auto sine = std::make_unique<PcmClip>();
+        sine->frames = kSampleRate;
+        sine->sampleRate = kSampleRate;
+        sine->channelCount = kChannels;
+        sine->samples.resize(static_cast<size_t>(sine->frames) * kChannels);
+        for (int32_t i = 0; i < sine->frames; ++i) {
+            const float v = 0.5f * static_cast<float>(std::sin(2.0 * M_PI * 1000.0 * i / kSampleRate));
+            sine->samples[i * kChannels] = sine->samples[i * kChannels + 1] = v;
+        }
+        VoiceMixer         mixer(kSampleRate, kChannels);
+        std::vector<float> output(kBurstFrames * kChannels);
+        mixer.play(sine.get());
+        for (int32_t burst = 0; burst < 50; ++burst) {
+            mixer.renderAudio(output.data(), kBurstFrames);
+        }
+        EnvelopeFollower::Envelope envelope;
+        bool ok = check(mixer.getEnvelope().read(envelope), "envelope published");
+        ok &= check(std::fabs(envelope.rms - 0.35355f) < 0.01f && std::fabs(envelope.peak - 0.5f) < 0.01f,
+                    "envelope RMS and peak match the signal");
+        ok &= check(std::fabs(envelope.level - envelope.rms) < 0.01f, "smoothed level settles on the RMS");
+        ok &= check(envelope.sequence == 50 && envelope.framePosition == 49 * kBurstFrames,
+                    "envelope carries its burst");
+        mixer.stopAll();
+        mixer.renderAudio(output.data(), kBurstFrames);
+
+        // Publish bursts of a constant value from one thread while another reads: every envelope read
+        // must come from a single burst.
+        constexpr int32_t  kWrites = 200000;
+        EnvelopeFollower   follower;
+        std::atomic<bool>  done { false };
+        int64_t            reads = 0;
+        int64_t            torn = 0;
+        std::thread        reader([&]() {
+            EnvelopeFollower::Envelope read;
+            while (!done.load(std::memory_order_acquire)) {
+                if (follower.read(read)) {
+                    ++reads;
+                    const int64_t burst = std::lround(read.peak * 1000000.0f);
+                    if (std::fabs(read.rms - read.peak) > 1e-6f * read.peak || read.framePosition != burst * 16) {
+                        ++torn;
+                    }
+                }
+            }
+        });
+        float block[16];
+        for (int32_t k = 1; k <= kWrites; ++k) {
+            std::fill(std::begin(block), std::end(block), static_cast<float>(k) / 1000000.0f);
+            follower.process(block, 16, 1, kSampleRate, static_cast<int64_t>(k) * 16);
+        }
+        done.store(true, std::memory_order_release);
+        reader.join();
+        printf("envelope: %lld reads during %d writes, %lld torn\n", (long long)reads, kWrites, (long long)torn);
+        ok &= check(reads > 0 && torn == 0, "envelope reads are never torn");
+        return ok;
+    }
+}  // namespace
+
+int main() {
+    std::vector<std::unique_ptr<PcmClip>> clips;
+    for (int32_t v = 0; v < kMaxVoices; ++v) {
+        clips.push_back(makeNoiseClip(1000 + v, kClipFrames));
+    }
+
+    bool ok = checkStealing(clips);
+    ok &= checkFormatChange(clips);
+    ok &= checkScheduling();
+    ok &= checkEnvelope();
+    for (int32_t voices : {1, 3, 8, kMaxVoices}) {
+        ok &= checkMix(clips, voices);
+    }
+
+    std::vector<float> output(kBurstFrames * kChannels);
+    double             emptyNanos = 0.0;
+    printf("%8s %14s %18s\n", "voices", "ns/burst", "ns/voice/burst");
+    for (int32_t voices : {0, 1, 2, 4, 8, 16, 32}) {
+        VoiceMixer mixer(kSampleRate, kChannels, kMaxVoices);
+        for (int32_t v = 0; v < voices; ++v) {
+            mixer.play(clips[v].get(), 0.8f, 0.25f);
+        }
+        mixer.renderAudio(output.data(), kBurstFrames);
+        const int64_t start = benchNowNanos();
+        for (int32_t burst = 1; burst < kBenchBursts; ++burst) {
+            mixer.renderAudio(output.data(), kBurstFrames);
+            benchKeep(output[0]);
+        }
+        const double burstNanos = static_cast<double>(benchNowNanos() - start) / (kBenchBursts - 1);
+        if (voices == 0) {
+            emptyNanos = burstNanos;
+            printf("%8d %14.1f %18s\n", voices, burstNanos, "-");
+        } else {
+            printf("%8d %14.1f %18.1f\n", voices, burstNanos, (burstNanos - emptyNanos) / voices);
+        }
+        ok &= check(mixer.getActiveVoiceCount() == voices, "voices still active after the benchmark");
+        mixer.stopAll();
+    }
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+/**
+ * Host benchmark for the camera preview's YUV_420_888 to RGBA conversion, camera/yuv_convert.h.
+ *
+ * Checks that yuv::toRgba() and the vector path of yuv::convertRow() match the per-pixel YUV2RGB the
+ * preview used, for every Y, U and V, and that yuv::convert() matches the reference for I420, NV12 and
+ * NV21 images with padded rows, odd crop rectangles and every width up to a few vectors. The planes end
+ * on an inaccessible page, so a read past their end crashes the benchmark. yuv::convertRotate90() and
+ * yuv::convertRotate270() are checked the same way against the reference rows written out rotated.
+ * Then times a 1080p frame against the per-pixel loop, and the rotated previews at 720p and 1080p
+ * against converting a row at a time and walking it down a column of the output, as ImageReader did.
+ *
+ * Exits with a non-zero status if any check fails.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "bench_util.h"
+#include "camera/yuv_convert.h"
+#include "yuv_test_image.h"
+
+namespace {
+    constexpr int32_t kFrameWidth = 1920;
+    constexpr int32_t kFrameHeight = 1080;
+    constexpr int32_t kSmallFrameWidth = 1280;
+    constexpr int32_t kSmallFrameHeight = 720;
+    constexpr int32_t kFrames = 50;
+    constexpr int32_t kMaxCheckedWidth = 70;
+
+    // The conversion ImageReader::PresentImage made per pixel, as it was.
+    const int kLegacyMaxChannelValue = 262143;
+
+    inline uint32_t legacyYuv2Rgb(int nY, int nU, int nV) {
+        nY -= 16;
+        nU -= 128;
+        nV -= 128;
+        if (nY < 0) nY = 0;
+
+        int nR = (int)(1192 * nY + 1634 * nV);
+        int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
+        int nB = (int)(1192 * nY + 2066 * nU);
+
+        nR = std::min(kLegacyMaxChannelValue, std::max(0, nR));
+        nG = std::min(kLegacyMaxChannelValue, std::max(0, nG));
+        nB = std::min(kLegacyMaxChannelValue, std::max(0, nB));
+
+        nR = (nR >> 10) & 0xff;
+        nG = (nG >> 10) & 0xff;
+        nB = (nB >> 10) & 0xff;
+
+        return 0xff000000 | (nB << 16) | (nG << 8) | nR;
+    }
+
+    // The inner loop of ImageReader::PresentImage as it was, for a crop starting at column 0.
+    void legacyConvert(const yuv::Image& image, int32_t width, int32_t height, uint32_t* out, int32_t outStride) {
+        for (int32_t y = 0; y < height; y++) {
+            const uint8_t* pY = image.y + image.yRowStride * y;
+            int32_t        uvRowStart = image.uvRowStride * (y >> 1);
+            const uint8_t* pU = image.u + uvRowStart;
+            const uint8_t* pV = image.v + uvRowStart;
+            for (int32_t x = 0; x < width; x++) {
+                const int32_t uvOffset = (x >> 1) * image.uvPixelStride;
+                out[x] = legacyYuv2Rgb(pY[x], pU[uvOffset], pV[uvOffset]);
+            }
+            out += outStride;
+        }
+    }
+
+    /**
+     * A row at a time, each row written down a column of out: PresentImage90 and PresentImage270 before
+     * the tiles. Pixel (x, y) goes to row x, column crop.height - 1 - y when rotating by 90 and to row
+     * crop.width - 1 - x, column y otherwise.
+     */
+    template <typename ConvertRow>
+    void columnWalkConvert(ConvertRow convertRow, const yuv::Image& image, const yuv::Rect& crop, bool rotate90,
+                           uint32_t* row, uint32_t* out, int32_t outStride) {
+        for (int32_t y = 0; y < crop.height; y++) {
+            convertRow(image, crop.top + y, crop.left, crop.width, row);
+            for (int32_t x = 0; x < crop.width; x++) {
+                const size_t outRow = rotate90 ? x : crop.width - 1 - x;
+                out[outRow * outStride + (rotate90 ? crop.height - 1 - y : y)] = row[x];
+            }
+        }
+    }
+
+    // Milliseconds per frame.
+    template <typename Convert>
+    double timeFrames(Convert convert) {
+        convert();
+        const int64_t start = benchNowNanos();
+        for (int32_t frame = 0; frame < kFrames; ++frame) {
+            convert();
+        }
+        return double(benchNowNanos() - start) / kFrames / 1e6;
+    }
+}  // namespace
+
+int main() {
+    bool ok = true;
+
+    // The reference is the legacy per-pixel math for every input.
+    uint64_t mismatches = 0;
+    for (int y = 0; y < 256; ++y) {
+        for (int u = 0; u < 256; ++u) {
+            for (int v = 0; v < 256; ++v) {
+                mismatches += yuv::toRgba(y, u, v) != legacyYuv2Rgb(y, u, v);
+            }
+        }
+    }
+    printf("toRgba vs. the legacy YUV2RGB over all 2^24 inputs: %llu mismatches\n", (unsigned long long)mismatches);
+    ok &= check(mismatches == 0, "toRgba differs from the legacy conversion");
+
+    // So are the vectors: rows of 256 chroma samples with every V, for every U and every pair of Y.
+    for (int32_t uvPixelStride : {1, 2}) {
+        std::vector<uint8_t>  luma(2 * 256);
+        std::vector<uint8_t>  chroma(2 * 256 * uvPixelStride + 1);
+        std::vector<uint32_t> out(luma.size());
+        yuv::Image            image;
+        image.y = luma.data();
+        image.u = chroma.data();
+        image.v = chroma.data() + (uvPixelStride == 1 ? 256 : 1);
+        image.uvPixelStride = uvPixelStride;
+        mismatches = 0;
+        for (int u = 0; u < 256; ++u) {
+            for (int v = 0; v < 256; ++v) {
+                const_cast<uint8_t*>(image.u)[v * uvPixelStride] = static_cast<uint8_t>(u);
+                const_cast<uint8_t*>(image.v)[v * uvPixelStride] = static_cast<uint8_t>(v);
+            }
+            for (int y = 0; y < 256; y += 2) {
+                for (size_t x = 0; x < luma.size(); ++x) {
+                    luma[x] = static_cast<uint8_t>(y + x % 2);
+                }
+                yuv::convertRow(image, 0, 0, static_cast<int32_t>(out.size()), out.data());
+                for (size_t x = 0; x < out.size(); ++x) {
+                    mismatches += out[x] != legacyYuv2Rgb(luma[x], u, static_cast<int>(x / 2));
+                }
+            }
+        }
+        printf("convertRow, pixel stride %d, vs. the legacy YUV2RGB over all 2^24 inputs: %llu mismatches\n",
+               uvPixelStride, (unsigned long long)mismatches);
+        ok &= check(mismatches == 0, "convertRow differs from the legacy conversion");
+    }
+
+    // Every layout, odd and padded row strides, crops starting on odd and even columns and rows, and
+    // every width up to a few vectors so each tail length is seen.
+    for (Layout layout : {Layout::I420, Layout::NV12, Layout::NV21}) {
+        uint64_t checkedPixels = 0;
+        uint64_t checkedRotatedPixels = 0;
+        bool     layoutOk = true;
+        bool     rotatedOk = true;
+        for (int32_t width = 1; width <= kMaxCheckedWidth; ++width) {
+            // Up to a few bands of the rotated tiles.
+            const int32_t height = 5 + width % 4 + 16 * (width % 3);
+            for (int32_t padding : {0, 7, 64}) {
+                TestImage image(layout, width, height, width + padding, uint32_t(width * 131 + padding));
+                for (int32_t left = 0; left <= std::min(3, width - 1); ++left) {
+                    for (int32_t top = 0; top <= 1; ++top) {
+                        const yuv::Rect       crop {left, top, width - left, height - top};
+                        std::vector<uint32_t> expected(static_cast<size_t>(crop.width) * crop.height);
+                        std::vector<uint32_t> actual(expected.size());
+                        for (int32_t row = 0; row < crop.height; ++row) {
+                            yuv::convertRowReference(image.image, crop.top + row, crop.left, crop.width,
+                                                     expected.data() + static_cast<size_t>(row) * crop.width);
+                        }
+                        yuv::convert(image.image, crop, actual.data(), crop.width);
+                        layoutOk &= actual == expected;
+                        checkedPixels += actual.size();
+
+                        // Rotated into rows a little longer than the crop is high, to check the stride.
+                        const int32_t         rotatedStride = crop.height + 3;
+                        std::vector<uint32_t> row(crop.width);
+                        for (bool rotate90 : {true, false}) {
+                            std::vector<uint32_t> rotatedExpected(static_cast<size_t>(crop.width) * rotatedStride);
+                            std::vector<uint32_t> rotated(rotatedExpected.size());
+                            columnWalkConvert(yuv::convertRowReference, image.image, crop, rotate90, row.data(),
+                                              rotatedExpected.data(), rotatedStride);
+                            (rotate90 ? yuv::convertRotate90 : yuv::convertRotate270)(image.image, crop,
+                                                                                     rotated.data(), rotatedStride);
+                            rotatedOk &= rotated == rotatedExpected;
+                            checkedRotatedPixels += actual.size();
+                        }
+                    }
+                }
+                if (width % 2 == 0) {
+                    // Uncropped, the legacy loop reads the same chroma.
+                    std::vector<uint32_t> legacy(static_cast<size_t>(width) * height);
+                    std::vector<uint32_t> actual(legacy.size());
+                    legacyConvert(image.image, width, height, legacy.data(), width);
+                    yuv::convert(image.image, {0, 0, width, height}, actual.data(), width);
+                    layoutOk &= actual == legacy;
+                }
+            }
+        }
+        printf("%s: convert vs. the reference over %llu pixels of cropped images: %s\n", layoutName(layout),
+               (unsigned long long)checkedPixels, layoutOk ? "identical" : "DIFFERENT");
+        ok &= check(layoutOk, "convert differs from the reference");
+        printf("%s: convertRotate90/270 vs. the reference over %llu pixels of cropped images: %s\n",
+               layoutName(layout), (unsigned long long)checkedRotatedPixels, rotatedOk ? "identical" : "DIFFERENT");
+        ok &= check(rotatedOk, "convertRotate90/270 differ from the reference");
+    }
+
+    printf("\n%-28s %12s %12s %8s\n", "1920x1080 frame", "per pixel ms", "convert ms", "speedup");
+    for (Layout layout : {Layout::I420, Layout::NV21}) {
+        TestImage             image(layout, kFrameWidth, kFrameHeight, kFrameWidth, 1);
+        std::vector<uint32_t> legacy(static_cast<size_t>(kFrameWidth) * kFrameHeight);
+        std::vector<uint32_t> converted(legacy.size());
+        const double          legacyMs = timeFrames([&]() {
+            legacyConvert(image.image, kFrameWidth, kFrameHeight, legacy.data(), kFrameWidth);
+            benchKeep(legacy[0]);
+        });
+        const double          convertMs = timeFrames([&]() {
+            yuv::convert(image.image, {0, 0, kFrameWidth, kFrameHeight}, converted.data(), kFrameWidth);
+            benchKeep(converted[0]);
+        });
+        printf("%-28s %12.2f %12.2f %7.1fx\n", layoutName(layout), legacyMs, convertMs, legacyMs / convertMs);
+        ok &= check(converted == legacy, "the 1080p frame differs from the per-pixel loop");
+        ok &= check(convertMs < legacyMs, "convert is slower than the per-pixel loop");
+    }
+
+    printf("\n%-28s %12s %12s %8s\n", "rotated preview", "column ms", "tiled ms", "speedup");
+    const std::pair<int32_t, int32_t> frameSizes[] = {{kSmallFrameWidth, kSmallFrameHeight},
+                                                      {kFrameWidth, kFrameHeight}};
+    for (auto [width, height] : frameSizes) {
+        for (Layout layout : {Layout::I420, Layout::NV21}) {
+            TestImage             image(layout, width, height, width, 2);
+            const yuv::Rect       crop {0, 0, width, height};
+            std::vector<uint32_t> row(width);
+            std::vector<uint32_t> walked(static_cast<size_t>(width) * height);
+            std::vector<uint32_t> tiled(walked.size());
+            for (bool rotate90 : {true, false}) {
+                const double walkedMs = timeFrames([&]() {
+                    columnWalkConvert(yuv::convertRow, image.image, crop, rotate90, row.data(), walked.data(), height);
+                    benchKeep(walked[0]);
+                });
+                const double tiledMs = timeFrames([&]() {
+                    (rotate90 ? yuv::convertRotate90 : yuv::convertRotate270)(image.image, crop, tiled.data(), height);
+                    benchKeep(tiled[0]);
+                });
+                char name[64];
+                snprintf(name, sizeof(name), "%dx%d %s %d", width, height, layoutName(layout), rotate90 ? 90 : 270);
+                printf("%-28s %12.2f %12.2f %7.1fx\n", name, walkedMs, tiledMs, walkedMs / tiledMs);
+                ok &= check(tiled == walked, "the rotated frame differs from the column walk");
+                ok &= check(tiledMs < walkedMs, "the tiles are slower than the column walk");
+            }
+        }
+    }
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "camera/yuv_convert.h"
+
+// Test images for the benchmarks of camera/yuv_convert.h and camera/frame_converter.h.
+
+// Bytes which end right before a page that cannot be read.
+class GuardedBytes {
+  public:
+    explicit GuardedBytes(size_t size) : mPageSize(sysconf(_SC_PAGESIZE)) {
+        const size_t pages = (size + mPageSize - 1) / mPageSize;
+        mMapSize = (pages + 1) * mPageSize;
+        mMap = static_cast<uint8_t*>(mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                                          -1, 0));
+        mprotect(mMap + pages * mPageSize, mPageSize, PROT_NONE);
+        mData = mMap + pages * mPageSize - size;
+    }
+
+    ~GuardedBytes() { munmap(mMap, mMapSize); }
+
+    uint8_t* data() { return mData; }
+
+  private:
+    size_t   mPageSize;
+    size_t   mMapSize = 0;
+    uint8_t* mMap = nullptr;
+    uint8_t* mData = nullptr;
+};
+
+enum class Layout { I420, NV12, NV21 };
+
+inline const char* layoutName(Layout layout) {
+    switch (layout) {
+        case Layout::I420: return "I420";
+        case Layout::NV12: return "NV12";
+        case Layout::NV21: return "NV21";
+    }
+    return "";
+}
+
+/**
+ * A random image in one of the layouts YUV_420_888 comes in, its rows padded to rowStride, each
+ * plane ending on a guard page.
+ */
+struct TestImage {
+    TestImage(Layout layout, int32_t width, int32_t height, int32_t rowStride, uint32_t seed) {
+        const int32_t chromaWidth = (width + 1) / 2;
+        const int32_t chromaHeight = (height + 1) / 2;
+        // The last row is only as long as the image, as the camera HAL hands it over.
+        const size_t ySize = static_cast<size_t>(rowStride) * (height - 1) + width;
+        yPlane = std::make_unique<GuardedBytes>(ySize);
+        fill(yPlane->data(), ySize, seed);
+        image.y = yPlane->data();
+        image.yRowStride = rowStride;
+        image.uvRowStride = rowStride;
+        if (layout == Layout::I420) {
+            const size_t size = static_cast<size_t>(rowStride) * (chromaHeight - 1) + chromaWidth;
+            uPlane = std::make_unique<GuardedBytes>(size);
+            vPlane = std::make_unique<GuardedBytes>(size);
+            fill(uPlane->data(), size, seed + 1);
+            fill(vPlane->data(), size, seed + 2);
+            image.u = uPlane->data();
+            image.v = vPlane->data();
+            image.uvPixelStride = 1;
+        } else {
+            // One interleaved plane; the second component's last byte is the plane's last.
+            const size_t size = static_cast<size_t>(rowStride) * (chromaHeight - 1) + 2 * chromaWidth;
+            uPlane = std::make_unique<GuardedBytes>(size);
+            fill(uPlane->data(), size, seed + 1);
+            const uint8_t* first = uPlane->data();
+            image.u = layout == Layout::NV12 ? first : first + 1;
+            image.v = layout == Layout::NV12 ? first + 1 : first;
+            image.uvPixelStride = 2;
+        }
+    }
+
+    static void fill(uint8_t* bytes, size_t size, uint32_t seed) {
+        for (size_t i = 0; i < size; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            bytes[i] = static_cast<uint8_t>(seed >> 24);
+        }
+    }
+
+    std::unique_ptr<GuardedBytes> yPlane;
+    std::unique_ptr<GuardedBytes> uPlane;
+    std::unique_ptr<GuardedBytes> vPlane;
+    yuv::Image                    image;
+};
@@ -0,0 +1,247 @@
+#include "ndk_utils/cpu_topology.h"
+
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <tuple>
+
+#include "ndk_utils/log.h"
+
+namespace cpu_topology {
+
+    namespace {
+        bool readFile(const std::string& path, std::string& contents) {
+            std::ifstream file(path);
+            if (!file) {
+                return false;
+            }
+            std::getline(file, contents);
+            return true;
+        }
+
+        int64_t readNumber(const std::string& path, int64_t fallback) {
+            std::string contents;
+            if (!readFile(path, contents) || contents.empty()) {
+                return fallback;
+            }
+            char*         end = nullptr;
+            const int64_t value = std::strtoll(contents.c_str(), &end, 10);
+            return end == contents.c_str() ? fallback : value;
+        }
+
+        /**
+         * Parse a kernel CPU list such as "0-3,6" or "0 1 2 3".
+         */
+        std::vector<int> parseCpuList(const std::string& list) {
+            std::vector<int> cpus;
+            const char*      p = list.c_str();
+            while (*p != '\0') {
+                if (!std::isdigit(static_cast<unsigned char>(*p))) {
+                    ++p;
+                    continue;
+                }
+                char*     end = nullptr;
+                const int first = static_cast<int>(std::strtol(p, &end, 10));
+                int       last = first;
+                p = end;
+                if (*p == '-') {
+                    last = static_cast<int>(std::strtol(p + 1, &end, 10));
+                    p = end;
+                }
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        std::vector<int> listCpus(const std::string& root) {
+            std::string online;
+            if (readFile(root + "/online", online)) {
+                return parseCpuList(online);
+            }
+            std::vector<int> cpus;
+            if (DIR* dir = opendir(root.c_str())) {
+                while (dirent* entry = readdir(dir)) {
+                    const char* name = entry->d_name;
+                    if (strncmp(name, "cpu", 3) == 0 && std::isdigit(static_cast<unsigned char>(name[3]))) {
+                        cpus.push_back(std::atoi(name + 3));
+                    }
+                }
+                closedir(dir);
+            }
+            std::sort(cpus.begin(), cpus.end());
+            return cpus;
+        }
+
+        /**
+         * The first CPU of the frequency domain, or the cluster id on kernels without cpufreq, -1 if
+         * neither can be read.
+         */
+        int readDomain(const std::string& cpuDir) {
+            std::string            related;
+            const std::vector<int> domain =
+                    readFile(cpuDir + "/cpufreq/related_cpus", related) ? parseCpuList(related) : std::vector<int>();
+            if (!domain.empty()) {
+                return domain.front();
+            }
+            return static_cast<int>(readNumber(cpuDir + "/topology/cluster_id", -1));
+        }
+
+        std::string toString(const std::vector<int>& cpus) {
+            std::string text;
+            for (int cpu : cpus) {
+                text += (text.empty() ? "" : ",") + std::to_string(cpu);
+            }
+            return text.empty() ? "-" : text;
+        }
+    }  // namespace
+
+    Topology probe(const std::string& sysfsRoot) {
+        Topology topology;
+        // Cores of the same capacity and top frequency are one cluster as far as placement is concerned,
+        // even when they sit in separate frequency domains. Without a capacity, mid and big cores may
+        // share a top frequency, so the domains are kept apart; the ones further up are the bigger cores.
+        std::map<std::tuple<int64_t, int64_t, int>, Cluster> byPerformance;
+        for (int id : listCpus(sysfsRoot)) {
+            const std::string dir = sysfsRoot + "/cpu" + std::to_string(id);
+            Cpu               cpu;
+            cpu.id = id;
+            cpu.maxFrequencyKHz = readNumber(dir + "/cpufreq/cpuinfo_max_freq", 0);
+            cpu.capacity = readNumber(dir + "/cpu_capacity", 0);
+            topology.cpus.push_back(cpu);
+
+            const int domain = cpu.capacity > 0 ? -1 : readDomain(dir);
+            Cluster&  cluster = byPerformance[{cpu.capacity, cpu.maxFrequencyKHz, domain}];
+            cluster.cpus.push_back(id);
+            cluster.capacity = cpu.capacity;
+            cluster.maxFrequencyKHz = cpu.maxFrequencyKHz;
+        }
+        for (auto& [key, cluster] : byPerformance) {
+            std::sort(cluster.cpus.begin(), cluster.cpus.end());
+            topology.clusters.push_back(std::move(cluster));
+        }
+        return topology;
+    }
+
+    std::string Topology::toString() const {
+        std::string text;
+        for (const Cluster& cluster : clusters) {
+            char line[96];
+            snprintf(line, sizeof(line), "%s[%s] %lld MHz capacity %lld", text.empty() ? "" : ", ",
+                     cpu_topology::toString(cluster.cpus).c_str(), (long long)cluster.maxFrequencyKHz / 1000,
+                     (long long)cluster.capacity);
+            text += line;
+        }
+        return text;
+    }
+
+    const std::vector<int>& Placement::forRole(ThreadRole role) const {
+        switch (role) {
+            case ThreadRole::Audio: return audio;
+            case ThreadRole::Decoder: return decoder;
+            default: return inference;
+        }
+    }
+
+    std::string Placement::toString() const {
+        return "audio " + cpu_topology::toString(audio) + ", decoder " + cpu_topology::toString(decoder)
+               + ", inference " + cpu_topology::toString(inference);
+    }
+
+    Placement place(const Topology& topology) {
+        Placement placement;
+        if (topology.clusters.empty()) {
+            // Nothing could be read: the audio and decoder threads stay unpinned and inference may use
+            // every online CPU, so its thread count is never 0.
+            const int count = static_cast<int>(std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L));
+            for (int cpu = 0; cpu < count; ++cpu) {
+                placement.inference.push_back(cpu);
+            }
+            return placement;
+        }
+        std::vector<int> used;
+        auto             isFree = [&used](int cpu) { return std::find(used.begin(), used.end(), cpu) == used.end(); };
+
+        const Cluster* audioCluster = &topology.clusters.back();
+        for (auto it = topology.clusters.rbegin(); it != topology.clusters.rend(); ++it) {
+            if (it->cpus.size() >= 2) {
+                audioCluster = &*it;
+                break;
+            }
+        }
+        placement.audio = {audioCluster->cpus.back()};
+        used.push_back(audioCluster->cpus.back());
+
+        for (const Cluster& cluster : topology.clusters) {
+            auto cpu = std::find_if(cluster.cpus.begin(), cluster.cpus.end(), isFree);
+            if (cpu != cluster.cpus.end()) {
+                placement.decoder = {*cpu};
+                used.push_back(*cpu);
+                break;
+            }
+        }
+
+        // The faster clusters first, the slowest one only if nothing else is left.
+        for (size_t i = topology.isHeterogeneous() ? 1 : 0; i < topology.clusters.size(); ++i) {
+            std::copy_if(topology.clusters[i].cpus.begin(), topology.clusters[i].cpus.end(),
+                         std::back_inserter(placement.inference), isFree);
+        }
+        if (placement.inference.empty()) {
+            std::copy_if(topology.clusters.front().cpus.begin(), topology.clusters.front().cpus.end(),
+                         std::back_inserter(placement.inference), isFree);
+        }
+
+        // Too few CPUs to keep the roles apart.
+        if (placement.decoder.empty()) {
+            placement.decoder = placement.audio;
+        }
+        if (placement.inference.empty()) {
+            for (const Cpu& cpu : topology.cpus) {
+                placement.inference.push_back(cpu.id);
+            }
+        }
+        return placement;
+    }
+
+    const Placement& getPlacement() {
+        static const Placement placement = []() {
+            const Topology topology = probe();
+            Placement      result = place(topology);
+            LOGI("CPU clusters: %s", topology.toString().c_str());
+            LOGI("Thread placement: %s", result.toString().c_str());
+            return result;
+        }();
+        return placement;
+    }
+
+    bool placeCurrentThread(ThreadRole role) {
+        return setCurrentThreadAffinity(getPlacement().forRole(role));
+    }
+
+    bool setCurrentThreadAffinity(const std::vector<int>& cpus) {
+        if (cpus.empty()) {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            LOGW("Could not set thread affinity to %s", toString(cpus).c_str());
+            return false;
+        }
+        return true;
+    }
+
+}  // namespace cpu_topology
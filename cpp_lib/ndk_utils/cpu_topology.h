@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * CPU topology probe and thread placement policy.
+ *
+ * The probe reads sysfs (cpuN/cpufreq/cpuinfo_max_freq, cpuN/cpu_capacity, cpufreq/related_cpus and
+ * topology/cluster_id), so it works the same on a device and on a Linux host, and can be pointed at
+ * a fake tree. CPUs of the same capacity and maximum frequency form a cluster, whatever frequency
+ * domain they are in. Without a capacity the frequency domains, or the cluster ids, split them as
+ * well. Clusters are ordered from the slowest to the fastest.
+ */
+namespace cpu_topology {
+
+    constexpr const char* kSysfsRoot = "/sys/devices/system/cpu";
+
+    struct Cpu {
+        int     id = 0;
+        int64_t maxFrequencyKHz = 0;  // 0 if unknown
+        int64_t capacity = 0;         // scheduler capacity, 1024 for the fastest core, 0 if unknown
+    };
+
+    struct Cluster {
+        std::vector<int> cpus;
+        int64_t          maxFrequencyKHz = 0;
+        int64_t          capacity = 0;
+    };
+
+    struct Topology {
+        std::vector<Cpu>     cpus;      // online CPUs only
+        std::vector<Cluster> clusters;  // slowest first
+
+        bool isHeterogeneous() const { return clusters.size() > 1; }
+
+        std::string toString() const;
+    };
+
+    /**
+     * Probe the online CPUs under sysfsRoot. CPUs which nothing in sysfs tells apart end up in a single
+     * cluster.
+     */
+    Topology probe(const std::string& sysfsRoot = kSysfsRoot);
+
+    enum class ThreadRole { Audio, Decoder, Inference };
+
+    /**
+     * Which CPUs each role may run on. The sets do not overlap unless there are too few CPUs.
+     *
+     * - Audio gets one core of the fastest cluster that has at least two, so a lone prime core is
+     *   left to inference and a little core never has to meet the callback deadline.
+     * - Decoder threads get one core of the slowest cluster. They decode far ahead of the stream and
+     *   only need throughput.
+     * - Inference gets every remaining core of the faster clusters, or of any cluster if those are
+     *   all taken.
+     *
+     * Without a topology, e.g. when sysfs cannot be read, only inference gets CPUs: every online one.
+     */
+    struct Placement {
+        std::vector<int> audio;
+        std::vector<int> decoder;
+        std::vector<int> inference;
+
+        const std::vector<int>& forRole(ThreadRole role) const;
+
+        std::string toString() const;
+    };
+
+    Placement place(const Topology& topology);
+
+    /**
+     * The placement for this device, probed from sysfs on the first call.
+     */
+    const Placement& getPlacement();
+
+    /**
+     * Restrict the calling thread to the CPUs of a role.
+     * @return true if the affinity was set
+     */
+    bool placeCurrentThread(ThreadRole role);
+
+    bool setCurrentThreadAffinity(const std::vector<int>& cpus);
+
+}  // namespace cpu_topology
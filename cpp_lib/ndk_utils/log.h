@@ -22,9 +22,13 @@ constexpr std::string_view get_filename(const std::string_view path) {
     return path.substr(last_slash + 1);
 }
 
+#    include "ndk_utils/rt_check.h"
+
+// Logging blocks, so it counts as a violation inside the audio callback in AUDIO_RT_CHECK builds.
 #    define PRINT(LEVEL, fmt, ...)                                                                                     \
-        __android_log_print(LEVEL, "NativeOpenGL", "(%10.10s:%4.4d) %10.10s: " fmt, get_filename(__FILE__).data(),     \
-                            __LINE__, __func__, ##__VA_ARGS__)
+        (rt_check::onBlockingCall("log"),                                                                            \
+         __android_log_print(LEVEL, "NativeOpenGL", "(%10.10s:%4.4d) %10.10s: " fmt, get_filename(__FILE__).data(),    \
+                             __LINE__, __func__, ##__VA_ARGS__))
 #else
 #    define PRINT(LEVEL, fmt, ...)                                                                                     \
         __android_log_print(LEVEL, "NativeOpenGL", "(%s:%d %s): " fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
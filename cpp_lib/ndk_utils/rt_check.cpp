@@ -0,0 +1,304 @@
+// Real-time safety checker, only built with AUDIO_RT_CHECK=1. @see rt_check.h
+//
+// Allocation, pthread mutex and file functions are interposed: the definitions below take the
+// place of the C library's and forward to it via dlsym(RTLD_NEXT). In an executable (the host
+// harness) they catch every call in the process. In the Android shared library they catch the
+// library's own calls, which requires linking it with -Bsymbolic.
+#include "ndk_utils/rt_check.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <unwind.h>
+
+#include <atomic>
+#include <new>
+
+#include "ndk_utils/log.h"
+
+namespace {
+    constexpr int kMaxFrames = 24;
+    // Call sites already reported with a stack trace, later hits are only counted.
+    constexpr int kMaxReportedSites = 64;
+
+    // Thread state lives in pthread keys rather than thread_local: TLS in a shared library may be
+    // allocated lazily with malloc, which would recurse into the interposer.
+    pthread_key_t gDepthKey;
+    pthread_key_t gReportingKey;
+    bool          gKeysCreated = false;
+
+    std::atomic<uint64_t>  gViolations { 0 };
+    std::atomic<bool>      gAbortOnViolation { false };
+    std::atomic<uintptr_t> gReportedSites[kMaxReportedSites];
+
+    __attribute__((constructor)) void createKeys() {
+        gKeysCreated = pthread_key_create(&gDepthKey, nullptr) == 0
+                       && pthread_key_create(&gReportingKey, nullptr) == 0;
+        const char* abortEnv = getenv("AUDIO_RT_CHECK_ABORT");
+        gAbortOnViolation = abortEnv != nullptr && abortEnv[0] == '1';
+    }
+
+    intptr_t getKey(pthread_key_t key) {
+        return gKeysCreated ? reinterpret_cast<intptr_t>(pthread_getspecific(key)) : 0;
+    }
+
+    void setKey(pthread_key_t key, intptr_t value) {
+        if (gKeysCreated) {
+            pthread_setspecific(key, reinterpret_cast<void*>(value));
+        }
+    }
+
+    struct Backtrace {
+        uintptr_t frames[kMaxFrames];
+        int       count = 0;
+        int       skip = 1;
+    };
+
+    _Unwind_Reason_Code unwindFrame(struct _Unwind_Context* context, void* arg) {
+        auto*     trace = static_cast<Backtrace*>(arg);
+        uintptr_t pc = _Unwind_GetIP(context);
+        // Skip the frame of onBlockingCall itself.
+        if (pc != 0 && trace->skip-- <= 0 && trace->count < kMaxFrames) {
+            trace->frames[trace->count++] = pc;
+        }
+        return trace->count < kMaxFrames ? _URC_NO_REASON : _URC_END_OF_STACK;
+    }
+
+    // Hash of the innermost frames outside this file, to report each call site once.
+    uintptr_t siteOf(const Backtrace& trace) {
+        uintptr_t site = 0;
+        for (int i = 0; i < trace.count && i < 8; ++i) {
+            site = site * 31 + trace.frames[i];
+        }
+        return site == 0 ? 1 : site;
+    }
+
+    bool firstReportOf(uintptr_t site) {
+        for (auto& slot : gReportedSites) {
+            uintptr_t expected = 0;
+            if (slot.compare_exchange_strong(expected, site) || expected == site) {
+                return expected == 0;
+            }
+        }
+        return false;
+    }
+
+    void printBacktrace(const Backtrace& trace) {
+        for (int i = 0; i < trace.count; ++i) {
+            Dl_info info {};
+            if (dladdr(reinterpret_cast<void*>(trace.frames[i]), &info) != 0 && info.dli_sname != nullptr) {
+                LOGE("  #%02d pc %p %s+%zu (%s)", i, reinterpret_cast<void*>(trace.frames[i]), info.dli_sname,
+                     static_cast<size_t>(trace.frames[i] - reinterpret_cast<uintptr_t>(info.dli_saddr)),
+                     info.dli_fname);
+            } else {
+                LOGE("  #%02d pc %p (%s)", i, reinterpret_cast<void*>(trace.frames[i]),
+                     info.dli_fname != nullptr ? info.dli_fname : "?");
+            }
+        }
+    }
+
+    /**
+     * The next definition of an interposed function, looked up on first use. A plain atomic rather
+     * than a function-local static, whose initialization guard may itself take a lock.
+     */
+    template <typename Fn>
+    class RealFunction {
+      public:
+        constexpr explicit RealFunction(const char* name) : mName(name) { }
+
+        Fn get() {
+            Fn fn = mFunction.load(std::memory_order_relaxed);
+            if (fn == nullptr) {
+                fn = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, mName));
+                mFunction.store(fn, std::memory_order_relaxed);
+            }
+            return fn;
+        }
+
+      private:
+        const char*     mName;
+        std::atomic<Fn> mFunction { nullptr };
+    };
+}  // namespace
+
+namespace rt_check {
+
+    void enterRealtime() { setKey(gDepthKey, getKey(gDepthKey) + 1); }
+
+    void exitRealtime() { setKey(gDepthKey, getKey(gDepthKey) - 1); }
+
+    bool isRealtime() { return getKey(gDepthKey) > 0; }
+
+    void onBlockingCall(const char* what) {
+        if (!isRealtime() || getKey(gReportingKey) != 0) {
+            return;
+        }
+        // Reporting logs and allocates, so the calls it makes are not violations themselves.
+        setKey(gReportingKey, 1);
+        gViolations.fetch_add(1, std::memory_order_relaxed);
+
+        Backtrace trace;
+        _Unwind_Backtrace(unwindFrame, &trace);
+        if (firstReportOf(siteOf(trace))) {
+            LOGE("Real-time violation: %s inside the audio callback", what);
+            printBacktrace(trace);
+        }
+        if (gAbortOnViolation.load(std::memory_order_relaxed)) {
+            LOGF("Aborting on real-time violation: %s", what);
+            abort();
+        }
+        setKey(gReportingKey, 0);
+    }
+
+    uint64_t getViolationCount() { return gViolations.load(std::memory_order_relaxed); }
+
+    void setAbortOnViolation(bool abortOnViolation) { gAbortOnViolation = abortOnViolation; }
+
+}  // namespace rt_check
+
+// Interposers
+
+#if defined(__GLIBC__)
+// glibc's dlsym allocates, so the allocator is reached through its internal entry points instead.
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void  __libc_free(void*);
+#    define REAL_MALLOC __libc_malloc
+#    define REAL_CALLOC __libc_calloc
+#    define REAL_REALLOC __libc_realloc
+#    define REAL_FREE __libc_free
+#else
+constinit RealFunction<void* (*)(size_t)>         gMalloc("malloc");
+constinit RealFunction<void* (*)(size_t, size_t)> gCalloc("calloc");
+constinit RealFunction<void* (*)(void*, size_t)>  gRealloc("realloc");
+constinit RealFunction<void (*)(void*)>           gFree("free");
+#    define REAL_MALLOC gMalloc.get()
+#    define REAL_CALLOC gCalloc.get()
+#    define REAL_REALLOC gRealloc.get()
+#    define REAL_FREE gFree.get()
+#endif
+
+namespace {
+    constinit RealFunction<int (*)(void**, size_t, size_t)>         gPosixMemalign("posix_memalign");
+    constinit RealFunction<void* (*)(size_t, size_t)>               gAlignedAlloc("aligned_alloc");
+    constinit RealFunction<int (*)(pthread_mutex_t*)>               gMutexLock("pthread_mutex_lock");
+    constinit RealFunction<int (*)(pthread_mutex_t*)>               gMutexTryLock("pthread_mutex_trylock");
+    constinit RealFunction<int (*)(const char*, int, ...)>          gOpen("open");
+    constinit RealFunction<int (*)(int, const char*, int, ...)>     gOpenAt("openat");
+    constinit RealFunction<FILE* (*)(const char*, const char*)>     gFopen("fopen");
+    constinit RealFunction<ssize_t (*)(int, void*, size_t)>         gRead("read");
+    constinit RealFunction<ssize_t (*)(int, const void*, size_t)>   gWrite("write");
+    constinit RealFunction<int (*)(int)>                            gClose("close");
+}  // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    rt_check::onBlockingCall("malloc");
+    return REAL_MALLOC(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    rt_check::onBlockingCall("calloc");
+    return REAL_CALLOC(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    rt_check::onBlockingCall("realloc");
+    return REAL_REALLOC(ptr, size);
+}
+
+void free(void* ptr) {
+    if (ptr != nullptr) {
+        rt_check::onBlockingCall("free");
+    }
+    REAL_FREE(ptr);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    rt_check::onBlockingCall("posix_memalign");
+    return gPosixMemalign.get()(ptr, alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    rt_check::onBlockingCall("aligned_alloc");
+    return gAlignedAlloc.get()(alignment, size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (!rt_check::isRealtime()) {
+        return gMutexLock.get()(mutex);
+    }
+    // Even an uncontended lock can invert priorities, but say when it actually had to wait.
+    if (gMutexTryLock.get()(mutex) == 0) {
+        rt_check::onBlockingCall("pthread_mutex_lock");
+        return 0;
+    }
+    rt_check::onBlockingCall("pthread_mutex_lock (waited)");
+    return gMutexLock.get()(mutex);
+}
+
+int open(const char* path, int flags, ...) {
+    rt_check::onBlockingCall("open");
+    va_list args;
+    va_start(args, flags);
+    const mode_t mode = (flags & O_CREAT) != 0 ? static_cast<mode_t>(va_arg(args, int)) : 0;
+    va_end(args);
+    return gOpen.get()(path, flags, mode);
+}
+
+int openat(int dirFd, const char* path, int flags, ...) {
+    rt_check::onBlockingCall("openat");
+    va_list args;
+    va_start(args, flags);
+    const mode_t mode = (flags & O_CREAT) != 0 ? static_cast<mode_t>(va_arg(args, int)) : 0;
+    va_end(args);
+    return gOpenAt.get()(dirFd, path, flags, mode);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+    rt_check::onBlockingCall("fopen");
+    return gFopen.get()(path, mode);
+}
+
+ssize_t read(int fd, void* buffer, size_t count) {
+    rt_check::onBlockingCall("read");
+    return gRead.get()(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void* buffer, size_t count) {
+    rt_check::onBlockingCall("write");
+    return gWrite.get()(fd, buffer, count);
+}
+
+int close(int fd) {
+    rt_check::onBlockingCall("close");
+    return gClose.get()(fd);
+}
+
+}  // extern "C"
+
+// The replaceable global operators go through the interposed malloc and free, so they only need
+// defining to bind the library's own new and delete to them.
+void* operator new(size_t size) {
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete[](void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
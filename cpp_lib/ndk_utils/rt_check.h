@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Real-time safety checker for the audio callback.
+ *
+ * Build with AUDIO_RT_CHECK=1 (and ndk_utils/rt_check.cpp) to report every allocation, mutex lock,
+ * file operation and log call made on a thread while it is inside an audio callback, each with a
+ * stack trace. The callbacks mark themselves with ScopedRealtime. Without AUDIO_RT_CHECK everything
+ * here compiles to nothing.
+ */
+namespace rt_check {
+
+#if AUDIO_RT_CHECK
+    void enterRealtime();
+    void exitRealtime();
+    bool isRealtime();
+
+    /**
+     * Record a blocking call if the current thread is inside an audio callback.
+     */
+    void onBlockingCall(const char* what);
+
+    uint64_t getViolationCount();
+
+    // Abort on the first violation, also enabled by AUDIO_RT_CHECK_ABORT=1 in the environment.
+    void setAbortOnViolation(bool abortOnViolation);
+#else
+    inline void enterRealtime() { }
+
+    inline void exitRealtime() { }
+
+    inline bool isRealtime() { return false; }
+
+    inline void onBlockingCall(const char*) { }
+
+    inline uint64_t getViolationCount() { return 0; }
+
+    inline void setAbortOnViolation(bool) { }
+#endif
+
+    /**
+     * Marks the current thread as real-time for the lifetime of the object. Scopes may nest.
+     */
+    class ScopedRealtime {
+      public:
+        ScopedRealtime() { enterRealtime(); }
+
+        ~ScopedRealtime() { exitRealtime(); }
+
+        ScopedRealtime(const ScopedRealtime&) = delete;
+        ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+    };
+
+}  // namespace rt_check
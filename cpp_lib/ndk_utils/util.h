@@ -12,6 +12,11 @@ inline uint64_t get_time_millis() {
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
+inline int64_t get_time_nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 inline double get_time_second() {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -0,0 +1,73 @@
+#include "ndk_utils/worker_pool.h"
+
+#include "ndk_utils/cpu_topology.h"
+
+WorkerPool::WorkerPool(int32_t threadCount, const std::vector<int>& cpus) {
+    for (int32_t i = 0; i + 1 < threadCount; ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        mWorkers.emplace_back(&WorkerPool::workerLoop, this, cpu);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    mJobReady.notify_all();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::runJob(int32_t taskCount, TaskFunction function, void* context) {
+    if (taskCount <= 1 || mWorkers.empty()) {
+        for (int32_t index = 0; index < taskCount; ++index) {
+            function(context, index);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mFunction = function;
+        mContext = context;
+        mTaskCount = taskCount;
+        mNextTask.store(0, std::memory_order_relaxed);
+        mBusyWorkers = static_cast<int32_t>(mWorkers.size());
+        ++mJobSequence;
+    }
+    mJobReady.notify_all();
+    runTasks();
+    // Every worker checks in, even one which woke too late to find a task, before the job may change.
+    std::unique_lock<std::mutex> lock(mLock);
+    mJobDone.wait(lock, [this]() { return mBusyWorkers == 0; });
+}
+
+void WorkerPool::runTasks() {
+    for (int32_t index = mNextTask.fetch_add(1, std::memory_order_relaxed); index < mTaskCount;
+         index = mNextTask.fetch_add(1, std::memory_order_relaxed)) {
+        mFunction(mContext, index);
+    }
+}
+
+void WorkerPool::workerLoop(int cpu) {
+    if (cpu >= 0) {
+        cpu_topology::setCurrentThreadAffinity({cpu});
+    }
+    uint64_t jobSequence = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mJobReady.wait(lock, [&]() { return mStopping || mJobSequence != jobSequence; });
+            if (mStopping) {
+                return;
+            }
+            jobSequence = mJobSequence;
+        }
+        runTasks();
+        std::lock_guard<std::mutex> lock(mLock);
+        if (--mBusyWorkers == 0) {
+            mJobDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A fixed set of threads which run the tasks of one job at a time, such as the row bands of a camera
+ * frame, so that no thread is created per job.
+ *
+ * run() hands the task indices out to the workers and to the calling thread, which takes its share,
+ * and returns when every task has finished. Between jobs the workers wait on a condition variable.
+ * Each worker is pinned to one of the CPUs it was given, in turn, or left to the scheduler if there
+ * are none. Jobs come from one thread at a time.
+ */
+class WorkerPool {
+  public:
+    /**
+     * @param threadCount - the threads running a job, counting the caller, so threadCount - 1 workers
+     * @param cpus - the CPUs to pin the workers to, one each in turn
+     */
+    explicit WorkerPool(int32_t threadCount, const std::vector<int>& cpus = {});
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int32_t getThreadCount() const { return static_cast<int32_t>(mWorkers.size()) + 1; }
+
+    /**
+     * How many tasks to split work into so each gets at least minWorkPerTask of it, at most one per
+     * thread: 1 for jobs too small to pay for waking the workers.
+     */
+    int32_t getTaskCount(int64_t work, int64_t minWorkPerTask) const {
+        return static_cast<int32_t>(std::clamp<int64_t>(work / std::max<int64_t>(minWorkPerTask, 1), 1,
+                                                        getThreadCount()));
+    }
+
+    /**
+     * Call task(index) for every index from 0 to taskCount - 1, across the pool, and wait for them.
+     * With a single task, or no workers, everything runs on the calling thread.
+     */
+    template <typename Task>
+    void run(int32_t taskCount, Task&& task) {
+        using TaskType = std::remove_reference_t<Task>;
+        runJob(
+                taskCount,
+                [](void* context, int32_t index) { (*static_cast<TaskType*>(context))(index); },
+                const_cast<void*>(static_cast<const void*>(&task)));
+    }
+
+  private:
+    using TaskFunction = void (*)(void* context, int32_t index);
+
+    void runJob(int32_t taskCount, TaskFunction function, void* context);
+    void runTasks();
+    void workerLoop(int cpu);
+
+    std::vector<std::thread> mWorkers;
+
+    std::mutex              mLock;
+    std::condition_variable mJobReady;
+    std::condition_variable mJobDone;
+    uint64_t                mJobSequence = 0;  // guarded by mLock, as are the two below
+    int32_t                 mBusyWorkers = 0;  // workers which have not finished the current job
+    bool                    mStopping = false;
+
+    // The current job, set before the workers are woken and left alone until they are all done.
+    TaskFunction         mFunction = nullptr;
+    void*                mContext = nullptr;
+    int32_t              mTaskCount = 0;
+    std::atomic<int32_t> mNextTask { 0 };
+};
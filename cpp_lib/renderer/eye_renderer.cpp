@@ -1,9 +1,24 @@
 #include "eye_renderer.h"
 #include <GLES2/gl2.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "ndk_utils/log.h"
 
+// Mouth opening per unit of output RMS
+static const float MOUTH_LEVEL_GAIN = 4.0f;
+// Treble level in dB which lights the iris fully, and the range below it which fades it out
+static const float IRIS_GLOW_TOP_DB = -20.0f;
+static const float IRIS_GLOW_RANGE_DB = 40.0f;
+static const float IRIS_GLOW_DECAY = 4.0f;  // per second
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000;
+}
+
 // Random float in [-r, r]
 static float jitter(float r) {
     return r * (2.0f * ((float)(rand() / RAND_MAX)) - 1.0f);
@@ -94,11 +109,12 @@ void EyeRenderer::resize(int width, int height) {
     aspectRatio = (float)width / (height ? height : 1);
 }
 
-void EyeRenderer::playMouth() {
-    LOGI("playMouth");
+void EyeRenderer::playMouth(float delaySeconds) {
+    LOGI("playMouth %f", delaySeconds);
     if (mouthPlayer.state != PLAYING) {
         mouthPlayer.state = PLAYING;
-        mouthPlayer.playTime = 0.0f;
+        // The mouth stays closed until the play time reaches zero.
+        mouthPlayer.playTime = -delaySeconds;
     }
 }
 
@@ -133,6 +149,68 @@ void EyeRenderer::update(float deltaTime) {
             mouthPlayer.playTime = 0.0f;
         }
     }
+
+    followAudioEnvelope();
+    followAudioSpectrum(deltaTime);
+}
+
+void EyeRenderer::setAudioEnvelope(const EnvelopeFollower* envelope) {
+    audioEnvelope = envelope;
+    envelopeCount = 0;
+}
+
+void EyeRenderer::setOutputLatency(float seconds) {
+    outputLatency = seconds;
+}
+
+void EyeRenderer::setAudioSpectrum(const SpectrumAnalyzer* spectrum) {
+    audioSpectrum = spectrum;
+    irisGlow = 0.0f;
+}
+
+void EyeRenderer::followAudioSpectrum(float deltaTime) {
+    if (audioSpectrum == nullptr) {
+        return;
+    }
+    // Rises at once with the upper half of the bands and falls back slowly
+    irisGlow = fmaxf(0.0f, irisGlow - IRIS_GLOW_DECAY * deltaTime);
+    SpectrumAnalyzer::Spectrum spectrum;
+    if (audioSpectrum->read(spectrum) && spectrum.sequence != lastSpectrumSequence) {
+        lastSpectrumSequence = spectrum.sequence;
+        float treble = SpectrumAnalyzer::kFloorDb;
+        for (int band = SpectrumAnalyzer::kBandCount / 2; band < SpectrumAnalyzer::kBandCount; ++band) {
+            treble = fmaxf(treble, spectrum.bandsDb[band]);
+        }
+        float glow = (treble - IRIS_GLOW_TOP_DB + IRIS_GLOW_RANGE_DB) / IRIS_GLOW_RANGE_DB;
+        irisGlow = fmaxf(irisGlow, fminf(1.0f, glow));
+    }
+}
+
+void EyeRenderer::followAudioEnvelope() {
+    if (audioEnvelope == nullptr) {
+        return;
+    }
+    EnvelopeFollower::Envelope envelope;
+    if (audioEnvelope->read(envelope) && envelope.sequence != lastEnvelopeSequence) {
+        lastEnvelopeSequence = envelope.sequence;
+        if (envelopeCount == ENVELOPE_HISTORY) {
+            memmove(envelopeHistory, envelopeHistory + 1, sizeof(HeardLevel) * (ENVELOPE_HISTORY - 1));
+            --envelopeCount;
+        }
+        envelopeHistory[envelopeCount++] = {(double)envelope.renderNanos / 1000000000 + outputLatency, envelope.level};
+    }
+
+    // The latest level already heard, older ones are no longer needed
+    const double now = monotonicSeconds();
+    int heard = 0;
+    while (heard < envelopeCount && envelopeHistory[heard].time <= now) {
+        ++heard;
+    }
+    if (heard > 0) {
+        mouthOpen = fminf(1.0f, envelopeHistory[heard - 1].level * MOUTH_LEVEL_GAIN);
+        envelopeCount -= heard - 1;
+        memmove(envelopeHistory, envelopeHistory + heard - 1, sizeof(HeardLevel) * envelopeCount);
+    }
 }
 
 void EyeRenderer::render() {
@@ -171,7 +249,7 @@ void EyeRenderer::render() {
     }
 
     // Draw mouth
-    drawMouth(time, mouthValue, 0.0f);  // Smile whe
+    drawMouth(time, mouthValue, mouthOpen);  // Smile whe
 
     glDisableVertexAttribArray(attribPosition);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -236,7 +314,8 @@ void EyeRenderer::drawIris(const Eye& eye, float idleOffset) {
     buildCircle(cx, cy, irx, iry, circleVertices);
 
     glVertexAttribPointer(attribPosition, 2, GL_FLOAT, GL_FALSE, 0, circleVertices);
-    glUniform4f(uniformColor, 0.2f, 0.4f, 0.8f, 1.0f);  // Blue
+    // Blue, towards cyan with the treble
+    glUniform4f(uniformColor, 0.2f + 0.3f * irisGlow, 0.4f + 0.5f * irisGlow, 0.8f + 0.2f * irisGlow, 1.0f);
     glDrawArrays(GL_TRIANGLE_FAN, 0, SEGMENTS);
 }
 
@@ -4,6 +4,8 @@
 #include <math.h>
 #include <GLES3/gl32.h>
 
+#include "audio/EnvelopeFollower.h"
+#include "audio/SpectrumAnalyzer.h"
 #include "input_handler.h"
 
 // 2D vector helper
@@ -40,10 +42,18 @@ public:
     // Animation control
     void playBlink(float scale = 1.0f);
     void playSleepy(float scale = 1.0f);
-    void playMouth();
+    // Open the mouth after a delay, e.g. when a sound scheduled ahead is heard
+    void playMouth(float delaySeconds = 0.0f);
     void setWrinkle(float strength);
     void enableIdle(bool enabled);
 
+    // Open the mouth with the level of the audio output. update() reads the envelope and shows each
+    // value once the audio it was measured on is heard, outputLatency after it was rendered.
+    void setAudioEnvelope(const EnvelopeFollower* envelope);
+    void setOutputLatency(float seconds);
+    // Brighten the iris with the treble of the audio output, as measured by the analyzer.
+    void setAudioSpectrum(const SpectrumAnalyzer* spectrum);
+
     // Access current time
     float getTime() const { return time; }
 
@@ -62,6 +72,24 @@ private:
     float wrinkleLevel = 0.0f;
     bool idleEnabled = true;
 
+    // Audio envelope, oldest first, waiting for the time it is heard
+    struct HeardLevel {
+        double time;
+        float level;
+    };
+    static const int ENVELOPE_HISTORY = 16;
+    const EnvelopeFollower* audioEnvelope = nullptr;
+    HeardLevel envelopeHistory[ENVELOPE_HISTORY];
+    int envelopeCount = 0;
+    uint64_t lastEnvelopeSequence = 0;
+    float outputLatency = 0.0f;
+    float mouthOpen = 0.0f;
+
+    // Audio spectrum, smoothed
+    const SpectrumAnalyzer* audioSpectrum = nullptr;
+    uint64_t lastSpectrumSequence = 0;
+    float irisGlow = 0.0f;
+
     // Eye geometry
     struct Eye {
         float cx, cy;
@@ -100,6 +128,8 @@ private:
     void handleButton(float x, float y, int button, int bDown) override;
 
     void drawMouth(float t, float smileFactor, float openFactor);
+    void followAudioEnvelope();
+    void followAudioSpectrum(float deltaTime);
 
 };
 
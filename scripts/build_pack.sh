@@ -39,8 +39,31 @@ $ANDROID_HOME/build-tools/${BUILD_TOOLS_VERSION}/aapt2 link \
    build/res-compiled/*.flat
 
 echo "Add assets to apk"
-find assets -type f -exec zip build/apk/app-unaligned.apk {} \;
+# Audio is stored uncompressed so AAsset_getBuffer maps it in place instead of inflating a copy.
+find assets -type f -exec zip -n .mp3:.wav:.flac build/apk/app-unaligned.apk {} \;
+
+echo "Add MP3 seek indexes to apk"
+# The app opens and seeks an MP3 without walking it when <name>.mp3.idx sits next to it, see Mp3FrameIndex.
+mkdir -p build/index/assets
+if bash cpp_lib/host/build.sh mp3_index && build/host/mp3_index build/index/assets assets/*.mp3; then
+    cd build/index
+    zip -g ../apk/app-unaligned.apk assets/*.idx
+    cd ../..
+else
+    echo "MP3 seek indexes skipped, the app falls back to the Xing header and decoding from the start"
+fi
 
+echo "Add PCM pack to apk"
+# Clips transcoded to 48 kHz stereo int16 play from the mapped pack with no decoding, see PcmPack.
+# Stored uncompressed like the audio, so AAsset_getBuffer maps it in place.
+mkdir -p build/pack/assets
+if bash cpp_lib/host/build.sh pcm_pack && build/host/pcm_pack build/pack/assets/clips.pcmpack assets/*.mp3; then
+    cd build/pack
+    zip -n .pcmpack -g ../apk/app-unaligned.apk assets/clips.pcmpack
+    cd ../..
+else
+    echo "PCM pack skipped, the app decodes each clip on its first trigger"
+fi
 
 echo "Add DEX file to APK"
 if [[ -d build/dex ]]; then
@@ -72,8 +95,11 @@ fi
 
 
 echo "Align the APK with zipalign"
+# Page alignment rather than 4 bytes: the clips of the PCM pack start on 4096 byte boundaries of the
+# pack, which are only page boundaries of the mapping if the entry itself starts on one. zipalign
+# applies one alignment to every stored entry, so the other uncompressed assets are padded too.
 $ANDROID_HOME/build-tools/34.0.0/zipalign \
-  -f 4 \
+  -f 4096 \
   build/apk/app-unaligned.apk \
   build/apk/app-aligned.apk
 
@@ -93,7 +119,9 @@ else
 fi
 
 echo "Sign the APK"
+# Keep the page alignment zipalign gave the stored entries.
 $ANDROID_HOME/build-tools/34.0.0/apksigner sign \
+  --alignment-preserved \
   --key-pass pass:android \
   --ks-pass pass:android \
   --ks mykey.jks \